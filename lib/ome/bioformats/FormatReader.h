@@ -49,6 +49,7 @@
 #include <ome/bioformats/FormatHandler.h>
 #include <ome/bioformats/MetadataConfigurable.h>
 #include <ome/bioformats/MetadataMap.h>
+#include <ome/bioformats/PlaneRegion.h>
 #include <ome/bioformats/Types.h>
 
 #include <ome/compat/array.h>
@@ -81,6 +82,19 @@ namespace ome
           CANNOT_GROUP ///< Files can not be grouped.
         };
 
+      /// Plane prefetch counters.
+      struct PrefetchStatistics
+      {
+        /// Number of planes read from prefetched planes.
+        dimension_size_type hits;
+        /// Number of planes read directly.
+        dimension_size_type misses;
+        /// Total number of planes prefetched.
+        dimension_size_type prefetched;
+        /// Total number of prefetched planes discarded unused.
+        dimension_size_type discarded;
+      };
+
     protected:
       /**
        * Sentry for saving and restoring reader series state.
@@ -563,6 +577,13 @@ namespace ome
        * w * h * bytesPerPixel * getRGBChannelCount(channel)
        * \endcode
        *
+       * If the destination buffer is already of the correct size,
+       * pixel type and storage order, it will be filled in place
+       * without reallocation.  This permits reading directly into
+       * caller-owned memory by using a VariantPixelBuffer
+       * referencing external storage.  If the destination buffer is
+       * incompatible and uses internal storage, it will be resized.
+       *
        * @param plane the plane index within the series.
        * @param buf the destination pixel buffer.
        * @param x the @c X coordinate of the upper-left corner of the sub-image.
@@ -571,6 +592,8 @@ namespace ome
        * @param h the height of the sub-image.
        * @throws FormatException if there was a problem parsing the metadata of the
        *   file.
+       * @throws std::logic_error if the destination pixel buffer
+       *   uses incompatible external storage.
        */
       virtual
       void
@@ -581,6 +604,114 @@ namespace ome
                 dimension_size_type w,
                 dimension_size_type h) const = 0;
 
+      /**
+       * Obtain a range of image planes.
+       *
+       * Obtain and copy the image planes within the specified @c Z,
+       * @c C and @c T ranges of the current series into a single
+       * VariantPixelBuffer.  The buffer @c Z, @c C and @c T extents
+       * are the sizes of the respective ranges; the buffer storage
+       * order follows the DimensionOrder of the series, so each
+       * plane occupies a contiguous block of storage.
+       *
+       * This is equivalent to calling openBytes() for each plane in
+       * the range, but avoids the overhead of separate calls.  If
+       * the reader's plane layout matches the buffer storage order,
+       * planes after the first are also read in place, without
+       * intermediate copies.
+       *
+       * @param start the first @c Z, @c C and @c T coordinate
+       * (effective sizes).
+       * @param count the number of @c Z, @c C and @c T planes.
+       * @param buf the destination pixel buffer.
+       * @throws FormatException if there was a problem parsing the
+       *   metadata of the file.
+       * @throws std::logic_error if the range is invalid, or the
+       *   channels in the range have differing numbers of samples.
+       */
+      virtual
+      void
+      openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                 const ome::compat::array<dimension_size_type, 3>& count,
+                 VariantPixelBuffer&                               buf) const = 0;
+
+      /**
+       * Obtain a sub-image of a range of image planes.
+       *
+       * As openPlanes(), but for the specified sub-image of each
+       * plane only.  As for openBytes(), if the destination buffer is
+       * already of the correct size, pixel type and storage order, it
+       * will be filled in place without reallocation.
+       *
+       * @param start the first @c Z, @c C and @c T coordinate
+       * (effective sizes).
+       * @param count the number of @c Z, @c C and @c T planes.
+       * @param buf the destination pixel buffer.
+       * @param x the @c X coordinate of the upper-left corner of the sub-image.
+       * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+       * @param w the width of the sub-image.
+       * @param h the height of the sub-image.
+       * @throws FormatException if there was a problem parsing the
+       *   metadata of the file.
+       * @throws std::logic_error if the range is invalid, the
+       *   channels in the range have differing numbers of samples,
+       *   or the destination pixel buffer uses incompatible external
+       *   storage.
+       */
+      virtual
+      void
+      openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                 const ome::compat::array<dimension_size_type, 3>& count,
+                 VariantPixelBuffer&                               buf,
+                 dimension_size_type                               x,
+                 dimension_size_type                               y,
+                 dimension_size_type                               w,
+                 dimension_size_type                               h) const = 0;
+
+      /**
+       * Obtain multiple sub-images of an image plane.
+       *
+       * Obtain and copy each of the specified regions of the
+       * specified image plane from the current series into a
+       * separate VariantPixelBuffer.  The buffer vector is resized
+       * to the number of regions.  Each buffer is filled as for
+       * openBytes().
+       *
+       * This is equivalent to calling openBytes() for each region,
+       * but readers may implement it more efficiently, for example
+       * by reading and decoding each tile shared by several regions
+       * only once.
+       *
+       * @param plane the plane index within the series.
+       * @param bufs the destination pixel buffers, one per region.
+       * @param regions the sub-images to read.
+       * @throws FormatException if there was a problem parsing the
+       *   metadata of the file.
+       * @throws std::logic_error if a destination pixel buffer
+       *   uses incompatible external storage.
+       */
+      virtual
+      void
+      openRegions(dimension_size_type              plane,
+                  std::vector<VariantPixelBuffer>& bufs,
+                  const std::vector<PlaneRegion>&  regions) const = 0;
+
+      /**
+       * Prefetch image planes.
+       *
+       * Hint that the specified planes of the current series will be
+       * read next with openBytes(), in the order specified.  The
+       * planes are read on a background thread, up to the prefetch
+       * depth, replacing any pending prefetch.  This has no effect if
+       * prefetching is disabled.
+       *
+       * @param planes the plane indexes within the series.
+       * @see setPrefetch()
+       */
+      virtual
+      void
+      prefetchPlanes(const std::vector<dimension_size_type>& planes) const = 0;
+
       /**
        * Obtain a thumbnail of an image plane.
        *
@@ -676,6 +807,12 @@ namespace ome
       /**
        * Specifies whether or not to save proprietary metadata
        * in the MetadataStore.
+       *
+       * The metadata is saved when the MetadataStore is first
+       * accessed with getMetadataStore() after setId(), so there is
+       * no cost if the MetadataStore is not used.  If the
+       * MetadataStore was set with setMetadataStore(), the metadata
+       * is saved by setId().
        */
       virtual
       void
@@ -713,6 +850,43 @@ namespace ome
       bool
       isGroupFiles() const = 0;
 
+      /**
+       * Set plane prefetch depth.
+       *
+       * If nonzero, sequential or strided reads of planes with
+       * openBytes() (for example stepping through @c Z or @c T) are
+       * detected, and the following planes are read ahead on a
+       * background thread.  A subsequent openBytes() call for a
+       * prefetched plane will then be satisfied from memory.  At most
+       * @p depth planes are held in memory.  Prefetching is disabled
+       * by default.
+       *
+       * @param depth the number of planes to read ahead; zero to
+       * disable.
+       */
+      virtual
+      void
+      setPrefetch(dimension_size_type depth) = 0;
+
+      /**
+       * Get plane prefetch depth.
+       *
+       * @returns the number of planes to read ahead; zero if
+       * disabled.
+       */
+      virtual
+      dimension_size_type
+      getPrefetch() const = 0;
+
+      /**
+       * Get plane prefetch counters.
+       *
+       * @returns the counters.
+       */
+      virtual
+      PrefetchStatistics
+      getPrefetchStatistics() const = 0;
+
       /**
        * Get status of metadata parsing.
        *
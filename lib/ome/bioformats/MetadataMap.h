@@ -74,7 +74,10 @@ namespace ome
      * The get() methods permit retrieval of values.  There are
      * various forms, which offer different tradeoffs, for example
      * copying the value and returning an error, versus returning a
-     * direct reference but throwing an exception on error.
+     * direct reference but throwing an exception on error.  The
+     * forms returning an error, along with set() and append(), do
+     * not use exceptions internally, and so are suitable for use
+     * when storing large numbers of keys.
      */
     class MetadataMap
     {
@@ -190,11 +193,11 @@ namespace ome
       set(const key_type&   key,
           const value_type& value)
       {
-        iterator i = find(key);
-        if (i != end())
-          erase(i);
-        map_type::value_type newvalue(key, value);
-        insert(newvalue);
+        iterator i = discriminating_map.lower_bound(key);
+        if (i != end() && i->first == key)
+          i->second = value;
+        else
+          discriminating_map.insert(i, map_type::value_type(key, value));
       }
 
       /**
@@ -232,12 +235,11 @@ namespace ome
       {
         typedef typename std::vector<T> list_type;
 
-        try
-          {
-            list_type& list(get<list_type>(key));
-            list.push_back(value);
-          }
-        catch (const boost::bad_get&)
+        iterator i = find(key);
+        list_type *list = i != end() ? boost::get<list_type>(&i->second) : 0;
+        if (list)
+          list->push_back(value);
+        else
           {
             list_type new_list;
             new_list.push_back(value);
@@ -282,15 +284,16 @@ namespace ome
       get(const key_type& key,
           T&              value) const
       {
-        try
-          {
-            value = get<T>(key);
-            return true;
-          }
-        catch (const boost::bad_get&)
-          {
-            return false;
-          }
+        const_iterator i = find(key);
+        if (i == end())
+          return false;
+
+        const T *v = boost::get<T>(&i->second);
+        if (!v)
+          return false;
+
+        value = *v;
+        return true;
       }
 
       /**
@@ -442,15 +445,40 @@ namespace ome
       merge(const MetadataMap& map,
             const std::string& prefix)
       {
+        // The prefixed keys remain in sorted order, so each key is
+        // usually inserted immediately after the last.
+        iterator hint = discriminating_map.lower_bound(prefix);
         for (const_iterator i = map.begin();
              i != map.end();
              ++i)
           {
             map_type::value_type v(prefix + i->first, i->second);
-            insert(v);
+            hint = discriminating_map.insert(hint, v);
           }
       }
 
+      /**
+       * Get the range of keys with a common prefix.
+       *
+       * This may be used to view a subset of the map, for example the
+       * keys for a single series after merging with a prefix, without
+       * copying.
+       *
+       * @param keyprefix the key prefix.
+       * @returns a pair of iterators delimiting the range of keys
+       * starting with @p keyprefix.
+       */
+      std::pair<const_iterator, const_iterator>
+      prefix(const std::string& keyprefix) const
+      {
+        const_iterator first = discriminating_map.lower_bound(keyprefix);
+        const_iterator last = first;
+        while (last != end() &&
+               last->first.compare(0, keyprefix.size(), keyprefix) == 0)
+          ++last;
+        return std::make_pair(first, last);
+      }
+
       /**
        * Create a flattened map.
        *
@@ -463,6 +491,25 @@ namespace ome
       MetadataMap
       flatten() const;
 
+      /**
+       * Flatten this map.
+       *
+       * This is equivalent to flatten(), but vectors are replaced in
+       * place, avoiding a copy of all the other values in the map.
+       * Flattened elements do not replace existing keys.
+       */
+      void
+      flattenInPlace();
+
+      /**
+       * Check if the map contains any vectors.
+       *
+       * @returns @c true if any values are vectors, @c false if the
+       * map is already flat.
+       */
+      bool
+      hasLists() const;
+
       /**
        * Get the underlying map.
        *
@@ -882,6 +929,36 @@ namespace ome
         }
       };
 
+      /**
+       * Visitor to check if a MetadataMap value is a vector.
+       */
+      struct MetadataMapIsListVisitor : public boost::static_visitor<bool>
+      {
+        /**
+         * Check a vector value of arbitrary type.
+         *
+         * @returns @c true.
+         */
+        template <typename T>
+        bool
+        operator() (const std::vector<T>& /* c */) const
+        {
+          return true;
+        }
+
+        /**
+         * Check a scalar value of arbitrary type.
+         *
+         * @returns @c false.
+         */
+        template <typename T>
+        bool
+        operator() (const T& /* v */) const
+        {
+          return false;
+        }
+      };
+
     }
 
     /**
@@ -942,6 +1019,46 @@ namespace ome
       return newmap;
     }
 
+    inline
+    void
+    MetadataMap::flattenInPlace()
+    {
+      for (map_type::iterator i = discriminating_map.begin();
+           i != discriminating_map.end();)
+        {
+          if (boost::apply_visitor(detail::MetadataMapIsListVisitor(), i->second))
+            {
+              MetadataMap elements;
+              boost::apply_visitor(detail::MetadataMapFlattenVisitor(elements, i->first), i->second);
+              // Elements sort after the vector key, so are inserted
+              // after the current position, and are skipped over
+              // since they are not vectors.
+              map_type::iterator hint = i;
+              for (map_type::iterator e = elements.discriminating_map.begin();
+                   e != elements.discriminating_map.end();
+                   ++e)
+                hint = discriminating_map.insert(hint, *e);
+              discriminating_map.erase(i++);
+            }
+          else
+            ++i;
+        }
+    }
+
+    inline
+    bool
+    MetadataMap::hasLists() const
+    {
+      for (map_type::const_iterator i = discriminating_map.begin();
+           i != discriminating_map.end();
+           ++i)
+        {
+          if (boost::apply_visitor(detail::MetadataMapIsListVisitor(), i->second))
+            return true;
+        }
+      return false;
+    }
+
   }
 }
 
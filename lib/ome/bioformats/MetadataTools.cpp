@@ -35,17 +35,20 @@
  * #L%
  */
 
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 
 #include <ome/bioformats/FormatException.h>
 #include <ome/bioformats/FormatTools.h>
 #include <ome/bioformats/MetadataTools.h>
 #include <ome/bioformats/PixelProperties.h>
 #include <ome/bioformats/XMLTools.h>
-
-#include <ome/compat/regex.h>
+#include <ome/bioformats/detail/XMLScan.h>
+#include <ome/bioformats/detail/XMLScanParser.h>
 
 #include <ome/common/xml/Platform.h>
 #include <ome/common/xml/String.h>
@@ -78,7 +81,6 @@
 #include <xercesc/sax/SAXException.hpp>
 #include <xercesc/sax2/DefaultHandler.hpp>
 #include <xercesc/sax2/SAX2XMLReader.hpp>
-#include <xercesc/sax2/XMLReaderFactory.hpp>
 
 // Include last due to side effect of MPL vector limit setting which can change the default
 #include <boost/lexical_cast.hpp>
@@ -126,8 +128,6 @@ namespace
       }
   }
 
-  const ome::compat::regex schema_match("^http://www.openmicroscopy.org/Schemas/OME/(.*)$");
-
   class OMEXMLVersionParser : public xercesc::DefaultHandler
   {
   public:
@@ -145,15 +145,10 @@ namespace
     {
       if (ome::common::xml::String(localname) == "OME")
         {
-          std::string ns = ome::common::xml::String(uri);
+          version = ome::bioformats::detail::getSchemaModelVersion(ome::common::xml::String(uri));
 
-          ome::compat::smatch found;
-
-          if (ome::compat::regex_match(ns, found, schema_match))
-            {
-              version = found[1];
-              throw xercesc::SAXException(ome::common::xml::String("Found schema version"));
-            }
+          if (!version.empty())
+            throw xercesc::SAXException(ome::common::xml::String("Found schema version"));
         }
     }
 
@@ -167,6 +162,371 @@ namespace
     std::string version;
   };
 
+  /**
+   * OME-XML document unsupported for streaming.
+   *
+   * The caller should fall back to parsing the full document.
+   */
+  class StreamUnsupported : public std::runtime_error
+  {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param message the reason streaming is not possible.
+     */
+    explicit
+    StreamUnsupported(const std::string& message):
+      std::runtime_error(message)
+    {}
+  };
+
+  /**
+   * Streaming OME-XML TiffData filter.
+   *
+   * TiffData elements (and their UUID children) are decoded as they
+   * are parsed, and are not retained.  All other content, including
+   * the first TiffData element of each Image, is copied to a reduced
+   * document, which is parsed to create the remainder of the model.
+   * Retaining one TiffData element keeps the reduced document valid,
+   * so it may be parsed with schema processing as for the full
+   * document.  For documents containing many TiffData elements,
+   * this avoids holding them in a DOM tree.
+   *
+   * Parsing is aborted with StreamUnsupported if the document is not
+   * at the current model version, or if any TiffData element can not
+   * be decoded; the caller should then fall back to parsing the full
+   * document.
+   */
+  class OMEXMLTiffDataFilter : public xercesc::DefaultHandler
+  {
+  public:
+    /// A decoded TiffData element.
+    struct TiffData
+    {
+      /// Image index.
+      ome::bioformats::dimension_size_type image;
+      /// TiffData index.
+      ome::bioformats::dimension_size_type index;
+      /// IFD attribute.
+      boost::optional<ome::bioformats::dimension_size_type> ifd;
+      /// FirstZ attribute.
+      boost::optional<ome::bioformats::dimension_size_type> firstZ;
+      /// FirstT attribute.
+      boost::optional<ome::bioformats::dimension_size_type> firstT;
+      /// FirstC attribute.
+      boost::optional<ome::bioformats::dimension_size_type> firstC;
+      /// PlaneCount attribute.
+      boost::optional<ome::bioformats::dimension_size_type> planeCount;
+      /// UUID value.
+      boost::optional<std::string> uuid;
+      /// UUID FileName attribute.
+      boost::optional<std::string> fileName;
+    };
+
+    OMEXMLTiffDataFilter():
+      xercesc::DefaultHandler(),
+      document("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"),
+      tiffData(),
+      current(),
+      inUUID(false),
+      text(),
+      depth(0U),
+      imageCount(0U),
+      tiffDataCount(0U)
+    {}
+
+    virtual ~OMEXMLTiffDataFilter() {}
+
+    void
+    startElement(const XMLCh* const         uri,
+                 const XMLCh* const         localname,
+                 const XMLCh* const         qname,
+                 const xercesc::Attributes& attrs)
+    {
+      const std::string name(ome::common::xml::String(localname));
+
+      if (depth == 0U &&
+          !ome::bioformats::detail::isCurrentModelRoot(name, ome::common::xml::String(uri)))
+        abort("Not an OME-XML document at the current model version");
+
+      if (current)
+        {
+          if (name != "UUID" || inUUID)
+            abort("Unexpected TiffData content");
+          inUUID = true;
+          text.clear();
+          const XMLCh *fileName = attrs.getValue(ome::common::xml::String("FileName"));
+          if (fileName)
+            current->fileName = std::string(ome::common::xml::String(fileName));
+          return;
+        }
+
+      if (name == "Image" && depth == 1U)
+        {
+          ++imageCount;
+          tiffDataCount = 0U;
+        }
+      else if (name == "TiffData" && imageCount && tiffDataCount++)
+        {
+          current = TiffData();
+          current->image = imageCount - 1U;
+          current->index = tiffDataCount - 1U;
+          for (XMLSize_t i = 0; i < attrs.getLength(); ++i)
+            {
+              const std::string attr(ome::common::xml::String(attrs.getLocalName(i)));
+              const std::string value(ome::common::xml::String(attrs.getValue(i)));
+              if (attr == "IFD")
+                current->ifd = parse(value);
+              else if (attr == "FirstZ")
+                current->firstZ = parse(value);
+              else if (attr == "FirstT")
+                current->firstT = parse(value);
+              else if (attr == "FirstC")
+                current->firstC = parse(value);
+              else if (attr == "PlaneCount")
+                current->planeCount = parse(value);
+            }
+          return;
+        }
+
+      document += '<';
+      document += std::string(ome::common::xml::String(qname));
+      for (XMLSize_t i = 0; i < attrs.getLength(); ++i)
+        {
+          document += ' ';
+          document += std::string(ome::common::xml::String(attrs.getQName(i)));
+          document += "=\"";
+          escape(ome::common::xml::String(attrs.getValue(i)), true);
+          document += '"';
+        }
+      document += '>';
+      ++depth;
+    }
+
+    void
+    endElement(const XMLCh* const /* uri */,
+               const XMLCh* const /* localname */,
+               const XMLCh* const qname)
+    {
+      if (current)
+        {
+          if (inUUID)
+            {
+              if (!text.empty())
+                current->uuid = text;
+              inUUID = false;
+            }
+          else
+            {
+              tiffData.push_back(*current);
+              current = boost::none;
+            }
+          return;
+        }
+
+      --depth;
+      document += "</";
+      document += std::string(ome::common::xml::String(qname));
+      document += '>';
+    }
+
+    void
+    characters(const XMLCh* const chars,
+               const XMLSize_t    length)
+    {
+      std::vector<XMLCh> buf(chars, chars + length);
+      buf.push_back(0);
+      const std::string value(ome::common::xml::String(&buf[0]));
+
+      if (current)
+        {
+          if (inUUID)
+            text += value;
+        }
+      else
+        escape(value, false);
+    }
+
+    /// Reduced document, without TiffData elements.
+    std::string document;
+    /// Decoded TiffData elements, in document order.
+    std::vector<TiffData> tiffData;
+
+  private:
+    /**
+     * Abort parsing.
+     *
+     * @param message the reason for stopping.
+     */
+    static void
+    abort(const std::string& message)
+    {
+      throw StreamUnsupported(message);
+    }
+
+    /**
+     * Parse a non-negative integer attribute.
+     *
+     * @param value the attribute value.
+     * @returns the parsed value.
+     */
+    static ome::bioformats::dimension_size_type
+    parse(const std::string& value)
+    {
+      try
+        {
+          return boost::lexical_cast<ome::bioformats::dimension_size_type>(value);
+        }
+      catch (const boost::bad_lexical_cast&)
+        {
+          abort("Invalid TiffData attribute");
+        }
+      return 0U;
+    }
+
+    /**
+     * Append escaped text to the reduced document.
+     *
+     * @param value the text to append.
+     * @param attribute @c true if an attribute value, @c false for
+     * element content.
+     */
+    void
+    escape(const std::string& value,
+           bool               attribute)
+    {
+      for (std::string::const_iterator i = value.begin();
+           i != value.end();
+           ++i)
+        {
+          switch (*i)
+            {
+            case '&':
+              document += "&amp;";
+              break;
+            case '<':
+              document += "&lt;";
+              break;
+            case '>':
+              document += "&gt;";
+              break;
+            case '"':
+              document += attribute ? "&quot;" : "\"";
+              break;
+            case '\t':
+              document += attribute ? "&#9;" : "\t";
+              break;
+            case '\n':
+              document += attribute ? "&#10;" : "\n";
+              break;
+            case '\r':
+              document += "&#13;";
+              break;
+            default:
+              document += *i;
+              break;
+            }
+        }
+    }
+
+    /// TiffData element being decoded.
+    boost::optional<TiffData> current;
+    /// Within a TiffData UUID element.
+    bool inUUID;
+    /// UUID text.
+    std::string text;
+    /// Depth of the current element in the reduced document.
+    ome::bioformats::dimension_size_type depth;
+    /// Number of Image elements seen.
+    ome::bioformats::dimension_size_type imageCount;
+    /// Number of TiffData elements seen in the current Image.
+    ome::bioformats::dimension_size_type tiffDataCount;
+  };
+
+  /**
+   * Create OME-XML metadata by streaming OME-XML text.
+   *
+   * @param text the XML string.
+   * @returns the OME-XML metadata.
+   * @throws StreamUnsupported if the text could not be streamed, or
+   * std::runtime_error if the text could not be parsed.
+   */
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata>
+  streamOMEXMLMetadata(const std::string& text)
+  {
+    OMEXMLTiffDataFilter handler;
+
+    {
+      // Namespace prefixes are needed to copy namespace declarations
+      // to the reduced document.
+      ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(ome::bioformats::detail::createScanningParser(true));
+
+      xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(text.c_str()),
+                                        static_cast<XMLSize_t>(text.size()),
+                                        ome::common::xml::String("OME-XML text (streamed)"));
+
+      parser->setContentHandler(&handler);
+      parser->setErrorHandler(&handler);
+
+      try
+        {
+          parser->parse(source);
+        }
+      catch (const xercesc::XMLException& e)
+        {
+          throw std::runtime_error(std::string(ome::common::xml::String(e.getMessage())));
+        }
+      catch (const xercesc::SAXException& e)
+        {
+          throw std::runtime_error(std::string(ome::common::xml::String(e.getMessage())));
+        }
+    }
+
+    // The reduced document is validated, and schema default
+    // attributes are supplied, as for the full document.
+    ome::common::xml::dom::Document doc;
+    try
+      {
+        doc = ome::xml::createDocument(handler.document, ome::common::xml::dom::ParseParameters(),
+                                       "OME-XML text (streamed)");
+      }
+    catch (const std::runtime_error&) // retry without strict validation
+      {
+        ome::common::xml::dom::ParseParameters params;
+        params.doSchema = false;
+        params.validationSchemaFullChecking = false;
+        doc = ome::xml::createDocument(handler.document, params, "Broken OME-XML text (streamed)");
+      }
+    handler.document.clear();
+
+    ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+    ome::xml::model::detail::OMEModel model;
+    ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadataRoot> root(ome::compat::dynamic_pointer_cast<ome::xml::meta::OMEXMLMetadataRoot>(meta->getRoot()));
+    root->update(doc.getDocumentElement(), model);
+
+    // Add the remaining TiffData elements directly to the model.
+    // These were not seen by the schema, so apply its defaults for
+    // the IFD and first plane here; PlaneCount has no default.
+    for (std::vector<OMEXMLTiffDataFilter::TiffData>::const_iterator td = handler.tiffData.begin();
+         td != handler.tiffData.end();
+         ++td)
+      {
+        meta->setTiffDataIFD(td->ifd ? *td->ifd : 0U, td->image, td->index);
+        meta->setTiffDataFirstZ(td->firstZ ? *td->firstZ : 0U, td->image, td->index);
+        meta->setTiffDataFirstT(td->firstT ? *td->firstT : 0U, td->image, td->index);
+        meta->setTiffDataFirstC(td->firstC ? *td->firstC : 0U, td->image, td->index);
+        if (td->planeCount)
+          meta->setTiffDataPlaneCount(*td->planeCount, td->image, td->index);
+        if (td->uuid)
+          meta->setUUIDValue(*td->uuid, td->image, td->index);
+        if (td->fileName)
+          meta->setUUIDFileName(*td->fileName, td->image, td->index);
+      }
+
+    return meta;
+  }
+
 }
 
 namespace ome
@@ -291,8 +651,20 @@ namespace ome
     ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(const std::string& text)
     {
-      // Parse OME-XML into DOM Document.
       ome::common::xml::Platform xmlplat;
+
+      // Stream documents at the current model version, decoding
+      // TiffData directly rather than via the DOM.
+      try
+        {
+          return streamOMEXMLMetadata(text);
+        }
+      catch (const StreamUnsupported&)
+        {
+          // Fall back to parsing the full document.
+        }
+
+      // Parse OME-XML into DOM Document.
       ome::common::xsl::Platform xslplat;
       ome::common::xml::dom::Document doc;
       try
@@ -392,6 +764,12 @@ namespace ome
       return validateXML(document, "OME-XML document for validation");
     }
 
+    bool
+    validateOMEXML(ome::common::xml::dom::Document& document)
+    {
+      return validateXML(document, "OME-XML document for validation");
+    }
+
     bool
     validateModel(::ome::xml::meta::Metadata& meta,
                   bool                        correct)
@@ -1017,7 +1395,12 @@ namespace ome
       if (metadata.empty())
         return;
 
-      MetadataMap flat(metadata.flatten());
+      // Only copy the metadata if flattening is required.
+      const bool lists = metadata.hasLists();
+      MetadataMap flattened;
+      if (lists)
+        flattened = metadata.flatten();
+      const MetadataMap& flat(lists ? flattened : metadata);
 
       ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadataRoot> root(ome::compat::dynamic_pointer_cast<ome::xml::meta::OMEXMLMetadataRoot>(omexml.getRoot()));
       if (root)
@@ -1076,11 +1459,11 @@ namespace ome
 
       std::string ns = common::xml::String(docroot->getNamespaceURI());
 
-      ome::compat::smatch found;
+      std::string version(detail::getSchemaModelVersion(ns));
 
-      if (ome::compat::regex_match(ns, found, schema_match))
+      if (!version.empty())
         {
-          return found[1];
+          return version;
         }
       else if(ns == "http://www.openmicroscopy.org/XMLschemas/OME/FC/ome.xsd")
         {
@@ -1095,16 +1478,11 @@ namespace ome
     {
       ome::common::xml::Platform xmlplat;
 
-      ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader());
       // We only want to get the schema version, so disable checking
       // of schema etc.  If there are problems with the XML, they'll
       // be picked up when we parse it for real.  Here, we'll only
       // read the first element if it's a valid OME-XML document.
-      parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, false);
-      parser->setFeature(xercesc::XMLUni::fgXercesSchemaFullChecking, false);
-      parser->setFeature(xercesc::XMLUni::fgXercesLoadSchema, false);
-      // Needed to get the schema namespace.
-      parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+      ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(detail::createScanningParser());
 
       xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(document.c_str()),
                                         static_cast<XMLSize_t>(document.size()),
@@ -137,6 +137,16 @@ namespace ome
     /**
      * Create OME-XML metadata from XML string.
      *
+     * Documents at the current model version are streamed: TiffData
+     * elements after the first of each image are decoded as they are
+     * parsed and added directly to the metadata, and only the
+     * remainder of the document is parsed into a DOM tree, with
+     * schema validation and default attributes as for the full
+     * document.  This avoids the memory and time overhead of a DOM
+     * tree containing many TiffData elements.  Other documents
+     * (or those which can not be streamed) are parsed in full,
+     * upgrading to the current model version as required.
+     *
      * @param text the XML string.
      * @returns the OME-XML metadata.
      */
@@ -210,6 +220,15 @@ namespace ome
     bool
     validateOMEXML(const std::string& document);
 
+    /**
+     * Validate a parsed OME-XML document.
+     *
+     * @param document the XML document.
+     * @returns @c true if valid, @c false if invalid.
+     */
+    bool
+    validateOMEXML(ome::common::xml::dom::Document& document);
+
     /**
      * Validate a metadata store.
      *
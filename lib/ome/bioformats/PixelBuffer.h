@@ -38,11 +38,13 @@
 #ifndef OME_BIOFORMATS_PIXELBUFFER_H
 #define OME_BIOFORMATS_PIXELBUFFER_H
 
+#include <algorithm>
 #include <istream>
 #include <limits>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 // Disable expensive bounds checking
 #define BOOST_DISABLE_ASSERTS 1
@@ -117,6 +119,10 @@ namespace ome
       typedef ome::compat::array<boost::multi_array_types::index,
                                  PixelBufferBase::dimensions> indices_type;
 
+      /// Type used for the extent of all dimensions in public interfaces.
+      typedef ome::compat::array<size_type,
+                                 PixelBufferBase::dimensions> shape_type;
+
       /// Storage ordering type for controlling pixel memory layout.
       typedef boost::general_storage_order<dimensions> storage_order_type;
 
@@ -199,6 +205,108 @@ namespace ome
       const EndianType endiantype;
     };
 
+    /**
+     * Raw span of pixel buffer storage.
+     *
+     * A span describes the storage of a pixel buffer as a pointer to
+     * its first element (the element at the index bases) plus the
+     * extent and stride of each dimension.  It is resolved once from
+     * a PixelBuffer or VariantPixelBuffer, after which elements may
+     * be addressed with plain pointer arithmetic in tight loops,
+     * avoiding repeated variant dispatch and multi-dimensional index
+     * computation for every row or element.
+     *
+     * Strides are in units of @c value_type.  For a typed span, a
+     * sample is a single @c value_type and @c element_size is 1.
+     * For a raw byte span, @c element_size is the size of a sample
+     * in bytes, and the strides are scaled to match.
+     *
+     * A span does not own the storage it references; it is valid
+     * only while the originating buffer exists and is not
+     * reallocated.
+     */
+    template<typename T>
+    struct PixelSpan
+    {
+      /// Element type.
+      typedef T value_type;
+      /// Size type.
+      typedef PixelBufferBase::size_type size_type;
+      /// Index type.
+      typedef PixelBufferBase::index index;
+
+      /// Pointer to the first element.
+      value_type *data;
+      /// Extent of each dimension.
+      ome::compat::array<size_type, PixelBufferBase::dimensions> shape;
+      /// Stride of each dimension, in units of @c value_type.
+      ome::compat::array<index, PixelBufferBase::dimensions> strides;
+      /// Size of a single sample, in units of @c value_type.
+      size_type element_size;
+
+      /// Constructor (null span).
+      PixelSpan():
+        data(0),
+        shape(),
+        strides(),
+        element_size(1U)
+      {
+        shape.fill(0U);
+        strides.fill(0);
+      }
+
+      /**
+       * Get a pointer to a sample in the first plane.
+       *
+       * All indices are relative to the first element.
+       *
+       * @param x the @c X index.
+       * @param y the @c Y index.
+       * @param subchannel the subchannel index.
+       * @returns a pointer to the sample.
+       */
+      value_type *
+      pointer(index x,
+              index y,
+              index subchannel = 0) const
+      {
+        return data +
+          (x * strides[DIM_SPATIAL_X]) +
+          (y * strides[DIM_SPATIAL_Y]) +
+          (subchannel * strides[DIM_SUBCHANNEL]);
+      }
+
+      /**
+       * Get a pointer to a sample.
+       *
+       * All indices are relative to the first element.
+       *
+       * @param indices the index of each dimension.
+       * @returns a pointer to the sample.
+       */
+      value_type *
+      pointer(const PixelBufferBase::indices_type& indices) const
+      {
+        value_type *ptr = data;
+        for (size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+          ptr += indices[d] * strides[d];
+        return ptr;
+      }
+
+      /**
+       * Check if a dimension is contiguous.
+       *
+       * @param dim the dimension to check.
+       * @returns @c true if adjacent samples of the dimension are
+       * adjacent in memory, @c false otherwise.
+       */
+      bool
+      contiguous(size_type dim) const
+      {
+        return strides[dim] == static_cast<index>(element_size);
+      }
+    };
+
     /**
      * Buffer for a specific pixel type.
      *
@@ -368,10 +476,86 @@ namespace ome
         multiarray(buffer.multiarray)
       {}
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      /**
+       * Move constructor.
+       *
+       * The storage of @p buffer is transferred to this buffer
+       * without copying the pixel data or its reference count.  @p
+       * buffer is left without storage (valid() will return @c
+       * false), and may only be destroyed or reassigned using move
+       * assignment or swap().
+       *
+       * @param buffer the buffer to move.
+       */
+      PixelBuffer(PixelBuffer&& buffer):
+        PixelBufferBase(buffer),
+        multiarray(std::move(buffer.multiarray))
+      {}
+#endif
+
       /// Destructor.
       virtual ~PixelBuffer()
       {}
 
+      /**
+       * Create a shallow view of this buffer.
+       *
+       * The view shares the storage of this buffer; no pixel data
+       * is copied, and modifications made through either buffer are
+       * visible in both.  This is equivalent to the copy
+       * constructor.
+       *
+       * @returns the new view.
+       */
+      ome::compat::shared_ptr<PixelBuffer>
+      view() const
+      {
+        return ome::compat::shared_ptr<PixelBuffer>(new PixelBuffer(*this));
+      }
+
+      /**
+       * Create a deep copy of this buffer.
+       *
+       * The copy has the same extents, index bases, pixel type,
+       * endian type and storage order as this buffer, but uses
+       * separate, internally managed storage, even if this buffer
+       * uses external storage.
+       *
+       * @returns the new copy.
+       */
+      ome::compat::shared_ptr<PixelBuffer>
+      clone() const
+      {
+        const size_type *shape_ptr(shape());
+        ome::compat::array<size_type, dimensions> extents;
+        std::copy(shape_ptr, shape_ptr + dimensions, extents.begin());
+
+        const index *bases_ptr(index_bases());
+        ome::compat::array<index, dimensions> bases;
+        std::copy(bases_ptr, bases_ptr + dimensions, bases.begin());
+
+        ome::compat::shared_ptr<PixelBuffer> copy(new PixelBuffer(extents, pixelType(), endianType(), storage_order()));
+        copy->array().reindex(bases);
+        std::copy(data(), data() + num_elements(), copy->data());
+        return copy;
+      }
+
+      /**
+       * Swap the storage of two buffers.
+       *
+       * No pixel data is copied.
+       *
+       * @param rhs the buffer to swap with.
+       * @throws std::logic_error if the pixel or endian types differ.
+       */
+      void
+      swap(PixelBuffer& rhs)
+      {
+        checkMove(rhs);
+        multiarray.swap(rhs.multiarray);
+      }
+
       /**
        * Get the pixel data.
        *
@@ -532,6 +716,50 @@ namespace ome
         return array().origin();
       }
 
+      /**
+       * Get a typed span of the pixel data.
+       *
+       * @returns the span.
+       */
+      PixelSpan<value_type>
+      span()
+      {
+        return makeSpan(array().origin(), 1U);
+      }
+
+      /**
+       * Get a typed span of the pixel data.
+       *
+       * @returns the span.
+       */
+      PixelSpan<const value_type>
+      span() const
+      {
+        return makeSpan(array().origin(), 1U);
+      }
+
+      /**
+       * Get a raw byte span of the pixel data.
+       *
+       * @returns the span.
+       */
+      PixelSpan<uint8_t>
+      rawSpan()
+      {
+        return makeSpan(reinterpret_cast<uint8_t *>(array().origin()), sizeof(value_type));
+      }
+
+      /**
+       * Get a raw byte span of the pixel data.
+       *
+       * @returns the span.
+       */
+      PixelSpan<const uint8_t>
+      rawSpan() const
+      {
+        return makeSpan(reinterpret_cast<const uint8_t *>(array().origin()), sizeof(value_type));
+      }
+
       /**
        * Get the array storage order.
        *
@@ -560,6 +788,33 @@ namespace ome
         return *this;
       }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      /**
+       * Move assign a pixel buffer.
+       *
+       * Unlike copy assignment, which copies the pixel values into
+       * the existing storage, this replaces the storage of this
+       * buffer with the storage of @p rhs without copying the pixel
+       * data.  The extents and storage order will be those of @p
+       * rhs.  @p rhs is left without storage (valid() will return @c
+       * false).
+       *
+       * @param rhs the pixel buffer to move.
+       * @returns the assigned buffer.
+       * @throws std::logic_error if the pixel or endian types differ.
+       */
+      PixelBuffer&
+      operator = (PixelBuffer&& rhs)
+      {
+        if (this != &rhs)
+          {
+            checkMove(rhs);
+            multiarray = std::move(rhs.multiarray);
+          }
+        return *this;
+      }
+#endif
+
       /**
        * Assign a pixel buffer.
        *
@@ -806,6 +1061,49 @@ namespace ome
       }
 
     private:
+      /**
+       * Create a span of the pixel data.
+       *
+       * @param origin the address of the array origin.
+       * @param scale the size of a sample in units of @c S.
+       * @returns the span.
+       */
+      template<typename S>
+      PixelSpan<S>
+      makeSpan(S        *origin,
+               size_type scale) const
+      {
+        const size_type *shape_ptr(shape());
+        const index *strides_ptr(strides());
+        const index *bases_ptr(index_bases());
+
+        PixelSpan<S> ret;
+        index offset = 0;
+        for (size_type d = 0; d < dimensions; ++d)
+          {
+            ret.shape[d] = shape_ptr[d];
+            ret.strides[d] = strides_ptr[d] * static_cast<index>(scale);
+            offset += bases_ptr[d] * ret.strides[d];
+          }
+        ret.data = origin + offset;
+        ret.element_size = scale;
+        return ret;
+      }
+
+      /**
+       * Check that storage may be transferred from another buffer.
+       *
+       * @param rhs the buffer to transfer from.
+       * @throws std::logic_error if the pixel or endian types differ.
+       */
+      void
+      checkMove(const PixelBuffer& rhs) const
+      {
+        if (pixelType() != rhs.pixelType() ||
+            endianType() != rhs.endianType())
+          throw std::logic_error("Pixel buffer storage transfer requires identical pixel and endian types");
+      }
+
       /**
        * Multi-dimensional pixel array.  This may be either a @c
        * multi_array containing the data directly, or a @c
@@ -0,0 +1,185 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <ome/bioformats/PixelCopy.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+
+    namespace
+    {
+
+      /**
+       * Copy a region between buffers of the same pixel type.
+       */
+      struct RegionCopyVisitor : public boost::static_visitor<>
+      {
+        /// Index of the first source element.
+        const PixelBufferBase::indices_type& source_start;
+        /// Region extents.
+        const PixelBufferBase::shape_type&   shape;
+        /// Index of the first destination element.
+        const PixelBufferBase::indices_type& dest_start;
+        /// Maximum number of threads.
+        dimension_size_type                  threads;
+
+        /**
+         * Constructor.
+         *
+         * @param source_start the index of the first source element.
+         * @param shape the region extents.
+         * @param dest_start the index of the first destination element.
+         * @param threads the maximum number of threads.
+         */
+        RegionCopyVisitor(const PixelBufferBase::indices_type& source_start,
+                          const PixelBufferBase::shape_type&   shape,
+                          const PixelBufferBase::indices_type& dest_start,
+                          dimension_size_type                  threads):
+          source_start(source_start),
+          shape(shape),
+          dest_start(dest_start),
+          threads(threads)
+        {}
+
+        template <typename T, typename U>
+        void
+        operator() (const T& /* source */,
+                    U&       /* dest */) const
+        {
+          throw std::runtime_error("Unsupported pixel type conversion for region copy");
+        }
+
+        template <typename T>
+        void
+        operator() (const T& source,
+                    T&       dest) const
+        {
+          if (!source || !dest)
+            throw std::runtime_error("Null pixel type");
+          copyRegion(*source, source_start, shape, *dest, dest_start, threads);
+        }
+      };
+
+      /**
+       * Copy a plane region between buffers of the same pixel type.
+       */
+      struct PlaneRegionCopyVisitor : public boost::static_visitor<>
+      {
+        /// Source region.
+        const PlaneRegion&  region;
+        /// Destination @c X position.
+        dimension_size_type x;
+        /// Destination @c Y position.
+        dimension_size_type y;
+        /// Maximum number of threads.
+        dimension_size_type threads;
+
+        /**
+         * Constructor.
+         *
+         * @param region the source region.
+         * @param x the destination @c X position.
+         * @param y the destination @c Y position.
+         * @param threads the maximum number of threads.
+         */
+        PlaneRegionCopyVisitor(const PlaneRegion&  region,
+                               dimension_size_type x,
+                               dimension_size_type y,
+                               dimension_size_type threads):
+          region(region),
+          x(x),
+          y(y),
+          threads(threads)
+        {}
+
+        template <typename T, typename U>
+        void
+        operator() (const T& /* source */,
+                    U&       /* dest */) const
+        {
+          throw std::runtime_error("Unsupported pixel type conversion for region copy");
+        }
+
+        template <typename T>
+        void
+        operator() (const T& source,
+                    T&       dest) const
+        {
+          if (!source || !dest)
+            throw std::runtime_error("Null pixel type");
+          copyRegion(*source, region, *dest, x, y, threads);
+        }
+      };
+
+    }
+
+    void
+    copyRegion(const VariantPixelBuffer&            source,
+               const PixelBufferBase::indices_type& source_start,
+               const PixelBufferBase::shape_type&   shape,
+               VariantPixelBuffer&                  dest,
+               const PixelBufferBase::indices_type& dest_start,
+               dimension_size_type                  threads)
+    {
+      RegionCopyVisitor v(source_start, shape, dest_start, threads);
+      boost::apply_visitor(v, source.vbuffer(), dest.vbuffer());
+    }
+
+    void
+    copyRegion(const VariantPixelBuffer& source,
+               const PlaneRegion&        region,
+               VariantPixelBuffer&       dest,
+               dimension_size_type       x,
+               dimension_size_type       y,
+               dimension_size_type       threads)
+    {
+      PlaneRegionCopyVisitor v(region, x, y, threads);
+      boost::apply_visitor(v, source.vbuffer(), dest.vbuffer());
+    }
+
+  }
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,420 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_BIOFORMATS_PIXELCOPY_H
+#define OME_BIOFORMATS_PIXELCOPY_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include <ome/bioformats/PixelBuffer.h>
+#include <ome/bioformats/PixelTranspose.h>
+#include <ome/bioformats/PlaneRegion.h>
+#include <ome/bioformats/Types.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+#include <ome/compat/array.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+
+    /**
+     * Minimum number of elements to copy per thread.
+     *
+     * Region copies smaller than this are always performed in the
+     * calling thread, since the cost of starting a thread would
+     * exceed the cost of the copy.
+     */
+    const dimension_size_type copy_thread_elements = 1U << 20;
+
+    namespace detail
+    {
+
+      /**
+       * Copy a region between arrays in a single thread.
+       *
+       * This is a copyable function object which may be run by a
+       * thread; the source and destination are as for transpose().
+       *
+       * @tparam T the element type.
+       */
+      template<typename T>
+      struct RegionCopyTask
+      {
+        /// First source element.
+        const T *source;
+        /// Source strides.
+        PixelBufferBase::indices_type source_strides;
+        /// First destination element.
+        T *dest;
+        /// Destination strides.
+        PixelBufferBase::indices_type dest_strides;
+        /// Region extents.
+        PixelBufferBase::shape_type shape;
+
+        /// Copy the region.
+        void
+        operator()() const
+        {
+          transpose(source, source_strides.data(),
+                    dest, dest_strides.data(),
+                    shape.data());
+        }
+      };
+
+      /**
+       * Check a region lies within a pixel buffer.
+       *
+       * @param extents the buffer extents.
+       * @param bases the buffer index bases.
+       * @param start the index of the first element of the region.
+       * @param shape the region extents.
+       * @param name the buffer name, for error reporting.
+       * @throws std::logic_error if the region is out of range.
+       */
+      inline void
+      checkRegion(const PixelBufferBase::size_type     *extents,
+                  const PixelBufferBase::index         *bases,
+                  const PixelBufferBase::indices_type& start,
+                  const PixelBufferBase::shape_type&   shape,
+                  const std::string&                   name)
+      {
+        for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+          {
+            if (start[d] < bases[d] ||
+                start[d] - bases[d] + static_cast<PixelBufferBase::index>(shape[d]) >
+                static_cast<PixelBufferBase::index>(extents[d]))
+              {
+                boost::format fmt("%1% region out of range in dimension %2%: %3%+%4% not within %5%+%6%");
+                fmt % name % d % start[d] % shape[d] % bases[d] % extents[d];
+                throw std::logic_error(fmt.str());
+              }
+          }
+      }
+
+    }
+
+    /**
+     * Copy a region of pixel data between arrays.
+     *
+     * The source and destination are described by the address of
+     * their first element plus the stride of each of the nine
+     * PixelBuffer dimensions, as for transpose().  Any storage order
+     * is permitted for both the source and destination.  The source
+     * and destination must not overlap.
+     *
+     * Adjacent dimensions which are contiguous in both the source
+     * and destination are first merged, so that a region spanning
+     * whole rows (or planes) is copied as a single run with
+     * std::copy (usually memmove(3) internally) rather than row by
+     * row.  Copies of at least copy_thread_elements elements are
+     * split across the outermost dimension and copied in parallel.
+     *
+     * @param source the first source element.
+     * @param source_strides the source strides (nine dimensions).
+     * @param dest the first destination element.
+     * @param dest_strides the destination strides (nine dimensions).
+     * @param shape the region extents (nine dimensions).
+     * @param threads the maximum number of threads to use; zero to
+     * use the number of hardware threads available.
+     */
+    template<typename T>
+    void
+    copyRegion(const T                                   *source,
+               const boost::multi_array_types::index     *source_strides,
+               T                                         *dest,
+               const boost::multi_array_types::index     *dest_strides,
+               const boost::multi_array_types::size_type *shape,
+               dimension_size_type                        threads = 0U)
+    {
+      typedef boost::multi_array_types::index index;
+      typedef boost::multi_array_types::size_type size_type;
+      const size_type dims = PixelBufferBase::dimensions;
+
+      detail::RegionCopyTask<T> task;
+      task.source = source;
+      task.dest = dest;
+      std::copy(source_strides, source_strides + dims, task.source_strides.begin());
+      std::copy(dest_strides, dest_strides + dims, task.dest_strides.begin());
+      std::copy(shape, shape + dims, task.shape.begin());
+
+      dimension_size_type nelem = 1U;
+      for (size_type d = 0; d < dims; ++d)
+        nelem *= shape[d];
+      if (!nelem)
+        return;
+
+      // Merge dimensions which are contiguous with an inner
+      // dimension in both the source and destination.
+      bool merged = true;
+      while (merged)
+        {
+          merged = false;
+          for (size_type i = 0; i < dims; ++i)
+            {
+              if (task.shape[i] < 2)
+                continue;
+              const index extent = static_cast<index>(task.shape[i]);
+              for (size_type j = 0; j < dims; ++j)
+                {
+                  if (j == i || task.shape[j] < 2)
+                    continue;
+                  if (task.source_strides[j] == task.source_strides[i] * extent &&
+                      task.dest_strides[j] == task.dest_strides[i] * extent)
+                    {
+                      task.shape[i] *= task.shape[j];
+                      task.shape[j] = 1U;
+                      merged = true;
+                      break;
+                    }
+                }
+              if (merged)
+                break;
+            }
+        }
+
+      // Split the outermost source dimension across threads.
+      size_type split = dims;
+      index splitstride = 0;
+      for (size_type d = 0; d < dims; ++d)
+        {
+          if (task.shape[d] < 2)
+            continue;
+          const index sabs = task.source_strides[d] < 0 ? -task.source_strides[d] : task.source_strides[d];
+          if (split == dims || sabs > splitstride)
+            {
+              split = d;
+              splitstride = sabs;
+            }
+        }
+
+      if (!threads)
+        threads = boost::thread::hardware_concurrency();
+      dimension_size_type nthreads = std::min(threads, nelem / copy_thread_elements);
+      if (split != dims)
+        nthreads = std::min(nthreads, static_cast<dimension_size_type>(task.shape[split]));
+
+      if (nthreads <= 1U)
+        {
+          task();
+          return;
+        }
+
+      const size_type extent = task.shape[split];
+      const size_type chunk = (extent + nthreads - 1) / nthreads;
+
+      boost::thread_group group;
+      for (size_type start = 0; start < extent; start += chunk)
+        {
+          detail::RegionCopyTask<T> part(task);
+          part.source += static_cast<index>(start) * task.source_strides[split];
+          part.dest += static_cast<index>(start) * task.dest_strides[split];
+          part.shape[split] = std::min(chunk, extent - start);
+          group.create_thread(part);
+        }
+      group.join_all();
+    }
+
+    /**
+     * Copy a region of pixel data between buffers.
+     *
+     * The region of @p source starting at @p source_start with
+     * extents @p shape is copied into @p dest starting at @p
+     * dest_start.  The indices include any non-zero index bases.
+     * The source and destination may have differing extents and
+     * storage orders, but must not share overlapping storage.
+     *
+     * @param source the source pixel buffer.
+     * @param source_start the index of the first source element.
+     * @param shape the region extents.
+     * @param dest the destination pixel buffer.
+     * @param dest_start the index of the first destination element.
+     * @param threads the maximum number of threads to use; zero to
+     * use the number of hardware threads available.
+     * @throws std::logic_error if the region is not within the
+     * source or destination buffer.
+     */
+    template<typename T>
+    void
+    copyRegion(const PixelBuffer<T>&                source,
+               const PixelBufferBase::indices_type& source_start,
+               const PixelBufferBase::shape_type&   shape,
+               PixelBuffer<T>&                      dest,
+               const PixelBufferBase::indices_type& dest_start,
+               dimension_size_type                  threads = 0U)
+    {
+      detail::checkRegion(source.shape(), source.index_bases(), source_start, shape, "Source");
+      detail::checkRegion(dest.shape(), dest.index_bases(), dest_start, shape, "Destination");
+
+      PixelBufferBase::indices_type source_offset;
+      PixelBufferBase::indices_type dest_offset;
+      for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+        {
+          source_offset[d] = source_start[d] - source.index_bases()[d];
+          dest_offset[d] = dest_start[d] - dest.index_bases()[d];
+        }
+
+      const PixelSpan<const T> sspan(source.span());
+      const PixelSpan<T> dspan(dest.span());
+
+      copyRegion(sspan.pointer(source_offset), sspan.strides.data(),
+                 dspan.pointer(dest_offset), dspan.strides.data(),
+                 shape.data(), threads);
+    }
+
+    /**
+     * Copy a plane region of pixel data between buffers.
+     *
+     * The @c X and @c Y extents of @p region of @p source are
+     * copied into @p dest at the position @p x, @p y, for every
+     * index of the remaining dimensions (including all subchannels).
+     * The extents of the remaining dimensions must be identical for
+     * both buffers.  This is the operation required to assemble a
+     * mosaic or viewport from several planes, or to extract a tile
+     * from a plane.
+     *
+     * @param source the source pixel buffer.
+     * @param region the source region.
+     * @param dest the destination pixel buffer.
+     * @param x the destination @c X position.
+     * @param y the destination @c Y position.
+     * @param threads the maximum number of threads to use; zero to
+     * use the number of hardware threads available.
+     * @throws std::logic_error if the region is not within the
+     * source or destination buffer, or the non-spatial extents
+     * differ.
+     */
+    template<typename T>
+    void
+    copyRegion(const PixelBuffer<T>& source,
+               const PlaneRegion&    region,
+               PixelBuffer<T>&       dest,
+               dimension_size_type   x,
+               dimension_size_type   y,
+               dimension_size_type   threads = 0U)
+    {
+      PixelBufferBase::indices_type source_start;
+      PixelBufferBase::indices_type dest_start;
+      PixelBufferBase::shape_type shape;
+
+      for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+        {
+          source_start[d] = source.index_bases()[d];
+          dest_start[d] = dest.index_bases()[d];
+          shape[d] = source.shape()[d];
+          if (d != DIM_SPATIAL_X && d != DIM_SPATIAL_Y &&
+              source.shape()[d] != dest.shape()[d])
+            throw std::logic_error("Buffer dimensions incompatible for region copy");
+        }
+
+      source_start[DIM_SPATIAL_X] += static_cast<PixelBufferBase::index>(region.x);
+      source_start[DIM_SPATIAL_Y] += static_cast<PixelBufferBase::index>(region.y);
+      dest_start[DIM_SPATIAL_X] += static_cast<PixelBufferBase::index>(x);
+      dest_start[DIM_SPATIAL_Y] += static_cast<PixelBufferBase::index>(y);
+      shape[DIM_SPATIAL_X] = region.w;
+      shape[DIM_SPATIAL_Y] = region.h;
+
+      copyRegion(source, source_start, shape, dest, dest_start, threads);
+    }
+
+    /**
+     * Copy a region of pixel data between buffers.
+     *
+     * As copyRegion() for PixelBuffer, but for any pixel type.  The
+     * pixel type is resolved once for the whole region.
+     *
+     * @param source the source pixel buffer.
+     * @param source_start the index of the first source element.
+     * @param shape the region extents.
+     * @param dest the destination pixel buffer.
+     * @param dest_start the index of the first destination element.
+     * @param threads the maximum number of threads to use; zero to
+     * use the number of hardware threads available.
+     * @throws std::logic_error if the region is not within the
+     * source or destination buffer.
+     * @throws std::runtime_error if the pixel types differ.
+     */
+    void
+    copyRegion(const VariantPixelBuffer&            source,
+               const PixelBufferBase::indices_type& source_start,
+               const PixelBufferBase::shape_type&   shape,
+               VariantPixelBuffer&                  dest,
+               const PixelBufferBase::indices_type& dest_start,
+               dimension_size_type                  threads = 0U);
+
+    /**
+     * Copy a plane region of pixel data between buffers.
+     *
+     * As copyRegion() for PixelBuffer, but for any pixel type.  The
+     * pixel type is resolved once for the whole region.
+     *
+     * @param source the source pixel buffer.
+     * @param region the source region.
+     * @param dest the destination pixel buffer.
+     * @param x the destination @c X position.
+     * @param y the destination @c Y position.
+     * @param threads the maximum number of threads to use; zero to
+     * use the number of hardware threads available.
+     * @throws std::logic_error if the region is not within the
+     * source or destination buffer, or the non-spatial extents
+     * differ.
+     * @throws std::runtime_error if the pixel types differ.
+     */
+    void
+    copyRegion(const VariantPixelBuffer& source,
+               const PlaneRegion&        region,
+               VariantPixelBuffer&       dest,
+               dimension_size_type       x,
+               dimension_size_type       y,
+               dimension_size_type       threads = 0U);
+
+  }
+}
+
+#endif // OME_BIOFORMATS_PIXELCOPY_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
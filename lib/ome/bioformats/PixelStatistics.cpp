@@ -0,0 +1,459 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include <ome/bioformats/PixelStatistics.h>
+
+using ::ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace bioformats
+  {
+
+    namespace
+    {
+
+      /**
+       * Minimum number of samples to process per thread.
+       *
+       * Below this, the cost of starting a thread exceeds the time
+       * saved, so the buffer is processed serially.
+       */
+      const dimension_size_type min_thread_samples = 1U << 20;
+
+      /**
+       * Get the default histogram range for a pixel type.
+       *
+       * Integer types use the full range of the type; floating
+       * point and complex types use [0,1).
+       */
+      template<typename T>
+      void
+      type_range(double& min,
+                 double& max)
+      {
+        if (std::numeric_limits<T>::is_specialized &&
+            std::numeric_limits<T>::is_integer)
+          {
+            min = static_cast<double>(std::numeric_limits<T>::min());
+            max = static_cast<double>(std::numeric_limits<T>::max()) + 1.0;
+          }
+        else
+          {
+            min = 0.0;
+            max = 1.0;
+          }
+      }
+
+      void
+      default_range(PixelType pixeltype,
+                    double&   min,
+                    double&   max)
+      {
+        switch(pixeltype)
+          {
+          case PixelType::INT8:
+            type_range<PixelProperties<PixelType::INT8>::std_type>(min, max);
+            break;
+          case PixelType::INT16:
+            type_range<PixelProperties<PixelType::INT16>::std_type>(min, max);
+            break;
+          case PixelType::INT32:
+            type_range<PixelProperties<PixelType::INT32>::std_type>(min, max);
+            break;
+          case PixelType::UINT8:
+            type_range<PixelProperties<PixelType::UINT8>::std_type>(min, max);
+            break;
+          case PixelType::UINT16:
+            type_range<PixelProperties<PixelType::UINT16>::std_type>(min, max);
+            break;
+          case PixelType::UINT32:
+            type_range<PixelProperties<PixelType::UINT32>::std_type>(min, max);
+            break;
+          case PixelType::BIT:
+            type_range<PixelProperties<PixelType::BIT>::std_type>(min, max);
+            break;
+          default:
+            min = 0.0;
+            max = 1.0;
+            break;
+          }
+      }
+
+      /**
+       * Accumulate statistics for a contiguous chunk of a buffer.
+       *
+       * @param stats the statistics to use for accumulation.
+       * @param data the start of the buffer.
+       * @param begin the first element of the chunk.
+       * @param end the end of the chunk.
+       * @param run the number of contiguous elements of the same
+       * subchannel.
+       * @param descending @c true if the subchannel dimension is
+       * stored in descending order.
+       * @param result the statistics to update.
+       */
+      template<typename T>
+      void
+      accumulate_chunk(const PixelStatistics&            stats,
+                       const T                          *data,
+                       dimension_size_type               begin,
+                       dimension_size_type               end,
+                       dimension_size_type               run,
+                       bool                              descending,
+                       PixelStatistics::statistics_type& result)
+      {
+        const dimension_size_type nsub = result.size();
+
+        if (run == 1U || nsub == 1U)
+          {
+            // Interleaved subchannels (or a single subchannel).
+            for (dimension_size_type s = 0; s < nsub; ++s)
+              {
+                const dimension_size_type sub = descending ? nsub - 1 - s : s;
+                stats.accumulate(data + begin + s, (end - begin) / nsub, nsub, result[sub]);
+              }
+          }
+        else
+          {
+            // Planar subchannels; process each contiguous run.
+            for (dimension_size_type r = begin; r < end; r += run)
+              {
+                const dimension_size_type k = (r / run) % nsub;
+                const dimension_size_type sub = descending ? nsub - 1 - k : k;
+                stats.accumulate(data + r, run, 1U, result[sub]);
+              }
+          }
+      }
+
+      /**
+       * Compute statistics for all pixel types.
+       */
+      struct ComputeVisitor : public boost::static_visitor<>
+      {
+        /// Statistics to use for accumulation.
+        const PixelStatistics& stats;
+        /// Statistics to update.
+        PixelStatistics::statistics_type& result;
+        /// Maximum number of threads.
+        dimension_size_type threads;
+
+        /**
+         * Constructor.
+         *
+         * @param stats the statistics to use for accumulation.
+         * @param result the statistics to update.
+         * @param threads the maximum number of threads.
+         */
+        ComputeVisitor(const PixelStatistics&            stats,
+                       PixelStatistics::statistics_type& result,
+                       dimension_size_type               threads):
+          stats(stats),
+          result(result),
+          threads(threads)
+        {}
+
+        /**
+         * Compute statistics for a buffer.
+         *
+         * The buffer is split into equal chunks, aligned such that
+         * each chunk starts at the first subchannel, with one chunk
+         * per thread.
+         *
+         * @param v the buffer to process.
+         */
+        template<typename T>
+        void
+        operator() (const T& v)
+        {
+          typedef typename T::element_type::value_type value_type;
+
+          const value_type *data = v->data();
+          const dimension_size_type nsub = result.size();
+          const dimension_size_type nelem = v->num_elements();
+          const dimension_size_type run =
+            static_cast<dimension_size_type>(std::abs(v->strides()[DIM_SUBCHANNEL]));
+          const bool descending = !v->storage_order().ascending(DIM_SUBCHANNEL);
+          const dimension_size_type align = (run == 1U || nsub == 1U) ? nsub : run;
+
+          if (!data || !nelem)
+            return;
+
+          dimension_size_type nthreads = std::min(threads,
+                                                  std::max(nelem / min_thread_samples,
+                                                           dimension_size_type(1U)));
+          dimension_size_type chunk = (((nelem / nthreads) + align - 1) / align) * align;
+          nthreads = (nelem + chunk - 1) / chunk;
+
+          if (nthreads <= 1U)
+            {
+              accumulate_chunk(stats, data, 0U, nelem, run, descending, result);
+              return;
+            }
+
+          std::vector<PixelStatistics::statistics_type> partial(nthreads, result);
+          boost::thread_group group;
+          for (dimension_size_type t = 0; t < nthreads; ++t)
+            {
+              const dimension_size_type begin = t * chunk;
+              const dimension_size_type end = std::min(begin + chunk, nelem);
+              group.create_thread(boost::bind(&accumulate_chunk<value_type>,
+                                              boost::cref(stats), data, begin, end, run,
+                                              descending, boost::ref(partial[t])));
+            }
+          group.join_all();
+
+          for (dimension_size_type t = 0; t < nthreads; ++t)
+            for (dimension_size_type s = 0; s < nsub; ++s)
+              result[s].merge(partial[t][s]);
+        }
+      };
+
+    }
+
+    SampleStatistics::SampleStatistics(dimension_size_type bins):
+      count(0U),
+      min(std::numeric_limits<double>::infinity()),
+      max(-std::numeric_limits<double>::infinity()),
+      sum(0.0),
+      sumsq(0.0),
+      histogram(bins, 0U)
+    {
+    }
+
+    double
+    SampleStatistics::mean() const
+    {
+      return count ? sum / static_cast<double>(count) : 0.0;
+    }
+
+    double
+    SampleStatistics::variance() const
+    {
+      if (!count)
+        return 0.0;
+      double m = mean();
+      return std::max(sumsq / static_cast<double>(count) - (m * m), 0.0);
+    }
+
+    double
+    SampleStatistics::stddev() const
+    {
+      return std::sqrt(variance());
+    }
+
+    void
+    SampleStatistics::merge(const SampleStatistics& rhs)
+    {
+      count += rhs.count;
+      min = std::min(min, rhs.min);
+      max = std::max(max, rhs.max);
+      sum += rhs.sum;
+      sumsq += rhs.sumsq;
+      for (dimension_size_type i = 0;
+           i < std::min(histogram.size(), rhs.histogram.size());
+           ++i)
+        histogram[i] += rhs.histogram[i];
+    }
+
+    PixelStatistics::PixelStatistics(dimension_size_type bins):
+      bins(256U),
+      explicitrange(false),
+      explicitmin(0.0),
+      explicitmax(1.0),
+      rmin(0.0),
+      rmax(1.0),
+      threads(0U),
+      stats()
+    {
+      setBins(bins);
+    }
+
+    PixelStatistics::~PixelStatistics()
+    {
+    }
+
+    dimension_size_type
+    PixelStatistics::getBins() const
+    {
+      return bins;
+    }
+
+    void
+    PixelStatistics::setBins(dimension_size_type bins)
+    {
+      if (!bins)
+        throw std::logic_error("Histogram bin count must be non-zero");
+      this->bins = bins;
+    }
+
+    void
+    PixelStatistics::setRange(double min,
+                              double max)
+    {
+      if (!(max > min))
+        {
+          boost::format fmt("Invalid histogram range [%1%,%2%)");
+          fmt % min % max;
+          throw std::logic_error(fmt.str());
+        }
+      explicitrange = true;
+      explicitmin = min;
+      explicitmax = max;
+    }
+
+    void
+    PixelStatistics::clearRange()
+    {
+      explicitrange = false;
+    }
+
+    double
+    PixelStatistics::getRangeMin() const
+    {
+      return rmin;
+    }
+
+    double
+    PixelStatistics::getRangeMax() const
+    {
+      return rmax;
+    }
+
+    dimension_size_type
+    PixelStatistics::getThreads() const
+    {
+      return threads;
+    }
+
+    void
+    PixelStatistics::setThreads(dimension_size_type threads)
+    {
+      this->threads = threads;
+    }
+
+    void
+    PixelStatistics::reset(dimension_size_type subchannels,
+                           PixelType           pixeltype)
+    {
+      if (explicitrange)
+        {
+          rmin = explicitmin;
+          rmax = explicitmax;
+        }
+      else
+        default_range(pixeltype, rmin, rmax);
+
+      stats.assign(subchannels, SampleStatistics(bins));
+    }
+
+    void
+    PixelStatistics::compute(const VariantPixelBuffer& buffer)
+    {
+      reset(buffer.shape()[DIM_SUBCHANNEL], buffer.pixelType());
+
+      dimension_size_type nthreads = threads;
+      if (!nthreads)
+        nthreads = boost::thread::hardware_concurrency();
+      if (!nthreads)
+        nthreads = 1U;
+
+      ComputeVisitor v(*this, stats, nthreads);
+      boost::apply_visitor(v, buffer.vbuffer());
+    }
+
+    void
+    PixelStatistics::merge(const PixelStatistics& rhs)
+    {
+      if (stats.size() != rhs.stats.size() ||
+          bins != rhs.bins ||
+          rmin != rhs.rmin ||
+          rmax != rhs.rmax)
+        throw std::logic_error("Incompatible pixel statistics");
+
+      for (dimension_size_type s = 0; s < stats.size(); ++s)
+        stats[s].merge(rhs.stats[s]);
+    }
+
+    const PixelStatistics::statistics_type&
+    PixelStatistics::getStatistics() const
+    {
+      return stats;
+    }
+
+    const SampleStatistics&
+    PixelStatistics::getStatistics(dimension_size_type subchannel) const
+    {
+      if (subchannel >= stats.size())
+        {
+          boost::format fmt("Invalid subchannel %1% (of %2%)");
+          fmt % subchannel % stats.size();
+          throw std::logic_error(fmt.str());
+        }
+      return stats[subchannel];
+    }
+
+    void
+    PixelStatistics::checkSubchannels(dimension_size_type samples,
+                                      dimension_size_type subchannel) const
+    {
+      if (subchannel + samples > stats.size())
+        {
+          boost::format fmt("Invalid subchannel range %1%-%2% (of %3%)");
+          fmt % subchannel % (subchannel + samples) % stats.size();
+          throw std::logic_error(fmt.str());
+        }
+    }
+
+  }
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,525 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_BIOFORMATS_PIXELSTATISTICS_H
+#define OME_BIOFORMATS_PIXELSTATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+
+#include <boost/type_traits/integral_constant.hpp>
+
+#include <ome/compat/cstdint.h>
+
+#include <ome/bioformats/Types.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+
+    /**
+     * Statistics for a single subchannel.
+     *
+     * The minimum, maximum, sum and sum of squares are accumulated
+     * for all samples, plus a histogram of the sample values.  NaN
+     * samples are ignored.  Complex samples are represented by their
+     * magnitude.
+     */
+    struct SampleStatistics
+    {
+      /// Number of samples.
+      dimension_size_type count;
+      /// Minimum sample value (positive infinity if no samples).
+      double min;
+      /// Maximum sample value (negative infinity if no samples).
+      double max;
+      /// Sum of sample values.
+      double sum;
+      /// Sum of squared sample values.
+      double sumsq;
+      /// Histogram of sample values.
+      std::vector<dimension_size_type> histogram;
+
+      /**
+       * Constructor.
+       *
+       * @param bins the number of histogram bins.
+       */
+      explicit
+      SampleStatistics(dimension_size_type bins = 0U);
+
+      /**
+       * Get the mean sample value.
+       *
+       * @returns the mean, or zero if there are no samples.
+       */
+      double
+      mean() const;
+
+      /**
+       * Get the (population) variance of the sample values.
+       *
+       * @returns the variance, or zero if there are no samples.
+       */
+      double
+      variance() const;
+
+      /**
+       * Get the (population) standard deviation of the sample values.
+       *
+       * @returns the standard deviation, or zero if there are no
+       * samples.
+       */
+      double
+      stddev() const;
+
+      /**
+       * Merge statistics from another set of samples.
+       *
+       * @param rhs the statistics to merge; the histogram must have
+       * the same number of bins and range.
+       */
+      void
+      merge(const SampleStatistics& rhs);
+    };
+
+    /**
+     * Pixel statistics.
+     *
+     * Compute the minimum, maximum, mean, standard deviation and
+     * histogram of each subchannel of a pixel buffer in a single pass
+     * over the pixel data.  Buffers large enough to give each thread
+     * at least a million samples are split into contiguous chunks
+     * which are processed concurrently, and the partial results
+     * merged; smaller buffers, such as individual tiles, are
+     * processed on the calling thread, since starting threads would
+     * cost more than the computation.
+     *
+     * The statistics may alternatively be accumulated incrementally
+     * with add(), for example while pixel data is being read, so that
+     * the data need not be traversed a second time; see
+     * ome::bioformats::tiff::IFD::readImage().
+     *
+     * The histogram spans the half-open range [min,max) of the pixel
+     * type by default (for integer types this is the full range of
+     * the type, while for floating point and complex types it is
+     * [0,1)).  An explicit range may be set with setRange().  Values
+     * outside the histogram range are counted in the first or last
+     * bin.
+     */
+    class PixelStatistics
+    {
+    public:
+      /// Statistics for all subchannels.
+      typedef std::vector<SampleStatistics> statistics_type;
+
+      /**
+       * Constructor.
+       *
+       * @param bins the number of histogram bins.
+       * @throws std::logic_error if @p bins is zero.
+       */
+      explicit
+      PixelStatistics(dimension_size_type bins = 256U);
+
+      /// Destructor.
+      virtual
+      ~PixelStatistics();
+
+      /**
+       * Get the number of histogram bins.
+       *
+       * @returns the number of bins.
+       */
+      dimension_size_type
+      getBins() const;
+
+      /**
+       * Set the number of histogram bins.
+       *
+       * This will take effect at the next reset().
+       *
+       * @param bins the number of bins.
+       * @throws std::logic_error if @p bins is zero.
+       */
+      void
+      setBins(dimension_size_type bins);
+
+      /**
+       * Set an explicit histogram range.
+       *
+       * This will take effect at the next reset().
+       *
+       * @param min the lower bound of the histogram (inclusive).
+       * @param max the upper bound of the histogram (exclusive).
+       * @throws std::logic_error if @p max is not greater than @p min.
+       */
+      void
+      setRange(double min,
+               double max);
+
+      /**
+       * Use the default histogram range for the pixel type.
+       *
+       * This will take effect at the next reset().
+       */
+      void
+      clearRange();
+
+      /**
+       * Get the lower bound of the histogram range.
+       *
+       * @returns the lower bound (inclusive).
+       */
+      double
+      getRangeMin() const;
+
+      /**
+       * Get the upper bound of the histogram range.
+       *
+       * @returns the upper bound (exclusive).
+       */
+      double
+      getRangeMax() const;
+
+      /**
+       * Get the maximum number of threads used by compute().
+       *
+       * @returns the number of threads; zero indicates the number of
+       * hardware threads available.
+       */
+      dimension_size_type
+      getThreads() const;
+
+      /**
+       * Set the maximum number of threads used by compute().
+       *
+       * @param threads the number of threads; zero to use the number
+       * of hardware threads available.
+       */
+      void
+      setThreads(dimension_size_type threads);
+
+      /**
+       * Reset all statistics.
+       *
+       * @param subchannels the number of subchannels.
+       * @param pixeltype the pixel type, used to determine the
+       * default histogram range.
+       */
+      void
+      reset(dimension_size_type                       subchannels,
+            ::ome::xml::model::enums::PixelType pixeltype);
+
+      /**
+       * Compute statistics for a pixel buffer.
+       *
+       * The statistics are reset prior to computation, with one set
+       * of statistics per subchannel of the buffer.
+       *
+       * @param buffer the pixel buffer to use.
+       */
+      void
+      compute(const VariantPixelBuffer& buffer);
+
+      /**
+       * Add samples to the statistics.
+       *
+       * The samples are @p count pixels of @p samples interleaved
+       * samples, the first sample of each pixel being subchannel @p
+       * subchannel.  This is not thread-safe; concurrent callers
+       * must use separate PixelStatistics objects and merge() the
+       * results.
+       *
+       * @param data the sample data.
+       * @param count the number of pixels.
+       * @param samples the number of samples per pixel.
+       * @param subchannel the subchannel of the first sample.
+       * @throws std::logic_error if the subchannels are out of range.
+       */
+      template<typename T>
+      void
+      add(const T            *data,
+          dimension_size_type count,
+          dimension_size_type samples = 1U,
+          dimension_size_type subchannel = 0U)
+      {
+        checkSubchannels(samples, subchannel);
+        for (dimension_size_type s = 0; s < samples; ++s)
+          accumulate(data + s, count, samples, stats[subchannel + s]);
+      }
+
+      /**
+       * Merge statistics.
+       *
+       * @param rhs the statistics to merge; these must have the same
+       * subchannel count, bins and range.
+       * @throws std::logic_error if the statistics are incompatible.
+       */
+      void
+      merge(const PixelStatistics& rhs);
+
+      /**
+       * Get the statistics for all subchannels.
+       *
+       * @returns the statistics.
+       */
+      const statistics_type&
+      getStatistics() const;
+
+      /**
+       * Get the statistics for a single subchannel.
+       *
+       * @param subchannel the subchannel.
+       * @returns the statistics.
+       * @throws std::logic_error if the subchannel is out of range.
+       */
+      const SampleStatistics&
+      getStatistics(dimension_size_type subchannel) const;
+
+      /**
+       * Accumulate strided samples.
+       *
+       * @param data the sample data.
+       * @param count the number of samples.
+       * @param stride the distance between samples.
+       * @param s the statistics to update.
+       */
+      template<typename T>
+      void
+      accumulate(const T            *data,
+                 dimension_size_type count,
+                 dimension_size_type stride,
+                 SampleStatistics&   s) const
+      {
+        typedef boost::integral_constant<bool,
+                                         std::numeric_limits<T>::is_integer &&
+                                         (sizeof(T) <= 2)> exact;
+        accumulate(data, count, stride, s, exact());
+      }
+
+    private:
+      /**
+       * Accumulate strided samples exactly.
+       *
+       * Used for integer samples of up to 16 bits, which can not be
+       * NaN.  The samples are processed in blocks.  The moments of
+       * each block are reduced with integer arithmetic in a loop
+       * without branches or conversions, which the compiler may
+       * vectorize, and the histogram is then updated from the same
+       * block while it is still in cache.
+       *
+       * @param data the sample data.
+       * @param count the number of samples.
+       * @param stride the distance between samples.
+       * @param s the statistics to update.
+       */
+      template<typename T>
+      void
+      accumulate(const T            *data,
+                 dimension_size_type count,
+                 dimension_size_type stride,
+                 SampleStatistics&   s,
+                 boost::true_type) const
+      {
+        const dimension_size_type block = 4096U;
+        const dimension_size_type nbins = s.histogram.size();
+        const double scale = static_cast<double>(nbins) / (rmax - rmin);
+
+        for (dimension_size_type done = 0; done < count; done += block)
+          {
+            const T *begin = data + (done * stride);
+            const dimension_size_type n = std::min(block, count - done);
+            const T *end = begin + (n * stride);
+
+            T vmin = *begin;
+            T vmax = *begin;
+            int64_t sum = 0;
+            uint64_t sumsq = 0;
+            for (const T *d = begin; d != end; d += stride)
+              {
+                const T v = *d;
+                vmin = std::min(vmin, v);
+                vmax = std::max(vmax, v);
+                sum += static_cast<int64_t>(v);
+                sumsq += static_cast<uint64_t>(static_cast<int64_t>(v) * static_cast<int64_t>(v));
+              }
+
+            s.count += n;
+            s.min = std::min(s.min, static_cast<double>(vmin));
+            s.max = std::max(s.max, static_cast<double>(vmax));
+            s.sum += static_cast<double>(sum);
+            s.sumsq += static_cast<double>(sumsq);
+
+            for (const T *d = begin; d != end; d += stride)
+              {
+                const double b = (static_cast<double>(*d) - rmin) * scale;
+                if (b <= 0.0)
+                  ++s.histogram[0];
+                else if (b >= static_cast<double>(nbins))
+                  ++s.histogram[nbins - 1];
+                else
+                  ++s.histogram[static_cast<dimension_size_type>(b)];
+              }
+          }
+      }
+
+      /**
+       * Accumulate strided samples.
+       *
+       * Used for floating point, complex and wider integer samples,
+       * skipping NaN samples.
+       *
+       * @param data the sample data.
+       * @param count the number of samples.
+       * @param stride the distance between samples.
+       * @param s the statistics to update.
+       */
+      template<typename T>
+      void
+      accumulate(const T            *data,
+                 dimension_size_type count,
+                 dimension_size_type stride,
+                 SampleStatistics&   s,
+                 boost::false_type) const
+      {
+        const dimension_size_type nbins = s.histogram.size();
+        const double scale = static_cast<double>(nbins) / (rmax - rmin);
+        double vmin = s.min;
+        double vmax = s.max;
+        double sum = 0.0;
+        double sumsq = 0.0;
+        dimension_size_type n = 0;
+
+        for (const T *end = data + count * stride; data != end; data += stride)
+          {
+            const double v = value(*data);
+            if (v != v) // NaN
+              continue;
+            ++n;
+            vmin = std::min(vmin, v);
+            vmax = std::max(vmax, v);
+            sum += v;
+            sumsq += v * v;
+            const double b = (v - rmin) * scale;
+            if (b <= 0.0)
+              ++s.histogram[0];
+            else if (b >= static_cast<double>(nbins))
+              ++s.histogram[nbins - 1];
+            else
+              ++s.histogram[static_cast<dimension_size_type>(b)];
+          }
+
+        s.count += n;
+        s.min = vmin;
+        s.max = vmax;
+        s.sum += sum;
+        s.sumsq += sumsq;
+      }
+
+      /**
+       * Check subchannels are within range.
+       *
+       * @param samples the number of samples.
+       * @param subchannel the first subchannel.
+       * @throws std::logic_error if out of range.
+       */
+      void
+      checkSubchannels(dimension_size_type samples,
+                       dimension_size_type subchannel) const;
+
+      /**
+       * Convert a sample to a double value.
+       *
+       * @param v the sample value.
+       * @returns the value.
+       */
+      template<typename T>
+      static double
+      value(const T& v)
+      {
+        return static_cast<double>(v);
+      }
+
+      /**
+       * Convert a complex sample to a double value.
+       *
+       * @param v the sample value.
+       * @returns the magnitude of the value.
+       */
+      template<typename T>
+      static double
+      value(const std::complex<T>& v)
+      {
+        return std::abs(std::complex<double>(v.real(), v.imag()));
+      }
+
+      /// Number of histogram bins.
+      dimension_size_type bins;
+      /// Explicit histogram range set.
+      bool explicitrange;
+      /// Explicit histogram lower bound.
+      double explicitmin;
+      /// Explicit histogram upper bound.
+      double explicitmax;
+      /// Current histogram lower bound.
+      double rmin;
+      /// Current histogram upper bound.
+      double rmax;
+      /// Maximum number of threads.
+      dimension_size_type threads;
+      /// Statistics for each subchannel.
+      statistics_type stats;
+    };
+
+  }
+}
+
+#endif // OME_BIOFORMATS_PIXELSTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
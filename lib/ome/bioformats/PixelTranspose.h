@@ -0,0 +1,255 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_BIOFORMATS_PIXELTRANSPOSE_H
+#define OME_BIOFORMATS_PIXELTRANSPOSE_H
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <ome/bioformats/PixelBuffer.h>
+
+#include <ome/compat/array.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+
+    /**
+     * Block size for cache-blocked transposition.
+     *
+     * This is the edge length (in elements) of the square blocks
+     * used when the innermost source and destination dimensions
+     * differ, for example when converting between interleaved and
+     * planar storage ordering.  Both the source and destination
+     * blocks should fit comfortably within the L1 cache.
+     */
+    const boost::multi_array_types::size_type transpose_block_size = 32U;
+
+    /**
+     * Copy pixel data between arrays with differing strides.
+     *
+     * The source and destination are described by the address of
+     * their first element plus the stride of each of the nine
+     * PixelBuffer dimensions, and must be of identical shape.  Any
+     * storage order (including descending dimensions, indicated by a
+     * negative stride) is permitted for both the source and
+     * destination.
+     *
+     * If the innermost (smallest stride) dimension is the same for
+     * the source and destination, the data is copied as runs along
+     * this dimension; where both strides are unity, this is a
+     * straight std::copy.  Otherwise, the two innermost dimensions
+     * are transposed in square blocks of transpose_block_size
+     * elements, writing sequentially to the destination.  This
+     * keeps both the source and destination blocks in cache, which
+     * avoids the cache thrashing of an element-by-element logical
+     * copy, and the unit-stride inner loop permits the compiler to
+     * vectorize the copy.  This is the case when converting between
+     * interleaved (SXY) and planar (XYS) storage orders.
+     *
+     * @param source the first source element.
+     * @param source_strides the source strides (nine dimensions).
+     * @param dest the first destination element.
+     * @param dest_strides the destination strides (nine dimensions).
+     * @param shape the source and destination extents (nine
+     * dimensions).
+     */
+    template<typename T>
+    void
+    transpose(const T                                   *source,
+              const boost::multi_array_types::index     *source_strides,
+              T                                         *dest,
+              const boost::multi_array_types::index     *dest_strides,
+              const boost::multi_array_types::size_type *shape)
+    {
+      typedef boost::multi_array_types::index index;
+      typedef boost::multi_array_types::size_type size_type;
+      const size_type dims = PixelBufferBase::dimensions;
+
+      for (size_type d = 0; d < dims; ++d)
+        if (shape[d] == 0)
+          return;
+
+      // Find the innermost non-unit dimensions of the source and
+      // destination, and the remaining outer dimensions.
+      size_type sdim = dims;
+      size_type ddim = dims;
+      index smin = 0;
+      index dmin = 0;
+      for (size_type d = 0; d < dims; ++d)
+        {
+          if (shape[d] < 2)
+            continue;
+          const index sabs = source_strides[d] < 0 ? -source_strides[d] : source_strides[d];
+          const index dabs = dest_strides[d] < 0 ? -dest_strides[d] : dest_strides[d];
+          if (sdim == dims || sabs < smin)
+            {
+              sdim = d;
+              smin = sabs;
+            }
+          if (ddim == dims || dabs < dmin)
+            {
+              ddim = d;
+              dmin = dabs;
+            }
+        }
+
+      if (sdim == dims) // Single element.
+        {
+          *dest = *source;
+          return;
+        }
+
+      ome::compat::array<size_type, PixelBufferBase::dimensions> outer;
+      size_type nouter = 0;
+      for (size_type d = 0; d < dims; ++d)
+        if (d != sdim && d != ddim && shape[d] > 1)
+          outer[nouter++] = d;
+
+      const index ss = source_strides[sdim];
+      const index ds = dest_strides[sdim];
+      const index sd = source_strides[ddim];
+      const index dd = dest_strides[ddim];
+
+      ome::compat::array<size_type, PixelBufferBase::dimensions> idx;
+      std::fill(idx.begin(), idx.end(), 0);
+      const T *src = source;
+      T *dst = dest;
+
+      while (true)
+        {
+          if (sdim == ddim)
+            {
+              // Same innermost dimension; copy a single run.
+              if (ss == 1 && ds == 1)
+                std::copy(src, src + shape[sdim], dst);
+              else
+                {
+                  const T *s = src;
+                  T *d = dst;
+                  for (size_type i = 0; i < shape[sdim]; ++i, s += ss, d += ds)
+                    *d = *s;
+                }
+            }
+          else
+            {
+              // Differing innermost dimensions; blocked transpose of
+              // the two innermost dimensions.
+              for (size_type b0 = 0; b0 < shape[sdim]; b0 += transpose_block_size)
+                {
+                  const size_type bend = std::min(b0 + transpose_block_size, shape[sdim]);
+                  for (size_type a0 = 0; a0 < shape[ddim]; a0 += transpose_block_size)
+                    {
+                      const size_type aend = std::min(a0 + transpose_block_size, shape[ddim]);
+                      for (size_type b = b0; b < bend; ++b)
+                        {
+                          const T *s = src + static_cast<index>(b) * ss + static_cast<index>(a0) * sd;
+                          T *d = dst + static_cast<index>(b) * ds + static_cast<index>(a0) * dd;
+                          for (size_type a = a0; a < aend; ++a, s += sd, d += dd)
+                            *d = *s;
+                        }
+                    }
+                }
+            }
+
+          // Advance to the next run or block over the outer
+          // dimensions.
+          size_type o = 0;
+          for (; o < nouter; ++o)
+            {
+              const size_type d = outer[o];
+              src += source_strides[d];
+              dst += dest_strides[d];
+              if (++idx[d] < shape[d])
+                break;
+              src -= source_strides[d] * static_cast<index>(shape[d]);
+              dst -= dest_strides[d] * static_cast<index>(shape[d]);
+              idx[d] = 0;
+            }
+          if (o == nouter)
+            break;
+        }
+    }
+
+    /**
+     * Copy pixel data between buffers with differing storage order.
+     *
+     * This is equivalent to assignment of the source to the
+     * destination (the logical order of the data is preserved), but
+     * uses transpose() to efficiently convert between storage
+     * orders.
+     *
+     * @param source the source pixel buffer.
+     * @param dest the destination pixel buffer.
+     * @throws std::runtime_error if the buffer extents differ.
+     */
+    template<typename T>
+    void
+    transpose(const PixelBuffer<T>& source,
+              PixelBuffer<T>&       dest)
+    {
+      typedef boost::multi_array_types::index index;
+
+      const boost::multi_array_types::size_type *shape = source.shape();
+      if (!std::equal(shape, shape + PixelBufferBase::dimensions, dest.shape()))
+        throw std::runtime_error("Buffer dimensions incompatible for transposition");
+
+      // Address of the first element (taking any non-zero index
+      // bases into account).
+      const T *src = source.origin();
+      T *dst = dest.array().origin();
+      for (boost::multi_array_types::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+        {
+          src += source.index_bases()[d] * source.strides()[d];
+          dst += dest.index_bases()[d] * dest.strides()[d];
+        }
+
+      transpose(src, source.strides(), dst, dest.strides(), shape);
+    }
+
+  }
+}
+
+#endif // OME_BIOFORMATS_PIXELTRANSPOSE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
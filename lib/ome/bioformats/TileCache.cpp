@@ -35,6 +35,13 @@
  * #L%
  */
 
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/format.hpp>
+
 #include <ome/bioformats/TileCache.h>
 
 namespace ome
@@ -42,8 +49,132 @@ namespace ome
   namespace bioformats
   {
 
+    /**
+     * Spill file for tiles exceeding the memory limit.
+     *
+     * Tiles are stored in a temporary file which is removed on
+     * destruction.  The space used by restored or erased tiles is
+     * reused for subsequent spills of the same size; since all the
+     * tiles of an IFD are of identical size, the file will not grow
+     * beyond the peak number of spilled tiles.
+     */
+    class TileCache::Spill
+    {
+    public:
+      /// Temporary file path.
+      boost::filesystem::path path;
+      /// Temporary file stream.
+      std::fstream stream;
+      /// Spilled tiles (offset and size).
+      std::map<key_type, std::pair<std::streamoff, dimension_size_type> > tiles;
+      /// Unused space (size and offset).
+      std::multimap<dimension_size_type, std::streamoff> unused;
+      /// End of file.
+      std::streamoff end;
+
+      /// Constructor.
+      Spill():
+        path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("ome-bioformats-tiles-%%%%-%%%%-%%%%-%%%%.tmp")),
+        stream(),
+        tiles(),
+        unused(),
+        end(0)
+      {
+        stream.open(path.string().c_str(),
+                    std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!stream)
+          {
+            boost::format fmt("Failed to create tile cache spill file %1%");
+            fmt % path.string();
+            throw std::runtime_error(fmt.str());
+          }
+      }
+
+      /// Destructor.
+      ~Spill()
+      {
+        stream.close();
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+      }
+
+      /**
+       * Write a tile.
+       *
+       * @param tileindex the tile index.
+       * @param buffer the tile buffer.
+       */
+      void
+      write(key_type          tileindex,
+            const TileBuffer& buffer)
+      {
+        std::streamoff offset = end;
+        std::multimap<dimension_size_type, std::streamoff>::iterator i = unused.find(buffer.size());
+        if (i != unused.end())
+          {
+            offset = i->second;
+            unused.erase(i);
+          }
+        else
+          end += static_cast<std::streamoff>(buffer.size());
+
+        stream.seekp(offset);
+        stream.write(reinterpret_cast<const char *>(buffer.data()),
+                     static_cast<std::streamsize>(buffer.size()));
+        if (!stream)
+          throw std::runtime_error("Failed to write tile to tile cache spill file");
+
+        tiles[tileindex] = std::make_pair(offset, buffer.size());
+      }
+
+      /**
+       * Read and remove a tile.
+       *
+       * @param tileindex the tile index.
+       * @returns the tile buffer, or null if the tile was not
+       * spilled.
+       */
+      value_type
+      read(key_type tileindex)
+      {
+        value_type buffer;
+
+        std::map<key_type, std::pair<std::streamoff, dimension_size_type> >::iterator i = tiles.find(tileindex);
+        if (i != tiles.end())
+          {
+            buffer = value_type(new TileBuffer(i->second.second));
+            stream.seekg(i->second.first);
+            stream.read(reinterpret_cast<char *>(buffer->data()),
+                        static_cast<std::streamsize>(buffer->size()));
+            if (!stream)
+              throw std::runtime_error("Failed to read tile from tile cache spill file");
+            erase(i);
+          }
+
+        return buffer;
+      }
+
+      /**
+       * Remove a tile.
+       *
+       * @param i the tile to remove.
+       */
+      void
+      erase(std::map<key_type, std::pair<std::streamoff, dimension_size_type> >::iterator i)
+      {
+        unused.insert(std::make_pair(i->second.second, i->second.first));
+        tiles.erase(i);
+      }
+    };
+
     TileCache::TileCache():
-      cache()
+      cache(),
+      lru(),
+      limit(0),
+      usage(0),
+      pending(),
+      spill()
     {
     }
 
@@ -55,23 +186,41 @@ namespace ome
     TileCache::insert(key_type   tileindex,
                       value_type tilebuffer)
     {
-      std::pair<std::map<key_type, value_type>::iterator, bool> i =
-        cache.insert(std::pair<key_type, value_type>(tileindex, tilebuffer));
+      if (!tilebuffer ||
+          (spill && spill->tiles.find(tileindex) != spill->tiles.end()))
+        return false;
+
+      std::pair<cache_type::iterator, bool> i = add(tileindex, tilebuffer);
+      if (i.second)
+        enforceLimit(&tileindex);
       return i.second;
     }
 
     void
     TileCache::erase(key_type tileindex)
     {
-      cache.erase(tileindex);
+      cache_type::iterator e = cache.find(tileindex);
+      if (e != cache.end())
+        remove(e);
+      if (spill)
+        {
+          std::map<key_type, std::pair<std::streamoff, dimension_size_type> >::iterator i = spill->tiles.find(tileindex);
+          if (i != spill->tiles.end())
+            spill->erase(i);
+        }
     }
 
     TileCache::value_type
     TileCache::find(key_type tileindex)
     {
-      std::map<key_type, value_type>::iterator i = cache.find(tileindex);
+      cache_type::iterator i = cache.find(tileindex);
+      if (i == cache.end())
+        i = restore(tileindex);
       if (i != cache.end())
-        return i->second;
+        {
+          touch(i->second);
+          return i->second.buffer;
+        }
       else
         return value_type();
     }
@@ -79,9 +228,14 @@ namespace ome
     const TileCache::value_type
     TileCache::find(key_type tileindex) const
     {
-      std::map<key_type, value_type>::const_iterator i = cache.find(tileindex);
+      cache_type::iterator i = cache.find(tileindex);
+      if (i == cache.end())
+        i = restore(tileindex);
       if (i != cache.end())
-        return i->second;
+        {
+          touch(i->second);
+          return i->second.buffer;
+        }
       else
         return value_type();
     }
@@ -89,29 +243,160 @@ namespace ome
     dimension_size_type
     TileCache::size() const
     {
-      return cache.size();
+      return cache.size() + (spill ? spill->tiles.size() : 0U);
     }
 
     void
     TileCache::clear()
     {
       cache.clear();
+      lru.clear();
+      usage = 0U;
+      pending.clear();
+      spill.reset();
     }
 
     TileCache::value_type&
     TileCache::operator[](key_type tileindex)
     {
-      std::map<key_type, value_type>::iterator i = cache.find(tileindex);
+      // Account for any tile previously obtained here, since it may
+      // not be retained past this call.
+      enforceLimit(0);
+
+      cache_type::iterator i = cache.find(tileindex);
+      if (i == cache.end())
+        i = restore(tileindex);
       if (i != cache.end())
-        return i->second;
+        touch(i->second);
       else
+        i = add(tileindex, value_type()).first;
+      // The returned buffer may be reassigned by the caller.
+      pending.push_back(tileindex);
+      return i->second.buffer;
+    }
+
+    dimension_size_type
+    TileCache::getMemoryLimit() const
+    {
+      return limit;
+    }
+
+    void
+    TileCache::setMemoryLimit(dimension_size_type limit)
+    {
+      this->limit = limit;
+      enforceLimit(0);
+    }
+
+    dimension_size_type
+    TileCache::memoryUsage() const
+    {
+      reconcile();
+      return usage;
+    }
+
+    std::pair<TileCache::cache_type::iterator, bool>
+    TileCache::add(key_type   tileindex,
+                   value_type buffer) const
+    {
+      Entry entry;
+      entry.buffer = buffer;
+      entry.position = lru.end();
+      entry.size = buffer ? buffer->size() : 0U;
+
+      std::pair<cache_type::iterator, bool> i =
+        cache.insert(std::pair<key_type, Entry>(tileindex, entry));
+      if (i.second)
+        {
+          i.first->second.position = lru.insert(lru.end(), tileindex);
+          usage += entry.size;
+        }
+      return i;
+    }
+
+    void
+    TileCache::remove(cache_type::iterator entry) const
+    {
+      usage -= entry->second.size;
+      lru.erase(entry->second.position);
+      cache.erase(entry);
+    }
+
+    void
+    TileCache::touch(Entry& entry) const
+    {
+      lru.splice(lru.end(), lru, entry.position);
+    }
+
+    TileCache::cache_type::iterator
+    TileCache::restore(key_type tileindex) const
+    {
+      cache_type::iterator i = cache.end();
+
+      if (spill)
         {
-          value_type value;
-          std::pair<std::map<key_type, value_type>::iterator, bool> i =
-            cache.insert(std::pair<key_type, value_type>(tileindex, value));
-          return i.first->second;
+          value_type buffer = spill->read(tileindex);
+          if (buffer)
+            {
+              i = add(tileindex, buffer).first;
+              enforceLimit(&tileindex);
+            }
+        }
+
+      return i;
+    }
+
+    void
+    TileCache::reconcile() const
+    {
+      for (std::vector<key_type>::const_iterator k = pending.begin();
+           k != pending.end();
+           ++k)
+        {
+          cache_type::iterator i = cache.find(*k);
+          if (i != cache.end())
+            {
+              dimension_size_type size = i->second.buffer ? i->second.buffer->size() : 0U;
+              usage -= i->second.size;
+              usage += size;
+              i->second.size = size;
+            }
+        }
+      pending.clear();
+    }
+
+    void
+    TileCache::enforceLimit(const key_type *keep) const
+    {
+      reconcile();
+
+      if (!limit)
+        return;
+
+      // Spill the least recently used tiles first.
+      lru_type::iterator next = lru.begin();
+      while (usage > limit && next != lru.end())
+        {
+          lru_type::iterator current = next++;
+          if (keep && *current == *keep)
+            continue;
+
+          cache_type::iterator e = cache.find(*current);
+          if (!e->second.buffer)
+            continue;
+
+          if (!spill)
+            spill = ome::compat::shared_ptr<Spill>(new Spill());
+          spill->write(e->first, *e->second.buffer);
+          remove(e);
         }
     }
 
   }
 }
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
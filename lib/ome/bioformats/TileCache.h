@@ -43,7 +43,9 @@
 
 #include <ome/compat/memory.h>
 
+#include <list>
 #include <map>
+#include <vector>
 
 namespace ome
 {
@@ -55,6 +57,14 @@ namespace ome
      *
      * This is a collection of TileBuffer objects indexed by tile
      * number.
+     *
+     * The memory used by the cached tile buffers may optionally be
+     * limited.  If the limit is exceeded, the least recently used
+     * tile buffers are spilled to a temporary file, and are
+     * transparently restored when next accessed with find() or
+     * operator[].  Tile buffers obtained from the cache should
+     * therefore not be retained across subsequent insertions or
+     * lookups of other tiles, since the cache may spill them.
      */
     class TileCache
     {
@@ -71,8 +81,9 @@ namespace ome
       virtual ~TileCache();
 
     private:
-      // To avoid unintentional and expensive copies, copying and
-      // assignment of caches is prevented.
+      // To avoid unintentional and expensive copies, and sharing of
+      // the spill file, copying and assignment of caches is
+      // prevented.
 
       /// Copy constructor (deleted).
       TileCache (const TileCache&);
@@ -131,6 +142,8 @@ namespace ome
       /**
        * Get the tile cache size.
        *
+       * This includes both resident and spilled tiles.
+       *
        * @returns the tile cache size.
        */
       dimension_size_type
@@ -157,9 +170,133 @@ namespace ome
       value_type&
       operator[](key_type tileindex);
 
+      /**
+       * Get the memory limit.
+       *
+       * @returns the maximum size of resident tile buffers (bytes);
+       * zero if unlimited.
+       */
+      dimension_size_type
+      getMemoryLimit() const;
+
+      /**
+       * Set the memory limit.
+       *
+       * If the resident tile buffers exceed the new limit, the least
+       * recently used will be spilled immediately.
+       *
+       * @param limit the maximum size of resident tile buffers
+       * (bytes); zero if unlimited.
+       */
+      void
+      setMemoryLimit(dimension_size_type limit);
+
+      /**
+       * Get the memory usage.
+       *
+       * @returns the total size of resident tile buffers (bytes).
+       */
+      dimension_size_type
+      memoryUsage() const;
+
     private:
-      /// Mapping of tile number to tile buffer.
-      std::map<key_type, value_type> cache;
+      /// Spill file for tiles exceeding the memory limit.
+      class Spill;
+
+      /// Recency list of resident tiles (least recently used first).
+      typedef std::list<key_type> lru_type;
+
+      /// Cache entry.
+      struct Entry
+      {
+        /// Tile buffer.
+        value_type buffer;
+        /// Position in the recency list.
+        lru_type::iterator position;
+        /// Size of the tile buffer included in the memory usage.
+        dimension_size_type size;
+      };
+
+      /// Mapping of tile number to resident tile buffer.
+      typedef std::map<key_type, Entry> cache_type;
+
+      /**
+       * Add a resident tile.
+       *
+       * The tile is marked as most recently used.
+       *
+       * @param tileindex the tile index.
+       * @param buffer the tile buffer (may be null).
+       * @returns an iterator to the new entry, or to the existing
+       * entry if the tile was already resident.
+       */
+      std::pair<cache_type::iterator, bool>
+      add(key_type   tileindex,
+          value_type buffer) const;
+
+      /**
+       * Remove a resident tile.
+       *
+       * @param entry the tile to remove.
+       */
+      void
+      remove(cache_type::iterator entry) const;
+
+      /**
+       * Mark a resident tile as most recently used.
+       *
+       * @param entry the cache entry to update.
+       */
+      void
+      touch(Entry& entry) const;
+
+      /**
+       * Restore a spilled tile.
+       *
+       * @param tileindex the tile to restore.
+       * @returns an iterator to the restored tile, or the end
+       * iterator if the tile was not spilled.
+       */
+      cache_type::iterator
+      restore(key_type tileindex) const;
+
+      /**
+       * Update the memory usage for tiles obtained with operator[].
+       *
+       * The tile buffers of these tiles may have been assigned
+       * after they were obtained, so their sizes are only accounted
+       * for when the usage is next required, or when the cache is
+       * next accessed.
+       */
+      void
+      reconcile() const;
+
+      /**
+       * Spill tiles until the memory limit is satisfied.
+       *
+       * Pending tiles are reconciled whether or not a limit is set.
+       *
+       * @param keep a tile which must remain resident, or null.
+       */
+      void
+      enforceLimit(const key_type *keep) const;
+
+      /// Resident tile buffers.
+      mutable cache_type cache;
+      /// Resident tiles in order of use.
+      mutable lru_type lru;
+      /// Maximum size of resident tile buffers (bytes); zero if unlimited.
+      dimension_size_type limit;
+      /// Total size of resident tile buffers (bytes).
+      mutable dimension_size_type usage;
+      /// Tiles obtained with operator[] not yet accounted for.
+      mutable std::vector<key_type> pending;
+      /**
+       * Spilled tiles (created on first use).
+       *
+       * Owned by this cache alone, since copying is prevented.
+       */
+      mutable ome::compat::shared_ptr<Spill> spill;
     };
 
   }
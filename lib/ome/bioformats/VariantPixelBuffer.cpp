@@ -35,6 +35,11 @@
  * #L%
  */
 
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/format.hpp>
 #include <boost/type_traits.hpp>
 
 #include <ome/bioformats/VariantPixelBuffer.h>
@@ -48,33 +53,26 @@ using ::ome::xml::model::enums::PixelType;
 namespace
 {
 
-  struct PBCopyVisitor : public boost::static_visitor<>
+  struct PBValidVisitor : public boost::static_visitor<bool>
   {
-  private:
-    VariantPixelBuffer::variant_buffer_type& dest;
-
-  public:
-    PBCopyVisitor(VariantPixelBuffer::variant_buffer_type& dest):
-      dest(dest)
-    {}
-
     template <typename T>
-    void
+    bool
     operator() (const T& v)
     {
-      dest = v;
+      return v && v->valid();
     }
   };
 
-  struct PBValidVisitor : public boost::static_visitor<bool>
+  struct PBCloneVisitor : public boost::static_visitor<ome::compat::shared_ptr<VariantPixelBuffer> >
   {
     template <typename T>
-    bool
-    operator() (const T& v)
+    ome::compat::shared_ptr<VariantPixelBuffer>
+    operator() (const T& v) const
     {
       if (!v)
         throw std::runtime_error("Null pixel type");
-      return v->valid();
+      T copy(v->clone());
+      return ome::compat::shared_ptr<VariantPixelBuffer>(new VariantPixelBuffer(copy));
     }
   };
 
@@ -162,6 +160,31 @@ namespace
     }
   };
 
+  struct PBSpanVisitor : public boost::static_visitor<ome::bioformats::PixelSpan<VariantPixelBuffer::raw_type> >
+  {
+    template <typename T>
+    ome::bioformats::PixelSpan<VariantPixelBuffer::raw_type>
+    operator() (T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      return v->rawSpan();
+    }
+  };
+
+  struct PBConstSpanVisitor : public boost::static_visitor<ome::bioformats::PixelSpan<const VariantPixelBuffer::raw_type> >
+  {
+    template <typename T>
+    ome::bioformats::PixelSpan<const VariantPixelBuffer::raw_type>
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      const typename T::element_type& cv(*v);
+      return cv.rawSpan();
+    }
+  };
+
   struct PBRawBufferVisitor : public boost::static_visitor<VariantPixelBuffer::raw_type *>
   {
     template <typename T>
@@ -316,10 +339,26 @@ namespace ome
   {
 
     VariantPixelBuffer::VariantPixelBuffer(const VariantPixelBuffer& buffer):
-      buffer()
+      buffer(buffer.buffer)
+    {
+    }
+
+    ome::compat::shared_ptr<VariantPixelBuffer>
+    VariantPixelBuffer::view() const
+    {
+      return ome::compat::shared_ptr<VariantPixelBuffer>(new VariantPixelBuffer(*this));
+    }
+
+    ome::compat::shared_ptr<VariantPixelBuffer>
+    VariantPixelBuffer::clone() const
+    {
+      return boost::apply_visitor(PBCloneVisitor(), buffer);
+    }
+
+    void
+    VariantPixelBuffer::swap(VariantPixelBuffer& rhs)
     {
-      PBCopyVisitor v(this->buffer);
-      boost::apply_visitor(v, buffer.buffer);
+      buffer.swap(rhs.buffer);
     }
 
     bool
@@ -336,6 +375,65 @@ namespace ome
       return boost::apply_visitor(v, buffer);
     }
 
+    bool
+    VariantPixelBuffer::compatible(const ome::compat::array<size_type, PixelBufferBase::dimensions>& extents,
+                                   ::ome::xml::model::enums::PixelType                               pixeltype,
+                                   const storage_order_type&                                         storage) const
+    {
+      if (pixelType() != pixeltype)
+        return false;
+
+      const size_type *buffer_shape(shape());
+      if (!std::equal(extents.begin(), extents.end(), buffer_shape))
+        return false;
+
+      const boost::multi_array_types::index *buffer_bases(index_bases());
+      for (size_type i = 0; i < PixelBufferBase::dimensions; ++i)
+        if (buffer_bases[i] != 0)
+          return false;
+
+      // Compare the strides the storage order would give with the
+      // buffer strides.  Dimensions of extent 1 are never stepped
+      // over, so orders differing only in their placement are
+      // equivalent.
+      const boost::multi_array_types::index *buffer_strides(strides());
+      boost::multi_array_types::index stride = 1;
+      for (size_type i = 0; i < PixelBufferBase::dimensions; ++i)
+        {
+          const size_type dim = storage.ordering(i);
+          if (extents[dim] > 1)
+            {
+              const boost::multi_array_types::index expected =
+                storage.ascending(dim) ? stride : -stride;
+              if (buffer_strides[dim] != expected)
+                return false;
+            }
+          stride *= static_cast<boost::multi_array_types::index>(extents[dim]);
+        }
+
+      return true;
+    }
+
+    void
+    VariantPixelBuffer::ensureBuffer(const ome::compat::array<size_type, PixelBufferBase::dimensions>& extents,
+                                     ::ome::xml::model::enums::PixelType                               pixeltype,
+                                     const storage_order_type&                                         storage)
+    {
+      if (compatible(extents, pixeltype, storage))
+        return;
+
+      if (!managed())
+        {
+          boost::format fmt("External pixel buffer (%1%, %2%x%3%, %4% samples) incompatible with required pixel type, shape or storage order (%5%, %6%x%7%, %8% samples)");
+          const size_type *buffer_shape(shape());
+          fmt % pixelType() % buffer_shape[DIM_SPATIAL_X] % buffer_shape[DIM_SPATIAL_Y] % buffer_shape[DIM_SUBCHANNEL];
+          fmt % pixeltype % extents[DIM_SPATIAL_X] % extents[DIM_SPATIAL_Y] % extents[DIM_SUBCHANNEL];
+          throw std::logic_error(fmt.str());
+        }
+
+      setBuffer(extents, pixeltype, storage);
+    }
+
     boost::multi_array_types::size_type
     VariantPixelBuffer::num_elements() const
     {
@@ -378,6 +476,20 @@ namespace ome
       return boost::apply_visitor(v, buffer);
     }
 
+    ome::bioformats::PixelSpan<VariantPixelBuffer::raw_type>
+    VariantPixelBuffer::span()
+    {
+      PBSpanVisitor v;
+      return boost::apply_visitor(v, buffer);
+    }
+
+    ome::bioformats::PixelSpan<const VariantPixelBuffer::raw_type>
+    VariantPixelBuffer::span() const
+    {
+      PBConstSpanVisitor v;
+      return boost::apply_visitor(v, buffer);
+    }
+
     PixelType
     VariantPixelBuffer::pixelType() const
     {
@@ -413,6 +525,16 @@ namespace ome
       return *this;
     }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    VariantPixelBuffer&
+    VariantPixelBuffer::operator = (VariantPixelBuffer&& rhs)
+    {
+      if (this != &rhs)
+        buffer = std::move(rhs.buffer);
+      return *this;
+    }
+#endif
+
     bool
     VariantPixelBuffer::operator == (const VariantPixelBuffer& rhs) const
     {
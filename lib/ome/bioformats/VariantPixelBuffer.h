@@ -38,6 +38,8 @@
 #ifndef OME_BIOFORMATS_VARIANTPIXELBUFFER_H
 #define OME_BIOFORMATS_VARIANTPIXELBUFFER_H
 
+#include <utility>
+
 #include <ome/bioformats/PixelBuffer.h>
 #include <ome/bioformats/PixelProperties.h>
 
@@ -208,6 +210,24 @@ namespace ome
       explicit
       VariantPixelBuffer(const VariantPixelBuffer& buffer);
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      /**
+       * Move constructor.
+       *
+       * The contained buffer is transferred without copying the
+       * pixel data or its reference count.  @p buffer is left
+       * without a buffer (valid() will return @c false), and may
+       * only be destroyed or reassigned using move assignment,
+       * swap() or setBuffer().
+       *
+       * @param buffer the buffer to move.
+       */
+      VariantPixelBuffer(VariantPixelBuffer&& buffer):
+        buffer(std::move(buffer.buffer))
+      {
+      }
+#endif
+
       /**
        * Construct from existing pixel buffer.  Use for referencing external data.
        *
@@ -220,6 +240,34 @@ namespace ome
       {
       }
 
+      /**
+       * Construct from extents (external storage).
+       *
+       * The buffer will reference the caller-provided storage rather
+       * than allocating its own.  This storage must be of sufficient
+       * size to contain the specified extents of the specified pixel
+       * type, and must exist for the lifetime of this object.  This
+       * permits pixel data to be read directly into caller-owned
+       * memory, such as a shared memory segment or an array owned by
+       * another language runtime.
+       *
+       * @param pixeldata the externally-provided storage for pixel
+       * data.
+       * @param extents the extent of each dimension.
+       * @param pixeltype the pixel type to store.
+       * @param storage the storage ordering, defaulting to C array
+       * storage ordering.
+       */
+      template<class ExtentList>
+      explicit
+      VariantPixelBuffer(void                                *pixeldata,
+                         const ExtentList&                   extents,
+                         ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                         const storage_order_type&           storage = PixelBufferBase::default_storage_order()):
+        buffer(createBuffer(pixeldata, extents, pixeltype, storage))
+      {
+      }
+
       /// Destructor.
       virtual
       ~VariantPixelBuffer()
@@ -247,6 +295,42 @@ namespace ome
         return buffer;
       }
 
+      /**
+       * Create a shallow view of this buffer.
+       *
+       * The view shares the storage of this buffer; no pixel data
+       * is copied, and modifications made through either buffer are
+       * visible in both.  This is equivalent to the copy
+       * constructor.
+       *
+       * @returns the new view.
+       */
+      ome::compat::shared_ptr<VariantPixelBuffer>
+      view() const;
+
+      /**
+       * Create a deep copy of this buffer.
+       *
+       * The copy has the same extents, index bases, pixel type and
+       * storage order as this buffer, but uses separate, internally
+       * managed storage, even if this buffer uses external storage.
+       *
+       * @returns the new copy.
+       */
+      ome::compat::shared_ptr<VariantPixelBuffer>
+      clone() const;
+
+      /**
+       * Swap the contained buffers of two buffers.
+       *
+       * No pixel data is copied.  The buffers may be of different
+       * pixel types.
+       *
+       * @param rhs the buffer to swap with.
+       */
+      void
+      swap(VariantPixelBuffer& rhs);
+
     protected:
       /**
        * Create buffer from extents (helper).
@@ -268,6 +352,29 @@ namespace ome
         return variant_buffer_type(ome::compat::shared_ptr<PixelBuffer<T> >(new PixelBuffer<T>(extents, pixeltype, ENDIAN_NATIVE, storage)));
       }
 
+      /**
+       * Create buffer from extents (helper).
+       *
+       * The buffer will reference external storage.
+       *
+       * @param pixeldata the externally-provided storage for pixel
+       * data.
+       * @param extents the extent of each dimension.
+       * @param storage the storage ordering, defaulting to C array
+       * storage ordering.
+       * @param pixeltype the pixel type to store.
+       * @returns the new buffer contained in a variant.
+       */
+      template<class T, class ExtentList>
+      static variant_buffer_type
+      makeBuffer(void                                *pixeldata,
+                 const ExtentList&                   extents,
+                 const storage_order_type&           storage,
+                 ::ome::xml::model::enums::PixelType pixeltype)
+      {
+        return variant_buffer_type(ome::compat::shared_ptr<PixelBuffer<T> >(new PixelBuffer<T>(static_cast<T *>(pixeldata), extents, pixeltype, ENDIAN_NATIVE, storage)));
+      }
+
       /**
        * Create buffer from ranges (helper).
        *
@@ -355,6 +462,68 @@ namespace ome
         return buf;
       }
 
+      /**
+       * Create buffer from extents (external storage).
+       *
+       * The buffer will reference external storage.
+       *
+       * @param pixeldata the externally-provided storage for pixel
+       * data.
+       * @param extents the extent of each dimension.
+       * @param pixeltype the pixel type to store.
+       * @param storage the storage ordering, defaulting to C array
+       * storage ordering.
+       * @returns the new buffer contained in a variant.
+       */
+      template<class ExtentList>
+      static variant_buffer_type
+      createBuffer(void                                *pixeldata,
+                   const ExtentList&                   extents,
+                   ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                   const storage_order_type&           storage = PixelBufferBase::default_storage_order())
+      {
+        variant_buffer_type buf;
+
+        switch(pixeltype)
+          {
+          case ::ome::xml::model::enums::PixelType::INT8:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::INT8>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::INT16:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::INT16>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::INT32:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::INT32>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::UINT8:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::UINT8>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::UINT16:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::UINT16>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case :: ome::xml::model::enums::PixelType::UINT32:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::UINT32>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::FLOAT:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::FLOAT>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::DOUBLE:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::DOUBLE>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::BIT:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::BIT>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::COMPLEX:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::COMPLEX>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          case ::ome::xml::model::enums::PixelType::DOUBLECOMPLEX:
+            buf = makeBuffer<PixelProperties< ::ome::xml::model::enums::PixelType::DOUBLECOMPLEX>::std_type>(pixeldata, extents, storage, pixeltype);
+            break;
+          }
+
+        return buf;
+      }
+
       /**
        * Create buffer from ranges (helper).
        *
@@ -455,6 +624,51 @@ namespace ome
         buffer = createBuffer(range, pixeltype, storage);
       }
 
+      /**
+       * Check if the buffer is compatible with the specified layout.
+       *
+       * The buffer is compatible if it has the specified pixel type
+       * and extents, all index bases are zero, and its elements are
+       * laid out in memory as for the specified storage order.  The
+       * storage order itself need not be identical: dimensions with
+       * an extent of 1 do not affect the layout, so for example a
+       * single plane is compatible with any ordering of the @c Z,
+       * @c T and @c C dimensions, and a single subchannel with both
+       * interleaved and planar orders.  A compatible buffer may be
+       * filled in place by readers without any reallocation.
+       *
+       * @param extents the extent of each dimension.
+       * @param pixeltype the pixel type.
+       * @param storage the storage ordering.
+       * @returns @c true if compatible, @c false otherwise.
+       */
+      bool
+      compatible(const ome::compat::array<size_type, PixelBufferBase::dimensions>& extents,
+                 ::ome::xml::model::enums::PixelType                               pixeltype,
+                 const storage_order_type&                                         storage) const;
+
+      /**
+       * Ensure the buffer has the specified layout.
+       *
+       * If the buffer is already compatible with the specified
+       * layout, it is left unchanged, so that existing storage
+       * (including external storage) will be used in place.  If not
+       * compatible and the storage is managed internally, the buffer
+       * will be reset using setBuffer().  If not compatible and the
+       * storage is external, it can not be reallocated, and an
+       * exception will be thrown.
+       *
+       * @param extents the extent of each dimension.
+       * @param pixeltype the pixel type.
+       * @param storage the storage ordering.
+       * @throws std::logic_error if the buffer references external
+       * storage with an incompatible layout.
+       */
+      void
+      ensureBuffer(const ome::compat::array<size_type, PixelBufferBase::dimensions>& extents,
+                   ::ome::xml::model::enums::PixelType                               pixeltype,
+                   const storage_order_type&                                         storage);
+
       /**
        * Check if the buffer is internally managed.
        *
@@ -530,6 +744,27 @@ namespace ome
       const storage_order_type&
       storage_order() const;
 
+      /**
+       * Get a raw byte span of the pixel data.
+       *
+       * The span resolves the buffer pointer, extents and strides
+       * (in bytes) with a single dispatch on the pixel type, for use
+       * in loops which copy or transform pixel data without regard
+       * to the pixel type.
+       *
+       * @returns the span.
+       */
+      PixelSpan<raw_type>
+      span();
+
+      /**
+       * Get a raw byte span of the pixel data.
+       *
+       * @returns the span.
+       */
+      PixelSpan<const raw_type>
+      span() const;
+
       /**
        * Get the type of pixels stored in the buffer.
        */
@@ -611,6 +846,7 @@ namespace ome
        * to use.  Note that this is not a guarantee of safety in the
        * case of using an externally managed data buffer, in which
        * case the external buffer must still be valid in addition.
+       * A buffer which has been moved from is not valid.
        *
        * @returns @c true if not null, @c false if null.
        */
@@ -630,6 +866,24 @@ namespace ome
       VariantPixelBuffer&
       operator = (const VariantPixelBuffer& rhs);
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+      /**
+       * Move assign a pixel buffer.
+       *
+       * Unlike copy assignment, which copies the pixel values into
+       * the existing storage, this replaces the contained buffer
+       * with that of @p rhs without copying the pixel data.  The
+       * pixel type, extents and storage order will be those of @p
+       * rhs.  @p rhs is left without a buffer (valid() will return
+       * @c false).
+       *
+       * @param rhs the pixel buffer to move.
+       * @returns the assigned buffer.
+       */
+      VariantPixelBuffer&
+      operator = (VariantPixelBuffer&& rhs);
+#endif
+
       /**
        * Compare a pixel buffer for equality.
        *
@@ -912,9 +1166,11 @@ namespace ome
           // long as it matches what the TIFF reader/writer uses.
           PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
 
-          /// @todo Only call setBuffer if the shape and pixel type
-          /// differ, to allow user control over storage order.
-          dest.setBuffer(dest_shape, v->pixelType(), order);
+          // Reuse the destination buffer if the shape and pixel type
+          // match, in any storage order, so that user-provided
+          // (including external) storage is filled in place.
+          if (!dest.compatible(dest_shape, v->pixelType(), dest.storage_order()))
+            dest.ensureBuffer(dest_shape, v->pixelType(), order);
 
           T& destbuf = boost::get<T>(dest.vbuffer());
 
@@ -36,14 +36,32 @@
  */
 
 #include <cctype>
+#include <map>
+#include <sstream>
+
+#include <boost/thread.hpp>
 
 #include <ome/bioformats/XMLTools.h>
+#include <ome/bioformats/detail/XMLScan.h>
+#include <ome/bioformats/detail/XMLScanParser.h>
+
+#include <ome/compat/memory.h>
 
 #include <ome/common/xml/ErrorReporter.h>
 #include <ome/common/xml/Platform.h>
 #include <ome/common/xml/String.h>
 
 #include <ome/xml/Document.h>
+#include <ome/xml/OMEEntityResolver.h>
+
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/internal/XMLGrammarPoolImpl.hpp>
+#include <xercesc/sax/SAXException.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/validators/common/Grammar.hpp>
 
 namespace xml = ome::common::xml;
 
@@ -53,6 +71,228 @@ namespace
   const std::string xsi_ns("http://www.w3.org/2001/XMLSchema-instance");
   const std::string xml_schema_path("http://www.w3.org/2001/XMLSchema");
 
+  /**
+   * Find the schema of the root element of an XML document.
+   *
+   * Only the root element start tag is parsed.
+   */
+  class RootSchemaHandler : public xercesc::DefaultHandler
+  {
+  public:
+    /// Constructor.
+    RootSchemaHandler():
+      xercesc::DefaultHandler(),
+      ns(),
+      location()
+    {
+    }
+
+    /// Destructor.
+    ~RootSchemaHandler()
+    {
+    }
+
+    void
+    startElement(const XMLCh* const         uri,
+                 const XMLCh* const         /* localname */,
+                 const XMLCh* const         /* qname */,
+                 const xercesc::Attributes& attrs)
+    {
+      ns = xml::String(uri);
+
+      // Find the location for the root namespace in the list of
+      // namespace and location pairs.
+      const XMLCh *value = attrs.getValue(xml::String(xsi_ns),
+                                          xml::String("schemaLocation"));
+      if (value)
+        {
+          std::istringstream is(static_cast<std::string>(xml::String(value)));
+          std::string schemans, schemaloc;
+          while (is >> schemans >> schemaloc)
+            {
+              if (schemans == ns)
+                {
+                  location = schemaloc;
+                  break;
+                }
+            }
+        }
+
+      // Stop parsing.
+      throw xercesc::SAXException(xml::String("Root element found"));
+    }
+
+    /// Root element namespace.
+    std::string ns;
+    /// Schema location for the root element namespace.
+    std::string location;
+  };
+
+  /**
+   * Find the schema of the root element of an XML document.
+   *
+   * @param s the XML document.
+   * @param ns the namespace of the root element.
+   * @param location the schema location for @p ns.
+   * @returns @c true if a schema was found, @c false otherwise.
+   */
+  bool
+  findRootSchema(const std::string& s,
+                 std::string&       ns,
+                 std::string&       location)
+  {
+    RootSchemaHandler handler;
+
+    ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(ome::bioformats::detail::createScanningParser());
+    parser->setContentHandler(&handler);
+    parser->setErrorHandler(&handler);
+
+    xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(s.c_str()),
+                                      static_cast<XMLSize_t>(s.size()),
+                                      xml::String("XML root element"));
+
+    try
+      {
+        parser->parse(source);
+      }
+    catch (const xercesc::SAXException&)
+      {
+        // Early termination.
+      }
+    catch (...)
+      {
+        return false;
+      }
+
+    ns = handler.ns;
+    location = handler.location;
+    return !ns.empty() && !location.empty();
+  }
+
+  /**
+   * Process-wide cache of parsed schema grammars.
+   *
+   * Each schema is loaded once, into its own grammar pool, which is
+   * then locked so that it may be shared by concurrent parsers.
+   * Schemas which fail to load are remembered, so that they are not
+   * loaded again.
+   */
+  class GrammarCache
+  {
+  public:
+    /// Grammar pool.
+    typedef ome::compat::shared_ptr<xercesc::XMLGrammarPool> pool_type;
+
+    /**
+     * Get the grammar cache.
+     *
+     * @returns the grammar cache.
+     */
+    static GrammarCache&
+    instance()
+    {
+      boost::call_once(&GrammarCache::create, cacheFlag);
+      return *cache;
+    }
+
+    /**
+     * Get the grammar pool for a schema.
+     *
+     * The schema will be loaded if not already cached.
+     *
+     * @param ns the schema namespace.
+     * @param location the schema location.
+     * @returns the grammar pool, or null if the schema could not be
+     * loaded.
+     */
+    pool_type
+    get(const std::string& ns,
+        const std::string& location)
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+
+      const std::string key(ns + ' ' + location);
+      std::map<std::string, pool_type>::const_iterator i = pools.find(key);
+      if (i != pools.end())
+        return i->second;
+
+      pool_type pool(load(location));
+      pools.insert(std::make_pair(key, pool));
+      return pool;
+    }
+
+  private:
+    /// Constructor.
+    GrammarCache():
+      platform(),
+      mutex(),
+      pools()
+    {
+    }
+
+    /// Create the grammar cache.
+    static void
+    create()
+    {
+      cache = new GrammarCache;
+    }
+
+    /**
+     * Load a schema into a new grammar pool.
+     *
+     * @param location the schema location.
+     * @returns the locked grammar pool, or null on failure.
+     */
+    static pool_type
+    load(const std::string& location)
+    {
+      pool_type pool(new xercesc::XMLGrammarPoolImpl(xercesc::XMLPlatformUtils::fgMemoryManager));
+
+      try
+        {
+          ome::xml::OMEEntityResolver resolver;
+          xml::ErrorReporter reporter;
+
+          ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader(xercesc::XMLPlatformUtils::fgMemoryManager,
+                                                                                                             pool.get()));
+          parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesSchema, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesSchemaFullChecking, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesHandleMultipleImports, true);
+          parser->setXMLEntityResolver(&resolver);
+          parser->setErrorHandler(&reporter);
+
+          if (!parser->loadGrammar(location.c_str(), xercesc::Grammar::SchemaGrammarType, true) ||
+              reporter)
+            pool.reset();
+        }
+      catch (...)
+        {
+          pool.reset();
+        }
+
+      if (pool)
+        pool->lockPool();
+
+      return pool;
+    }
+
+    /// Keep the XML platform initialised while grammars are cached.
+    xml::Platform platform;
+    /// Mutex to lock cache access.
+    boost::mutex mutex;
+    /// Grammar pools indexed by namespace and location.
+    std::map<std::string, pool_type> pools;
+
+    /// The grammar cache (never deleted; used until exit).
+    static GrammarCache *cache;
+    /// Grammar cache creation flag.
+    static boost::once_flag cacheFlag;
+  };
+
+  GrammarCache *GrammarCache::cache = 0;
+  boost::once_flag GrammarCache::cacheFlag = BOOST_ONCE_INIT;
+
 }
 
 namespace ome
@@ -130,16 +370,55 @@ namespace ome
 
     bool
     validateXML(const std::string& s,
-                const std::string& /* loc */)
+                const std::string& loc)
     {
       bool valid = true;
 
       try
         {
-          ome::common::xml::Platform xmlplat;
-          ome::xml::createDocument(s);
+          xml::Platform xmlplat;
+
+          // Use the cached grammar for the document schema if
+          // possible; otherwise the schema is loaded during parsing.
+          GrammarCache::pool_type pool;
+          std::string ns, location;
+          if (findRootSchema(s, ns, location))
+            pool = GrammarCache::instance().get(ns, location);
+
+          ome::xml::OMEEntityResolver resolver;
+          xml::ErrorReporter reporter;
+
+          ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader(xercesc::XMLPlatformUtils::fgMemoryManager,
+                                                                                                             pool.get()));
+          parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+          parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesDynamic, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesSchema, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesSchemaFullChecking, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesHandleMultipleImports, true);
+          parser->setFeature(xercesc::XMLUni::fgXercesUseCachedGrammarInParse, pool.get() != 0);
+          parser->setFeature(xercesc::XMLUni::fgXercesCacheGrammarFromParse, false);
+          parser->setXMLEntityResolver(&resolver);
+          parser->setErrorHandler(&reporter);
+
+          xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(s.c_str()),
+                                            static_cast<XMLSize_t>(s.size()),
+                                            xml::String(loc));
+
+          parser->parse(source);
+
+          if (reporter)
+            valid = false;
+        }
+      catch (const xercesc::XMLException&)
+        {
+          valid = false;
         }
-      catch (const std::runtime_error&)
+      catch (const xercesc::SAXException&)
+        {
+          valid = false;
+        }
+      catch (const std::exception&)
         {
           valid = false;
         }
@@ -147,5 +426,23 @@ namespace ome
       return valid;
     }
 
+    bool
+    validateXML(xml::dom::Document& document,
+                const std::string&  loc)
+    {
+      std::string s;
+
+      try
+        {
+          xml::dom::writeDocument(document, s);
+        }
+      catch (const std::runtime_error&)
+        {
+          return false;
+        }
+
+      return validateXML(s, loc);
+    }
+
   }
 }
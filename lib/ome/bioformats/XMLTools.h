@@ -59,7 +59,7 @@ namespace ome
      * dumpXML(): Use ome::common::xml::dom::writeDocument(doc, string);
      * writeXML(stream): Use ome::common::xml::dom::writeDocument(doc, stream);
      *
-     * validateXML(doc): Use ome::common::xml::dom::validate(doc)
+     * validateXML(doc): Use validateXML(document, loc)
      *
      * All parseXML SAX methods are currently unimplemented.
      *
@@ -97,6 +97,11 @@ namespace ome
     /**
      * Validate XML in an XML string.
      *
+     * The schema for the root element is loaded once and cached for
+     * the lifetime of the process, so validating many documents
+     * using the same schema will only parse the schema once.  The
+     * cache is shared between threads.
+     *
      * @param s the string to validate.
      * @param loc the file location or other descriptive text for the
      * string; used for error reporting only.
@@ -106,6 +111,21 @@ namespace ome
     validateXML(const std::string& s,
                 const std::string& loc = "XML");
 
+    /**
+     * Validate XML in an XML document.
+     *
+     * The document is serialized and validated as for
+     * validateXML(const std::string&, const std::string&).
+     *
+     * @param document the document to validate.
+     * @param loc the file location or other descriptive text for the
+     * document; used for error reporting only.
+     * @returns @c true if valid, @c false if invalid.
+     */
+    bool
+    validateXML(ome::common::xml::dom::Document& document,
+                const std::string&               loc = "XML");
+
   }
 }
 
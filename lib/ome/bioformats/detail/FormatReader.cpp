@@ -35,9 +35,11 @@
  * #L%
  */
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
@@ -50,6 +52,7 @@
 #include <ome/bioformats/FormatTools.h>
 #include <ome/bioformats/MetadataTools.h>
 #include <ome/bioformats/PixelBuffer.h>
+#include <ome/bioformats/PixelCopy.h>
 #include <ome/bioformats/PixelProperties.h>
 #include <ome/bioformats/VariantPixelBuffer.h>
 #include <ome/bioformats/detail/FormatReader.h>
@@ -95,11 +98,16 @@ namespace ome
         normalizeData(false),
         filterMetadata(false),
         saveOriginalMetadata(false),
+        originalMetadataPending(false),
+        metadataStoreSupplied(false),
         indexedAsRGB(false),
         group(true),
         domains(),
         metadataStore(ome::compat::make_shared<DummyMetadata>()),
-        metadataOptions()
+        metadataOptions(),
+        canonicalUsedFiles(),
+        mutex(),
+        prefetch(boost::bind(&FormatReader::prefetchPlane, this, _1, _2, _3, _4))
       {
         assertId(currentId, false);
       }
@@ -152,6 +160,7 @@ namespace ome
               }
           }
 
+        prefetch.clear();
         coreIndex = 0;
         series = 0;
         close();
@@ -175,25 +184,27 @@ namespace ome
           {
             path thisfile = ome::common::canonical(path(file));
 
-            /// @todo: Use a set rather than a list?
-            const std::vector<path>& s = getUsedFiles();
-            for (std::vector<path>::const_iterator i = s.begin();
-                 i != s.end();
-                 ++i)
+            // The used files are only canonicalized once.
+            if (!canonicalUsedFiles)
               {
-                try
+                std::set<path> usedfiles;
+                const std::vector<path>& s = getUsedFiles();
+                for (std::vector<path>::const_iterator i = s.begin();
+                     i != s.end();
+                     ++i)
                   {
-                    path usedfile = ome::common::canonical(path(*i));
-                    if (thisfile == usedfile)
+                    try
+                      {
+                        usedfiles.insert(ome::common::canonical(path(*i)));
+                      }
+                    catch (const boost::filesystem::filesystem_error&)
                       {
-                        used = true;
-                        break;
                       }
                   }
-                catch (const boost::filesystem::filesystem_error&)
-                  {
-                  }
+                canonicalUsedFiles = usedfiles;
               }
+
+            used = canonicalUsedFiles->find(thisfile) != canonicalUsedFiles->end();
           }
         catch (const boost::filesystem::filesystem_error&)
           {
@@ -209,7 +220,7 @@ namespace ome
                               dimension_size_type y,
                               dimension_size_type w,
                               dimension_size_type h,
-                              dimension_size_type samples)
+                              dimension_size_type samples) const
       {
         return readPlane(source, dest, x, y, w, h, 0, samples);
       }
@@ -220,7 +231,7 @@ namespace ome
         struct PlaneVisitor : public boost::static_visitor<>
         {
           std::istream&       source;
-          FormatReader&       reader;
+          const FormatReader& reader;
           dimension_size_type x;
           dimension_size_type y;
           dimension_size_type w;
@@ -229,7 +240,7 @@ namespace ome
           dimension_size_type scanlinePad;
 
           PlaneVisitor(std::istream&       source,
-                       FormatReader&       reader,
+                       const FormatReader& reader,
                        dimension_size_type x,
                        dimension_size_type y,
                        dimension_size_type w,
@@ -257,6 +268,9 @@ namespace ome
             const dimension_size_type sizeY(reader.getSizeY());
             const bool interleaved(reader.isInterleaved());
 
+            // Resolve the destination row and sample positions once.
+            const PixelSpan<uint8_t> span(v->rawSpan());
+
             if (x == 0 && y == 0 &&
                 w == sizeX &&
                 h == sizeY &&
@@ -282,8 +296,7 @@ namespace ome
                     for (dimension_size_type sample = 0; sample < samples; ++sample)
                       {
                         source.seekg(static_cast<std::istream::off_type>(y * rowLen), std::ios::cur);
-                        source.read(reinterpret_cast<char *>(v->data())
-                                    + (sample * h * rowLen),
+                        source.read(reinterpret_cast<char *>(span.pointer(0, 0, sample)),
                                     static_cast<std::streamsize>(h * rowLen));
                         // no need to skip bytes after reading final sample
                         if (sample < samples - 1)
@@ -300,8 +313,7 @@ namespace ome
                     for (dimension_size_type row = 0; row < h; ++row)
                       {
                         source.seekg(static_cast<std::istream::off_type>(x * bpp * samples), std::ios::cur);
-                        source.read(reinterpret_cast<char *>(v->data())
-                                    + (row * w * bpp * samples),
+                        source.read(reinterpret_cast<char *>(span.pointer(0, row)),
                                     static_cast<std::streamsize>(w * bpp * samples));
                         // no need to skip bytes after reading final row
                         if (row < h - 1)
@@ -316,8 +328,7 @@ namespace ome
                         for (dimension_size_type row = 0; row < h; ++row)
                           {
                             source.seekg(static_cast<std::istream::off_type>(x * bpp), std::ios::cur);
-                            source.read(reinterpret_cast<char *>(v->data())
-                                        + (sample * w * h * bpp + row * w * bpp),
+                            source.read(reinterpret_cast<char *>(span.pointer(0, row, sample)),
                                         static_cast<std::streamsize>(w * bpp));
                             // no need to skip bytes after reading final row of final sample
                             if (row < h - 1 || sample < samples - 1)
@@ -357,17 +368,14 @@ namespace ome
                               dimension_size_type w,
                               dimension_size_type h,
                               dimension_size_type scanlinePad,
-                              dimension_size_type samples)
+                              dimension_size_type samples) const
       {
-        ome::compat::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
+        ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
         shape[DIM_SPATIAL_X] = w;
         shape[DIM_SPATIAL_Y] = h;
         shape[DIM_SUBCHANNEL] = samples;
         shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
           shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
-        const VariantPixelBuffer::size_type *dest_shape_ptr(dest.shape());
-        std::copy(dest_shape_ptr, dest_shape_ptr + PixelBufferBase::dimensions,
-                  dest_shape.begin());
 
         const ome::xml::model::enums::DimensionOrder order(getDimensionOrder());
         const bool interleaved(isInterleaved());
@@ -377,11 +385,9 @@ namespace ome
         const ome::xml::model::enums::PixelType type(getPixelType());
 
         // If the buffer is incorrectly sized, ordered or typed, reset
-        // to the correct buffer size, order and type.
-        if (type != dest.pixelType() ||
-            !(storage_order == dest.storage_order()) ||
-            shape != dest_shape)
-          dest.setBuffer(shape, type, storage_order);
+        // to the correct buffer size, order and type.  Compatible
+        // buffers (including external storage) are filled in place.
+        dest.ensureBuffer(shape, type, storage_order);
 
         // Fill the buffer according to its type.
         PlaneVisitor v(source, *this,
@@ -401,18 +407,24 @@ namespace ome
       void
       FormatReader::setMetadataOptions(const MetadataOptions& options)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         this->metadataOptions = options;
       }
 
       const MetadataOptions&
       FormatReader::getMetadataOptions() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return metadataOptions;
       }
 
       MetadataOptions&
       FormatReader::getMetadataOptions()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return metadataOptions;
       }
 
@@ -484,6 +496,8 @@ namespace ome
       dimension_size_type
       FormatReader::getImageCount() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).imageCount;
       }
@@ -491,6 +505,8 @@ namespace ome
       bool
       FormatReader::isRGB(dimension_size_type channel) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getRGBChannelCount(channel) > 1U;
       }
@@ -498,6 +514,8 @@ namespace ome
       dimension_size_type
       FormatReader::getSizeX() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).sizeX;
       }
@@ -505,6 +523,8 @@ namespace ome
       dimension_size_type
       FormatReader::getSizeY() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).sizeY;
       }
@@ -512,6 +532,8 @@ namespace ome
       dimension_size_type
       FormatReader::getSizeZ() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).sizeZ;
       }
@@ -519,6 +541,8 @@ namespace ome
       dimension_size_type
       FormatReader::getSizeT() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).sizeT;
       }
@@ -526,6 +550,8 @@ namespace ome
       dimension_size_type
       FormatReader::getSizeC() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         const std::vector<dimension_size_type>& c(getCoreMetadata(getCoreIndex()).sizeC);
@@ -536,6 +562,8 @@ namespace ome
       ome::xml::model::enums::PixelType
       FormatReader::getPixelType() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).pixelType;
       }
@@ -543,6 +571,8 @@ namespace ome
       pixel_size_type
       FormatReader::getBitsPerPixel() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         if (getCoreMetadata(getCoreIndex()).bitsPerPixel == 0) {
           return bitsPerPixel(getPixelType());
@@ -560,18 +590,24 @@ namespace ome
       dimension_size_type
       FormatReader::getEffectiveSizeC() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).sizeC.size();
       }
 
       dimension_size_type
       FormatReader::getRGBChannelCount(dimension_size_type channel) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).sizeC.at(channel);
       }
 
       bool
       FormatReader::isIndexed() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).indexed;
       }
@@ -579,6 +615,8 @@ namespace ome
       bool
       FormatReader::isFalseColor() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).falseColor;
       }
@@ -587,6 +625,8 @@ namespace ome
       FormatReader::getLookupTable(dimension_size_type /* plane */,
                                    VariantPixelBuffer& /* buf */) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         throw std::runtime_error("Reader does not implement lookup tables");
@@ -595,36 +635,48 @@ namespace ome
       Modulo&
       FormatReader::getModuloZ()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloZ;
       }
 
       const Modulo&
       FormatReader::getModuloZ() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloZ;
       }
 
       Modulo&
       FormatReader::getModuloT()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloT;
       }
 
       const Modulo&
       FormatReader::getModuloT() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloT;
       }
 
       Modulo&
       FormatReader::getModuloC()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloC;
       }
 
       const Modulo&
       FormatReader::getModuloC() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getCoreMetadata(getCoreIndex()).moduloC;
       }
 
@@ -675,18 +727,24 @@ namespace ome
       dimension_size_type
       FormatReader::getThumbSizeX() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getThumbSize()[0];
       }
 
       dimension_size_type
       FormatReader::getThumbSizeY() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return getThumbSize()[1];
       }
 
       bool
       FormatReader::isLittleEndian() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).littleEndian;
       }
@@ -694,6 +752,8 @@ namespace ome
       const std::string&
       FormatReader::getDimensionOrder() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).dimensionOrder;
       }
@@ -701,6 +761,8 @@ namespace ome
       bool
       FormatReader::isOrderCertain() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).orderCertain;
       }
@@ -708,6 +770,8 @@ namespace ome
       bool
       FormatReader::isThumbnailSeries() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).thumbnail;
       }
@@ -715,12 +779,16 @@ namespace ome
       bool
       FormatReader::isInterleaved() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return isInterleaved(0);
       }
 
       bool
       FormatReader::isInterleaved(dimension_size_type /* subC */) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).interleaved;
       }
@@ -740,14 +808,264 @@ namespace ome
                               dimension_size_type w,
                               dimension_size_type h) const
       {
+        dimension_size_type index;
+        dimension_size_type count;
+
+        {
+          boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+          setPlane(plane);
+
+          if (!prefetch.getDepth())
+            {
+              openBytesImpl(plane, buf, x, y, w, h);
+              return;
+            }
+
+          index = getCoreIndex();
+          count = getImageCount();
+        }
+
+        // The prefetch thread needs the lock to complete the read
+        // being waited for, so it is not held while taking the plane.
+        const PlaneRegion region(x, y, w, h);
+        if (!prefetch.take(index, plane, region, buf))
+          {
+            boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+            openBytesImpl(plane, buf, x, y, w, h);
+          }
+        prefetch.access(index, plane, region, count);
+      }
+
+      namespace
+      {
+
+        // Get the address of the first element of a plane.
+        struct PlanePointerVisitor : public boost::static_visitor<void *>
+        {
+          const PixelBufferBase::indices_type& indices;
+
+          PlanePointerVisitor(const PixelBufferBase::indices_type& indices):
+            indices(indices)
+          {}
+
+          template<typename T>
+          void *
+          operator()(T& v) const
+          {
+            return v->rawSpan().pointer(indices);
+          }
+        };
+
+        // Plane index and destination position.
+        typedef std::pair<dimension_size_type, PixelBufferBase::indices_type> plane_position;
+
+        bool
+        comparePlanePosition(const plane_position& lhs,
+                             const plane_position& rhs)
+        {
+          return lhs.first < rhs.first;
+        }
+
+      }
+
+      void
+      FormatReader::openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                               const ome::compat::array<dimension_size_type, 3>& count,
+                               VariantPixelBuffer&                               buf) const
+      {
+        openPlanes(start, count, buf, 0, 0, getSizeX(), getSizeY());
+      }
+
+      void
+      FormatReader::openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                               const ome::compat::array<dimension_size_type, 3>& count,
+                               VariantPixelBuffer&                               buf,
+                               dimension_size_type                               x,
+                               dimension_size_type                               y,
+                               dimension_size_type                               w,
+                               dimension_size_type                               h) const
+      {
+        // The planes to read are already known, so read them directly
+        // rather than through the prefetcher, which would otherwise
+        // read ahead past the end of the range.  The prefetch thread
+        // is stopped before locking, since it needs the lock to
+        // complete its current read.
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        assertId(currentId, true);
+
+        const char *names[3] = {"Z", "C", "T"};
+        const dimension_size_type sizes[3] = {getSizeZ(), getEffectiveSizeC(), getSizeT()};
+        for (dimension_size_type i = 0; i < 3; ++i)
+          {
+            if (count[i] == 0 || start[i] + count[i] > sizes[i])
+              {
+                boost::format fmt("Invalid %1% plane range: %2% planes starting at %3%");
+                fmt % names[i] % count[i] % start[i];
+                throw std::logic_error(fmt.str());
+              }
+          }
+
+        const dimension_size_type samples = getRGBChannelCount(start[1]);
+        for (dimension_size_type c = start[1] + 1; c < start[1] + count[1]; ++c)
+          {
+            if (getRGBChannelCount(c) != samples)
+              {
+                boost::format fmt("Channel %1% sample count differs from channel %2%");
+                fmt % c % start[1];
+                throw std::logic_error(fmt.str());
+              }
+          }
+
+        ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[DIM_SPATIAL_X] = w;
+        shape[DIM_SPATIAL_Y] = h;
+        shape[DIM_SUBCHANNEL] = samples;
+        shape[DIM_SPATIAL_Z] = count[0];
+        shape[DIM_CHANNEL] = count[1];
+        shape[DIM_TEMPORAL_T] = count[2];
+        shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+        ome::compat::array<VariantPixelBuffer::size_type, 9> planeShape(shape);
+        planeShape[DIM_SPATIAL_Z] = planeShape[DIM_CHANNEL] = planeShape[DIM_TEMPORAL_T] = 1;
+
+        // The X, Y and subchannel dimensions are always innermost,
+        // so every plane is a contiguous block of the buffer.
+        const VariantPixelBuffer::storage_order_type storage_order
+          (PixelBufferBase::make_storage_order(getDimensionOrder(), isInterleaved()));
+        const ome::xml::model::enums::PixelType type(getPixelType());
+
+        buf.ensureBuffer(shape, type, storage_order);
+
+        // Plan the reads in plane index order, so that the
+        // underlying file is accessed sequentially.
+        std::vector<plane_position> planes;
+        planes.reserve(count[0] * count[1] * count[2]);
+        for (dimension_size_type t = 0; t < count[2]; ++t)
+          for (dimension_size_type c = 0; c < count[1]; ++c)
+            for (dimension_size_type z = 0; z < count[0]; ++z)
+              {
+                PixelBufferBase::indices_type idx;
+                std::fill(idx.begin(), idx.end(), 0);
+                idx[DIM_SPATIAL_Z] = static_cast<PixelBufferBase::index>(z);
+                idx[DIM_CHANNEL] = static_cast<PixelBufferBase::index>(c);
+                idx[DIM_TEMPORAL_T] = static_cast<PixelBufferBase::index>(t);
+                planes.push_back(plane_position(getIndex(start[0] + z, start[1] + c, start[2] + t), idx));
+              }
+        std::sort(planes.begin(), planes.end(), comparePlanePosition);
+
+        PixelBufferBase::indices_type origin;
+        std::fill(origin.begin(), origin.end(), 0);
+
+        // Planes are read in place, through a buffer referencing
+        // each plane's storage, if the reader's native plane layout
+        // matches the destination; this need not be the case, for
+        // example for chunky RGB TIFF data.  The layout is found from
+        // the first plane, which is read into a separate buffer and
+        // copied.  Each series uses one layout for all planes.
+        VariantPixelBuffer native;
+        bool inplace = false;
+
+        for (std::vector<plane_position>::const_iterator i = planes.begin();
+             i != planes.end();
+             ++i)
+          {
+            PlanePointerVisitor v(i->second);
+            VariantPixelBuffer plane(boost::apply_visitor(v, buf.vbuffer()),
+                                     planeShape, type, storage_order);
+            setPlane(i->first);
+            if (inplace)
+              openBytesImpl(i->first, plane, x, y, w, h);
+            else
+              {
+                openBytesImpl(i->first, native, x, y, w, h);
+                copyRegion(native, origin, planeShape, buf, i->second);
+                inplace = plane.compatible(planeShape, type, native.storage_order());
+              }
+          }
+      }
+
+      void
+      FormatReader::openRegions(dimension_size_type              plane,
+                                std::vector<VariantPixelBuffer>& bufs,
+                                const std::vector<PlaneRegion>&  regions) const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        setPlane(plane);
+        openRegionsImpl(plane, bufs, regions);
+      }
+
+      void
+      FormatReader::openRegionsImpl(dimension_size_type              plane,
+                                    std::vector<VariantPixelBuffer>& bufs,
+                                    const std::vector<PlaneRegion>&  regions) const
+      {
+        bufs.resize(regions.size());
+        for (std::vector<PlaneRegion>::size_type i = 0; i < regions.size(); ++i)
+          {
+            const PlaneRegion& r(regions[i]);
+            openBytesImpl(plane, bufs[i], r.x, r.y, r.w, r.h);
+          }
+      }
+
+      void
+      FormatReader::stopPrefetch() const
+      {
+        prefetch.stop();
+      }
+
+      void
+      FormatReader::prefetchPlane(dimension_size_type index,
+                                  dimension_size_type plane,
+                                  VariantPixelBuffer& buf,
+                                  const PlaneRegion&  region) const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        // The current series or resolution may have been changed
+        // since the plane was queued, so read with those of the
+        // request and restore the current state afterward.
+        SaveSeries save(*this);
+        if (index != getCoreIndex())
+          setCoreIndex(index);
         setPlane(plane);
-        openBytesImpl(plane, buf, x, y, w, h);
+
+        openBytesImpl(plane, buf, region.x, region.y, region.w, region.h);
+      }
+
+      void
+      FormatReader::prefetchPlanes(const std::vector<dimension_size_type>& planes) const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        assertId(currentId, true);
+
+        for (std::vector<dimension_size_type>::const_iterator i = planes.begin();
+             i != planes.end();
+             ++i)
+          {
+            if (*i >= getImageCount())
+              {
+                boost::format fmt("Invalid plane: %1%");
+                fmt % *i;
+                throw std::logic_error(fmt.str());
+              }
+          }
+
+        prefetch.hint(getCoreIndex(), planes, PlaneRegion(0, 0, getSizeX(), getSizeY()));
       }
 
       void
       FormatReader::openThumbBytes(dimension_size_type /* plane */,
                                    VariantPixelBuffer& /* buf */) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         /**
          * @todo Implement openThumbBytes.  This requires implementing
@@ -759,6 +1077,11 @@ namespace ome
       void
       FormatReader::close(bool fileOnly)
       {
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        prefetch.clear();
         if (in)
           in = ome::compat::shared_ptr<std::istream>(); // set to null.
         if (!fileOnly)
@@ -766,12 +1089,16 @@ namespace ome
             currentId = boost::none;
             coreIndex = series = resolution = plane = 0;
             core.clear();
+            originalMetadataPending = false;
+            canonicalUsedFiles = boost::none;
           }
       }
 
       dimension_size_type
       FormatReader::getSeriesCount() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         dimension_size_type size = core.size();
         if (!hasFlattenedResolutions()) {
@@ -783,6 +1110,8 @@ namespace ome
       void
       FormatReader::setSeries(dimension_size_type series) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         this->coreIndex = seriesToCoreIndex(series);
         this->series = series;
         this->resolution = 0;
@@ -792,12 +1121,16 @@ namespace ome
       dimension_size_type
       FormatReader::getSeries() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return series;
       }
 
       void
       FormatReader::setPlane(dimension_size_type plane) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         if (plane >= getImageCount())
@@ -813,6 +1146,8 @@ namespace ome
       dimension_size_type
       FormatReader::getPlane() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         return plane;
@@ -821,6 +1156,8 @@ namespace ome
       void
       FormatReader::setGroupFiles(bool group)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
         this->group = group;
       }
@@ -828,9 +1165,32 @@ namespace ome
       bool
       FormatReader::isGroupFiles() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return group;
       }
 
+      void
+      FormatReader::setPrefetch(dimension_size_type depth)
+      {
+        prefetch.setDepth(depth);
+        // Reads will no longer wait for the background thread.
+        if (!depth)
+          stopPrefetch();
+      }
+
+      dimension_size_type
+      FormatReader::getPrefetch() const
+      {
+        return prefetch.getDepth();
+      }
+
+      FormatReader::PrefetchStatistics
+      FormatReader::getPrefetchStatistics() const
+      {
+        return prefetch.getStatistics();
+      }
+
       FormatReader::FileGroupOption
       FormatReader::fileGroupOption(const std::string& /* id */)
       {
@@ -840,6 +1200,8 @@ namespace ome
       bool
       FormatReader::isMetadataComplete() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).metadataComplete;
       }
@@ -847,6 +1209,8 @@ namespace ome
       void
       FormatReader::setNormalized(bool normalize)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
         normalizeData = normalize;
       }
@@ -854,12 +1218,16 @@ namespace ome
       bool
       FormatReader::isNormalized() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return normalizeData;
       }
 
       void
       FormatReader::setOriginalMetadataPopulated(bool populate)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
         saveOriginalMetadata = populate;
       }
@@ -867,12 +1235,16 @@ namespace ome
       bool
       FormatReader::isOriginalMetadataPopulated() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return saveOriginalMetadata;
       }
 
       const std::vector<boost::filesystem::path>
       FormatReader::getUsedFiles(bool noPixels) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         SaveSeries sentry(*this);
         std::set<path> files;
         for (dimension_size_type i = 0; i < getSeriesCount(); ++i)
@@ -892,6 +1264,8 @@ namespace ome
       const std::vector<boost::filesystem::path>
       FormatReader::getSeriesUsedFiles(bool noPixels) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         std::vector<path> ret;
         if (!noPixels && currentId)
           ret.push_back(currentId.get());
@@ -901,6 +1275,8 @@ namespace ome
       std::vector<FileInfo>
       FormatReader::getAdvancedUsedFiles(bool noPixels) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         std::vector<path> files = getUsedFiles(noPixels);
         std::vector<FileInfo> infos(files.size());
 
@@ -930,6 +1306,8 @@ namespace ome
       std::vector<FileInfo>
       FormatReader::getAdvancedSeriesUsedFiles(bool noPixels) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         std::vector<path> files = getSeriesUsedFiles(noPixels);
         std::vector<FileInfo> infos(files.size());
 
@@ -959,6 +1337,8 @@ namespace ome
       const boost::optional<boost::filesystem::path>&
       FormatReader::getCurrentFile() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return currentId;
       }
 
@@ -967,6 +1347,8 @@ namespace ome
                              dimension_size_type c,
                              dimension_size_type t) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return ome::bioformats::getIndex(getDimensionOrder(),
                                          getSizeZ(),
@@ -984,6 +1366,8 @@ namespace ome
                              dimension_size_type moduloC,
                              dimension_size_type moduloT) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return ome::bioformats::getIndex(getDimensionOrder(),
                                          getSizeZ(),
@@ -1000,6 +1384,8 @@ namespace ome
       ome::compat::array<dimension_size_type, 3>
       FormatReader::getZCTCoords(dimension_size_type index) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return ome::bioformats::getZCTCoords(getDimensionOrder(),
                                              getSizeZ(),
@@ -1012,6 +1398,8 @@ namespace ome
       ome::compat::array<dimension_size_type, 6>
       FormatReader::getZCTModuloCoords(dimension_size_type index) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return ome::bioformats::getZCTCoords(getDimensionOrder(),
                                              getSizeZ(),
@@ -1027,12 +1415,16 @@ namespace ome
       const MetadataMap::value_type&
       FormatReader::getMetadataValue(const std::string& field) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return metadata.get<MetadataMap::value_type>(field);
       }
 
       const MetadataMap::value_type&
       FormatReader::getSeriesMetadataValue(const MetadataMap::key_type& field) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getSeriesMetadata().get<MetadataMap::value_type>(field);
       }
@@ -1040,12 +1432,16 @@ namespace ome
       const MetadataMap&
       FormatReader::getGlobalMetadata() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return metadata;
       }
 
       const MetadataMap&
       FormatReader::getSeriesMetadata() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getCoreMetadata(getCoreIndex()).seriesMetadata;
       }
@@ -1053,6 +1449,8 @@ namespace ome
       const std::vector<ome::compat::shared_ptr< ::ome::bioformats::CoreMetadata> >&
       FormatReader::getCoreMetadataList() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return core;
       }
@@ -1060,6 +1458,8 @@ namespace ome
       void
       FormatReader::setMetadataFiltered(bool filter)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
         filterMetadata = filter;
       }
@@ -1067,32 +1467,89 @@ namespace ome
       bool
       FormatReader::isMetadataFiltered() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return filterMetadata;
       }
 
       void
       FormatReader::setMetadataStore(ome::compat::shared_ptr< ::ome::xml::meta::MetadataStore>& store)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
 
         if (!store)
           throw std::logic_error("MetadataStore can not be null");
 
         metadataStore = store;
+        metadataStoreSupplied = true;
       }
 
       const ome::compat::shared_ptr< ::ome::xml::meta::MetadataStore>&
       FormatReader::getMetadataStore() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        if (originalMetadataPending)
+          saveOriginalMetadataToStore();
         return metadataStore;
       }
 
       ome::compat::shared_ptr< ::ome::xml::meta::MetadataStore>&
       FormatReader::getMetadataStore()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        if (originalMetadataPending)
+          saveOriginalMetadataToStore();
         return metadataStore;
       }
 
+      void
+      FormatReader::saveOriginalMetadataToStore() const
+      {
+        // Clear first, since getMetadataStore() may be reentered.
+        originalMetadataPending = false;
+
+        const ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata>& store =
+          ome::compat::dynamic_pointer_cast< ::ome::xml::meta::OMEXMLMetadata>(metadataStore);
+        if (!store)
+          return;
+
+        MetadataMap allMetadata(metadata);
+
+        {
+          // Restore the caller's current series afterward.
+          SaveSeries saved(*this);
+          for (dimension_size_type series = 0;
+               series < getSeriesCount();
+               ++series)
+            {
+              boost::format fmt("Series %1%");
+              fmt % series;
+              std::string name(fmt.str());
+
+              try
+                {
+                  std::string imageName = store->getImageName(series);
+                  if (!imageName.empty() && ome::common::trim(imageName).size() != 0)
+                    name = imageName;
+                }
+              catch (const std::exception&)
+                {
+                }
+              setSeries(series);
+              allMetadata.merge(getSeriesMetadata(), name + " ");
+            }
+        }
+
+        // Flatten here, since allMetadata is already a copy, to avoid
+        // fillOriginalMetadata making another.
+        allMetadata.flattenInPlace();
+        fillOriginalMetadata(*store, allMetadata);
+      }
+
       std::vector<ome::compat::shared_ptr< ::ome::bioformats::FormatReader> >
       FormatReader::getUnderlyingReaders() const
       {
@@ -1139,6 +1596,8 @@ namespace ome
       dimension_size_type
       FormatReader::getOptimalTileWidth(dimension_size_type /* channel */) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getSizeX();
       }
@@ -1146,6 +1605,8 @@ namespace ome
       dimension_size_type
       FormatReader::getOptimalTileHeight(dimension_size_type channel) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         uint32_t bpp = bytesPerPixel(getPixelType());
         dimension_size_type maxHeight = (1024U * 1024U) / (getSizeX() * getRGBChannelCount(channel) * bpp);
@@ -1158,6 +1619,8 @@ namespace ome
       dimension_size_type
       FormatReader::getOptimalTileWidth() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         dimension_size_type csize = getEffectiveSizeC();
@@ -1171,6 +1634,8 @@ namespace ome
       dimension_size_type
       FormatReader::getOptimalTileHeight() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         dimension_size_type csize = getEffectiveSizeC();
@@ -1184,6 +1649,8 @@ namespace ome
       dimension_size_type
       FormatReader::seriesToCoreIndex(dimension_size_type series) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         dimension_size_type index = 0;
 
         if (hasFlattenedResolutions())
@@ -1242,6 +1709,8 @@ namespace ome
       dimension_size_type
       FormatReader::coreIndexToSeries(dimension_size_type index) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         dimension_size_type series = 0;
 
         if (index >= core.size())
@@ -1291,6 +1760,8 @@ namespace ome
       dimension_size_type
       FormatReader::getResolutionCount() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         dimension_size_type count = 1;
@@ -1303,6 +1774,8 @@ namespace ome
       void
       FormatReader::setResolution(dimension_size_type resolution) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         if (resolution >= getResolutionCount())
           {
             boost::format fmt("Invalid resolution: %1%");
@@ -1318,18 +1791,24 @@ namespace ome
       dimension_size_type
       FormatReader::getResolution() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return resolution;
       }
 
       bool
       FormatReader::hasFlattenedResolutions() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return flattenedResolutions;
       }
 
       void
       FormatReader::setFlattenedResolutions(bool flatten)
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, false);
         flattenedResolutions = flatten;
       }
@@ -1337,12 +1816,16 @@ namespace ome
       dimension_size_type
       FormatReader::getCoreIndex() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return coreIndex;
       }
 
       void
       FormatReader::setCoreIndex(dimension_size_type index) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         if (index >= core.size())
           {
             boost::format fmt("Invalid core index: %1%");
@@ -1358,6 +1841,10 @@ namespace ome
       void
       FormatReader::setId(const boost::filesystem::path& id)
       {
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         // Attempt to canonicalize the path.
         path canonicalpath = id;
         try
@@ -1377,40 +1864,14 @@ namespace ome
               ome::compat::dynamic_pointer_cast< ::ome::xml::meta::OMEXMLMetadata>(getMetadataStore());
             if(store)
               {
+                // Saved on first access to the metadata store, unless
+                // the caller supplied the store and may use it
+                // directly.
                 if(saveOriginalMetadata)
                   {
-                    MetadataMap allMetadata(metadata);
-
-                    setSeries(0);
-                    {
-                      SaveSeries(*this);
-                      for (dimension_size_type series = 0;
-                           series < getSeriesCount();
-                           ++series)
-                        {
-                          boost::format fmt("Series %1%");
-                          fmt % series;
-                          std::string name(fmt.str());
-
-                          try
-                            {
-                              std::string imageName = store->getImageName(series);
-                              if (!imageName.empty() && ome::common::trim(imageName).size() != 0)
-                                name = imageName;
-                            }
-                          catch (const std::exception&)
-                            {
-                            }
-                          setSeries(series);
-                          const MetadataMap& sm(getSeriesMetadata());
-                          for (MetadataMap::const_iterator i = sm.begin();
-                               i != sm.end();
-                               ++i)
-                            allMetadata.set(name + " " + i->first, i->second);
-                        }
-                    }
-
-                    fillOriginalMetadata(*store, allMetadata);
+                    originalMetadataPending = true;
+                    if (metadataStoreSupplied)
+                      saveOriginalMetadataToStore();
                   }
 
                 setSeries(0);
@@ -41,9 +41,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+
+#include <boost/thread/recursive_mutex.hpp>
 
 #include <ome/bioformats/FormatReader.h>
 #include <ome/bioformats/FormatHandler.h>
+#include <ome/bioformats/detail/PlanePrefetch.h>
 
 namespace ome
 {
@@ -189,6 +193,20 @@ namespace ome
         /// Whether or not to save proprietary metadata in the MetadataStore.
         bool saveOriginalMetadata;
 
+        /**
+         * Whether proprietary metadata is waiting to be saved in the
+         * MetadataStore.  Saving is deferred until the MetadataStore
+         * is first accessed after setId(), so that readers which
+         * never access the MetadataStore do not pay the cost.  It is
+         * not deferred if the MetadataStore was supplied by the
+         * caller, since it may be used without calling
+         * getMetadataStore().
+         */
+        mutable bool originalMetadataPending;
+
+        /// Whether the MetadataStore was supplied with setMetadataStore().
+        bool metadataStoreSupplied;
+
         /// Whether or not MetadataStore sets C = 3 for indexed color images.
         bool indexedAsRGB;
 
@@ -207,6 +225,24 @@ namespace ome
         /// Metadata parsing options.
         MetadataOptions metadataOptions;
 
+        /// Canonical used files, computed on first use by isUsedFile().
+        boost::optional<std::set<boost::filesystem::path> > canonicalUsedFiles;
+
+        /**
+         * Lock protecting the reader state.
+         *
+         * This is held by the public methods and by background
+         * plane reads (prefetchPlane()), so that prefetching does not
+         * run concurrently with other use of the reader.  It must
+         * not be held while waiting for the prefetch thread, for
+         * example by stopPrefetch(), since the current background
+         * read needs the lock to complete.
+         */
+        mutable boost::recursive_mutex mutex;
+
+        /// Plane readahead.
+        mutable PlanePrefetch prefetch;
+
         /// Constructor.
         FormatReader(const ReaderProperties&);
 
@@ -274,7 +310,7 @@ namespace ome
                   dimension_size_type y,
                   dimension_size_type w,
                   dimension_size_type h,
-                  dimension_size_type samples);
+                  dimension_size_type samples) const;
 
         /**
          * Read a raw plane with scanline padding.
@@ -300,7 +336,7 @@ namespace ome
                   dimension_size_type w,
                   dimension_size_type h,
                   dimension_size_type scanlinePad,
-                  dimension_size_type samples);
+                  dimension_size_type samples) const;
 
         /**
          * Create a configured FilterMetadata instance.
@@ -571,6 +607,28 @@ namespace ome
                   dimension_size_type w,
                   dimension_size_type h) const;
 
+        // Documented in superclass.
+        void
+        openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                   const ome::compat::array<dimension_size_type, 3>& count,
+                   VariantPixelBuffer&                               buf) const;
+
+        // Documented in superclass.
+        void
+        openPlanes(const ome::compat::array<dimension_size_type, 3>& start,
+                   const ome::compat::array<dimension_size_type, 3>& count,
+                   VariantPixelBuffer&                               buf,
+                   dimension_size_type                               x,
+                   dimension_size_type                               y,
+                   dimension_size_type                               w,
+                   dimension_size_type                               h) const;
+
+        // Documented in superclass.
+        void
+        openRegions(dimension_size_type              plane,
+                    std::vector<VariantPixelBuffer>& bufs,
+                    const std::vector<PlaneRegion>&  regions) const;
+
       protected:
         /**
          * @copydoc ome::bioformats::FormatReader::openBytes(dimension_size_type,VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type)const
@@ -584,7 +642,53 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const = 0;
 
+        /**
+         * @copydoc ome::bioformats::FormatReader::openRegions(dimension_size_type,std::vector<VariantPixelBuffer>&,const std::vector<PlaneRegion>&)const
+         *
+         * The default implementation calls openBytesImpl() for each
+         * region.
+         */
+        virtual
+        void
+        openRegionsImpl(dimension_size_type              plane,
+                        std::vector<VariantPixelBuffer>& bufs,
+                        const std::vector<PlaneRegion>&  regions) const;
+
+        /**
+         * Stop background plane reads.
+         *
+         * Pending prefetches are cancelled, and any plane currently
+         * being read is waited for.  Subclasses must call this before
+         * closing the underlying files.  The reader lock must not be
+         * held by the caller.
+         */
+        void
+        stopPrefetch() const;
+
+      private:
+        /**
+         * Read a plane region for prefetching.
+         *
+         * This is called on the prefetch thread.  The reader lock is
+         * held while reading, and the plane is read from the
+         * requested series and resolution, which need not be current.
+         *
+         * @param index the core index of the plane.
+         * @param plane the plane index within the series.
+         * @param buf the destination pixel buffer.
+         * @param region the region of the plane.
+         */
+        void
+        prefetchPlane(dimension_size_type index,
+                      dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      const PlaneRegion&  region) const;
+
       public:
+        // Documented in superclass.
+        void
+        prefetchPlanes(const std::vector<dimension_size_type>& planes) const;
+
         // Documented in superclass.
         void
         openThumbBytes(dimension_size_type plane,
@@ -622,6 +726,18 @@ namespace ome
         bool
         isGroupFiles() const;
 
+        // Documented in superclass.
+        void
+        setPrefetch(dimension_size_type depth);
+
+        // Documented in superclass.
+        dimension_size_type
+        getPrefetch() const;
+
+        // Documented in superclass.
+        PrefetchStatistics
+        getPrefetchStatistics() const;
+
         // Documented in superclass.
         FileGroupOption
         fileGroupOption(const std::string& id);
@@ -713,6 +829,20 @@ namespace ome
         ome::compat::shared_ptr< ::ome::xml::meta::MetadataStore>&
         getMetadataStore();
 
+      private:
+        /**
+         * Save pending proprietary metadata in the MetadataStore.
+         *
+         * The global and series metadata are added to the
+         * MetadataStore as original metadata annotations, if
+         * setId() deferred this and the MetadataStore is an
+         * OMEXMLMetadata store.
+         */
+        void
+        saveOriginalMetadataToStore() const;
+
+      public:
+
         // Documented in superclass.
         std::vector<ome::compat::shared_ptr< ::ome::bioformats::FormatReader> >
         getUnderlyingReaders() const;
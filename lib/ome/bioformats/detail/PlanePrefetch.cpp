@@ -0,0 +1,361 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+
+#include <ome/bioformats/PixelCopy.h>
+#include <ome/bioformats/detail/PlanePrefetch.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Transfer prefetched pixel data to a destination buffer.
+        // Internally managed buffers are swapped to avoid a copy;
+        // external storage is filled in place.
+        void
+        transfer(VariantPixelBuffer& source,
+                 VariantPixelBuffer& dest)
+        {
+          if (dest.managed())
+            {
+              dest.swap(source);
+              return;
+            }
+
+          ome::compat::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> extents;
+          std::copy(source.shape(), source.shape() + PixelBufferBase::dimensions, extents.begin());
+          dest.ensureBuffer(extents, source.pixelType(), source.storage_order());
+
+          PixelBufferBase::indices_type origin;
+          std::fill(origin.begin(), origin.end(), 0);
+          copyRegion(source, origin, extents, dest, origin);
+        }
+
+      }
+
+      PlanePrefetch::Key::Key(dimension_size_type series,
+                              dimension_size_type plane,
+                              const PlaneRegion&  region):
+        series(series),
+        plane(plane),
+        region(region)
+      {
+      }
+
+      bool
+      PlanePrefetch::Key::operator== (const Key& rhs) const
+      {
+        return series == rhs.series &&
+          plane == rhs.plane &&
+          region.x == rhs.region.x &&
+          region.y == rhs.region.y &&
+          region.w == rhs.region.w &&
+          region.h == rhs.region.h;
+      }
+
+      PlanePrefetch::PlanePrefetch(read_function read):
+        read(read),
+        mutex(),
+        done(),
+        worker(),
+        running(false),
+        active(),
+        depth(0U),
+        queue(),
+        ring(),
+        last(),
+        stride(0),
+        stats()
+      {
+        stats.hits = stats.misses = stats.prefetched = stats.discarded = 0U;
+      }
+
+      PlanePrefetch::~PlanePrefetch()
+      {
+        stop();
+      }
+
+      void
+      PlanePrefetch::setDepth(dimension_size_type depth)
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        this->depth = depth;
+        while (queue.size() > depth)
+          queue.pop_back();
+        while (ring.size() > depth)
+          {
+            ring.pop_front();
+            ++stats.discarded;
+          }
+      }
+
+      dimension_size_type
+      PlanePrefetch::getDepth() const
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        return depth;
+      }
+
+      bool
+      PlanePrefetch::take(dimension_size_type series,
+                          dimension_size_type plane,
+                          const PlaneRegion&  region,
+                          VariantPixelBuffer& buf)
+      {
+        const Key key(series, plane, region);
+
+        {
+          boost::unique_lock<boost::mutex> lock(mutex);
+
+          for (;;)
+            {
+              for (std::deque<Entry>::iterator i = ring.begin();
+                   i != ring.end();
+                   ++i)
+                {
+                  if (i->key == key)
+                    {
+                      ome::compat::shared_ptr<VariantPixelBuffer> buffer(i->buffer);
+                      ring.erase(i);
+                      ++stats.hits;
+                      lock.unlock();
+                      transfer(*buffer, buf);
+                      return true;
+                    }
+                }
+
+              // Wait if the plane is being read or queued for reading.
+              if (running &&
+                  ((active && *active == key) ||
+                   std::find(queue.begin(), queue.end(), key) != queue.end()))
+                done.wait(lock);
+              else
+                break;
+            }
+
+          ++stats.misses;
+        }
+
+        // Let the caller read directly.
+        stop();
+        return false;
+      }
+
+      void
+      PlanePrefetch::access(dimension_size_type series,
+                            dimension_size_type plane,
+                            const PlaneRegion&  region,
+                            dimension_size_type count)
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+
+        std::ptrdiff_t s = 0;
+        if (last &&
+            last->series == series &&
+            last->region.x == region.x &&
+            last->region.y == region.y &&
+            last->region.w == region.w &&
+            last->region.h == region.h)
+          s = static_cast<std::ptrdiff_t>(plane) - static_cast<std::ptrdiff_t>(last->plane);
+
+        // Adjacent planes are treated as sequential immediately;
+        // larger strides must repeat.
+        const bool sequential = s != 0 && (s == stride || s == 1 || s == -1);
+        stride = s;
+        last = Key(series, plane, region);
+
+        if (!depth || !sequential)
+          return;
+
+        queue.clear();
+        std::ptrdiff_t next = static_cast<std::ptrdiff_t>(plane);
+        for (dimension_size_type i = 0; i < depth; ++i)
+          {
+            next += s;
+            if (next < 0 || static_cast<dimension_size_type>(next) >= count)
+              break;
+            if (!enqueue(Key(series, static_cast<dimension_size_type>(next), region)))
+              break;
+          }
+        start();
+      }
+
+      void
+      PlanePrefetch::hint(dimension_size_type                     series,
+                          const std::vector<dimension_size_type>& planes,
+                          const PlaneRegion&                      region)
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+
+        queue.clear();
+        for (std::vector<dimension_size_type>::const_iterator i = planes.begin();
+             i != planes.end();
+             ++i)
+          {
+            if (!enqueue(Key(series, *i, region)))
+              break;
+          }
+        start();
+      }
+
+      void
+      PlanePrefetch::stop()
+      {
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          queue.clear();
+        }
+
+        // The thread exits after completing the current read.
+        if (worker.joinable())
+          worker.join();
+      }
+
+      void
+      PlanePrefetch::clear()
+      {
+        stop();
+
+        boost::lock_guard<boost::mutex> lock(mutex);
+        stats.discarded += ring.size();
+        ring.clear();
+        last = boost::none;
+        stride = 0;
+      }
+
+      PlanePrefetch::Statistics
+      PlanePrefetch::getStatistics() const
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        return stats;
+      }
+
+      bool
+      PlanePrefetch::enqueue(const Key& key)
+      {
+        if (active && *active == key)
+          return true;
+        for (std::deque<Entry>::const_iterator i = ring.begin();
+             i != ring.end();
+             ++i)
+          {
+            if (i->key == key)
+              return true;
+          }
+        if (std::find(queue.begin(), queue.end(), key) != queue.end())
+          return true;
+        if (queue.size() >= depth)
+          return false;
+        queue.push_back(key);
+        return true;
+      }
+
+      void
+      PlanePrefetch::start()
+      {
+        if (running || queue.empty())
+          return;
+
+        // Reap a previous thread; it has already finished.
+        if (worker.joinable())
+          worker.join();
+
+        running = true;
+        worker = boost::thread(&PlanePrefetch::run, this);
+      }
+
+      void
+      PlanePrefetch::run()
+      {
+        for (;;)
+          {
+            boost::optional<Key> key;
+            {
+              boost::lock_guard<boost::mutex> lock(mutex);
+              if (queue.empty())
+                {
+                  active = boost::none;
+                  running = false;
+                  done.notify_all();
+                  return;
+                }
+              key = active = queue.front();
+              queue.pop_front();
+            }
+
+            ome::compat::shared_ptr<VariantPixelBuffer> buffer(ome::compat::make_shared<VariantPixelBuffer>());
+            bool ok = true;
+            try
+              {
+                read(key->series, key->plane, *buffer, key->region);
+              }
+            catch (...)
+              {
+                // Any error will be reported when the plane is read
+                // directly.
+                ok = false;
+              }
+
+            {
+              boost::lock_guard<boost::mutex> lock(mutex);
+              if (ok)
+                {
+                  Entry entry = { *key, buffer };
+                  ring.push_back(entry);
+                  ++stats.prefetched;
+                  while (ring.size() > depth)
+                    {
+                      ring.pop_front();
+                      ++stats.discarded;
+                    }
+                }
+              active = boost::none;
+              done.notify_all();
+            }
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,323 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_BIOFORMATS_DETAIL_PLANEPREFETCH_H
+#define OME_BIOFORMATS_DETAIL_PLANEPREFETCH_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+
+#include <ome/bioformats/FormatReader.h>
+#include <ome/bioformats/PlaneRegion.h>
+#include <ome/bioformats/Types.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace detail
+    {
+
+      /**
+       * Asynchronous plane readahead.
+       *
+       * Planes are read on a background thread into a bounded ring
+       * of buffers, so that a subsequent read of the same plane may
+       * be satisfied from memory.  Planes to read are either
+       * predicted from the access pattern (sequential or strided
+       * plane indexes within a series, reading the same region), or
+       * specified explicitly with hint().
+       *
+       * Only a single background read is in progress at any time.
+       * The read function is called on the background thread, and
+       * must serialise its access to the reader state with the
+       * foreground thread.  It must not be called by the foreground
+       * while holding that lock, since take(), stop() and clear()
+       * wait for the background read to complete.  The methods of
+       * this class are intended to be called from a single thread,
+       * concurrently with the background thread.
+       */
+      class PlanePrefetch
+      {
+      public:
+        /**
+         * Function to read a plane.
+         *
+         * The arguments are the series (core index), the plane
+         * index within the series, the destination pixel buffer,
+         * and the region of the plane to read.
+         */
+        typedef boost::function<void (dimension_size_type,
+                                      dimension_size_type,
+                                      VariantPixelBuffer&,
+                                      const PlaneRegion&)> read_function;
+
+        /// Prefetch counters.
+        typedef ::ome::bioformats::FormatReader::PrefetchStatistics Statistics;
+
+        /**
+         * Constructor.
+         *
+         * Prefetching is disabled until a nonzero depth is set.
+         *
+         * @param read the function used to read planes.
+         */
+        explicit
+        PlanePrefetch(read_function read);
+
+        /// Destructor.  Stops any background read.
+        ~PlanePrefetch();
+
+      private:
+        /// Copy constructor (deleted).
+        PlanePrefetch (const PlanePrefetch&);
+
+        /// Assignment operator (deleted).
+        PlanePrefetch&
+        operator= (const PlanePrefetch&);
+
+      public:
+        /**
+         * Set the prefetch depth.
+         *
+         * This is the maximum number of planes read ahead and held
+         * in memory.  Prefetched planes beyond the new depth are
+         * discarded.
+         *
+         * @param depth the number of planes; zero to disable.
+         */
+        void
+        setDepth(dimension_size_type depth);
+
+        /**
+         * Get the prefetch depth.
+         *
+         * @returns the number of planes; zero if disabled.
+         */
+        dimension_size_type
+        getDepth() const;
+
+        /**
+         * Take a prefetched plane.
+         *
+         * If the plane is held in memory, it is transferred to the
+         * destination buffer and removed from the ring.  If the plane
+         * is being read or queued for reading, this waits for the
+         * read to complete.  Otherwise, pending reads are cancelled
+         * and the background read (if any) is waited for, so that
+         * the caller may read the plane directly.
+         *
+         * As for FormatReader::openBytes(), a destination buffer
+         * referencing external storage is filled in place.
+         *
+         * @param series the series (core index) of the plane.
+         * @param plane the plane index within the series.
+         * @param region the region of the plane.
+         * @param buf the destination pixel buffer.
+         * @returns @c true if the plane was prefetched, @c false
+         * otherwise.
+         * @throws std::logic_error if the destination pixel buffer
+         * uses incompatible external storage.
+         */
+        bool
+        take(dimension_size_type series,
+             dimension_size_type plane,
+             const PlaneRegion&  region,
+             VariantPixelBuffer& buf);
+
+        /**
+         * Record a plane access.
+         *
+         * If the access continues a sequential or strided pattern,
+         * the following planes in the pattern are read ahead, up to
+         * the prefetch depth.
+         *
+         * @param series the series (core index) of the plane.
+         * @param plane the plane index within the series.
+         * @param region the region of the plane.
+         * @param count the number of planes in the series.
+         */
+        void
+        access(dimension_size_type series,
+               dimension_size_type plane,
+               const PlaneRegion&  region,
+               dimension_size_type count);
+
+        /**
+         * Read ahead the specified planes.
+         *
+         * Pending reads are replaced with the specified planes, up
+         * to the prefetch depth, in the order specified.
+         *
+         * @param series the series (core index) of the planes.
+         * @param planes the plane indexes within the series.
+         * @param region the region of the planes.
+         */
+        void
+        hint(dimension_size_type                     series,
+             const std::vector<dimension_size_type>& planes,
+             const PlaneRegion&                      region);
+
+        /**
+         * Stop reading ahead.
+         *
+         * Pending reads are cancelled, and the background read (if
+         * any) is waited for.  Prefetched planes are retained.
+         */
+        void
+        stop();
+
+        /**
+         * Stop reading ahead and discard all prefetched planes.
+         *
+         * The access pattern is also reset.  The statistics are
+         * retained.
+         */
+        void
+        clear();
+
+        /**
+         * Get prefetch counters.
+         *
+         * @returns the counters.
+         */
+        Statistics
+        getStatistics() const;
+
+      private:
+        /// A plane to read.
+        struct Key
+        {
+          /// Series (core index).
+          dimension_size_type series;
+          /// Plane index.
+          dimension_size_type plane;
+          /// Plane region.
+          PlaneRegion region;
+
+          /// Constructor.
+          Key(dimension_size_type series,
+              dimension_size_type plane,
+              const PlaneRegion&  region);
+
+          /**
+           * Compare keys.
+           *
+           * @param rhs the key to compare with.
+           * @returns @c true if equal, @c false otherwise.
+           */
+          bool
+          operator== (const Key& rhs) const;
+        };
+
+        /// A prefetched plane.
+        struct Entry
+        {
+          /// Plane read.
+          Key key;
+          /// Pixel data.
+          ome::compat::shared_ptr<VariantPixelBuffer> buffer;
+        };
+
+        /// Background read loop.
+        void
+        run();
+
+        /**
+         * Queue a plane for reading.
+         *
+         * Planes already prefetched or queued are skipped.  The
+         * mutex must be held by the caller.
+         *
+         * @param key the plane to read.
+         * @returns @c true if queued or already present, @c false if
+         * the queue is full.
+         */
+        bool
+        enqueue(const Key& key);
+
+        /**
+         * Start the background thread if not running.
+         *
+         * The mutex must be held by the caller.
+         */
+        void
+        start();
+
+        /// Function used to read planes.
+        read_function read;
+        /// Lock protecting all members below.
+        mutable boost::mutex mutex;
+        /// Signalled on completion of each background read.
+        boost::condition_variable done;
+        /// Background read thread.
+        boost::thread worker;
+        /// Background thread running.
+        bool running;
+        /// Plane currently being read (if @c running and @c active).
+        boost::optional<Key> active;
+        /// Maximum number of planes held and queued.
+        dimension_size_type depth;
+        /// Planes waiting to be read.
+        std::deque<Key> queue;
+        /// Prefetched planes, oldest first.
+        std::deque<Entry> ring;
+        /// Last plane accessed.
+        boost::optional<Key> last;
+        /// Stride between the last two plane accesses.
+        std::ptrdiff_t stride;
+        /// Counters.
+        Statistics stats;
+      };
+
+    }
+  }
+}
+
+#endif // OME_BIOFORMATS_DETAIL_PLANEPREFETCH_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
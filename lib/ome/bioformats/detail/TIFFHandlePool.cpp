@@ -0,0 +1,196 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <vector>
+
+#include <ome/bioformats/detail/TIFFHandlePool.h>
+#include <ome/bioformats/tiff/TIFF.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        /**
+         * Default maximum number of open TIFFs.
+         *
+         * This leaves headroom below the common default descriptor
+         * limit of 1024.
+         */
+        const dimension_size_type default_limit = 512U;
+
+        /// The process-wide pool (never deleted; used until exit).
+        TIFFHandlePool *pool = 0;
+
+        /// Pool creation flag.
+        boost::once_flag poolFlag = BOOST_ONCE_INIT;
+
+      }
+
+      TIFFHandlePool::TIFFHandlePool():
+        mutex(),
+        limit(default_limit),
+        lru(),
+        index(),
+        opened(0U),
+        evicted(0U)
+      {
+      }
+
+      void
+      TIFFHandlePool::create()
+      {
+        pool = new TIFFHandlePool;
+      }
+
+      TIFFHandlePool&
+      TIFFHandlePool::instance()
+      {
+        boost::call_once(&TIFFHandlePool::create, poolFlag);
+        return *pool;
+      }
+
+      TIFFHandlePool::handle_type
+      TIFFHandlePool::open(const boost::filesystem::path& file)
+      {
+        // Open without holding the lock.
+        handle_type handle(tiff::TIFF::open(file, "r"));
+
+        std::vector<handle_type> closed;
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          if (handle)
+            {
+              ++opened;
+              touch(handle);
+            }
+          evict(closed);
+        }
+
+        return handle;
+      }
+
+      void
+      TIFFHandlePool::use(const handle_type& handle)
+      {
+        std::vector<handle_type> closed;
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          touch(handle);
+          evict(closed);
+        }
+      }
+
+      void
+      TIFFHandlePool::release(const handle_type& handle)
+      {
+        handle_type removed;
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          lru_index::iterator i = index.find(handle.get());
+          if (i != index.end())
+            {
+              removed = *i->second;
+              lru.erase(i->second);
+              index.erase(i);
+            }
+        }
+      }
+
+      void
+      TIFFHandlePool::setLimit(dimension_size_type limit)
+      {
+        std::vector<handle_type> closed;
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+          this->limit = limit;
+          evict(closed);
+        }
+      }
+
+      dimension_size_type
+      TIFFHandlePool::getLimit() const
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        return limit;
+      }
+
+      TIFFHandlePool::Statistics
+      TIFFHandlePool::getStatistics() const
+      {
+        boost::lock_guard<boost::mutex> lock(mutex);
+
+        Statistics stats;
+        stats.open = lru.size();
+        stats.opened = opened;
+        stats.evicted = evicted;
+        return stats;
+      }
+
+      void
+      TIFFHandlePool::touch(const handle_type& handle)
+      {
+        lru_index::iterator i = index.find(handle.get());
+        if (i != index.end())
+          lru.splice(lru.begin(), lru, i->second);
+        else
+          {
+            lru.push_front(handle);
+            index.insert(lru_index::value_type(handle.get(), lru.begin()));
+          }
+      }
+
+      void
+      TIFFHandlePool::evict(std::vector<handle_type>& closed)
+      {
+        while (lru.size() > limit)
+          {
+            closed.push_back(lru.back());
+            index.erase(lru.back().get());
+            lru.pop_back();
+            ++evicted;
+          }
+      }
+
+    }
+  }
+}
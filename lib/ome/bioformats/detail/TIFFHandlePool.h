@@ -0,0 +1,221 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_BIOFORMATS_DETAIL_TIFFHANDLEPOOL_H
+#define OME_BIOFORMATS_DETAIL_TIFFHANDLEPOOL_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <ome/bioformats/Types.h>
+
+#include <ome/common/filesystem.h>
+
+#include <ome/compat/memory.h>
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace tiff
+    {
+      class TIFF;
+    }
+
+    namespace detail
+    {
+
+      /**
+       * Pool of open TIFF file handles.
+       *
+       * Readers referencing many TIFF files register each open TIFF
+       * with this pool, which is shared by all readers in the
+       * process.  When the number of open TIFFs exceeds the limit,
+       * the least recently used TIFFs are evicted from the pool.
+       * The pool only holds a reference to each TIFF, so an evicted
+       * TIFF is closed once no longer in use; readers must hold a
+       * weak reference and reopen the file if it has been closed.
+       *
+       * All methods are thread-safe.
+       */
+      class TIFFHandlePool
+      {
+      public:
+        /// TIFF handle.
+        typedef ome::compat::shared_ptr<tiff::TIFF> handle_type;
+
+        /// Pool usage counters.
+        struct Statistics
+        {
+          /// Number of TIFFs currently in the pool.
+          dimension_size_type open;
+          /// Total number of TIFFs opened by the pool.
+          dimension_size_type opened;
+          /// Total number of TIFFs evicted from the pool.
+          dimension_size_type evicted;
+        };
+
+        /**
+         * Get the process-wide pool.
+         *
+         * @returns the pool.
+         */
+        static TIFFHandlePool&
+        instance();
+
+        /**
+         * Open a TIFF for reading and add it to the pool.
+         *
+         * @param file the file to open.
+         * @returns the open TIFF.
+         * @throws tiff::Exception if the file could not be opened.
+         */
+        handle_type
+        open(const boost::filesystem::path& file);
+
+        /**
+         * Mark a TIFF as used.
+         *
+         * The TIFF is made the most recently used, and is added to the
+         * pool if not already present.
+         *
+         * @param handle the TIFF to use.
+         */
+        void
+        use(const handle_type& handle);
+
+        /**
+         * Remove a TIFF from the pool.
+         *
+         * This is not counted as an eviction.
+         *
+         * @param handle the TIFF to remove.
+         */
+        void
+        release(const handle_type& handle);
+
+        /**
+         * Set the maximum number of TIFFs in the pool.
+         *
+         * If the pool currently contains more TIFFs than the new
+         * limit, the least recently used will be evicted.
+         *
+         * @param limit the maximum number of TIFFs.
+         */
+        void
+        setLimit(dimension_size_type limit);
+
+        /**
+         * Get the maximum number of TIFFs in the pool.
+         *
+         * @returns the maximum number of TIFFs.
+         */
+        dimension_size_type
+        getLimit() const;
+
+        /**
+         * Get pool usage counters.
+         *
+         * @returns the counters.
+         */
+        Statistics
+        getStatistics() const;
+
+      private:
+        /// TIFFs in order of use, most recently used first.
+        typedef std::list<handle_type> lru_list;
+
+        /// TIFF position in the use list, indexed by TIFF.
+        typedef std::map<const tiff::TIFF *, lru_list::iterator> lru_index;
+
+        /// Constructor.
+        TIFFHandlePool();
+
+        /// Create the process-wide pool.
+        static void
+        create();
+
+        /**
+         * Add or move a TIFF to the front of the use list.
+         *
+         * The mutex must be held by the caller.
+         *
+         * @param handle the TIFF to use.
+         */
+        void
+        touch(const handle_type& handle);
+
+        /**
+         * Evict TIFFs exceeding the limit.
+         *
+         * The mutex must be held by the caller.  The evicted TIFFs
+         * are returned so that they may be closed once the mutex has
+         * been released.
+         *
+         * @param closed the evicted TIFFs.
+         */
+        void
+        evict(std::vector<handle_type>& closed);
+
+        /// Mutex to lock pool access.
+        mutable boost::mutex mutex;
+        /// Maximum number of TIFFs in the pool.
+        dimension_size_type limit;
+        /// TIFFs in order of use.
+        lru_list lru;
+        /// TIFF positions in the use list.
+        lru_index index;
+        /// Total number of TIFFs opened.
+        dimension_size_type opened;
+        /// Total number of TIFFs evicted.
+        dimension_size_type evicted;
+      };
+
+    }
+  }
+}
+
+#endif // OME_BIOFORMATS_DETAIL_TIFFHANDLEPOOL_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
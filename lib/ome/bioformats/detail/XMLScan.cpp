@@ -0,0 +1,97 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+
+#include <ome/bioformats/detail/XMLScan.h>
+#include <ome/bioformats/detail/XMLScanParser.h>
+
+#include <ome/compat/regex.h>
+
+#include <ome/xml/version.h>
+
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        const ome::compat::regex schema_match("^http://www.openmicroscopy.org/Schemas/OME/(.*)$");
+
+      }
+
+      std::string
+      getSchemaModelVersion(const std::string& ns)
+      {
+        ome::compat::smatch found;
+
+        if (ome::compat::regex_match(ns, found, schema_match))
+          return found[1];
+
+        return std::string();
+      }
+
+      bool
+      isCurrentModelRoot(const std::string& name,
+                         const std::string& ns)
+      {
+        return name == "OME" &&
+          getSchemaModelVersion(ns) == OME_XML_MODEL_VERSION;
+      }
+
+      ome::compat::shared_ptr<xercesc::SAX2XMLReader>
+      createScanningParser(bool namespacePrefixes)
+      {
+        ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader());
+        parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, false);
+        parser->setFeature(xercesc::XMLUni::fgXercesSchemaFullChecking, false);
+        parser->setFeature(xercesc::XMLUni::fgXercesLoadSchema, false);
+        parser->setFeature(xercesc::XMLUni::fgXercesLoadExternalDTD, false);
+        // Needed to get the schema namespace.
+        parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+        parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpacePrefixes, namespacePrefixes);
+        return parser;
+      }
+
+    }
+  }
+}
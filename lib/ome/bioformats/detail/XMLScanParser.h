@@ -0,0 +1,81 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+
+#ifndef OME_BIOFORMATS_DETAIL_XMLSCANPARSER_H
+#define OME_BIOFORMATS_DETAIL_XMLSCANPARSER_H
+
+#include <ome/compat/memory.h>
+
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+
+// This header is internal to the library and is not installed, so
+// that the public headers do not depend upon Xerces.
+
+namespace ome
+{
+  namespace bioformats
+  {
+    namespace detail
+    {
+
+      /**
+       * Create a non-validating SAX parser for scanning XML text.
+       *
+       * Validation and schema and DTD loading are disabled, and
+       * namespace processing is enabled.  This is suitable for
+       * quickly extracting information from a document; any problems
+       * with the XML will be found when it is parsed in full.
+       *
+       * @param namespacePrefixes report namespace declarations as
+       * attributes.
+       * @returns the parser.
+       */
+      ome::compat::shared_ptr<xercesc::SAX2XMLReader>
+      createScanningParser(bool namespacePrefixes = false);
+
+    }
+  }
+}
+
+#endif // OME_BIOFORMATS_DETAIL_XMLSCANPARSER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -136,6 +136,10 @@ namespace ome
       void
       MinimalTIFFReader::close(bool fileOnly)
       {
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         // Drop shared reference to open TIFF.
         tiff.reset();
 
@@ -225,6 +229,8 @@ namespace ome
       MinimalTIFFReader::getLookupTable(dimension_size_type plane,
                                         VariantPixelBuffer& buf) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         const ome::compat::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
@@ -256,15 +262,31 @@ namespace ome
         ifd->readImage(buf, x, y, w, h);
       }
 
+      void
+      MinimalTIFFReader::openRegionsImpl(dimension_size_type              plane,
+                                         std::vector<VariantPixelBuffer>& bufs,
+                                         const std::vector<PlaneRegion>&  regions) const
+      {
+        assertId(currentId, true);
+
+        const ome::compat::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->readImages(bufs, regions);
+      }
+
       ome::compat::shared_ptr<ome::bioformats::tiff::TIFF>
       MinimalTIFFReader::getTIFF()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return tiff;
       }
 
       const ome::compat::shared_ptr<ome::bioformats::tiff::TIFF>
       MinimalTIFFReader::getTIFF() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         return tiff;
       }
 
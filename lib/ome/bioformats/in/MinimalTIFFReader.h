@@ -132,10 +132,20 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const;
 
+        // Documented in superclass.
+        void
+        openRegionsImpl(dimension_size_type              plane,
+                        std::vector<VariantPixelBuffer>& bufs,
+                        const std::vector<PlaneRegion>&  regions) const;
+
       public:
         /**
          * Get open TIFF file.
          *
+         * The TIFF may be used while planes are prefetched, since
+         * access to the TIFF is serialised by its own lock (see
+         * tiff::TIFF::getMutex()).
+         *
          * @note This will be null if setId has not been called.
          *
          * @returns a reference to the TIFF file.
@@ -146,6 +156,10 @@ namespace ome
         /**
          * Get open TIFF file.
          *
+         * The TIFF may be used while planes are prefetched, since
+         * access to the TIFF is serialised by its own lock (see
+         * tiff::TIFF::getMutex()).
+         *
          * @note This will be null if setId has not been called.
          *
          * @returns a reference to the TIFF file.
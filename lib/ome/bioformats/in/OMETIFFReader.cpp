@@ -40,22 +40,40 @@
 #include <map>
 #include <set>
 
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
 #include <boost/range/size.hpp>
+#include <boost/thread.hpp>
 
 #include <ome/bioformats/FormatException.h>
 #include <ome/bioformats/FormatTools.h>
 #include <ome/bioformats/MetadataTools.h>
 #include <ome/bioformats/detail/OMETIFF.h>
+#include <ome/bioformats/detail/TIFFHandlePool.h>
+#include <ome/bioformats/detail/XMLScan.h>
+#include <ome/bioformats/detail/XMLScanParser.h>
 #include <ome/bioformats/in/OMETIFFReader.h>
 #include <ome/bioformats/tiff/IFD.h>
 #include <ome/bioformats/tiff/TIFF.h>
 #include <ome/bioformats/tiff/Tags.h>
 #include <ome/bioformats/tiff/Field.h>
 
+#include <ome/common/xml/Platform.h>
+#include <ome/common/xml/String.h>
+
 #include <ome/xml/meta/OMEXMLMetadata.h>
 #include <ome/xml/meta/BaseMetadata.h>
 #include <ome/xml/meta/Convert.h>
 
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/sax/SAXException.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+
+// Include last due to side effect of MPL vector limit setting which can change the default
+#include <boost/lexical_cast.hpp>
+
 namespace fs = boost::filesystem;
 using boost::filesystem::path;
 using ome::common::canonical;
@@ -80,6 +98,265 @@ namespace
     }
   };
 
+  /// Maximum number of threads used to open TIFF files concurrently.
+  const ome::bioformats::dimension_size_type probe_thread_limit = 16U;
+
+  /**
+   * Lightweight OME-XML scanner.
+   *
+   * This scans OME-XML text with a non-validating SAX parser to
+   * obtain the information needed for format detection and file
+   * grouping, without creating a DOM tree, validating, or upgrading
+   * the document.  Only documents at the current model version are
+   * supported; older documents must be parsed in full.
+   *
+   * The whole document is scanned, so that the minimum metadata
+   * required for every image may be verified, as verifyMinimum()
+   * does for a full parse.  Only a BinaryOnly element ends the scan
+   * early.
+   */
+  class OMEXMLScanner : public xercesc::DefaultHandler
+  {
+  public:
+    /// Scan result.
+    enum Result
+      {
+        SCAN_OK,          ///< Scan completed.
+        SCAN_UNSUPPORTED, ///< Not at the current model version.
+        SCAN_INVALID      ///< Not well-formed XML.
+      };
+
+    /// Constructor.
+    OMEXMLScanner():
+      xercesc::DefaultHandler(),
+      metadataFile(),
+      images(0U),
+      planes(0U),
+      valid(true),
+      sizes(true),
+      unsupported(false),
+      started(false),
+      inPixels(false),
+      hasPixels(false),
+      sizeZ(0U),
+      sizeT(0U),
+      channels(0U)
+    {}
+
+    virtual ~OMEXMLScanner() {}
+
+    /**
+     * Scan OME-XML text.
+     *
+     * @param text the text to scan.
+     * @returns the scan result.
+     */
+    Result
+    scan(const std::string& text)
+    {
+      ome::common::xml::Platform xmlplat;
+
+      ome::compat::shared_ptr<xercesc::SAX2XMLReader> parser(ome::bioformats::detail::createScanningParser());
+
+      xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(text.c_str()),
+                                        static_cast<XMLSize_t>(text.size()),
+                                        ome::common::xml::String("OME-TIFF ImageDescription"));
+
+      parser->setContentHandler(this);
+      parser->setErrorHandler(this);
+
+      try
+        {
+          parser->parse(source);
+        }
+      catch (const xercesc::SAXParseException&)
+        {
+          return SCAN_INVALID;
+        }
+      catch (const xercesc::SAXException&)
+        {
+          // Early termination.
+        }
+      catch (...)
+        {
+          return SCAN_INVALID;
+        }
+
+      return unsupported ? SCAN_UNSUPPORTED : SCAN_OK;
+    }
+
+    void
+    startElement(const XMLCh* const         uri,
+                 const XMLCh* const         localname,
+                 const XMLCh* const         /* qname */,
+                 const xercesc::Attributes& attrs)
+    {
+      const std::string name(ome::common::xml::String(localname));
+
+      if (!started)
+        {
+          started = true;
+          if (!ome::bioformats::detail::isCurrentModelRoot(name, ome::common::xml::String(uri)))
+            {
+              unsupported = true;
+              stop();
+            }
+          return;
+        }
+
+      if (name == "BinaryOnly")
+        {
+          metadataFile = attribute(attrs, "MetadataFile");
+          stop();
+        }
+      else if (name == "Image")
+        {
+          ++images;
+          hasPixels = false;
+          if (attribute(attrs, "ID").empty())
+            valid = false;
+        }
+      else if (name == "Pixels" && images)
+        {
+          if (attribute(attrs, "ID").empty())
+            valid = false;
+          sizeZ = size(attribute(attrs, "SizeZ"));
+          sizeT = size(attribute(attrs, "SizeT"));
+          if (!sizeZ || !sizeT)
+            {
+              sizes = false;
+              valid = false;
+            }
+          channels = 0U;
+          inPixels = true;
+          hasPixels = true;
+        }
+      else if (name == "Channel" && inPixels)
+        {
+          ++channels;
+          if (attribute(attrs, "ID").empty())
+            valid = false;
+        }
+    }
+
+    void
+    endElement(const XMLCh* const /* uri */,
+               const XMLCh* const localname,
+               const XMLCh* const /* qname */)
+    {
+      const std::string name(ome::common::xml::String(localname));
+
+      if (inPixels && name == "Pixels")
+        {
+          inPixels = false;
+          planes += sizeZ * sizeT * std::max(channels, ome::bioformats::dimension_size_type(1U));
+        }
+      else if (name == "Image" && !hasPixels)
+        {
+          // Pixels is required.
+          valid = false;
+        }
+    }
+
+    /// BinaryOnly metadata file (empty if not BinaryOnly).
+    std::string metadataFile;
+    /// Number of images.
+    ome::bioformats::dimension_size_type images;
+    /// Total number of planes in all images.
+    ome::bioformats::dimension_size_type planes;
+    /// Every image has a Pixels element with valid sizes, and all
+    /// Image, Pixels and Channel IDs are present.
+    bool valid;
+    /// SizeZ and SizeT are positive integers for every image.
+    bool sizes;
+
+  private:
+    /// Stop scanning.
+    static void
+    stop()
+    {
+      throw xercesc::SAXException(ome::common::xml::String("Scan complete"));
+    }
+
+    /**
+     * Get an attribute value.
+     *
+     * @param attrs the element attributes.
+     * @param name the attribute name.
+     * @returns the value, or an empty string if unset.
+     */
+    static std::string
+    attribute(const xercesc::Attributes& attrs,
+              const std::string&         name)
+    {
+      const XMLCh *value = attrs.getValue(ome::common::xml::String(name));
+      return value ? std::string(ome::common::xml::String(value)) : std::string();
+    }
+
+    /**
+     * Parse a dimension size.
+     *
+     * @param value the attribute value.
+     * @returns the size, or zero if missing or not a positive
+     * integer.
+     */
+    static ome::bioformats::dimension_size_type
+    size(const std::string& value)
+    {
+      // lexical_cast would accept and wrap negative values.
+      if (value.empty() ||
+          value.find_first_not_of("0123456789") != std::string::npos)
+        return 0U;
+
+      try
+        {
+          return boost::lexical_cast<ome::bioformats::dimension_size_type>(value);
+        }
+      catch (const boost::bad_lexical_cast&)
+        {
+          return 0U;
+        }
+    }
+
+    /// Document is not at the current model version.
+    bool unsupported;
+    /// Root element seen.
+    bool started;
+    /// Within a Pixels element.
+    bool inPixels;
+    /// Current Image contains a Pixels element.
+    bool hasPixels;
+    /// SizeZ of current Pixels.
+    ome::bioformats::dimension_size_type sizeZ;
+    /// SizeT of current Pixels.
+    ome::bioformats::dimension_size_type sizeT;
+    /// Number of channels in current Pixels.
+    ome::bioformats::dimension_size_type channels;
+  };
+
+  /**
+   * Check if text might be OME-XML.
+   *
+   * This is a cheap check of the start of the text for an XML
+   * element and the OME namespace, to reject other TIFF
+   * ImageDescription content before any parsing.
+   *
+   * @param text the text to check.
+   * @returns @c true if the text might be OME-XML, @c false if it is
+   * certainly not OME-XML.
+   */
+  bool
+  sniffOMEXML(const std::string& text)
+  {
+    if (text.empty() || text[0] != '<' || text[text.size()-1] != '>')
+      return false;
+
+    // The OME namespace is declared on the root element, so will be
+    // found close to the start of the document.
+    const std::string prefix(text, 0, std::min(text.size(), std::string::size_type(4096U)));
+    return prefix.find("http://www.openmicroscopy.org/") != std::string::npos;
+  }
+
 }
 
 namespace ome
@@ -170,9 +447,16 @@ namespace ome
         files(),
         invalidFiles(),
         tiffs(),
+        ifdOffsets(),
         metadataFile(),
         usedFiles(),
-        hasSPW(false)
+        hasSPW(false),
+        parsedMetadata(),
+        pathExists(),
+        canonicalPaths(),
+        concurrentProbe(false),
+        trustOMEXML(false),
+        verifiedFiles()
       {
         this->suffixNecessary = false;
         this->suffixSufficient = false;
@@ -195,6 +479,10 @@ namespace ome
       void
       OMETIFFReader::close(bool fileOnly)
       {
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         /// @todo
 
         if (!fileOnly)
@@ -204,8 +492,23 @@ namespace ome
             hasSPW = false;
             usedFiles.clear();
             metadataFile.clear();
+            pathExists.clear();
+            canonicalPaths.clear();
+            verifiedFiles.clear();
+            boost::lock_guard<boost::mutex> lock(metadataMutex);
+            parsedMetadata.clear();
+          }
+        // Closes all open TIFFs once no longer in use.
+        for (tiff_map::const_iterator i = tiffs.begin();
+             i != tiffs.end();
+             ++i)
+          {
+            ome::compat::shared_ptr<tiff::TIFF> t(i->second.lock());
+            if (t)
+              detail::TIFFHandlePool::instance().release(t);
           }
-        tiffs.clear(); // Closes all open TIFFs.
+        tiffs.clear();
+        ifdOffsets.clear();
 
         detail::FormatReader::close(fileOnly);
       }
@@ -228,20 +531,36 @@ namespace ome
         std::string omexml;
         getComment(*tiff, omexml);
 
-        ome::compat::shared_ptr< ::ome::xml::meta::Metadata> meta(createOMEXMLMetadata(omexml));
-
         dimension_size_type nImages = 0U;
-        for (dimension_size_type i = 0U;
-             i < meta->getImageCount();
-             ++i)
+
+        // Count planes with a lightweight scan if possible.
+        OMEXMLScanner scanner;
+        if (scanner.scan(omexml) == OMEXMLScanner::SCAN_OK)
+          {
+            if (!scanner.sizes)
+              {
+                boost::format fmt("Invalid Pixels SizeZ or SizeT in OME-XML in ‘%1%’");
+                fmt % id.string();
+                throw FormatException(fmt.str());
+              }
+            nImages = scanner.planes;
+          }
+        else
           {
-            dimension_size_type nChannels = meta->getChannelCount(i);
-            if (!nChannels)
-              nChannels = 1;
-            ome::xml::model::primitives::PositiveInteger z(meta->getPixelsSizeZ(i));
-            ome::xml::model::primitives::PositiveInteger t(meta->getPixelsSizeT(i));
+            ome::compat::shared_ptr< ::ome::xml::meta::Metadata> meta(readMetadata(omexml, false));
 
-            nImages += static_cast<dimension_size_type>(z) * static_cast<dimension_size_type>(t) * nChannels;
+            for (dimension_size_type i = 0U;
+                 i < meta->getImageCount();
+                 ++i)
+              {
+                dimension_size_type nChannels = meta->getChannelCount(i);
+                if (!nChannels)
+                  nChannels = 1;
+                ome::xml::model::primitives::PositiveInteger z(meta->getPixelsSizeZ(i));
+                ome::xml::model::primitives::PositiveInteger t(meta->getPixelsSizeT(i));
+
+                nImages += static_cast<dimension_size_type>(z) * static_cast<dimension_size_type>(t) * nChannels;
+              }
           }
 
         dimension_size_type nIFD = tiff->directoryCount();
@@ -275,12 +594,29 @@ namespace ome
         getComment(*tiff, omexml);
 
         // Basic sanity check before parsing.
-        if (omexml.size() == 0 || omexml[0] != '<' || omexml[omexml.size()-1] != '>')
+        if (!sniffOMEXML(omexml))
           return false;
 
+        // Lightweight scan, verifying every image.  Full parsing is
+        // deferred to initFile().
+        OMEXMLScanner scanner;
+        switch (scanner.scan(omexml))
+          {
+          case OMEXMLScanner::SCAN_OK:
+            if (!scanner.metadataFile.empty())
+              return true;
+            return scanner.valid && scanner.images > 0;
+          case OMEXMLScanner::SCAN_INVALID:
+            return false;
+          case OMEXMLScanner::SCAN_UNSUPPORTED:
+          default:
+            break;
+          }
+
+        // Older model versions require a full parse and upgrade.
         try
           {
-            ome::compat::shared_ptr< ::ome::xml::meta::Metadata> meta(createOMEXMLMetadata(omexml));
+            ome::compat::shared_ptr< ::ome::xml::meta::Metadata> meta(readMetadata(omexml, false));
 
             std::string metadataFile = meta->getBinaryOnlyMetadataFile();
             if (!metadataFile.empty())
@@ -310,9 +646,7 @@ namespace ome
         if (plane < ometa.tiffPlanes.size())
           {
             const OMETIFFPlane& tiffplane(ometa.tiffPlanes.at(plane));
-            const ome::compat::shared_ptr<const TIFF> tiff(getTIFF(tiffplane.id));
-            if (tiff)
-              ifd = ome::compat::shared_ptr<const IFD>(tiff->getDirectoryByIndex(tiffplane.ifd));
+            ifd = getDirectory(tiffplane.id, tiffplane.ifd);
           }
 
         if (!ifd)
@@ -328,6 +662,8 @@ namespace ome
       const std::vector<std::string>&
       OMETIFFReader::getDomains() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
         return getDomainCollection(hasSPW ? HCS_ONLY_DOMAINS : NON_GRAPHICS_DOMAINS);
       }
@@ -335,6 +671,8 @@ namespace ome
       const std::vector<boost::filesystem::path>
       OMETIFFReader::getSeriesUsedFiles(bool noPixels) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         std::set<boost::filesystem::path> fileSet;
@@ -378,27 +716,50 @@ namespace ome
       dimension_size_type
       OMETIFFReader::getOptimalTileWidth(dimension_size_type channel) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(getCoreIndex())));
 
+        // Not set during initialization if trusting the OME-XML.
+        if (ometa.tileWidth.empty())
+          return channelIFD(channel)->getTileInfo().tileWidth();
+
         return ometa.tileWidth.at(channel);
       }
 
       dimension_size_type
       OMETIFFReader::getOptimalTileHeight(dimension_size_type channel) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(getCoreIndex())));
 
+        // Not set during initialization if trusting the OME-XML.
+        if (ometa.tileHeight.empty())
+          return channelIFD(channel)->getTileInfo().tileHeight();
+
         return ometa.tileHeight.at(channel);
       }
 
       void
       OMETIFFReader::initFile(const boost::filesystem::path& id)
       {
+        // Retain metadata parsed while checking the type of this
+        // file across the close() in the base initFile().
+        metadata_cache parsed;
+        {
+          boost::lock_guard<boost::mutex> lock(metadataMutex);
+          parsed.swap(parsedMetadata);
+        }
         detail::FormatReader::initFile(id);
+        {
+          boost::lock_guard<boost::mutex> lock(metadataMutex);
+          parsedMetadata.swap(parsed);
+        }
         // Note: Use canonical currentId rather than non-canonical id after this point.
         path dir((*currentId).parent_path());
 
@@ -407,7 +768,9 @@ namespace ome
             // This is a companion file.  Read the metadata, get the
             // TIFF for the TiffData for the first image, and then
             // recurse with this file as the id.
-            ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(createOMEXMLMetadata(*currentId));
+            // The metadata is cached for reuse if the TIFF refers back
+            // to this file with BinaryOnly.
+            ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(readMetadata(*currentId, false));
             path firstTIFF(path(meta->getUUIDFileName(0, 0)));
             initFile(canonical(firstTIFF, dir));
             return;
@@ -421,14 +784,14 @@ namespace ome
         // metadata from it.
         std::string omexml;
         getComment(*tiff, omexml);
-        ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(createOMEXMLMetadata(omexml));
+        ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(readMetadata(omexml, true));
 
         // Is there an associated binary-only metadata file?
         try
           {
             metadataFile = canonical(path(meta->getBinaryOnlyMetadataFile()), dir);
             if (!metadataFile.empty() && boost::filesystem::exists(metadataFile))
-              meta = createOMEXMLMetadata(metadataFile);
+              meta = readMetadata(metadataFile, true);
           }
         catch (const std::exception&)
           {
@@ -482,6 +845,11 @@ namespace ome
         // UUID → file mapping and used files.
         findUsedFiles(*meta, *currentId, dir, currentUUID);
 
+        // Open all the used files up front, rather than one at a time
+        // while checking each image below.
+        if (concurrentProbe && !trustOMEXML)
+          probeTIFFs();
+
         // Process TiffData elements.
         for (index_type series = 0; series < seriesCount; ++series)
           {
@@ -616,8 +984,8 @@ namespace ome
                 else
                   {
                     // All the other cases will already have a canonical path.
-                    if (fs::exists(dir / *filename))
-                      filename = canonical(dir / *filename, dir);
+                    if (cachedExists(dir / *filename))
+                      filename = cachedCanonical(dir / *filename, dir);
                     else
                       {
                         invalid_file_map::const_iterator invalid = invalidFiles.find(*filename);
@@ -640,7 +1008,7 @@ namespace ome
                 addTIFF(*filename);
 
                 bool exists = true;
-                if (!fs::exists(*filename))
+                if (!cachedExists(*filename))
                   {
                     // If an absolute filename, try using a relative
                     // name.  Old versions of the Java OMETiffWriter
@@ -648,7 +1016,7 @@ namespace ome
                     // causes problems if the file is moved to a
                     // different directory.
                     path relative(dir / (*filename).filename());
-                    if (fs::exists(relative))
+                    if (cachedExists(relative))
                       {
                         filename = relative;
                       }
@@ -757,14 +1125,15 @@ namespace ome
             // Fill CoreMetadata.
             try
               {
-                const OMETIFFPlane& plane(coreMeta->tiffPlanes.at(0));
-                const ome::compat::shared_ptr<const tiff::TIFF> ptiff(getTIFF(plane.id));
-                const ome::compat::shared_ptr<const tiff::IFD> pifd(ptiff->getDirectoryByIndex(plane.ifd));
-
-                uint32_t tiffWidth = pifd->getImageWidth();
-                uint32_t tiffHeight = pifd->getImageHeight();
-                ome::xml::model::enums::PixelType tiffPixelType = pifd->getPixelType();
-                tiff::PhotometricInterpretation photometric = pifd->getPhotometricInterpretation();
+                // The TIFF is only opened here if the OME-XML is not
+                // trusted; otherwise it is checked by verifyPixels()
+                // on first use.
+                ome::compat::shared_ptr<const tiff::IFD> pifd;
+                if (!trustOMEXML)
+                  {
+                    const OMETIFFPlane& plane(coreMeta->tiffPlanes.at(0));
+                    pifd = getDirectory(plane.id, plane.ifd);
+                  }
 
                 coreMeta->sizeX = meta->getPixelsSizeX(series);
                 coreMeta->sizeY = meta->getPixelsSizeY(series);
@@ -783,7 +1152,7 @@ namespace ome
 #endif
                 coreMeta->interleaved = false;
                 coreMeta->indexed = false;
-                if (photometric == tiff::PALETTE)
+                if (pifd && pifd->getPhotometricInterpretation() == tiff::PALETTE)
                   {
                     try
                       {
@@ -818,7 +1187,9 @@ namespace ome
                   }
 
                 // Check channel sizes and correct if wrong.
-                for (dimension_size_type channel = 0; channel < coreMeta->sizeC.size(); ++channel)
+                for (dimension_size_type channel = 0;
+                     pifd && channel < coreMeta->sizeC.size();
+                     ++channel)
                   {
                     dimension_size_type planeIndex =
                       ome::bioformats::getIndex(coreMeta->dimensionOrder,
@@ -831,8 +1202,7 @@ namespace ome
                                                 0);
 
                     const OMETIFFPlane& plane(coreMeta->tiffPlanes.at(planeIndex));
-                    const ome::compat::shared_ptr<const tiff::TIFF> ctiff(getTIFF(plane.id));
-                    const ome::compat::shared_ptr<const tiff::IFD> cifd(ctiff->getDirectoryByIndex(plane.ifd));
+                    const ome::compat::shared_ptr<const tiff::IFD> cifd(getDirectory(plane.id, plane.ifd));
                     const tiff::TileInfo tinfo(cifd->getTileInfo());
                     const dimension_size_type tiffSamples = cifd->getSamplesPerPixel();
 
@@ -849,17 +1219,17 @@ namespace ome
                     coreMeta->tileHeight.push_back(tinfo.tileHeight());
                   }
 
-                if (coreMeta->sizeX != tiffWidth)
+                if (pifd && coreMeta->sizeX != pifd->getImageWidth())
                   {
                     boost::format fmt("SizeX mismatch: OME=%1%, TIFF=%2%");
-                    fmt % coreMeta->sizeX % tiffWidth;
+                    fmt % coreMeta->sizeX % pifd->getImageWidth();
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
-                if (coreMeta->sizeY != tiffHeight)
+                if (pifd && coreMeta->sizeY != pifd->getImageHeight())
                   {
                     boost::format fmt("SizeY mismatch: OME=%1%, TIFF=%2%");
-                    fmt % coreMeta->sizeY % tiffHeight;
+                    fmt % coreMeta->sizeY % pifd->getImageHeight();
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
@@ -871,10 +1241,10 @@ namespace ome
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
-                if (coreMeta->pixelType != tiffPixelType)
+                if (pifd && coreMeta->pixelType != pifd->getPixelType())
                   {
                     boost::format fmt("PixelType mismatch: OME=%1%, TIFF=%2%");
-                    fmt % coreMeta->pixelType % tiffPixelType;
+                    fmt % coreMeta->pixelType % pifd->getPixelType();
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
@@ -962,6 +1332,118 @@ namespace ome
         metadataStore = getMetadataStoreForConversion();
       }
 
+      bool
+      OMETIFFReader::cachedExists(const boost::filesystem::path& file)
+      {
+        path_exists_map::const_iterator i = pathExists.find(file);
+        if (i != pathExists.end())
+          return i->second;
+
+        bool exists = fs::exists(file);
+        pathExists.insert(path_exists_map::value_type(file, exists));
+        return exists;
+      }
+
+      boost::filesystem::path
+      OMETIFFReader::cachedCanonical(const boost::filesystem::path& file,
+                                     const boost::filesystem::path& base)
+      {
+        const canonical_path_map::key_type key(file, base);
+        canonical_path_map::const_iterator i = canonicalPaths.find(key);
+        if (i != canonicalPaths.end())
+          return i->second;
+
+        // Failures are not cached; the exception is propagated.
+        path canonicalpath(canonical(file, base));
+        canonicalPaths.insert(canonical_path_map::value_type(key, canonicalpath));
+        return canonicalpath;
+      }
+
+      ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+      OMETIFFReader::readMetadata(const std::string& text,
+                                  bool               take) const
+      {
+        // Key on the complete content; a hash alone could collide
+        // and return the metadata for a different document.  The
+        // comparison is cheap relative to parsing, and the text is
+        // only copied when cached.
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata> meta(findMetadata("text", text, take));
+        if (!meta)
+          {
+            meta = createOMEXMLMetadata(text);
+            if (!take)
+              cacheMetadata(metadata_key("text", text), meta);
+          }
+        return meta;
+      }
+
+      ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+      OMETIFFReader::readMetadata(const boost::filesystem::path& file,
+                                  bool                           take) const
+      {
+        // Key on the file and its size and modification time, so
+        // that modified files are parsed again.
+        std::string key;
+        try
+          {
+            boost::format fmt("%1%:%2%:%3%");
+            fmt % file.string() % boost::filesystem::file_size(file) % boost::filesystem::last_write_time(file);
+            key = fmt.str();
+          }
+        catch (const boost::filesystem::filesystem_error&)
+          {
+            // Not cacheable; createOMEXMLMetadata will report any error.
+          }
+
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata> meta;
+        if (!key.empty())
+          meta = findMetadata("file", key, take);
+        if (!meta)
+          {
+            meta = createOMEXMLMetadata(file);
+            if (!take && !key.empty())
+              cacheMetadata(metadata_key("file", key), meta);
+          }
+        return meta;
+      }
+
+      ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+      OMETIFFReader::findMetadata(const std::string& type,
+                                  const std::string& source,
+                                  bool               take) const
+      {
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata> meta;
+
+        boost::lock_guard<boost::mutex> lock(metadataMutex);
+        for (metadata_cache::iterator i = parsedMetadata.begin();
+             i != parsedMetadata.end();
+             ++i)
+          {
+            if (i->first.first == type && i->first.second == source)
+              {
+                meta = i->second;
+                if (take)
+                  parsedMetadata.erase(i);
+                break;
+              }
+          }
+
+        return meta;
+      }
+
+      void
+      OMETIFFReader::cacheMetadata(const metadata_key&                                             key,
+                                   const ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>& meta) const
+      {
+        // Only a few documents are needed for a single setId.
+        const metadata_cache::size_type limit = 4U;
+
+        boost::lock_guard<boost::mutex> lock(metadataMutex);
+        while (parsedMetadata.size() >= limit)
+          parsedMetadata.pop_front();
+        parsedMetadata.push_back(metadata_cache::value_type(key, meta));
+      }
+
       void
       OMETIFFReader::findUsedFiles(const ome::xml::meta::OMEXMLMetadata& meta,
                                    const boost::filesystem::path&        currentId,
@@ -999,9 +1481,9 @@ namespace ome
                     catch (const std::exception&)
                       {
                       }
-                    if (fs::exists(uuidFilename))
+                    if (cachedExists(uuidFilename))
                       {
-                        filename = canonical(uuidFilename, currentDir);
+                        filename = cachedCanonical(uuidFilename, currentDir);
                       }
                     else
                       {
@@ -1276,6 +1758,8 @@ namespace ome
       OMETIFFReader::getLookupTable(dimension_size_type plane,
                                     VariantPixelBuffer& buf) const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         assertId(currentId, true);
 
         setPlane(plane);
@@ -1306,46 +1790,266 @@ namespace ome
 
         const ome::compat::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
 
+        if (trustOMEXML)
+          verifyPixels(plane, *ifd);
+
         ifd->readImage(buf, x, y, w, h);
       }
 
+      void
+      OMETIFFReader::openRegionsImpl(dimension_size_type              plane,
+                                     std::vector<VariantPixelBuffer>& bufs,
+                                     const std::vector<PlaneRegion>&  regions) const
+      {
+        assertId(currentId, true);
+
+        const ome::compat::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        if (trustOMEXML)
+          verifyPixels(plane, *ifd);
+
+        ifd->readImages(bufs, regions);
+      }
+
+      void
+      OMETIFFReader::verifyPixels(dimension_size_type plane,
+                                  const tiff::IFD&    ifd) const
+      {
+        const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(getCoreIndex())));
+        const verified_set::value_type key(ometa.tiffPlanes.at(plane).id, getCoreIndex());
+
+        if (verifiedFiles.find(key) != verifiedFiles.end())
+          return;
+
+        if (ometa.sizeX != ifd.getImageWidth() ||
+            ometa.sizeY != ifd.getImageHeight() ||
+            ometa.pixelType != ifd.getPixelType())
+          {
+            boost::format fmt("Pixels metadata mismatch in ‘%1%’: OME=%2%x%3% %4%, TIFF=%5%x%6% %7%");
+            fmt % key.first.string();
+            fmt % ometa.sizeX % ometa.sizeY % ometa.pixelType;
+            fmt % ifd.getImageWidth() % ifd.getImageHeight() % ifd.getPixelType();
+            throw FormatException(fmt.str());
+          }
+
+        verifiedFiles.insert(key);
+      }
+
+      const ome::compat::shared_ptr<const tiff::IFD>
+      OMETIFFReader::channelIFD(dimension_size_type channel) const
+      {
+        const CoreMetadata& cmeta(getCoreMetadata(getCoreIndex()));
+
+        dimension_size_type plane =
+          ome::bioformats::getIndex(cmeta.dimensionOrder,
+                                    cmeta.sizeZ,
+                                    cmeta.sizeC.size(),
+                                    cmeta.sizeT,
+                                    cmeta.imageCount,
+                                    0,
+                                    channel,
+                                    0);
+
+        return ifdAtIndex(plane);
+      }
+
+      void
+      OMETIFFReader::setConcurrentProbe(bool concurrent)
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        assertId(currentId, false);
+        concurrentProbe = concurrent;
+      }
+
+      bool
+      OMETIFFReader::getConcurrentProbe() const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        return concurrentProbe;
+      }
+
+      void
+      OMETIFFReader::setTrustOMEXML(bool trust)
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        assertId(currentId, false);
+        trustOMEXML = trust;
+      }
+
+      bool
+      OMETIFFReader::getTrustOMEXML() const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        return trustOMEXML;
+      }
+
+      /// Files to open concurrently during initialization.
+      struct OMETIFFReader::ProbeQueue
+      {
+        /// Files to open.
+        std::vector<path> ids;
+        /// Opened files, in the same order as ids.
+        std::vector<ome::compat::shared_ptr<tiff::TIFF> > tiffs;
+        /// Index of the next file to open.
+        std::vector<path>::size_type next;
+        /// Mutex protecting the queue.
+        boost::mutex mutex;
+      };
+
+      void
+      OMETIFFReader::probeTIFFs()
+      {
+        // Files opened beyond the pool limit would evict those opened
+        // earlier before they are checked, so only open as many as
+        // the pool can hold alongside the files already open.  The
+        // remainder are opened when used.
+        dimension_size_type limit = detail::TIFFHandlePool::instance().getLimit();
+        for (tiff_map::const_iterator t = tiffs.begin();
+             t != tiffs.end() && limit > 0U;
+             ++t)
+          {
+            if (!t->second.expired())
+              --limit;
+          }
+
+        ProbeQueue queue;
+        for (std::vector<path>::const_iterator i = usedFiles.begin();
+             i != usedFiles.end() && queue.ids.size() < limit;
+             ++i)
+          {
+            tiff_map::const_iterator t = tiffs.find(*i);
+            if ((t == tiffs.end() || t->second.expired()) && cachedExists(*i))
+              queue.ids.push_back(*i);
+          }
+        queue.tiffs.resize(queue.ids.size());
+        queue.next = 0U;
+
+        // Opening is bound by I/O latency rather than by the CPU, so
+        // use more threads than cores, within a fixed limit.
+        const dimension_size_type threads =
+          std::min(static_cast<dimension_size_type>(queue.ids.size()),
+                   probe_thread_limit);
+
+        if (threads > 1U)
+          {
+            boost::thread_group group;
+            for (dimension_size_type i = 0U; i < threads; ++i)
+              group.create_thread(boost::bind(&OMETIFFReader::probeTask, boost::ref(queue)));
+            group.join_all();
+          }
+        else
+          probeTask(queue);
+
+        for (std::vector<path>::size_type i = 0U; i < queue.ids.size(); ++i)
+          {
+            if (queue.tiffs[i])
+              tiffs[queue.ids[i]] = queue.tiffs[i];
+          }
+      }
+
+      void
+      OMETIFFReader::probeTask(ProbeQueue& queue)
+      {
+        for (;;)
+          {
+            std::vector<path>::size_type index;
+
+            {
+              boost::lock_guard<boost::mutex> lock(queue.mutex);
+              if (queue.next >= queue.ids.size())
+                break;
+              index = queue.next++;
+            }
+
+            try
+              {
+                queue.tiffs[index] = detail::TIFFHandlePool::instance().open(queue.ids[index]);
+              }
+            catch (const std::exception&)
+              {
+                // Reported by getTIFF() when the file is next used.
+              }
+          }
+      }
+
       void
       OMETIFFReader::addTIFF(const boost::filesystem::path& tiff)
       {
-        tiffs.insert(std::make_pair(tiff, ome::compat::shared_ptr<tiff::TIFF>()));
+        tiffs.insert(std::make_pair(tiff, ome::compat::weak_ptr<tiff::TIFF>()));
       }
 
       const ome::compat::shared_ptr<const ome::bioformats::tiff::TIFF>
       OMETIFFReader::getTIFF(const boost::filesystem::path& tiff) const
       {
         tiff_map::iterator i = tiffs.find(tiff);
-        if (!i->second)
-          i->second = tiff::TIFF::open(i->first, "r");
+        if (i == tiffs.end())
+          i = tiffs.insert(std::make_pair(tiff, ome::compat::weak_ptr<tiff::TIFF>())).first;
+
+        detail::TIFFHandlePool& pool(detail::TIFFHandlePool::instance());
+        ome::compat::shared_ptr<tiff::TIFF> t(i->second.lock());
+        if (t)
+          pool.use(t);
+        else
+          {
+            // Not yet opened, or closed by the pool; (re)open.
+            t = pool.open(i->first);
+            i->second = t;
+          }
 
-        if (!i->second)
+        if (!t)
           {
             boost::format fmt("Failed to open ‘%1%’");
             fmt % i->first.string();
             throw FormatException(fmt.str());
           }
 
-        return i->second;
+        return t;
+      }
+
+      const ome::compat::shared_ptr<const ome::bioformats::tiff::IFD>
+      OMETIFFReader::getDirectory(const boost::filesystem::path& tiff,
+                                  dimension_size_type            index) const
+      {
+        const ome::compat::shared_ptr<const tiff::TIFF> t(getTIFF(tiff));
+        std::vector<tiff::offset_type>& offsets(ifdOffsets[tiff]);
+
+        if (index < offsets.size() && offsets[index] != 0)
+          return t->getDirectoryByOffset(offsets[index]);
+
+        const ome::compat::shared_ptr<const tiff::IFD> ifd
+          (t->getDirectoryByIndex(static_cast<tiff::directory_index_type>(index)));
+        if (index >= offsets.size())
+          offsets.resize(index + 1, 0);
+        offsets[index] = ifd->getOffset();
+
+        return ifd;
       }
 
       void
       OMETIFFReader::closeTIFF(const boost::filesystem::path& tiff)
       {
         tiff_map::iterator i = tiffs.find(tiff);
-        if (i->second)
+        if (i != tiffs.end())
           {
-            i->second->close();
-            i->second = ome::compat::shared_ptr<ome::bioformats::tiff::TIFF>();
+            ome::compat::shared_ptr<tiff::TIFF> t(i->second.lock());
+            if (t)
+              {
+                detail::TIFFHandlePool::instance().release(t);
+                t->close();
+              }
+            i->second.reset();
           }
       }
 
       ome::compat::shared_ptr<ome::xml::meta::MetadataStore>
       OMETIFFReader::getMetadataStoreForConversion()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         SaveSeries sentry(*this);
 
         ome::compat::shared_ptr<ome::xml::meta::MetadataStore> store = getMetadataStore();
@@ -1365,6 +2069,8 @@ namespace ome
       ome::compat::shared_ptr<ome::xml::meta::MetadataStore>
       OMETIFFReader::getMetadataStoreForDisplay()
       {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata> omexml;
         ome::compat::shared_ptr<ome::xml::meta::MetadataStore> store = getMetadataStore();
 
@@ -38,8 +38,17 @@
 #ifndef OME_BIOFORMATS_IN_OMETIFFREADER_H
 #define OME_BIOFORMATS_IN_OMETIFFREADER_H
 
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+
 #include <ome/bioformats/in/MinimalTIFFReader.h>
 #include <ome/bioformats/tiff/ImageJMetadata.h>
+#include <ome/bioformats/tiff/Types.h>
 
 #include <ome/common/log.h>
 
@@ -80,8 +89,11 @@ namespace ome
         /// Map filename to another file.
         typedef std::map<boost::filesystem::path, boost::filesystem::path> invalid_file_map;
 
-        /// Map filename to open TIFF handle.
-        typedef std::map<boost::filesystem::path, ome::compat::shared_ptr<ome::bioformats::tiff::TIFF> > tiff_map;
+        /// Map filename to TIFF handle (owned by detail::TIFFHandlePool).
+        typedef std::map<boost::filesystem::path, ome::compat::weak_ptr<ome::bioformats::tiff::TIFF> > tiff_map;
+
+        /// Map filename to IFD offsets, indexed by IFD index (zero if unknown).
+        typedef std::map<boost::filesystem::path, std::vector<ome::bioformats::tiff::offset_type> > ifd_offset_map;
 
         /// UUID to filename mapping.
         uuid_file_map files;
@@ -90,9 +102,25 @@ namespace ome
         invalid_file_map invalidFiles;
 
         // Mutable to allow opening TIFFs when const.
-        /// Open TIFF files
+        /**
+         * Referenced TIFF files.
+         *
+         * Open TIFFs are held by the process-wide TIFF handle pool,
+         * which may close them if too many files are open; they are
+         * reopened on demand.
+         */
         mutable tiff_map tiffs;
 
+        /**
+         * IFD offsets of referenced TIFF files.
+         *
+         * These are retained when a TIFF is closed by the handle pool,
+         * so that IFDs may be accessed directly by offset after
+         * reopening, without walking the IFD chain from the start of
+         * the file.
+         */
+        mutable ifd_offset_map ifdOffsets;
+
         /// Metadata file.
         boost::filesystem::path metadataFile;
 
@@ -102,6 +130,61 @@ namespace ome
         /// Has screen-plate-well metadata.
         bool hasSPW;
 
+        /// Parsed OME-XML metadata cache key (source type and source).
+        typedef std::pair<std::string, std::string> metadata_key;
+
+        /// Parsed OME-XML metadata, keyed by source.
+        typedef std::deque<std::pair<metadata_key, ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata> > > metadata_cache;
+
+        /**
+         * Recently parsed OME-XML metadata.
+         *
+         * Metadata parsed during type checking, or from a companion
+         * file, is retained here for reuse by initFile(), so that the
+         * OME-XML for a file is only parsed once.  Entries for text
+         * are keyed by the complete text, so that different documents
+         * can never share an entry, and entries for files by path,
+         * size and modification time.  Entries are discarded by
+         * close().  Access is protected by metadataMutex.
+         */
+        mutable metadata_cache parsedMetadata;
+
+        /// Mutex protecting parsedMetadata.
+        mutable boost::mutex metadataMutex;
+
+        /// Path existence, indexed by path.
+        typedef std::map<boost::filesystem::path, bool> path_exists_map;
+
+        /// Canonical paths, indexed by path and base directory.
+        typedef std::map<std::pair<boost::filesystem::path, boost::filesystem::path>, boost::filesystem::path> canonical_path_map;
+
+        /**
+         * Cached path existence.
+         *
+         * Many TiffData elements typically refer to the same few
+         * files, so the filesystem is only queried once per file
+         * during initialization.
+         */
+        path_exists_map pathExists;
+
+        /// Cached canonical paths.
+        canonical_path_map canonicalPaths;
+
+        /// Open referenced TIFF files concurrently during initialization.
+        bool concurrentProbe;
+
+        /// Trust the OME-XML metadata without checking the TIFF files.
+        bool trustOMEXML;
+
+        /// Files and core indexes checked against the OME-XML metadata.
+        typedef std::set<std::pair<boost::filesystem::path, dimension_size_type> > verified_set;
+
+        /// Files verified on first pixel access when trusting the OME-XML.
+        mutable verified_set verifiedFiles;
+
+        /// Files to open concurrently during initialization.
+        struct ProbeQueue;
+
       public:
         /// Constructor.
         OMETIFFReader();
@@ -138,6 +221,12 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const;
 
+        // Documented in superclass.
+        void
+        openRegionsImpl(dimension_size_type              plane,
+                        std::vector<VariantPixelBuffer>& bufs,
+                        const std::vector<PlaneRegion>&  regions) const;
+
         /**
          * Get the IFD index for a plane in the current series.
          *
@@ -163,6 +252,9 @@ namespace ome
          * added to the internal map first.  If the file is not
          * currently open it will be opened.
          *
+         * The TIFF map is shared with the prefetch thread, so the
+         * reader lock must be held by the caller.
+         *
          * @param tiff the TIFF file to get.
          * @returns the open TIFF.
          * @throws FormatException if invalid.
@@ -170,6 +262,24 @@ namespace ome
         const ome::compat::shared_ptr<const ome::bioformats::tiff::TIFF>
         getTIFF(const boost::filesystem::path& tiff) const;
 
+        /**
+         * Get an IFD from a TIFF file in the internal TIFF map.
+         *
+         * The TIFF is opened if required.  The IFD offset is cached,
+         * so that subsequent access is by offset.
+         *
+         * The TIFF map is shared with the prefetch thread, so the
+         * reader lock must be held by the caller.
+         *
+         * @param tiff the TIFF file to use.
+         * @param index the IFD index.
+         * @returns the IFD.
+         * @throws FormatException or tiff::Exception if invalid.
+         */
+        const ome::compat::shared_ptr<const ome::bioformats::tiff::IFD>
+        getDirectory(const boost::filesystem::path& tiff,
+                     dimension_size_type            index) const;
+
         /**
          * Close an open TIFF file from the internal TIFF map.
          *
@@ -208,7 +318,185 @@ namespace ome
         void
         initFile(const boost::filesystem::path& id);
 
+      public:
+        /**
+         * Set concurrent opening of referenced TIFF files.
+         *
+         * If enabled, all TIFF files referenced by the OME-XML
+         * metadata are opened concurrently during initialization,
+         * rather than one at a time while checking each image.  This
+         * reduces the time taken to initialize datasets split across
+         * many files on high-latency storage.
+         *
+         * @param concurrent @c true to open files concurrently, or @c
+         * false to open files from the calling thread when needed.
+         */
+        void
+        setConcurrentProbe(bool concurrent = true);
+
+        /**
+         * Get concurrent opening of referenced TIFF files.
+         *
+         * @returns @c true if opening files concurrently, or @c false
+         * otherwise.
+         */
+        bool
+        getConcurrentProbe() const;
+
+        /**
+         * Set trust of the OME-XML metadata.
+         *
+         * By default, the image dimensions, pixel type and samples per
+         * pixel of each image are checked against the TIFF during
+         * initialization, and the samples per pixel and indexed color
+         * state are corrected from the TIFF.  If the OME-XML is
+         * trusted, the TIFF files are not opened during
+         * initialization.  Instead, the dimensions and pixel type are
+         * checked when pixel data are first read from each file, and
+         * a mismatch is reported as an error.  Indexed color is not
+         * detected.
+         *
+         * @param trust @c true to trust the OME-XML metadata, or @c
+         * false to check it against the TIFF files.
+         */
+        void
+        setTrustOMEXML(bool trust = true);
+
+        /**
+         * Get trust of the OME-XML metadata.
+         *
+         * @returns @c true if the OME-XML metadata is trusted, or @c
+         * false otherwise.
+         */
+        bool
+        getTrustOMEXML() const;
+
       private:
+        /**
+         * Open all used TIFF files concurrently.
+         *
+         * No more files are opened than the TIFFHandlePool can hold
+         * alongside the files already open; any remaining files are
+         * opened when next used.  Files which
+         * fail to open are left closed, so that the error is reported
+         * when the file is next used.
+         */
+        void
+        probeTIFFs();
+
+        /**
+         * Open TIFF files until the queue is empty.
+         *
+         * @param queue the files to open.
+         */
+        static void
+        probeTask(ProbeQueue& queue);
+
+        /**
+         * Check a plane's IFD against the core metadata.
+         *
+         * This is only done once for each file and series.
+         *
+         * @param plane the plane index within the current series.
+         * @param ifd the IFD for the plane.
+         * @throws FormatException if the IFD does not match.
+         */
+        void
+        verifyPixels(dimension_size_type plane,
+                     const tiff::IFD&    ifd) const;
+
+        /**
+         * Get the IFD for the first plane of a channel.
+         *
+         * The reader lock must be held by the caller.
+         *
+         * @param channel the channel index within the current series.
+         * @returns the IFD.
+         */
+        const ome::compat::shared_ptr<const tiff::IFD>
+        channelIFD(dimension_size_type channel) const;
+
+        /**
+         * Check if a path exists, using the path cache.
+         *
+         * @param file the path to check.
+         * @returns @c true if the path exists, @c false otherwise.
+         */
+        bool
+        cachedExists(const boost::filesystem::path& file);
+
+        /**
+         * Get the canonical form of a path, using the path cache.
+         *
+         * @param file the path to canonicalize.
+         * @param base the base directory for relative paths.
+         * @returns the canonical path.
+         * @throws boost::filesystem::filesystem_error if the path
+         * could not be canonicalized.
+         */
+        boost::filesystem::path
+        cachedCanonical(const boost::filesystem::path& file,
+                        const boost::filesystem::path& base);
+
+      protected:
+        /**
+         * Get OME-XML metadata from OME-XML text.
+         *
+         * Previously parsed metadata for identical text is reused if
+         * available.
+         *
+         * @param text the OME-XML text.
+         * @param take @c true to remove the metadata from the cache
+         * (because the caller will modify it), or @c false to cache
+         * the metadata for later reuse.
+         * @returns the OME-XML metadata.
+         */
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+        readMetadata(const std::string& text,
+                     bool               take) const;
+
+        /**
+         * Get OME-XML metadata from an OME-XML file.
+         *
+         * Previously parsed metadata for the same unmodified file is
+         * reused if available.
+         *
+         * @param file the OME-XML file.
+         * @param take @c true to remove the metadata from the cache
+         * (because the caller will modify it), or @c false to cache
+         * the metadata for later reuse.
+         * @returns the OME-XML metadata.
+         */
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+        readMetadata(const boost::filesystem::path& file,
+                     bool                           take) const;
+
+      private:
+        /**
+         * Get cached OME-XML metadata.
+         *
+         * @param type the source type.
+         * @param source the source (text or file details).
+         * @param take @c true to remove the metadata from the cache.
+         * @returns the OME-XML metadata, or null if not cached.
+         */
+        ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+        findMetadata(const std::string& type,
+                     const std::string& source,
+                     bool               take) const;
+
+        /**
+         * Cache OME-XML metadata.
+         *
+         * The oldest entries are discarded if the cache is full.
+         *
+         * @param key the cache key.
+         * @param meta the OME-XML metadata.
+         */
+        void
+        cacheMetadata(const metadata_key&                                             key,
+                      const ome::compat::shared_ptr<ome::xml::meta::OMEXMLMetadata>& meta) const;
+
         /**
          * Get UUID to file associations and used files.
          *
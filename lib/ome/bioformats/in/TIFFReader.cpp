@@ -35,10 +35,16 @@
  * #L%
  */
 
+#include <stdexcept>
+
+#include <boost/format.hpp>
 #include <boost/range/size.hpp>
 
 #include <ome/bioformats/FormatException.h>
+#include <ome/bioformats/PixelProperties.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
 #include <ome/bioformats/in/TIFFReader.h>
+#include <ome/bioformats/tiff/Exception.h>
 #include <ome/bioformats/tiff/IFD.h>
 #include <ome/bioformats/tiff/TIFF.h>
 #include <ome/bioformats/tiff/Tags.h>
@@ -80,10 +86,30 @@ namespace ome
         std::vector<boost::filesystem::path> companion_suffixes(companion_suffixes_array,
                                                                 companion_suffixes_array + boost::size(companion_suffixes_array));
 
+        // Byteswap all pixels in a buffer.
+        struct ByteSwapVisitor : public boost::static_visitor<>
+        {
+          template<typename T>
+          void
+          operator()(T& v)
+          {
+            typename T::element_type::value_type *data = v->data();
+            typename T::element_type::size_type num_elements = v->num_elements();
+            for (typename T::element_type::size_type i = 0; i < num_elements; ++i)
+              byteswap(data[i]);
+          }
+        };
+
       }
 
       TIFFReader::TIFFReader():
-        MinimalTIFFReader(props)
+        MinimalTIFFReader(props),
+        logger(ome::common::createLogger("TIFFReader")),
+        ijmeta(),
+        ijOffset(0U),
+        ijPlaneSize(0U),
+        ijByteSwapped(false),
+        ijStream()
       {
       }
 
@@ -101,7 +127,17 @@ namespace ome
       void
       TIFFReader::close(bool fileOnly)
       {
+        stopPrefetch();
+
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
         ijmeta = boost::none;
+        ijOffset = 0U;
+        ijPlaneSize = 0U;
+        ijByteSwapped = false;
+        if (ijStream.is_open())
+          ijStream.close();
+        ijStream.clear();
 
         MinimalTIFFReader::close(fileOnly);
       }
@@ -117,56 +153,89 @@ namespace ome
 
             try
               {
-                tiff::ImageJMetadata ijmeta(*ifd0);
+                tiff::ImageJMetadata meta(*ifd0);
+
+                if (meta.map.find("ImageJ") == meta.map.end())
+                  throw std::runtime_error("Not an ImageJ TIFF");
 
                 ome::compat::shared_ptr<CoreMetadata> ijm(tiff::makeCoreMetadata(*ifd0));
 
-                ijm->sizeZ = ijmeta.slices;
-                ijm->sizeT = ijmeta.frames;
+                const dimension_size_type samples = ijm->sizeC.at(0);
+                ijm->sizeZ = meta.slices;
+                ijm->sizeT = meta.frames;
                 ijm->sizeC.clear();
-                for (dimension_size_type c = 0; c < ijmeta.channels; ++c)
-                  ijm->sizeC.push_back(1U);
-
-                core.clear();
-                core.push_back(ijm);
+                for (dimension_size_type c = 0; c < meta.channels; ++c)
+                  ijm->sizeC.push_back(samples);
+                ijm->imageCount = meta.images;
 
-                dimension_size_type images = 0;
-                for (TIFF::const_iterator i = tiff->begin();
-                     i != tiff->end();
-                     ++i, ++images)
+                if (meta.slices * meta.frames * meta.channels != meta.images)
                   {
-                    if (imagej_metadata)
-                      {
-                        // Verify metadata is consistent
+                    BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
+                      << "ImageJ TIFF metadata dimensions are inconsistent with image count; treating as a plain TIFF";
+                    imagej_metadata = false;
+                  }
+                else if (!findContiguousPlanes(*ifd0, meta.images))
+                  {
+                    // Not contiguous; all IFDs must be read.
+                    std::string desc0;
+                    ifd0->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(desc0);
 
+                    dimension_size_type images = 0;
+                    for (TIFF::const_iterator i = tiff->begin();
+                         i != tiff->end();
+                         ++i, ++images)
+                      {
+                        // Verify metadata is consistent.  Only
+                        // parse the description if it differs from
+                        // the first IFD.
                         std::string desc;
                         (*i)->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(desc);
-                        std::map<std::string,std::string> imap(tiff::ImageJMetadata::parse_imagedescription(desc));
 
-                        if (imap != ijmeta.map)
+                        if (desc != desc0 &&
+                            tiff::ImageJMetadata::parse_imagedescription(desc) != meta.map)
                           {
-                            std::cerr << "ImageJ TIFF metadata is inconsistent; treating as a plain TIFF";
+                            BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
+                              << "ImageJ TIFF metadata is inconsistent; treating as a plain TIFF";
                             imagej_metadata = false;
                             break;
                           }
                       }
+
+                    if (imagej_metadata && images != meta.images)
+                      {
+                        BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
+                          << "ImageJ TIFF metadata is inconsistent with TIFF image count; treating as a plain TIFF";
+                        imagej_metadata = false;
+                      }
                   }
 
-                if (images != ijmeta.images)
+                if (imagej_metadata)
                   {
-                    std::cerr << "ImageJ TIFF metadata is inconsistent with TIFF image count; treating as a plain TIFF";
-                    imagej_metadata = false;
+                    core.clear();
+                    core.push_back(ijm);
+
+                    seriesIFDRange.clear();
+                    tiff::IFDRange range;
+                    range.filename = *currentId;
+                    range.begin = 0U;
+                    range.end = meta.images;
+                    seriesIFDRange.push_back(range);
+
+                    this->ijmeta = meta;
                   }
               }
             catch (const std::exception& e)
               {
                 // Catch all TIFF exceptions and parse failures.
                 imagej_metadata = false;
-                core.clear();
               }
 
-            if (imagej_metadata)
-              this->ijmeta = ijmeta;
+            if (!imagej_metadata)
+              {
+                ijOffset = 0U;
+                ijPlaneSize = 0U;
+                ijByteSwapped = false;
+              }
           }
 
         // If a plain TIFF, read metadata from IFDs.
@@ -174,6 +243,185 @@ namespace ome
           MinimalTIFFReader::readIFDs();
       }
 
+      bool
+      TIFFReader::findContiguousPlanes(const tiff::IFD&    ifd0,
+                                       dimension_size_type images)
+      {
+        ijOffset = 0U;
+        ijPlaneSize = 0U;
+        ijByteSwapped = false;
+
+        if (images < 2U)
+          return false;
+
+        // Uncompressed strips only.
+        tiff::Compression compression = tiff::COMPRESSION_NONE;
+        try
+          {
+            ifd0.getField(tiff::COMPRESSION).get(compression);
+          }
+        catch (const tiff::Exception&)
+          {
+          }
+        if (compression != tiff::COMPRESSION_NONE ||
+            ifd0.getTileType() != tiff::STRIP)
+          return false;
+
+        // Whole-byte samples only, contiguous if multiple samples.
+        const ome::xml::model::enums::PixelType pixeltype(ifd0.getPixelType());
+        if (pixeltype == ome::xml::model::enums::PixelType::BIT)
+          return false;
+        const dimension_size_type bpp = bytesPerPixel(pixeltype);
+        const dimension_size_type samples = ifd0.getSamplesPerPixel();
+        if (ifd0.getBitsPerSample() != bpp * 8U ||
+            (samples > 1U && ifd0.getPlanarConfiguration() != tiff::CONTIG))
+          return false;
+
+        tiff::FillOrder fillorder = tiff::MSB_TO_LSB;
+        try
+          {
+            ifd0.getField(tiff::FILLORDER).get(fillorder);
+          }
+        catch (const tiff::Exception&)
+          {
+          }
+        if (fillorder != tiff::MSB_TO_LSB)
+          return false;
+
+        const dimension_size_type planeSize = ifd0.getImageWidth() * ifd0.getImageHeight() * samples * bpp;
+
+        // All strips must be contiguous.
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> counts;
+        ifd0.getField(tiff::STRIPOFFSETS).get(offsets);
+        ifd0.getField(tiff::STRIPBYTECOUNTS).get(counts);
+        if (offsets.empty() || offsets.size() != counts.size())
+          return false;
+
+        tiff::offset_type end = offsets.front();
+        for (std::vector<uint64_t>::size_type i = 0; i < offsets.size(); ++i)
+          {
+            if (offsets[i] != end)
+              return false;
+            end += counts[i];
+          }
+        if (end - offsets.front() != planeSize)
+          return false;
+
+        // The file must contain all planes.
+        const tiff::offset_type offset = offsets.front();
+        if (boost::filesystem::file_size(*currentId) < offset + (images * planeSize))
+          return false;
+
+        // If present, the second IFD must directly follow the first.
+        TIFF::const_iterator i = tiff->begin();
+        if (++i != tiff->end())
+          {
+            std::vector<uint64_t> next;
+            (*i)->getField(tiff::STRIPOFFSETS).get(next);
+            if (next.empty() || next.front() != offset + planeSize)
+              return false;
+          }
+
+        // Data byte order from file header.
+        ijStream.close();
+        ijStream.clear();
+        ijStream.open(*currentId, std::ios::in | std::ios::binary);
+        char order[2];
+        if (!ijStream.read(order, 2))
+          return false;
+        bool bigEndian;
+        if (order[0] == 'M' && order[1] == 'M')
+          bigEndian = true;
+        else if (order[0] == 'I' && order[1] == 'I')
+          bigEndian = false;
+        else
+          return false;
+
+        ijOffset = offset;
+        ijPlaneSize = planeSize;
+#ifdef BOOST_BIG_ENDIAN
+        ijByteSwapped = !bigEndian;
+#else // ! BOOST_BIG_ENDIAN
+        ijByteSwapped = bigEndian;
+#endif // BOOST_BIG_ENDIAN
+
+        return true;
+      }
+
+      void
+      TIFFReader::getLookupTable(dimension_size_type plane,
+                                 VariantPixelBuffer& buf) const
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(mutex);
+
+        if (!ijOffset)
+          {
+            MinimalTIFFReader::getLookupTable(plane, buf);
+            return;
+          }
+
+        assertId(currentId, true);
+
+        // All contiguous planes share the first IFD.
+        const ome::compat::shared_ptr<const IFD> ifd(tiff->getDirectoryByIndex(0));
+
+        try
+          {
+            ifd->readLookupTable(buf);
+          }
+        catch (const std::exception& e)
+          {
+            boost::format fmt("Failed to get lookup table: %1%");
+            fmt % e.what();
+            throw FormatException(fmt.str());
+          }
+      }
+
+      void
+      TIFFReader::openBytesImpl(dimension_size_type plane,
+                                VariantPixelBuffer& buf,
+                                dimension_size_type x,
+                                dimension_size_type y,
+                                dimension_size_type w,
+                                dimension_size_type h) const
+      {
+        if (!ijOffset)
+          {
+            MinimalTIFFReader::openBytesImpl(plane, buf, x, y, w, h);
+            return;
+          }
+
+        assertId(currentId, true);
+
+        // Read directly from the computed plane offset.
+        if (!ijStream.is_open())
+          ijStream.open(*currentId, std::ios::in | std::ios::binary);
+        ijStream.clear();
+        ijStream.seekg(static_cast<std::istream::off_type>(ijOffset + (plane * ijPlaneSize)),
+                       std::ios::beg);
+
+        readPlane(ijStream, buf, x, y, w, h, getRGBChannelCount(0));
+
+        if (ijByteSwapped)
+          {
+            ByteSwapVisitor v;
+            boost::apply_visitor(v, buf.vbuffer());
+          }
+      }
+
+      void
+      TIFFReader::openRegionsImpl(dimension_size_type              plane,
+                                  std::vector<VariantPixelBuffer>& bufs,
+                                  const std::vector<PlaneRegion>&  regions) const
+      {
+        // Contiguous planes are not tiled; read each region directly.
+        if (ijOffset)
+          detail::FormatReader::openRegionsImpl(plane, bufs, regions);
+        else
+          MinimalTIFFReader::openRegionsImpl(plane, bufs, regions);
+      }
+
     }
   }
 }
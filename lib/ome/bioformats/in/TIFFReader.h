@@ -38,8 +38,13 @@
 #ifndef OME_BIOFORMATS_IN_TIFFREADER_H
 #define OME_BIOFORMATS_IN_TIFFREADER_H
 
+#include <boost/filesystem/fstream.hpp>
+
 #include <ome/bioformats/in/MinimalTIFFReader.h>
 #include <ome/bioformats/tiff/ImageJMetadata.h>
+#include <ome/bioformats/tiff/Types.h>
+
+#include <ome/common/log.h>
 
 namespace ome
 {
@@ -50,13 +55,35 @@ namespace ome
 
       /**
        * TIFF reader with support for ImageJ extensions.
+       *
+       * ImageJ hyperstacks which are uncompressed and store all
+       * planes contiguously following the first plane (including
+       * stacks larger than 4 GiB, for which only the first IFD is
+       * valid) are read directly from the computed plane offsets,
+       * without reading the remaining IFDs.
        */
       class TIFFReader : public MinimalTIFFReader
       {
       protected:
+        /// Message logger.
+        ome::common::Logger logger;
+
         /// ImageJ metadata.
         boost::optional<tiff::ImageJMetadata> ijmeta;
 
+        /// Offset of the first contiguous ImageJ plane (zero if not contiguous).
+        tiff::offset_type ijOffset;
+
+        /// Size of each contiguous ImageJ plane, in bytes.
+        dimension_size_type ijPlaneSize;
+
+        /// Contiguous ImageJ plane data is not in native byte order.
+        bool ijByteSwapped;
+
+        // Mutable to allow reading when const.
+        /// Stream for reading contiguous ImageJ planes.
+        mutable boost::filesystem::ifstream ijStream;
+
       public:
         /// Constructor.
         TIFFReader();
@@ -70,10 +97,48 @@ namespace ome
         void
         readIFDs();
 
+        /**
+         * Check if ImageJ planes may be read directly.
+         *
+         * The planes must be uncompressed, with whole-byte samples,
+         * and stored contiguously starting with the pixel data of
+         * the first IFD.  If so, @c ijOffset, @c ijPlaneSize and @c
+         * ijByteSwapped are set.
+         *
+         * @param ifd0 the first IFD.
+         * @param images the number of ImageJ planes.
+         * @returns @c true if the planes are contiguous, @c false
+         * otherwise.
+         */
+        bool
+        findContiguousPlanes(const tiff::IFD&    ifd0,
+                             dimension_size_type images);
+
       public:
         // Documented in superclass.
         void
         close(bool fileOnly = false);
+
+        // Documented in superclass.
+        void
+        getLookupTable(dimension_size_type plane,
+                       VariantPixelBuffer& buf) const;
+
+      protected:
+        // Documented in superclass.
+        void
+        openBytesImpl(dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      dimension_size_type x,
+                      dimension_size_type y,
+                      dimension_size_type w,
+                      dimension_size_type h) const;
+
+        // Documented in superclass.
+        void
+        openRegionsImpl(dimension_size_type              plane,
+                        std::vector<VariantPixelBuffer>& bufs,
+                        const std::vector<PlaneRegion>&  regions) const;
       };
 
     }
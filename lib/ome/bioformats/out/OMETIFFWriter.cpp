@@ -35,12 +35,18 @@
  * #L%
  */
 
+#include <algorithm>
 #include <cassert>
+#include <deque>
+#include <sstream>
+#include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/range/size.hpp>
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/thread.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/uuid_generators.hpp>
@@ -124,6 +130,127 @@ namespace ome
 
         const std::string default_description("OME-TIFF");
 
+        /// Maximum number of queued operations per file when writing concurrently.
+        const std::size_t concurrent_queue_limit = 8U;
+
+        /// Set up the current IFD for a plane.
+        struct IFDSetup
+        {
+          /// TIFF file to set up.
+          ome::compat::shared_ptr<TIFF> file;
+          /// Image width.
+          dimension_size_type width;
+          /// Image height.
+          dimension_size_type height;
+          /// Pixel type.
+          PixelType pixeltype;
+          /// Samples per pixel.
+          dimension_size_type samples;
+          /// Planar configuration.
+          tiff::PlanarConfiguration planarconfig;
+          /// Photometric interpretation.
+          tiff::PhotometricInterpretation photometric;
+          /// Set the default image description.
+          bool description;
+
+          /// Apply the settings to the current IFD.
+          void
+          operator()() const
+          {
+            ome::compat::shared_ptr<IFD> ifd (file->getCurrentDirectory());
+
+            // Default to single strips for now.
+            ifd->setImageWidth(width);
+            ifd->setImageHeight(height);
+
+            ifd->setTileType(tiff::STRIP);
+            ifd->setTileWidth(width);
+            ifd->setTileHeight(1U);
+
+            ifd->setPixelType(pixeltype);
+            ifd->setBitsPerSample(bitsPerPixel(pixeltype));
+            ifd->setSamplesPerPixel(samples);
+            ifd->setPlanarConfiguration(planarconfig);
+            ifd->setPhotometricInterpretation(photometric);
+
+            if (description)
+              ifd->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).set(default_description);
+          }
+        };
+
+        /// Write the current IFD.
+        struct DirectoryWrite
+        {
+          /// TIFF file to write.
+          ome::compat::shared_ptr<TIFF> file;
+
+          /**
+           * Constructor.
+           *
+           * @param file the TIFF file to write.
+           */
+          DirectoryWrite(const ome::compat::shared_ptr<TIFF>& file):
+            file(file)
+          {
+          }
+
+          /// Write the directory.
+          void
+          operator()() const
+          {
+            file->writeCurrentDirectory();
+          }
+        };
+
+        /// Write a plane region to the current IFD.
+        struct PlaneWrite
+        {
+          /// TIFF file to write.
+          ome::compat::shared_ptr<TIFF> file;
+          /// Pixel data to write.
+          ome::compat::shared_ptr<const VariantPixelBuffer> buffer;
+          /// Region x start.
+          dimension_size_type x;
+          /// Region y start.
+          dimension_size_type y;
+          /// Region width.
+          dimension_size_type w;
+          /// Region height.
+          dimension_size_type h;
+
+          /**
+           * Constructor.
+           *
+           * @param file the TIFF file to write.
+           * @param buffer the pixel data to write.
+           * @param x the @c X coordinate of the upper-left corner of the region.
+           * @param y the @c Y coordinate of the upper-left corner of the region.
+           * @param w the width of the region.
+           * @param h the height of the region.
+           */
+          PlaneWrite(const ome::compat::shared_ptr<TIFF>&                     file,
+                     const ome::compat::shared_ptr<const VariantPixelBuffer>& buffer,
+                     dimension_size_type                                      x,
+                     dimension_size_type                                      y,
+                     dimension_size_type                                      w,
+                     dimension_size_type                                      h):
+            file(file),
+            buffer(buffer),
+            x(x),
+            y(y),
+            w(w),
+            h(h)
+          {
+          }
+
+          /// Write the region.
+          void
+          operator()() const
+          {
+            file->getCurrentDirectory()->writeImage(*buffer, x, y, w, h);
+          }
+        };
+
         /**
          * @todo Move these stream helpers to a proper location,
          * i.e. to replicate the equivalent Java helpers.
@@ -406,10 +533,167 @@ namespace ome
 
       }
 
+      /**
+       * Background writer for a single TIFF file.
+       *
+       * Operations are queued with submit() and run in order on a
+       * dedicated thread.  The queue length is bounded, so that a
+       * fast producer can not exhaust memory with copies of pending
+       * plane data.  The first failure is retained; subsequent
+       * operations are discarded and the error is rethrown to the
+       * caller by submit() or finish().
+       */
+      class OMETIFFWriter::FileWorker
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param id the TIFF file being written.
+         */
+        FileWorker(const path& id):
+          id(id),
+          mutex(),
+          cond(),
+          tasks(),
+          stop(false),
+          error(),
+          thread(boost::bind(&FileWorker::run, this))
+        {
+        }
+
+        /// Destructor.
+        ~FileWorker()
+        {
+          shutdown();
+        }
+
+        /**
+         * Queue an operation.
+         *
+         * Blocks while the queue is full.
+         *
+         * @param task the operation to run.
+         * @throws FormatException if a previous operation failed.
+         */
+        void
+        submit(const boost::function<void ()>& task)
+        {
+          boost::unique_lock<boost::mutex> lock(mutex);
+          while (tasks.size() >= concurrent_queue_limit && error.empty())
+            cond.wait(lock);
+          check();
+          tasks.push_back(task);
+          lock.unlock();
+          cond.notify_all();
+        }
+
+        /**
+         * Run all queued operations and stop the thread.
+         *
+         * @throws FormatException if any operation failed.
+         */
+        void
+        finish()
+        {
+          shutdown();
+          boost::lock_guard<boost::mutex> lock(mutex);
+          check();
+        }
+
+      private:
+        /// Stop the thread once the queue is empty.
+        void
+        shutdown()
+        {
+          {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            stop = true;
+          }
+          cond.notify_all();
+          if (thread.joinable())
+            thread.join();
+        }
+
+        /// Throw any saved error; the mutex must be held.
+        void
+        check() const
+        {
+          if (!error.empty())
+            {
+              boost::format fmt("Failed to write %1%: %2%");
+              fmt % id.string() % error;
+              throw FormatException(fmt.str());
+            }
+        }
+
+        /// Thread main loop.
+        void
+        run()
+        {
+          for (;;)
+            {
+              boost::function<void ()> task;
+              {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (tasks.empty() && !stop)
+                  cond.wait(lock);
+                if (tasks.empty())
+                  break;
+                task = tasks.front();
+                tasks.pop_front();
+              }
+              cond.notify_all();
+
+              std::string failure;
+              try
+                {
+                  task();
+                }
+              catch (const std::exception& e)
+                {
+                  failure = e.what();
+                }
+              catch (...)
+                {
+                  failure = "Unknown error";
+                }
+
+              if (!failure.empty())
+                {
+                  {
+                    boost::lock_guard<boost::mutex> lock(mutex);
+                    if (error.empty())
+                      error = failure;
+                    tasks.clear();
+                  }
+                  cond.notify_all();
+                }
+            }
+        }
+
+        /// TIFF file being written.
+        path id;
+        /// Mutex protecting the queue and error state.
+        boost::mutex mutex;
+        /// Queue state change notification.
+        boost::condition_variable cond;
+        /// Queued operations.
+        std::deque<boost::function<void ()> > tasks;
+        /// Stop once the queue is empty.
+        bool stop;
+        /// First error message.
+        std::string error;
+        /// Writer thread (started last, once all other members are constructed).
+        boost::thread thread;
+      };
+
       OMETIFFWriter::TIFFState::TIFFState(ome::compat::shared_ptr<ome::bioformats::tiff::TIFF>& tiff):
         uuid(boost::uuids::to_string(boost::uuids::random_generator()())),
         tiff(tiff),
-        ifdCount(0U)
+        ifdCount(0U),
+        pending(),
+        worker()
       {
       }
 
@@ -427,7 +711,8 @@ namespace ome
         seriesState(),
         originalMetadataRetrieve(),
         omeMeta(),
-        bigTIFF(boost::none)
+        bigTIFF(boost::none),
+        concurrent(false)
       {
       }
 
@@ -528,6 +813,8 @@ namespace ome
               tiffs.insert(tiff_map::value_type(*currentId, TIFFState(tiff)));
             if (result.second) // should always be true
               currentTIFF = result.first;
+            if (concurrent)
+              currentTIFF->second.worker = ome::compat::make_shared<FileWorker>(canonicalpath);
             detail::FormatWriter::setId(id);
             setupIFD();
           }
@@ -535,6 +822,8 @@ namespace ome
           {
             detail::FormatWriter::setId(i->first);
             currentTIFF = i;
+            // The current IFD of this file may hold a different plane.
+            changeIFD();
           }
       }
 
@@ -545,30 +834,48 @@ namespace ome
           {
             if (currentId)
               {
-                // Flush last IFD if unwritten.
+                // Flush last IFD of each file if unwritten.
                 if(currentTIFF != tiffs.end())
                   {
-                    nextIFD();
+                    for (tiff_map::iterator t = tiffs.begin();
+                         t != tiffs.end();
+                         ++t)
+                      {
+                        if (t->second.pending || t->second.ifdCount == 0U)
+                          {
+                            currentTIFF = t;
+                            nextIFD();
+                          }
+                      }
                     currentTIFF = tiffs.end();
                   }
 
+                // Wait for any concurrent writes to complete.
+                for (tiff_map::iterator t = tiffs.begin();
+                     t != tiffs.end();
+                     ++t)
+                  {
+                    if (t->second.worker)
+                      {
+                        ome::compat::shared_ptr<FileWorker> worker(t->second.worker);
+                        t->second.worker.reset();
+                        worker->finish();
+                      }
+                  }
+
                 // Remove any BinData elements.
                 removeBinData(*omeMeta);
                 // Create UUID and TiffData elements for each series.
                 fillMetadata();
 
+                // Make sure files are closed before we modify them outside libtiff.
                 for (tiff_map::const_iterator t = tiffs.begin();
                      t != tiffs.end();
                      ++t)
-                  {
-                    // Get OME-XML for this TIFF file.
-                    std::string xml = getOMEXML(t->first);
-                    // Make sure file is closed before we modify it outside libtiff.
-                    t->second.tiff->close();
+                  t->second.tiff->close();
 
-                    // Save OME-XML in the TIFF.
-                    saveComment(t->first, xml);
-                  }
+                // Save OME-XML in the TIFFs.
+                saveComments();
               }
 
             // Close any open TIFFs.
@@ -585,12 +892,18 @@ namespace ome
             originalMetadataRetrieve.reset();
             omeMeta.reset();
             bigTIFF = boost::none;
+            concurrent = false;
 
             ome::bioformats::detail::FormatWriter::close(fileOnly);
           }
         catch (const std::exception&)
           {
             currentTIFF = tiffs.end(); // Ensure we only flush the last IFD once.
+            // Stop any remaining writer threads.
+            for (tiff_map::iterator t = tiffs.begin();
+                 t != tiffs.end();
+                 ++t)
+              t->second.worker.reset();
             ome::bioformats::detail::FormatWriter::close(fileOnly);
             throw;
           }
@@ -600,73 +913,119 @@ namespace ome
       OMETIFFWriter::setSeries(dimension_size_type series) const
       {
         const dimension_size_type currentSeries = getSeries();
-        detail::FormatWriter::setSeries(series);
 
-        if (currentSeries != series)
+        if (getWriteSequentially())
+          detail::FormatWriter::setSeries(series);
+        else
           {
-            nextIFD();
-            setupIFD();
+            // Any order is permitted; IFDs are allocated as planes
+            // are written.
+            if (series >= getSeriesCount())
+              {
+                boost::format fmt("Invalid series: %1%");
+                fmt % series;
+                throw std::logic_error(fmt.str());
+              }
+
+            this->series = series;
+            this->plane = 0U;
           }
+
+        if (currentSeries != series)
+          changeIFD();
       }
 
       void
       OMETIFFWriter::setPlane(dimension_size_type plane) const
       {
         const dimension_size_type currentPlane = getPlane();
-        detail::FormatWriter::setPlane(plane);
 
-        if (currentPlane != plane)
+        if (getWriteSequentially())
+          detail::FormatWriter::setPlane(plane);
+        else
           {
-            nextIFD();
-            setupIFD();
+            // Any order is permitted; IFDs are allocated as planes
+            // are written.
+            if (plane >= getImageCount())
+              {
+                boost::format fmt("Invalid plane: %1%");
+                fmt % plane;
+                throw std::logic_error(fmt.str());
+              }
+
+            this->plane = plane;
           }
+
+        if (currentPlane != plane)
+          changeIFD();
       }
 
       void
       OMETIFFWriter::nextIFD() const
       {
-        currentTIFF->second.tiff->writeCurrentDirectory();
+        submit(currentTIFF->second, DirectoryWrite(currentTIFF->second.tiff));
         ++currentTIFF->second.ifdCount;
+        currentTIFF->second.pending = boost::none;
       }
 
       void
-      OMETIFFWriter::setupIFD() const
+      OMETIFFWriter::changeIFD() const
       {
-        // Get current IFD.
-        ome::compat::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
+        TIFFState& state(currentTIFF->second);
 
-        // Default to single strips for now.
-        ifd->setImageWidth(getSizeX());
-        ifd->setImageHeight(getSizeY());
+        if (state.pending)
+          {
+            // Continue writing the plane in the current IFD.
+            if (*state.pending == std::make_pair(getSeries(), getPlane()))
+              return;
+
+            nextIFD();
+          }
 
-        ifd->setTileType(tiff::STRIP);
-        ifd->setTileWidth(getSizeX());
-        ifd->setTileHeight(1U);
+        setupIFD();
+      }
 
+      void
+      OMETIFFWriter::setupIFD() const
+      {
         ome::compat::array<dimension_size_type, 3> coords = getZCTCoords(getPlane());
 
         dimension_size_type channel = coords[1];
 
-        ifd->setPixelType(getPixelType());
-        ifd->setBitsPerSample(bitsPerPixel(getPixelType()));
-        ifd->setSamplesPerPixel(getRGBChannelCount(channel));
+        IFDSetup setup;
+        setup.file = currentTIFF->second.tiff;
+        setup.width = getSizeX();
+        setup.height = getSizeY();
+        setup.pixeltype = getPixelType();
+        setup.samples = getRGBChannelCount(channel);
 
         const boost::optional<bool> interleaved(getInterleaved());
         if (isRGB(channel) && interleaved && *interleaved)
-          ifd->setPlanarConfiguration(tiff::CONTIG);
+          setup.planarconfig = tiff::CONTIG;
         else
-          ifd->setPlanarConfiguration(tiff::SEPARATE);
+          setup.planarconfig = tiff::SEPARATE;
 
         // This isn't necessarily always true; we might want to use a
         // photometric interpretation other than RGB with three
         // subchannels.
         if (isRGB(channel) && getRGBChannelCount(channel) == 3)
-          ifd->setPhotometricInterpretation(tiff::RGB);
+          setup.photometric = tiff::RGB;
         else
-          ifd->setPhotometricInterpretation(tiff::MIN_IS_BLACK);
+          setup.photometric = tiff::MIN_IS_BLACK;
+
+        setup.description = (currentTIFF->second.ifdCount == 0);
 
-        if (currentTIFF->second.ifdCount == 0)
-          ifd->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).set(default_description);
+        submit(currentTIFF->second, setup);
+      }
+
+      void
+      OMETIFFWriter::submit(TIFFState&                      state,
+                            const boost::function<void ()>& task) const
+      {
+        if (state.worker)
+          state.worker->submit(task);
+        else
+          task();
       }
 
       void
@@ -679,21 +1038,44 @@ namespace ome
       {
         assertId(currentId, true);
 
-        setPlane(plane);
-
-        // Get current IFD.
-        ome::compat::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
-
         // Get plane metadata.
         detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
 
-        ifd->writeImage(buf, x, y, w, h);
+        // A plane may only be written to while its IFD is current;
+        // once flushed it can not be modified.
+        const TIFFState& state(currentTIFF->second);
+        if (planeMeta.status == detail::OMETIFFPlane::PRESENT &&
+            !(planeMeta.id == currentTIFF->first &&
+              state.pending &&
+              *state.pending == std::make_pair(getSeries(), plane)))
+          {
+            boost::format fmt("Plane %1% of series %2% has already been written");
+            fmt % plane % getSeries();
+            throw FormatException(fmt.str());
+          }
+
+        setPlane(plane);
+
+        if (currentTIFF->second.worker)
+          {
+            // The caller may reuse the buffer, so queue a copy.
+            submit(currentTIFF->second,
+                   PlaneWrite(currentTIFF->second.tiff, buf.clone(), x, y, w, h));
+          }
+        else
+          {
+            // Get current IFD.
+            ome::compat::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
+
+            ifd->writeImage(buf, x, y, w, h);
+          }
 
         // Set plane metadata.
         planeMeta.id = currentTIFF->first;
         planeMeta.ifd = currentTIFF->second.ifdCount;
         planeMeta.certain = true;
         planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+        currentTIFF->second.pending = std::make_pair(getSeries(), plane);
       }
 
       void
@@ -771,54 +1153,48 @@ namespace ome
           }
       }
 
-      std::string
-      OMETIFFWriter::getOMEXML(const boost::filesystem::path& id)
+      void
+      OMETIFFWriter::saveComment(const boost::filesystem::path& id,
+                                 const std::string&             xml,
+                                 std::string::size_type         uuidOffset,
+                                 std::string::size_type         uuidSize,
+                                 const std::string&             uuid)
       {
-        tiff_map::const_iterator t = tiffs.find(id);
-
-        if (t == tiffs.end())
+        // Open TIFF as a raw stream.
+        boost::iostreams::stream<boost::iostreams::file_descriptor> io(id);
+        io.imbue(std::locale::classic());
+
+        // Read the header (up to the IFD 0 offset for BigTIFF).
+        std::string headerdata(16U, '\0');
+        io.read(&headerdata[0], static_cast<std::streamsize>(headerdata.size()));
+        headerdata.resize(io.gcount() > 0 ? static_cast<std::string::size_type>(io.gcount()) : 0U);
+        io.clear();
+        if (headerdata.size() < 8U)
           {
             boost::format fmt
-              ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
+              ("%1% is not a valid TIFF file: Truncated header");
             fmt % id;
             throw FormatException(fmt.str());
           }
-
-        path relative(make_relative(baseDir, id));
-        std::string uuid("urn:uuid:");
-        uuid += t->second.uuid;
-        omeMeta->setUUID(uuid);
-
-        return bioformats::getOMEXML(*omeMeta, true);
-      }
-
-      void
-      OMETIFFWriter::saveComment(const boost::filesystem::path& id,
-                                 const std::string&             xml)
-      {
-        // Open TIFF as a raw stream.
-        boost::iostreams::stream<boost::iostreams::file_descriptor> in(id);
-        in.imbue(std::locale::classic());
+        std::istringstream header(headerdata);
+        header.imbue(std::locale::classic());
 
         // Check endianness.
         EndianType endian = ENDIAN_NATIVE;
-        char endianchars[2];
-        in >> endianchars[0] >> endianchars[1];
-
-        if (endianchars[0] == 'I' && endianchars[1] == 'I')
+        if (headerdata[0] == 'I' && headerdata[1] == 'I')
           endian = ENDIAN_LITTLE;
-        else if (endianchars[0] == 'M' && endianchars[1] == 'M')
+        else if (headerdata[0] == 'M' && headerdata[1] == 'M')
           endian = ENDIAN_BIG;
         else
           {
             boost::format fmt
               ("%1% is not a valid TIFF file: Invalid endian header \"%2%%3%\"");
-            fmt % id % endianchars[0] % endianchars[1];
+            fmt % id % headerdata[0] % headerdata[1];
             throw FormatException(fmt.str());
           }
 
         // Check version.
-        uint16_t version = read_raw_uint16(in, endian);
+        uint16_t version = read_raw_uint16(header, 2, endian);
 
         bool bigOffsets;
         if (version == 0x2A)
@@ -834,7 +1210,7 @@ namespace ome
           }
 
         // Check offset size and bail out if unusual.
-        uint16_t offsetSize = bigOffsets ? read_raw_uint16(in, endian) : 4U;
+        uint16_t offsetSize = bigOffsets ? read_raw_uint16(header, 4, endian) : 4U;
         if (offsetSize != 4U && offsetSize != 8U)
           {
             boost::format fmt
@@ -843,29 +1219,39 @@ namespace ome
             throw FormatException(fmt.str());
           }
 
-        // Get offset of IFD 0 for later use.
-        uint64_t ifd0Offset = bigOffsets ? read_raw_uint64(in, 8, endian) : read_raw_uint32(in, 4, endian);
+        // Get offset of IFD 0.
+        uint64_t ifd0Offset = bigOffsets ? read_raw_uint64(header, 8, endian) : read_raw_uint32(header, 4, endian);
+
+        // Read the directory entry count and all IFD 0 entries, each
+        // as a single block.
+        const uint64_t countSize = bigOffsets ? 8U : 2U;
+        const uint64_t entrySize = bigOffsets ? 20U : 12U;
+
+        std::string countdata(static_cast<std::string::size_type>(countSize), '\0');
+        io.seekg(static_cast<std::streamoff>(ifd0Offset), std::ios::beg);
+        io.read(&countdata[0], static_cast<std::streamsize>(countdata.size()));
+        if (!io)
+          throw FormatException("Error reading TIFF IFD 0");
+        std::istringstream countstream(countdata);
+        uint64_t entries = bigOffsets ? read_raw_uint64(countstream, 0, endian) : read_raw_uint16(countstream, 0, endian);
+
+        std::string entrydata(static_cast<std::string::size_type>(entries * entrySize), '\0');
+        if (!entrydata.empty())
+          io.read(&entrydata[0], static_cast<std::streamsize>(entrydata.size()));
+        if (!io)
+          throw FormatException("Error reading TIFF IFD 0 entries");
+        std::istringstream entrystream(entrydata);
 
-        // Append XML text with a NUL terminator at end of file, noting the offset.
-        in.seekp(0, std::ios::end);
-        uint64_t descOffset = in.tellp();
-        in << xml << '\0';
-
-        // Get number of directory entries for IFD 0.
-        uint64_t entries = bigOffsets ? read_raw_uint64(in, ifd0Offset, endian) : read_raw_uint16(in, ifd0Offset, endian);
-
-        // Has ImageDescription been found?
-        bool found = false;
         // Loop over directory entries to find ImageDescription.
+        boost::optional<uint64_t> descEntry;
         for (uint64_t i = 0; i < entries; ++i)
           {
-            const uint64_t tagOff = bigOffsets ? ifd0Offset + 8 + (i * 20) : ifd0Offset + 2 + (i * 12);
-            const uint16_t tagid = read_raw_uint16(in, tagOff + 0, endian);
-            const uint16_t tagtype = read_raw_uint16(in, tagOff + 2, endian);
+            const std::streamoff tagOff = static_cast<std::streamoff>(i * entrySize);
+            const uint16_t tagid = read_raw_uint16(entrystream, tagOff + 0, endian);
+            const uint16_t tagtype = read_raw_uint16(entrystream, tagOff + 2, endian);
 
             if (tagid != TIFFTAG_IMAGEDESCRIPTION)
               continue;
-            found = true;
 
             if (tagtype != TIFF_ASCII)
             {
@@ -875,29 +1261,162 @@ namespace ome
               throw FormatException(fmt.str());
             }
 
-            uint64_t count = bigOffsets ? read_raw_uint64(in, tagOff + 4, endian) : read_raw_uint32(in, tagOff + 4, endian);
+            uint64_t count = bigOffsets ? read_raw_uint64(entrystream, tagOff + 4, endian) : read_raw_uint32(entrystream, tagOff + 4, endian);
             if (count != default_description.size() + 1)
               throw FormatException("TIFF ImageDescription size is incorrect");
 
-            // Overwrite count and offset for the ImageDescription text.
-            if (bigOffsets)
-              {
-                write_raw_uint64(in, tagOff + 4, endian, xml.size() + 1);
-                write_raw_uint64(in, tagOff + 12, endian, descOffset);
-              }
-            else
-              {
-                write_raw_uint32(in, tagOff + 4, endian, xml.size() + 1);
-                write_raw_uint32(in, tagOff + 8, endian, descOffset);
-              }
+            descEntry = ifd0Offset + countSize + (i * entrySize);
+            break;
           }
 
-        if (!found)
+        if (!descEntry)
           throw FormatException("Could not find TIFF ImageDescription tag");
-        if (!in)
+
+        // Append XML text with the UUID of this file and a NUL
+        // terminator at end of file, noting the offset.
+        io.seekp(0, std::ios::end);
+        uint64_t descOffset = static_cast<uint64_t>(static_cast<std::streamoff>(io.tellp()));
+        const std::string::size_type uuidEnd = uuidOffset + uuidSize;
+        io.write(xml.data(), static_cast<std::streamsize>(uuidOffset));
+        io.write(uuid.data(), static_cast<std::streamsize>(uuid.size()));
+        io.write(xml.c_str() + uuidEnd, static_cast<std::streamsize>(xml.size() - uuidEnd + 1));
+        const uint64_t descSize = xml.size() - uuidSize + uuid.size() + 1;
+
+        // Overwrite count and offset for the ImageDescription text in
+        // a single write.
+        std::ostringstream patch;
+        patch.imbue(std::locale::classic());
+        if (bigOffsets)
+          {
+            write_raw_uint64(patch, 0, endian, descSize);
+            write_raw_uint64(patch, 8, endian, descOffset);
+          }
+        else
+          {
+            write_raw_uint32(patch, 0, endian, static_cast<uint32_t>(descSize));
+            write_raw_uint32(patch, 4, endian, static_cast<uint32_t>(descOffset));
+          }
+        const std::string patchdata(patch.str());
+        io.seekp(static_cast<std::streamoff>(*descEntry + 4U), std::ios::beg);
+        io.write(patchdata.data(), static_cast<std::streamsize>(patchdata.size()));
+
+        io.flush();
+        if (!io)
           throw FormatException("Error writing TIFF ImageDescription tag");
 
-        in.close();
+        io.close();
+      }
+
+      /// Files awaiting OME-XML at close.
+      struct OMETIFFWriter::CommentQueue
+      {
+        /// Files to update.
+        std::vector<path> ids;
+        /// Next file to update.
+        std::vector<path>::const_iterator next;
+        /// OME-XML text, with a placeholder root UUID.
+        std::string xml;
+        /// Offset of the UUID placeholder.
+        std::string::size_type uuidOffset;
+        /// Size of the UUID placeholder.
+        std::string::size_type uuidSize;
+        /// Mutex protecting the queue and error state.
+        boost::mutex mutex;
+        /// First error message.
+        std::string error;
+      };
+
+      void
+      OMETIFFWriter::saveComments()
+      {
+        CommentQueue queue;
+        for (tiff_map::const_iterator t = tiffs.begin();
+             t != tiffs.end();
+             ++t)
+          queue.ids.push_back(t->first);
+        queue.next = queue.ids.begin();
+
+        // Serialize the OME-XML once.  A random placeholder UUID is
+        // set for the root element; it can't occur elsewhere in the
+        // document, and is replaced with the UUID of each file as it
+        // is written.
+        std::string placeholder("urn:uuid:");
+        placeholder += boost::uuids::to_string(boost::uuids::random_generator()());
+        omeMeta->setUUID(placeholder);
+        queue.xml = bioformats::getOMEXML(*omeMeta, true);
+        queue.uuidOffset = queue.xml.find(placeholder);
+        queue.uuidSize = placeholder.size();
+        if (queue.uuidOffset == std::string::npos)
+          throw FormatException("Inconsistent writer state: OME-XML root UUID not found");
+
+        // Don't leave the placeholder in the metadata, which may be
+        // retained by the caller.  As when the text was serialized
+        // for each file in turn, the root UUID is that of the last
+        // file.
+        if (!tiffs.empty())
+          {
+            std::string uuid("urn:uuid:");
+            uuid += tiffs.rbegin()->second.uuid;
+            omeMeta->setUUID(uuid);
+          }
+
+        // Each file is independent, so update them in parallel.
+        const dimension_size_type threads =
+          std::min(static_cast<dimension_size_type>(queue.ids.size()),
+                   static_cast<dimension_size_type>(boost::thread::hardware_concurrency()));
+
+        if (threads > 1U)
+          {
+            boost::thread_group group;
+            for (dimension_size_type i = 0U; i < threads; ++i)
+              group.create_thread(boost::bind(&OMETIFFWriter::saveCommentTask, this, boost::ref(queue)));
+            group.join_all();
+          }
+        else
+          saveCommentTask(queue);
+
+        if (!queue.error.empty())
+          throw FormatException(queue.error);
+      }
+
+      void
+      OMETIFFWriter::saveCommentTask(CommentQueue& queue)
+      {
+        for (;;)
+          {
+            path id;
+
+            try
+              {
+                {
+                  boost::lock_guard<boost::mutex> lock(queue.mutex);
+                  if (queue.next == queue.ids.end() || !queue.error.empty())
+                    break;
+                  id = *queue.next++;
+                }
+
+                tiff_map::const_iterator t = tiffs.find(id);
+                if (t == tiffs.end())
+                  {
+                    boost::format fmt
+                      ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
+                    fmt % id;
+                    throw FormatException(fmt.str());
+                  }
+
+                std::string uuid("urn:uuid:");
+                uuid += t->second.uuid;
+
+                saveComment(id, queue.xml, queue.uuidOffset, queue.uuidSize, uuid);
+              }
+            catch (const std::exception& e)
+              {
+                boost::lock_guard<boost::mutex> lock(queue.mutex);
+                if (queue.error.empty())
+                  queue.error = e.what();
+                break;
+              }
+          }
       }
 
       void
@@ -912,6 +1431,18 @@ namespace ome
         return bigTIFF;
       }
 
+      void
+      OMETIFFWriter::setConcurrentWrite(bool concurrent)
+      {
+        this->concurrent = concurrent;
+      }
+
+      bool
+      OMETIFFWriter::getConcurrentWrite() const
+      {
+        return concurrent;
+      }
+
     }
   }
 }
@@ -38,6 +38,11 @@
 #ifndef OME_BIOFORMATS_OUT_OMETIFFWRITER_H
 #define OME_BIOFORMATS_OUT_OMETIFFWRITER_H
 
+#include <utility>
+
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+
 #include <ome/bioformats/detail/FormatWriter.h>
 #include <ome/bioformats/detail/OMETIFF.h>
 
@@ -73,6 +78,12 @@ namespace ome
         /// Map filename to UUID.
         typedef std::map<boost::filesystem::path, std::string> file_uuid_map;
 
+        /// Background writer for a single TIFF file.
+        class FileWorker;
+
+        /// Files awaiting OME-XML at close.
+        struct CommentQueue;
+
         // In the Java reader, this is uuids + ifdCounts
         /// State of TIFF file.
         struct TIFFState
@@ -83,6 +94,10 @@ namespace ome
           ome::compat::shared_ptr<ome::bioformats::tiff::TIFF> tiff;
           /// Number of IFDs written.
           dimension_size_type ifdCount;
+          /// Series and plane contained in the current IFD, if it holds unflushed pixel data.
+          boost::optional<std::pair<dimension_size_type, dimension_size_type> > pending;
+          /// Background writer (if writing concurrently).
+          ome::compat::shared_ptr<FileWorker> worker;
 
           /**
            * Constructor.
@@ -146,6 +161,9 @@ namespace ome
         /// Write a Big TIFF
         boost::optional<bool> bigTIFF;
 
+        /// Write each file on a separate thread.
+        bool concurrent;
+
       public:
         /// Constructor.
         OMETIFFWriter();
@@ -164,11 +182,29 @@ namespace ome
 
         using FormatWriter::saveBytes;
 
-        // Documented in superclass.
+        /**
+         * Set the active series.
+         *
+         * Unlike other writers, series may be activated in any order
+         * unless writing sequentially.
+         *
+         * @param series the series to activate.
+         * @throws std::logic_error if the series is invalid, or is
+         * out of order when writing sequentially.
+         */
         void
         setSeries(dimension_size_type series) const;
 
-        // Documented in superclass.
+        /**
+         * Set the active plane.
+         *
+         * Unlike other writers, planes may be activated in any order
+         * unless writing sequentially.
+         *
+         * @param plane the plane to activate.
+         * @throws std::logic_error if the plane is invalid, or is out
+         * of order when writing sequentially.
+         */
         void
         setPlane(dimension_size_type plane) const;
 
@@ -181,6 +217,35 @@ namespace ome
         void
         setupIFD() const;
 
+        /**
+         * Switch to the IFD for the current series and plane.
+         *
+         * If the current IFD contains pixel data for a different
+         * plane, it is flushed and a new IFD is set up.  Planes may
+         * therefore be written in any order; each plane is stored in
+         * the next free IFD and the TiffData IFD index is recorded
+         * when the plane is saved.
+         */
+        void
+        changeIFD() const;
+
+        /**
+         * Run an operation on a TIFF file.
+         *
+         * If the file has a background writer, the operation is
+         * queued to run on the writer thread, otherwise it is run
+         * immediately.  Operations on the same file are always run in
+         * the order submitted.
+         *
+         * @param state the state of the TIFF file.
+         * @param task the operation to run.
+         * @throws FormatException if a previously queued operation
+         * failed.
+         */
+        void
+        submit(TIFFState&                      state,
+               const boost::function<void ()>& task) const;
+
       public:
         // Documented in superclass.
         void
@@ -201,23 +266,48 @@ namespace ome
         fillMetadata();
 
         /**
-         * Get OME-XML for embedding into the specified TIFF file.
+         * Save OME-XML text in the first IFD of the specified TIFF file.
+         *
+         * The IFD entries are read as a single block, and the text is
+         * appended to the file and referenced from the existing
+         * ImageDescription entry in place; the IFD is not rewritten.
+         *
+         * The OME-XML text is shared between all files, and contains
+         * a placeholder root UUID which is replaced by the UUID of
+         * this file as the text is written.
          *
          * @param id the TIFF in which to embed the OME-XML.
-         * @returns the OME-XML text for embedding.
+         * @param xml the OME-XML text to embed.
+         * @param uuidOffset the offset of the UUID placeholder in @c xml.
+         * @param uuidSize the size of the UUID placeholder.
+         * @param uuid the UUID of this file.
          */
-        std::string
-        getOMEXML(const boost::filesystem::path& id);
+        void
+        saveComment(const boost::filesystem::path& id,
+                    const std::string&             xml,
+                    std::string::size_type         uuidOffset,
+                    std::string::size_type         uuidSize,
+                    const std::string&             uuid);
 
         /**
-         * Save OME-XML text in the first IFD of the specified TIFF file.
+         * Save OME-XML text in all TIFF files.
          *
-         * @param id the TIFF in which to embed the OME-XML.
-         * @param xml the OME-XML text to embed.
+         * The OME-XML is serialized once, and the root UUID of each
+         * file is substituted when it is written.  The files must
+         * have been closed.  Files are updated in parallel.
+         *
+         * @throws FormatException if any file could not be updated.
          */
         void
-        saveComment(const boost::filesystem::path& id,
-                    const std::string&             xml);
+        saveComments();
+
+        /**
+         * Save OME-XML text in TIFF files until the queue is empty.
+         *
+         * @param queue the files to update.
+         */
+        void
+        saveCommentTask(CommentQueue& queue);
 
         // Java getUUID unimplemented; see uuid member of TIFFState.
 
@@ -238,6 +328,35 @@ namespace ome
          */
         boost::optional<bool>
         getBigTIFF() const;
+
+        /**
+         * Set concurrent writing of output files.
+         *
+         * When enabled, each TIFF file subsequently opened with
+         * setId() is written by its own thread.  Pixel data passed to
+         * saveBytes() is copied and queued, and IFD setup, encoding
+         * and writing take place in the background, so that datasets
+         * split across several files (for example, one file per
+         * channel or timepoint) are written in parallel.  Planes
+         * destined for the same file are still written in order.
+         * Errors are reported by the next call which writes to the
+         * same file, or by close().  The OME-XML metadata is
+         * generated at close() once all files have been written.
+         *
+         * @param concurrent @c true to write files concurrently, or
+         * @c false to write all files from the calling thread.
+         */
+        void
+        setConcurrentWrite(bool concurrent = true);
+
+        /**
+         * Get concurrent writing of output files.
+         *
+         * @returns @c true if writing files concurrently, or @c false
+         * otherwise.
+         */
+        bool
+        getConcurrentWrite() const;
       };
 
     }
@@ -185,7 +185,7 @@ namespace ome
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
           if (!fieldinfo)
             {
-              Sentry sentry;
+              Sentry sentry(getIFD()->getTIFF()->getMutex());
 
               fieldinfo = TIFFFindField(getTIFF(), tag, TIFF_ANY);
               // The returned tag is sometimes incorrect (all libtiff versions)
@@ -251,7 +251,7 @@ namespace ome
         std::string ret("Unknown");
 
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -275,7 +275,7 @@ namespace ome
         Type ret = TYPE_UNDEFINED;
 
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -291,7 +291,7 @@ namespace ome
         bool ret = false;
 
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -307,7 +307,7 @@ namespace ome
         int ret = 1;
 
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -323,7 +323,7 @@ namespace ome
         int ret = 1;
 
 #if defined(TIFF_HAVE_FIELD) || defined(TIFF_HAVE_FIELDINFO)
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
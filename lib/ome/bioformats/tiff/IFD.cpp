@@ -39,10 +39,13 @@
 #include <cmath>
 #include <cstdarg>
 #include <cassert>
+#include <map>
 
 #include <boost/format.hpp>
 #include <boost/thread.hpp>
 
+#include <ome/bioformats/PixelStatistics.h>
+#include <ome/bioformats/PixelTranspose.h>
 #include <ome/bioformats/PlaneRegion.h>
 #include <ome/bioformats/TileBuffer.h>
 #include <ome/bioformats/TileCache.h>
@@ -66,11 +69,15 @@ namespace
   using namespace ::ome::bioformats::tiff;
   using ::ome::bioformats::dimension_size_type;
   using ::ome::bioformats::PixelBuffer;
+  using ::ome::bioformats::PixelBufferBase;
   using ::ome::bioformats::PixelProperties;
+  using ::ome::bioformats::PixelSpan;
+  using ::ome::bioformats::PixelStatistics;
   using ::ome::bioformats::PlaneRegion;
   using ::ome::bioformats::TileBuffer;
   using ::ome::bioformats::TileCache;
   using ::ome::bioformats::TileCoverage;
+  using ::ome::bioformats::transpose;
 
   // VariantPixelBuffer tile transfer
   // ────────────────────────────────
@@ -119,6 +126,156 @@ namespace
   // std::copy (usually memmove(3) internally) of whole tiles or tile
   // chunks where the tile widths are compatible, or individual
   // scanlines where they are not compatible.
+  //
+  // The pixel buffer storage is resolved to a PixelSpan once per
+  // call, so that the position of each row is computed with plain
+  // pointer arithmetic rather than by multi-dimensional indexing of
+  // the pixel buffer for every row of every tile.
+  //
+  // ReadVisitor may optionally accumulate pixel statistics for each
+  // clip region immediately after its transfer, while the data is
+  // still in cache, avoiding a second pass over the pixel buffer.
+
+  // Transfer the clip region of a tile buffer into the pixel buffer
+  // span of a destination region.
+  template<typename T>
+  void
+  read_transfer(const PixelSpan<T>& span,
+                const PlaneRegion&  region,
+                dimension_size_type subchannel,
+                const TileBuffer&   tilebuf,
+                const PlaneRegion&  rfull,
+                const PlaneRegion&  rclip,
+                uint16_t            copysamples)
+  {
+    if (rclip.w == rfull.w &&
+        rclip.x == region.x &&
+        rclip.w == region.w)
+      {
+        // Transfer contiguous block since the tile spans the
+        // whole region width for both source and destination
+        // buffers.
+
+        T *dest = span.pointer(rclip.x - region.x, rclip.y - region.y, subchannel);
+        const T *src = reinterpret_cast<const T *>(tilebuf.data());
+        std::copy(src,
+                  src + (rclip.w * rclip.h * copysamples),
+                  dest);
+      }
+    else
+      {
+        // Transfer discontiguous block.
+
+        dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+
+        for (dimension_size_type row = rclip.y;
+             row != rclip.y + rclip.h;
+             ++row)
+          {
+            dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+
+            T *dest = span.pointer(rclip.x - region.x, row - region.y, subchannel);
+            const T *src = reinterpret_cast<const T *>(tilebuf.data());
+            std::copy(src + yoffset + xoffset,
+                      src + yoffset + xoffset + (rclip.w * copysamples),
+                      dest);
+          }
+      }
+  }
+
+  // Special case for BIT
+  void
+  read_transfer(const PixelSpan<PixelProperties<PixelType::BIT>::std_type>& span,
+                const PlaneRegion&                                          region,
+                dimension_size_type                                         subchannel,
+                const TileBuffer&                                           tilebuf,
+                const PlaneRegion&                                          rfull,
+                const PlaneRegion&                                          rclip,
+                uint16_t                                                    copysamples)
+  {
+    // Unpack bits from buffer.
+
+    typedef PixelProperties<PixelType::BIT>::std_type T;
+
+    dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+
+    for (dimension_size_type row = rclip.y;
+         row != rclip.y + rclip.h;
+         ++row)
+      {
+        dimension_size_type row_width = rfull.w * copysamples;
+        if (row_width % 8U)
+          row_width += 8U - (row_width % 8U); // pad to next full byte
+        dimension_size_type yoffset = (row - rfull.y) * row_width;
+
+        T *dest = span.pointer(rclip.x - region.x, row - region.y, subchannel);
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(tilebuf.data());
+
+        for (dimension_size_type sampleoffset = 0U;
+             sampleoffset < (rclip.w * copysamples);
+             ++sampleoffset)
+          {
+            dimension_size_type src_bit = yoffset + xoffset + sampleoffset;
+            const uint8_t *src_byte = src + (src_bit / 8U);
+            const uint8_t bit_offset = 7U - (src_bit % 8U);
+            const uint8_t mask = static_cast<uint8_t>(1U << bit_offset);
+            assert(src_byte >= src && src_byte < src + tilebuf.size());
+            *(dest+sampleoffset) = static_cast<T>(*src_byte & mask);
+          }
+      }
+  }
+
+  template<typename T>
+  dimension_size_type
+  expected_read(const ome::compat::shared_ptr<T>& /* buffer */,
+                const PlaneRegion&                rclip,
+                uint16_t                          copysamples)
+  {
+    return rclip.w * rclip.h * copysamples * sizeof(typename T::value_type);
+  }
+
+  // Special case for BIT
+  dimension_size_type
+  expected_read(const ome::compat::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type> >& /* buffer */,
+                const PlaneRegion&                                                                      rclip,
+                uint16_t                                                                                copysamples)
+  {
+    dimension_size_type expectedread = rclip.w;
+
+    if (expectedread % 8)
+      ++expectedread;
+    expectedread *= rclip.h * copysamples;
+    expectedread /= 8;
+
+    return expectedread;
+  }
+
+  // Read and decode a single tile or strip into a tile buffer.
+  void
+  read_tile(::TIFF              *tiffraw,
+            TileType             type,
+            tstrile_t            tile,
+            TileBuffer&          tilebuf,
+            dimension_size_type  expectedread,
+            Sentry&              sentry)
+  {
+    if (type == TILE)
+      {
+        tmsize_t bytesread = TIFFReadEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+        if (bytesread < 0)
+          sentry.error("Failed to read encoded tile");
+        else if (static_cast<dimension_size_type>(bytesread) != tilebuf.size())
+          sentry.error("Failed to read encoded tile fully");
+      }
+    else
+      {
+        tmsize_t bytesread = TIFFReadEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+        if (bytesread < 0)
+          sentry.error("Failed to read encoded strip");
+        else if (static_cast<dimension_size_type>(bytesread) < expectedread)
+          sentry.error("Failed to read encoded strip fully");
+      }
+  }
 
   struct ReadVisitor : public boost::static_visitor<>
   {
@@ -126,16 +283,19 @@ namespace
     const TileInfo&                         tileinfo;
     const PlaneRegion&                      region;
     const std::vector<dimension_size_type>& tiles;
+    PixelStatistics                        *stats;
     TileBuffer                              tilebuf;
 
     ReadVisitor(const IFD&                              ifd,
                 const TileInfo&                         tileinfo,
                 const PlaneRegion&                      region,
-                const std::vector<dimension_size_type>& tiles):
+                const std::vector<dimension_size_type>& tiles,
+                PixelStatistics                        *stats = 0):
       ifd(ifd),
       tileinfo(tileinfo),
       region(region),
       tiles(tiles),
+      stats(stats),
       tilebuf(tileinfo.bufferSize())
     {}
 
@@ -145,122 +305,87 @@ namespace
 
     template<typename T>
     void
-    transfer(ome::compat::shared_ptr<T>& buffer,
-             typename T::indices_type&   destidx,
-             const TileBuffer&           tilebuf,
-             PlaneRegion&                rfull,
-             PlaneRegion&                rclip,
-             uint16_t                    copysamples)
+    operator()(ome::compat::shared_ptr<T>& buffer)
     {
-      if (rclip.w == rfull.w &&
-          rclip.x == region.x &&
-          rclip.w == region.w)
-        {
-          // Transfer contiguous block since the tile spans the
-          // whole region width for both source and destination
-          // buffers.
-
-          destidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-          destidx[ome::bioformats::DIM_SPATIAL_Y] = rclip.y - region.y;
+      ome::compat::shared_ptr< ::ome::bioformats::tiff::TIFF>& tiff(ifd.getTIFF());
+      ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
+      TileType type = tileinfo.tileType();
 
-          typename T::value_type *dest = &buffer->at(destidx);
-          const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tilebuf.data());
-          std::copy(src,
-                    src + (rclip.w * rclip.h * copysamples),
-                    dest);
-        }
-      else
-        {
-          // Transfer discontiguous block.
+      uint16_t samples = ifd.getSamplesPerPixel();
+      PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
 
-          dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+      const PixelSpan<typename T::value_type> span(buffer->span());
 
-          for (dimension_size_type row = rclip.y;
-               row != rclip.y + rclip.h;
-               ++row)
-            {
-              dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+      Sentry sentry(tiff->getMutex());
+      // Another thread may have changed directory since the above.
+      ifd.makeCurrent();
 
-              destidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-              destidx[ome::bioformats::DIM_SPATIAL_Y] = row - region.y;
+      for(std::vector<dimension_size_type>::const_iterator i = tiles.begin();
+          i != tiles.end();
+          ++i)
+        {
+          tstrile_t tile = static_cast<tstrile_t>(*i);
+          PlaneRegion rfull = tileinfo.tileRegion(tile);
+          PlaneRegion rclip = tileinfo.tileRegion(tile, region);
+          dimension_size_type sample = tileinfo.tileSample(tile);
 
-              typename T::value_type *dest = &buffer->at(destidx);
-              const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tilebuf.data());
-              std::copy(src + yoffset + xoffset,
-                        src + yoffset + xoffset + (rclip.w * copysamples),
-                        dest);
+          uint16_t copysamples = samples;
+          dimension_size_type dest_subchannel = 0;
+          if (planarconfig == SEPARATE)
+            {
+              copysamples = 1;
+              dest_subchannel = sample;
             }
-        }
-    }
-
-    // Special case for BIT
-    void
-    transfer(ome::compat::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type> >& buffer,
-             PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&             destidx,
-             const TileBuffer&                                                                 tilebuf,
-             PlaneRegion&                                                                      rfull,
-             PlaneRegion&                                                                      rclip,
-             uint16_t                                                                          copysamples)
-    {
-      // Unpack bits from buffer.
-
-      typedef PixelBuffer<PixelProperties<PixelType::BIT>::std_type> T;
-
-      dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
 
-      for (dimension_size_type row = rclip.y;
-           row != rclip.y + rclip.h;
-           ++row)
-        {
-          dimension_size_type row_width = rfull.w * copysamples;
-          if (row_width % 8U)
-            row_width += 8U - (row_width % 8U); // pad to next full byte
-          dimension_size_type yoffset = (row - rfull.y) * row_width;
+          read_tile(tiffraw, type, tile, tilebuf,
+                    expected_read(buffer, rclip, copysamples), sentry);
 
-          destidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-          destidx[ome::bioformats::DIM_SPATIAL_Y] = row - region.y;
+          read_transfer(span, region, dest_subchannel, tilebuf, rfull, rclip, copysamples);
 
-          T::value_type *dest = &buffer->at(destidx);
-          const uint8_t *src = reinterpret_cast<const uint8_t *>(tilebuf.data());
-
-          for (dimension_size_type sampleoffset = 0U;
-               sampleoffset < (rclip.w * copysamples);
-               ++sampleoffset)
+          if (stats)
             {
-              dimension_size_type src_bit = yoffset + xoffset + sampleoffset;
-              const uint8_t *src_byte = src + (src_bit / 8U);
-              const uint8_t bit_offset = 7U - (src_bit % 8U);
-              const uint8_t mask = static_cast<uint8_t>(1U << bit_offset);
-              assert(src_byte >= src && src_byte < src + tilebuf.size());
-              *(dest+sampleoffset) = static_cast<T::value_type>(*src_byte & mask);
+              // Each destination row of the clip region is
+              // contiguous.
+              for (dimension_size_type row = rclip.y;
+                   row != rclip.y + rclip.h;
+                   ++row)
+                {
+                  stats->add(span.pointer(rclip.x - region.x, row - region.y, dest_subchannel),
+                             rclip.w, copysamples, dest_subchannel);
+                }
             }
         }
     }
+  };
 
-    template<typename T>
-    dimension_size_type
-    expected_read(const ome::compat::shared_ptr<T>& /* buffer */,
-                  const PlaneRegion&                rclip,
-                  uint16_t                          copysamples) const
-    {
-      return rclip.w * rclip.h * copysamples * sizeof(typename T::value_type);
-    }
-
-    // Special case for BIT
-    dimension_size_type
-    expected_read(const ome::compat::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type> >& /* buffer */,
-                  const PlaneRegion&                                                                      rclip,
-                  uint16_t                                                                                copysamples) const
-    {
-      dimension_size_type expectedread = rclip.w;
-
-      if (expectedread % 8)
-        ++expectedread;
-      expectedread *= rclip.h * copysamples;
-      expectedread /= 8;
+  // Tile index to the indexes of the regions requiring the tile.
+  typedef std::map<dimension_size_type, std::vector<dimension_size_type> > tile_region_map;
 
-      return expectedread;
-    }
+  // Transfer a set of tiles to multiple destination pixel buffers.
+  // Each tile is read and decoded once, in tile order, and then
+  // copied into every destination region it overlaps.  All
+  // destination buffers must be of the same pixel type.
+  struct MultiReadVisitor : public boost::static_visitor<>
+  {
+    const IFD&                                         ifd;
+    const TileInfo&                                    tileinfo;
+    const std::vector<PlaneRegion>&                    regions;
+    std::vector< ::ome::bioformats::VariantPixelBuffer>& dests;
+    const tile_region_map&                             tiles;
+    TileBuffer                                         tilebuf;
+
+    MultiReadVisitor(const IFD&                                         ifd,
+                     const TileInfo&                                    tileinfo,
+                     const std::vector<PlaneRegion>&                    regions,
+                     std::vector< ::ome::bioformats::VariantPixelBuffer>& dests,
+                     const tile_region_map&                             tiles):
+      ifd(ifd),
+      tileinfo(tileinfo),
+      regions(regions),
+      dests(dests),
+      tiles(tiles),
+      tilebuf(tileinfo.bufferSize())
+    {}
 
     template<typename T>
     void
@@ -273,15 +398,26 @@ namespace
       uint16_t samples = ifd.getSamplesPerPixel();
       PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
 
-      Sentry sentry;
+      // Resolve all destination spans once.
+      std::vector<PixelSpan<typename T::value_type> > spans;
+      spans.reserve(dests.size());
+      for (std::vector< ::ome::bioformats::VariantPixelBuffer>::iterator d = dests.begin();
+           d != dests.end();
+           ++d)
+        spans.push_back(boost::get<ome::compat::shared_ptr<T> >(d->vbuffer())->span());
 
-      for(std::vector<dimension_size_type>::const_iterator i = tiles.begin();
+      const PlaneRegion full(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+
+      Sentry sentry(tiff->getMutex());
+      // Another thread may have changed directory since the above.
+      ifd.makeCurrent();
+
+      for(tile_region_map::const_iterator i = tiles.begin();
           i != tiles.end();
           ++i)
         {
-          tstrile_t tile = static_cast<tstrile_t>(*i);
+          tstrile_t tile = static_cast<tstrile_t>(i->first);
           PlaneRegion rfull = tileinfo.tileRegion(tile);
-          PlaneRegion rclip = tileinfo.tileRegion(tile, region);
           dimension_size_type sample = tileinfo.tileSample(tile);
 
           uint16_t copysamples = samples;
@@ -292,33 +428,16 @@ namespace
               dest_subchannel = sample;
             }
 
-          if (type == TILE)
-            {
-              tmsize_t bytesread = TIFFReadEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (bytesread < 0)
-                sentry.error("Failed to read encoded tile");
-              else if (static_cast<dimension_size_type>(bytesread) != tilebuf.size())
-                sentry.error("Failed to read encoded tile fully");
-            }
-          else
+          read_tile(tiffraw, type, tile, tilebuf,
+                    expected_read(buffer, tileinfo.tileRegion(tile, full), copysamples), sentry);
+
+          for (std::vector<dimension_size_type>::const_iterator r = i->second.begin();
+               r != i->second.end();
+               ++r)
             {
-              tmsize_t bytesread = TIFFReadEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              dimension_size_type expectedread = expected_read(buffer, rclip, copysamples);
-              if (bytesread < 0)
-                sentry.error("Failed to read encoded strip");
-              else if (static_cast<dimension_size_type>(bytesread) < expectedread)
-                sentry.error("Failed to read encoded strip fully");
+              PlaneRegion rclip = tileinfo.tileRegion(tile, regions[*r]);
+              read_transfer(spans[*r], regions[*r], dest_subchannel, tilebuf, rfull, rclip, copysamples);
             }
-
-          typename T::indices_type destidx;
-          destidx[ome::bioformats::DIM_SPATIAL_X] = 0;
-          destidx[ome::bioformats::DIM_SPATIAL_Y] = 0;
-          destidx[ome::bioformats::DIM_SUBCHANNEL] = dest_subchannel;
-          destidx[ome::bioformats::DIM_SPATIAL_Z] = destidx[ome::bioformats::DIM_TEMPORAL_T] =
-            destidx[ome::bioformats::DIM_CHANNEL] = destidx[ome::bioformats::DIM_MODULO_Z] =
-            destidx[ome::bioformats::DIM_MODULO_T] = destidx[ome::bioformats::DIM_MODULO_C] = 0;
-
-          transfer(buffer, destidx, tilebuf, rfull, rclip, copysamples);
         }
     }
   };
@@ -328,91 +447,137 @@ namespace
     IFD&                                    ifd;
     std::vector<TileCoverage>&              tilecoverage;
     TileCache&                              tilecache;
+    std::vector<bool>&                      written;
     const TileInfo&                         tileinfo;
     const PlaneRegion&                      region;
     const std::vector<dimension_size_type>& tiles;
+    bool                                    reorder;
+    bool                                    single;
 
     WriteVisitor(IFD&                                    ifd,
                  std::vector<TileCoverage>&              tilecoverage,
                  TileCache&                              tilecache,
+                 std::vector<bool>&                      written,
                  const TileInfo&                         tileinfo,
                  const PlaneRegion&                      region,
-                 const std::vector<dimension_size_type>& tiles):
+                 const std::vector<dimension_size_type>& tiles,
+                 bool                                    reorder,
+                 bool                                    single = false):
       ifd(ifd),
       tilecoverage(tilecoverage),
       tilecache(tilecache),
+      written(written),
       tileinfo(tileinfo),
       region(region),
-      tiles(tiles)
+      tiles(tiles),
+      reorder(reorder),
+      single(single)
     {}
 
-    // Flush covered tiles.
+    // Write a tile if it is fully covered.
+    //
+    // A tile is written as soon as the write completing it has been
+    // transferred, whether or not the preceding tiles have been
+    // written.  libtiff records the offset and size of each tile or
+    // strip as it is written, and the directory entries are written
+    // with the IFD, so tiles may be written in any order.  This
+    // means that only partially covered tiles are retained in the
+    // tile cache, however the image is written, and complete tiles
+    // are never spilled by a cache memory limit.
     void
-    flush()
+    writeCovered(tstrile_t           tile,
+                 dimension_size_type subchannel)
     {
-      ome::compat::shared_ptr< ::ome::bioformats::tiff::TIFF>& tiff(ifd.getTIFF());
-      ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
-      TileType type = tileinfo.tileType();
       PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
-      tstrile_t tile = static_cast<tstrile_t>(ifd.getCurrentTile());
+      PlaneRegion validarea = tileinfo.tileRegion(tile) & rimage;
+      if (!validarea.area() ||
+          !tilecoverage.at(subchannel).covered(validarea))
+        return;
 
-      Sentry sentry;
-      while(tile < tileinfo.tileCount())
-        {
-          dimension_size_type tile_subchannel = tileinfo.tileSample(tile);
-
-          PlaneRegion validarea = tileinfo.tileRegion(tile) & rimage;
-          if (!validarea.area())
-            break;
+      ome::compat::shared_ptr< ::ome::bioformats::tiff::TIFF>& tiff(ifd.getTIFF());
+      ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-          if (!tilecoverage.at(tile_subchannel).covered(validarea))
-            break;
+      Sentry sentry(tiff->getMutex());
+      ifd.makeCurrent();
 
-          assert(tilecache.find(tile));
-          TileBuffer& tilebuf = *tilecache.find(tile);
-          if (type == TILE)
-            {
-              tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (byteswritten < 0)
-                sentry.error("Failed to write encoded tile");
-              else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
-                sentry.error("Failed to write encoded tile fully");
-            }
-          else
-            {
-              tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (byteswritten < 0)
-                sentry.error("Failed to write encoded strip");
-              else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
-                sentry.error("Failed to write encoded strip fully");
-            }
-          tilecache.erase(tile);
-          ifd.setCurrentTile(++tile);
+      assert(tilecache.find(tile));
+      TileBuffer& tilebuf = *tilecache.find(tile);
+      if (tileinfo.tileType() == TILE)
+        {
+          tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+          if (byteswritten < 0)
+            sentry.error("Failed to write encoded tile");
+          else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+            sentry.error("Failed to write encoded tile fully");
         }
+      else
+        {
+          tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+          if (byteswritten < 0)
+            sentry.error("Failed to write encoded strip");
+          else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+            sentry.error("Failed to write encoded strip fully");
+        }
+      tilecache.erase(tile);
+      written.at(tile) = true;
+    }
+
+    // Update the current tile; this is the first tile not yet
+    // written.
+    void
+    flush()
+    {
+      dimension_size_type current = ifd.getCurrentTile();
+      while (current < written.size() && written[current])
+        ++current;
+      ifd.setCurrentTile(current);
     }
 
     template<typename T>
     void
-    transfer(const ome::compat::shared_ptr<T>& buffer,
-             typename T::indices_type&         srcidx,
-             TileBuffer&                       tilebuf,
-             PlaneRegion&                      rfull,
-             PlaneRegion&                      rclip,
-             uint16_t                          copysamples)
+    transfer(const PixelSpan<const T>& span,
+             dimension_size_type       subchannel,
+             TileBuffer&               tilebuf,
+             PlaneRegion&              rfull,
+             PlaneRegion&              rclip,
+             uint16_t                  copysamples)
     {
-      if (rclip.w == rfull.w &&
-          rclip.x == region.x &&
-          rclip.w == region.w)
+      if (reorder)
+        {
+          // Transpose block since the source buffer storage order
+          // differs from the tile layout.
+
+          dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+          dimension_size_type yoffset = (rclip.y - rfull.y) * (rfull.w * copysamples);
+
+          T *dest = reinterpret_cast<T *>(tilebuf.data());
+          const T *src = span.pointer(rclip.x - region.x, rclip.y - region.y, subchannel);
+
+          boost::multi_array_types::size_type shape[PixelBufferBase::dimensions];
+          std::fill(shape, shape + PixelBufferBase::dimensions, 1U);
+          shape[ome::bioformats::DIM_SPATIAL_X] = rclip.w;
+          shape[ome::bioformats::DIM_SPATIAL_Y] = rclip.h;
+          shape[ome::bioformats::DIM_SUBCHANNEL] = copysamples;
+
+          boost::multi_array_types::index tilestrides[PixelBufferBase::dimensions];
+          std::fill(tilestrides, tilestrides + PixelBufferBase::dimensions, 0);
+          tilestrides[ome::bioformats::DIM_SPATIAL_X] = copysamples;
+          tilestrides[ome::bioformats::DIM_SPATIAL_Y] = rfull.w * copysamples;
+          tilestrides[ome::bioformats::DIM_SUBCHANNEL] = 1;
+
+          assert(dest + yoffset + xoffset + ((rclip.h - 1) * rfull.w + rclip.w) * copysamples <= dest + tilebuf.size());
+          transpose(src, span.strides.data(), dest + yoffset + xoffset, tilestrides, shape);
+        }
+      else if (rclip.w == rfull.w &&
+               rclip.x == region.x &&
+               rclip.w == region.w)
         {
           // Transfer contiguous block since the tile spans the
           // whole region width for both source and destination
           // buffers.
 
-          srcidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-          srcidx[ome::bioformats::DIM_SPATIAL_Y] = rclip.y - region.y;
-
-          typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data());
-          const typename T::value_type *src = &buffer->at(srcidx);
+          T *dest = reinterpret_cast<T *>(tilebuf.data());
+          const T *src = span.pointer(rclip.x - region.x, rclip.y - region.y, subchannel);
 
           assert(dest + (rclip.w * rclip.h * copysamples) <= dest + tilebuf.size());
           std::copy(src,
@@ -431,11 +596,8 @@ namespace
             {
               dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
 
-              srcidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-              srcidx[ome::bioformats::DIM_SPATIAL_Y] = row - region.y;
-
-              typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data());
-              const typename T::value_type *src = &buffer->at(srcidx);
+              T *dest = reinterpret_cast<T *>(tilebuf.data());
+              const T *src = span.pointer(rclip.x - region.x, row - region.y, subchannel);
 
               assert(dest + yoffset + xoffset + (rclip.w * copysamples) <= dest + tilebuf.size());
               std::copy(src,
@@ -447,19 +609,30 @@ namespace
 
     // Special case for BIT
     void
-    transfer(const ome::compat::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type> >& buffer,
-             PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&                   srcidx,
-             TileBuffer&                                                                             tilebuf,
-             PlaneRegion&                                                                            rfull,
-             PlaneRegion&                                                                            rclip,
-             uint16_t                                                                                copysamples)
+    transfer(const PixelSpan<const PixelProperties<PixelType::BIT>::std_type>& span,
+             dimension_size_type                                               subchannel,
+             TileBuffer&                                                       tilebuf,
+             PlaneRegion&                                                      rfull,
+             PlaneRegion&                                                      rclip,
+             uint16_t                                                          copysamples)
     {
       // Pack bits into buffer.
 
-      typedef PixelBuffer<PixelProperties<PixelType::BIT>::std_type> T;
+      typedef PixelProperties<PixelType::BIT>::std_type T;
 
       dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
 
+      // Source strides for pixels and samples; these are contiguous
+      // unless the source buffer storage order differs from the tile
+      // layout.
+      boost::multi_array_types::index xstride = copysamples;
+      boost::multi_array_types::index sstride = 1;
+      if (reorder)
+        {
+          xstride = span.strides[ome::bioformats::DIM_SPATIAL_X];
+          sstride = span.strides[ome::bioformats::DIM_SUBCHANNEL];
+        }
+
       for (dimension_size_type row = rclip.y;
            row != rclip.y + rclip.h;
            ++row)
@@ -469,17 +642,16 @@ namespace
             row_width += 8 - (row_width % 8); // pad to next full byte
           dimension_size_type yoffset = (row - rfull.y) * row_width;
 
-          srcidx[ome::bioformats::DIM_SPATIAL_X] = rclip.x - region.x;
-          srcidx[ome::bioformats::DIM_SPATIAL_Y] = row - region.y;
-
           uint8_t *dest = reinterpret_cast<uint8_t *>(tilebuf.data());
-          const T::value_type *src = &buffer->at(srcidx);
+          const T *src = span.pointer(rclip.x - region.x, row - region.y, subchannel);
 
           for (dimension_size_type sampleoffset = 0;
                sampleoffset < (rclip.w * copysamples);
                ++sampleoffset)
             {
-              const T::value_type *srcsample = src + sampleoffset;
+              const T *srcsample = src +
+                (static_cast<boost::multi_array_types::index>(sampleoffset / copysamples) * xstride) +
+                (static_cast<boost::multi_array_types::index>(sampleoffset % copysamples) * sstride);
               dimension_size_type dest_bit = yoffset + xoffset + sampleoffset;
               uint8_t *dest_byte = dest + (dest_bit / 8);
               const uint8_t bit_offset = 7 - (dest_bit % 8);
@@ -500,6 +672,11 @@ namespace
 
       if (tilecoverage.size() != (planarconfig == CONTIG ? 1 : samples))
         tilecoverage.resize(planarconfig == CONTIG ? 1 : samples);
+      if (written.size() != tileinfo.tileCount())
+        written.resize(tileinfo.tileCount(), false);
+
+      const T& cbuffer(*buffer);
+      const PixelSpan<const typename T::value_type> span(cbuffer.span());
 
       for(std::vector<dimension_size_type>::const_iterator i = tiles.begin();
           i != tiles.end();
@@ -510,6 +687,13 @@ namespace
           PlaneRegion rclip = tileinfo.tileRegion(tile, region);
           dimension_size_type sample = tileinfo.tileSample(tile);
 
+          if (written.at(tile))
+            {
+              boost::format fmt("Tile %1% has already been written");
+              fmt % tile;
+              throw Exception(fmt.str());
+            }
+
           uint16_t copysamples = samples;
           dimension_size_type dest_subchannel = 0;
           if (planarconfig == SEPARATE)
@@ -525,19 +709,14 @@ namespace
           assert(tilecache.find(tile));
           TileBuffer& tilebuf = *tilecache.find(tile);
 
-          typename T::indices_type srcidx;
-          srcidx[ome::bioformats::DIM_SPATIAL_X] = 0;
-          srcidx[ome::bioformats::DIM_SPATIAL_Y] = 0;
-          srcidx[ome::bioformats::DIM_SUBCHANNEL] = dest_subchannel;
-          srcidx[ome::bioformats::DIM_SPATIAL_Z] = srcidx[ome::bioformats::DIM_TEMPORAL_T] =
-            srcidx[ome::bioformats::DIM_CHANNEL] = srcidx[ome::bioformats::DIM_MODULO_Z] =
-            srcidx[ome::bioformats::DIM_MODULO_T] = srcidx[ome::bioformats::DIM_MODULO_C] = 0;
-
-          transfer(buffer, srcidx, tilebuf, rfull, rclip, copysamples);
+          // If the source contains a single subchannel, it is the
+          // sample of every tile being written.
+          transfer(span, single ? 0 : dest_subchannel, tilebuf, rfull, rclip, copysamples);
           tilecoverage.at(dest_subchannel).insert(rclip);
+
+          writeCovered(tile, dest_subchannel);
         }
 
-      // Flush covered tiles
       flush();
     }
   };
@@ -574,6 +753,90 @@ namespace ome
           }
         };
 
+        void
+        read_image(const IFD&          ifd,
+                   VariantPixelBuffer& dest,
+                   dimension_size_type x,
+                   dimension_size_type y,
+                   dimension_size_type w,
+                   dimension_size_type h,
+                   PixelStatistics    *stats)
+        {
+          PixelType type = ifd.getPixelType();
+          PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
+          uint16_t subC = ifd.getSamplesPerPixel();
+
+          ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+          shape[DIM_SPATIAL_X] = w;
+          shape[DIM_SPATIAL_Y] = h;
+          shape[DIM_SUBCHANNEL] = subC;
+          shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+            shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+          PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+
+          // Fill a compatible buffer in place (including external
+          // storage); only reallocate if managed internally.
+          dest.ensureBuffer(shape, type, order);
+
+          TileInfo info = ifd.getTileInfo();
+
+          PlaneRegion region(x, y, w, h);
+          std::vector<dimension_size_type> tiles(info.tileCoverage(region));
+
+          if (stats)
+            stats->reset(subC, type);
+
+          ReadVisitor v(ifd, info, region, tiles, stats);
+          boost::apply_visitor(v, dest.vbuffer());
+        }
+
+        void
+        read_images(const IFD&                       ifd,
+                    std::vector<VariantPixelBuffer>& dests,
+                    const std::vector<PlaneRegion>&  regions)
+        {
+          PixelType type = ifd.getPixelType();
+          PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
+          uint16_t subC = ifd.getSamplesPerPixel();
+
+          PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+
+          dests.resize(regions.size());
+          if (regions.empty())
+            return;
+
+          TileInfo info = ifd.getTileInfo();
+
+          // The union of the tiles covering all regions, and the
+          // regions covered by each tile.
+          tile_region_map tiles;
+          for (std::vector<PlaneRegion>::size_type i = 0; i < regions.size(); ++i)
+            {
+              const PlaneRegion& region(regions[i]);
+
+              ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+              shape[DIM_SPATIAL_X] = region.w;
+              shape[DIM_SPATIAL_Y] = region.h;
+              shape[DIM_SUBCHANNEL] = subC;
+              shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+                shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+              // Fill a compatible buffer in place (including external
+              // storage); only reallocate if managed internally.
+              dests[i].ensureBuffer(shape, type, order);
+
+              std::vector<dimension_size_type> rtiles(info.tileCoverage(region));
+              for (std::vector<dimension_size_type>::const_iterator t = rtiles.begin();
+                   t != rtiles.end();
+                   ++t)
+                tiles[*t].push_back(i);
+            }
+
+          MultiReadVisitor v(ifd, info, regions, dests, tiles);
+          boost::apply_visitor(v, dests.front().vbuffer());
+        }
+
       }
 
       /**
@@ -590,6 +853,8 @@ namespace ome
         std::vector<TileCoverage> coverage;
         /// Tile cache (used when writing).
         TileCache tilecache;
+        /// Tiles written (used when writing).
+        std::vector<bool> written;
         /// Tile type.
         boost::optional<TileType> tiletype;
         /// Image width.
@@ -625,6 +890,7 @@ namespace ome
           offset(offset),
           coverage(),
           tilecache(),
+          written(),
           imagewidth(),
           imageheight(),
           tilewidth(),
@@ -634,6 +900,8 @@ namespace ome
           planarconfig(),
           ctile(0)
         {
+          if (tiff)
+            tilecache.setMemoryLimit(tiff->getTileCacheLimit());
         }
 
         /// Destructor.
@@ -675,7 +943,7 @@ namespace ome
       {
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         if (!TIFFSetDirectory(tiffraw, index))
           sentry.error();
@@ -708,7 +976,7 @@ namespace ome
         ome::compat::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         if (static_cast<offset_type>(TIFFCurrentDirOffset(tiffraw)) != impl->offset)
           {
@@ -741,7 +1009,7 @@ namespace ome
         ome::compat::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         makeCurrent();
 
@@ -770,7 +1038,7 @@ namespace ome
         ome::compat::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         makeCurrent();
 
@@ -840,6 +1108,18 @@ namespace ome
         return TileInfo(const_cast<IFD *>(this)->shared_from_this());
       }
 
+      dimension_size_type
+      IFD::getTileCacheLimit() const
+      {
+        return impl->tilecache.getMemoryLimit();
+      }
+
+      void
+      IFD::setTileCacheLimit(dimension_size_type limit)
+      {
+        impl->tilecache.setMemoryLimit(limit);
+      }
+
       std::vector<TileCoverage>&
       IFD::getTileCoverage()
       {
@@ -1201,35 +1481,32 @@ namespace ome
                      dimension_size_type w,
                      dimension_size_type h) const
       {
-        PixelType type = getPixelType();
-        PlanarConfiguration planarconfig = getPlanarConfiguration();
-        uint16_t subC = getSamplesPerPixel();
-
-        ome::compat::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
-        shape[DIM_SPATIAL_X] = w;
-        shape[DIM_SPATIAL_Y] = h;
-        shape[DIM_SUBCHANNEL] = subC;
-        shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
-          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
-
-        const VariantPixelBuffer::size_type *dest_shape_ptr(dest.shape());
-        std::copy(dest_shape_ptr, dest_shape_ptr + PixelBufferBase::dimensions,
-                  dest_shape.begin());
-
-        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
-
-        if (type != dest.pixelType() ||
-            shape != dest_shape ||
-            !(order == dest.storage_order()))
-          dest.setBuffer(shape, type, order);
+        read_image(*this, dest, x, y, w, h, 0);
+      }
 
-        TileInfo info = getTileInfo();
+      void
+      IFD::readImages(std::vector<VariantPixelBuffer>& dests,
+                      const std::vector<PlaneRegion>&  regions) const
+      {
+        read_images(*this, dests, regions);
+      }
 
-        PlaneRegion region(x, y, w, h);
-        std::vector<dimension_size_type> tiles(info.tileCoverage(region));
+      void
+      IFD::readImage(VariantPixelBuffer& dest,
+                     PixelStatistics&    stats) const
+      {
+        read_image(*this, dest, 0, 0, getImageWidth(), getImageHeight(), &stats);
+      }
 
-        ReadVisitor v(*this, info, region, tiles);
-        boost::apply_visitor(v, dest.vbuffer());
+      void
+      IFD::readImage(VariantPixelBuffer& dest,
+                     dimension_size_type x,
+                     dimension_size_type y,
+                     dimension_size_type w,
+                     dimension_size_type h,
+                     PixelStatistics&    stats) const
+      {
+        read_image(*this, dest, x, y, w, h, &stats);
       }
 
       void
@@ -1354,37 +1631,92 @@ namespace ome
               }
           }
 
-        if (!(order == source_order))
-          {
-            boost::format fmt("VariantPixelBuffer storage order (%1%%2%%3%%4%%5%%6%%7%%8%%9%) incompatible with %10% TIFF planar configuration (%11%%12%%13%%14%%15%%16%%17%%18%%19%");
-            fmt % source_order.ordering(0) % source_order.ordering(1) % source_order.ordering(2);
-            fmt % source_order.ordering(3) % source_order.ordering(4) % source_order.ordering(5);
-            fmt % source_order.ordering(6) % source_order.ordering(7) % source_order.ordering(8);
-            fmt % (planarconfig == SEPARATE ? "separate" : "contiguous");
-            fmt % order.ordering(0) % order.ordering(1) % order.ordering(2);
-            fmt % order.ordering(3) % order.ordering(4) % order.ordering(5);
-            fmt % order.ordering(6) % order.ordering(7) % order.ordering(8);
-            throw Exception(fmt.str());
-          }
+        // If the storage order differs from the planar
+        // configuration, convert the storage order of each tile as
+        // it is transferred.
+        bool reorder = !(order == source_order);
 
         TileInfo info = getTileInfo();
 
         PlaneRegion region(x, y, w, h);
         std::vector<dimension_size_type> tiles(info.tileCoverage(region));
 
-        WriteVisitor v(*this, impl->coverage, impl->tilecache, info, region, tiles);
+        WriteVisitor v(*this, impl->coverage, impl->tilecache, impl->written, info, region, tiles, reorder);
         boost::apply_visitor(v, source.vbuffer());
       }
 
       void
-      IFD::writeImage(const VariantPixelBuffer& /* source*/,
-                      dimension_size_type       /* x*/,
-                      dimension_size_type       /* y*/,
-                      dimension_size_type       /* w*/,
-                      dimension_size_type       /* h*/,
-                      dimension_size_type       /* subC */)
+      IFD::writeImage(const VariantPixelBuffer& source,
+                      dimension_size_type       x,
+                      dimension_size_type       y,
+                      dimension_size_type       w,
+                      dimension_size_type       h,
+                      dimension_size_type       subC)
       {
-        throw Exception("Writing subchannels separately is not yet implemented (requires TileCache and WriteVisitor to handle writing and caching of interleaved and non-interleaved subchannels; currently it handles writing all subchannels in one call only and can not combine separate subchannels from separate calls");
+        PixelType type = getPixelType();
+        PlanarConfiguration planarconfig = getPlanarConfiguration();
+        uint16_t samples = getSamplesPerPixel();
+
+        // Each sample of a planar image is stored in separate tiles,
+        // with separate tile coverage, so may be written
+        // independently.  Samples of a contiguous image share tiles.
+        if (planarconfig != SEPARATE && samples > 1)
+          throw Exception("Writing subchannels separately requires a separate planar configuration");
+
+        if (subC >= samples)
+          {
+            boost::format fmt("Subchannel %1% out of range (%2% samples)");
+            fmt % subC % samples;
+            throw Exception(fmt.str());
+          }
+
+        ome::compat::array<VariantPixelBuffer::size_type, 9> shape, source_shape;
+        shape[DIM_SPATIAL_X] = w;
+        shape[DIM_SPATIAL_Y] = h;
+        shape[DIM_SUBCHANNEL] = shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+        const VariantPixelBuffer::size_type *source_shape_ptr(source.shape());
+        std::copy(source_shape_ptr, source_shape_ptr + PixelBufferBase::dimensions,
+                  source_shape.begin());
+
+        if (type != source.pixelType())
+          {
+            boost::format fmt("VariantPixelBuffer %1% pixel type is incompatible with TIFF %2% sample format and bit depth");
+            fmt % source.pixelType() % type;
+            throw Exception(fmt.str());
+          }
+
+        if (shape != source_shape)
+          {
+            boost::format fmt("VariantPixelBuffer dimensions (%1%×%2%×%3%, %4%t, %5%c, %6% samples, %7%mz, %8%mt, %9%mc) incompatible with TIFF image size (%10%×%11%, 1 sample)");
+            fmt % source_shape[DIM_SPATIAL_X] % source_shape[DIM_SPATIAL_Y] % source_shape[DIM_SPATIAL_Z];
+            fmt % source_shape[DIM_TEMPORAL_T] % source_shape[DIM_CHANNEL] % source_shape[DIM_SUBCHANNEL];
+            fmt % source_shape[DIM_MODULO_Z] % source_shape[DIM_MODULO_T] % source_shape[DIM_MODULO_C];
+            fmt % shape[DIM_SPATIAL_X] % shape[DIM_SPATIAL_Y];
+            throw Exception(fmt.str());
+          }
+
+        // With a single subchannel, the storage order only matters
+        // if the rows are not contiguous.
+        const boost::multi_array_types::index *strides = source.strides();
+        bool reorder = !(strides[DIM_SPATIAL_X] == 1 &&
+                         strides[DIM_SPATIAL_Y] == static_cast<boost::multi_array_types::index>(w));
+
+        TileInfo info = getTileInfo();
+
+        // Only the tiles of the specified sample are written.
+        PlaneRegion region(x, y, w, h);
+        std::vector<dimension_size_type> alltiles(info.tileCoverage(region));
+        std::vector<dimension_size_type> tiles;
+        for (std::vector<dimension_size_type>::const_iterator i = alltiles.begin();
+             i != alltiles.end();
+             ++i)
+          if (info.tileSample(*i) == subC)
+            tiles.push_back(*i);
+
+        WriteVisitor v(*this, impl->coverage, impl->tilecache, impl->written, info, region, tiles, reorder, true);
+        boost::apply_visitor(v, source.vbuffer());
       }
 
       ome::compat::shared_ptr<IFD>
@@ -1395,7 +1727,7 @@ namespace ome
         ome::compat::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         makeCurrent();
 
@@ -1414,7 +1746,7 @@ namespace ome
         ome::compat::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(tiff->getMutex());
 
         makeCurrent();
 
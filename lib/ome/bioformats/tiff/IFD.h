@@ -39,6 +39,7 @@
 #define OME_BIOFORMATS_TIFF_IFD_H
 
 #include <string>
+#include <vector>
 
 #include <ome/compat/memory.h>
 
@@ -54,6 +55,9 @@ namespace ome
 {
   namespace bioformats
   {
+
+    class PixelStatistics;
+
     namespace tiff
     {
 
@@ -225,7 +229,9 @@ namespace ome
         /**
          * Get the current tile being written.
          *
-         * This is the tile currently being modified pending flush.
+         * This is the first tile which has not yet been written.
+         * Tiles following it may already have been written, since
+         * complete tiles are written out of order.
          *
          * @returns the current tile.
          */
@@ -264,6 +270,31 @@ namespace ome
         const TileInfo
         getTileInfo() const;
 
+        /**
+         * Get the tile cache memory limit.
+         *
+         * @returns the maximum memory used to hold partially written
+         * tiles (bytes); zero if unlimited.
+         */
+        dimension_size_type
+        getTileCacheLimit() const;
+
+        /**
+         * Set the tile cache memory limit.
+         *
+         * When writing, tiles which are only partially covered by the
+         * regions written so far are held in memory.  If this exceeds
+         * the limit, the least recently used partial tiles are spilled
+         * to a temporary file until they are complete.  Complete tiles
+         * are always written immediately, in any order.  The default
+         * is the limit of the parent TIFF.
+         *
+         * @param limit the maximum memory used to hold partially
+         * written tiles (bytes); zero if unlimited.
+         */
+        void
+        setTileCacheLimit(dimension_size_type limit);
+
         /**
          * Get tile coverage cache.
          *
@@ -455,9 +486,14 @@ namespace ome
          * If the destination pixel buffer is of a different size to
          * the region being read, or is of the incorrect pixel type,
          * or has a different storage order, it will be resized using
-         * the correct pixel type and storage order.
+         * the correct pixel type and storage order.  If it is already
+         * of the correct size, pixel type and storage order, it will
+         * be filled in place; this permits reading directly into
+         * external storage, which can not be resized.
          *
          * @param dest the destination pixel buffer.
+         * @throws std::logic_error if the destination pixel buffer
+         * uses incompatible external storage.
          * @param x the @c X coordinate of the upper-left corner of the sub-image.
          * @param y the @c Y coordinate of the upper-left corner of the sub-image.
          * @param w the width of the sub-image.
@@ -482,6 +518,56 @@ namespace ome
                   dimension_size_type h,
                   dimension_size_type subC) const;
 
+        /**
+         * Read a whole image plane into a pixel buffer, computing
+         * pixel statistics during the read.
+         *
+         * The statistics are reset and then accumulated for each
+         * tile or strip as it is transferred into the destination
+         * pixel buffer, avoiding a second pass over the pixel data.
+         *
+         * @param dest the destination pixel buffer.
+         * @param stats the statistics to compute.
+         */
+        void
+        readImage(VariantPixelBuffer& dest,
+                  PixelStatistics&    stats) const;
+
+        /**
+         * @copydoc IFD::readImage(VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type) const
+         * @param stats the statistics to compute during the read.
+         */
+        void
+        readImage(VariantPixelBuffer& dest,
+                  dimension_size_type x,
+                  dimension_size_type y,
+                  dimension_size_type w,
+                  dimension_size_type h,
+                  PixelStatistics&    stats) const;
+
+        /**
+         * Read multiple regions of an image plane into pixel buffers.
+         *
+         * The union of the tiles or strips covering all the regions
+         * is computed, and each tile is read and decoded only once,
+         * in file order, being copied into every destination buffer
+         * whose region it overlaps.  This is more efficient than
+         * calling readImage() for each region when the regions
+         * overlap or share tiles.
+         *
+         * The destination vector is resized to the number of
+         * regions.  Each destination pixel buffer is resized or
+         * filled in place as for readImage().
+         *
+         * @param dests the destination pixel buffers, one per region.
+         * @param regions the regions to read.
+         * @throws std::logic_error if a destination pixel buffer uses
+         * incompatible external storage.
+         */
+        void
+        readImages(std::vector<VariantPixelBuffer>& dests,
+                   const std::vector<PlaneRegion>&  regions) const;
+
         /**
          * Read a lookup table into a pixel buffer.
          *
@@ -510,8 +596,11 @@ namespace ome
          * Write a whole image plane from a pixel buffer.
          *
          * The source pixel buffer must match the size of the region
-         * being written, and must also the same pixel type and
-         * storage ordering as the TIFF image.
+         * being written, and must also the same pixel type as the
+         * TIFF image.  The storage ordering of the source pixel
+         * buffer may differ from the planar configuration of the
+         * TIFF image; if so, the data will be reordered as each tile
+         * is transferred.
          *
          * @param source the source pixel buffer.
          * @param x the @c X coordinate of the upper-left corner of the sub-image.
@@ -527,8 +616,24 @@ namespace ome
                    dimension_size_type       h);
 
         /**
-         * @copydoc IFD::writeImage(const VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type)
+         * Write a region of a single subchannel from a pixel buffer.
+         *
+         * The source pixel buffer must contain a single subchannel,
+         * and must match the size of the region being written.  The
+         * TIFF image must have a separate (planar) configuration, so
+         * that each subchannel is stored in separate tiles; the
+         * subchannels may then be written independently and in any
+         * order, and each tile is written as soon as it is complete
+         * without caching the other subchannels.
+         *
+         * @param source the source pixel buffer.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
          * @param subC the subchannel to write.
+         * @throws an Exception if the planar configuration is not
+         * separate, or the subchannel or source buffer are invalid.
          */
         void
         writeImage(const VariantPixelBuffer& source,
@@ -60,33 +60,26 @@ namespace ome
       {
 
         /// Saved libtiff global error handler.
-        TIFFErrorHandler oldErrorHandler;
+        TIFFErrorHandler oldErrorHandler = 0;
 
-        /// Sentry currently holding the tiff_lock mutex.
-        Sentry *currentSentry = 0;
+        /// Error handler installation flag.
+        boost::once_flag handlerFlag = BOOST_ONCE_INIT;
 
         /**
-         * Set the libtiff error handler.
+         * Thread-specific Sentry cleanup.
          *
-         * @param sentry the current Sentry.
-         * @param handler the handler function to set.
-         * @returns the old handler to allow later restoration.
+         * Sentry objects have block scope and are owned by the
+         * caller; the default cleanup would delete them when replaced.
          */
-        TIFFErrorHandler
-        setHandler(Sentry           *sentry,
-                   TIFFErrorHandler  handler)
+        void
+        releaseSentry(Sentry * /* sentry */)
         {
-          if (sentry)
-            currentSentry = sentry;
-          TIFFErrorHandler old = TIFFSetErrorHandler(handler);
-          if (!sentry)
-            currentSentry = sentry;
-          return old;
         }
 
-      }
+        /// Innermost Sentry active in the current thread.
+        boost::thread_specific_ptr<Sentry> currentSentry(releaseSentry);
 
-      boost::recursive_mutex Sentry::tiff_mutex;
+      }
 
       // Visual Studio 12 and earlier don't have va_copy.
 #if _MSC_VER &&_MSC_VER < 1800
@@ -105,6 +98,16 @@ namespace ome
                            const char *fmt,
                            va_list     ap)
       {
+        Sentry *sentry = currentSentry.get();
+
+        if (!sentry)
+          {
+            // Not called by this library; defer to the original handler.
+            if (oldErrorHandler)
+              oldErrorHandler(module, fmt, ap);
+            return;
+          }
+
         try
           {
             va_list ap2;
@@ -136,8 +139,7 @@ namespace ome
 
             free(dest);
 
-            if (currentSentry)
-              currentSentry->setMessage(message);
+            sentry->setMessage(message);
           }
         catch (...)
           {
@@ -150,16 +152,33 @@ namespace ome
 #  pragma GCC diagnostic pop
 #endif
 
+      void
+      Sentry::installHandler()
+      {
+        oldErrorHandler = TIFFSetErrorHandler(&Sentry::errorHandler);
+      }
+
       Sentry::Sentry():
-        lock(tiff_mutex),
+        lock(),
+        previous(currentSentry.get()),
+        message()
+      {
+        boost::call_once(&Sentry::installHandler, handlerFlag);
+        currentSentry.reset(this);
+      }
+
+      Sentry::Sentry(boost::recursive_mutex& mutex):
+        lock(mutex),
+        previous(currentSentry.get()),
         message()
       {
-        oldErrorHandler = setHandler(this, &Sentry::errorHandler);
+        boost::call_once(&Sentry::installHandler, handlerFlag);
+        currentSentry.reset(this);
       }
 
       Sentry::~Sentry()
       {
-        setHandler(0, oldErrorHandler);
+        currentSentry.reset(previous);
       }
 
       void
@@ -56,16 +56,20 @@ namespace ome
       /**
        * Sentry for saving and restoring libtiff state.
        *
-       * This acts primarily to save the state of the global error and
-       * warning handlers, which are configured to work with the
-       * currently active TIFF/IFD.  The original state is restored
-       * when destroyed.  Note that this exclusively locks all TIFF
-       * and IFD methods calling into libtiff, so will potentially
-       * block other threads.
+       * This acts primarily to capture libtiff errors for the
+       * currently active TIFF/IFD.  The libtiff error handler is
+       * installed once, and dispatches errors to the innermost Sentry
+       * active in the calling thread; errors raised in threads without
+       * an active Sentry are passed to the previously installed
+       * handler.  The latest error will be available using
+       * getMessage().
        *
-       * This class also hooks into the global libtiff error handling
-       * to capture any errors which occur.  The latest error will be
-       * available using getMessage().
+       * When constructed with a TIFF mutex (TIFF::getMutex()), the
+       * mutex is held for the lifetime of the Sentry, serialising all
+       * libtiff calls made on the same file.  Separate files use
+       * separate mutexes, so may be used concurrently.  The default
+       * constructor takes no lock, and is only suitable where no
+       * TIFF handle exists yet, such as when opening a file.
        *
        * This class should be used at block scope so that instances
        * will only exist transiently until the block ends.
@@ -76,6 +80,14 @@ namespace ome
         /// Constructor.
         Sentry();
 
+        /**
+         * Constructor, locking a TIFF.
+         *
+         * @param mutex the mutex of the TIFF to be used.
+         */
+        explicit
+        Sentry(boost::recursive_mutex& mutex);
+
         /// Destructor.
         ~Sentry();
 
@@ -126,15 +138,19 @@ namespace ome
         error() const;
 
       private:
-        /// Mutex to lock libtiff access.
-        static boost::recursive_mutex tiff_mutex;
+        /// Acquired lock on the TIFF mutex (if any).
+        boost::unique_lock<boost::recursive_mutex> lock;
 
-        /// Acquired lock on tiff_lock.
-        boost::lock_guard<boost::recursive_mutex> lock;
+        /// Sentry active in this thread when this Sentry was created.
+        Sentry *previous;
 
         /// Last error message.
         std::string message;
 
+        /// Install the libtiff error handler.
+        static void
+        installHandler();
+
         /**
          * libtiff error handler.
          *
@@ -112,6 +112,10 @@ namespace ome
         ::TIFF *tiff;
         /// The number of IFDs.
         directory_index_type directoryCount;
+        /// Default tile cache memory limit for IFDs.
+        dimension_size_type tileCacheLimit;
+        /// Mutex serialising libtiff access to this file.
+        boost::recursive_mutex mutex;
 
         /**
          * The constructor.
@@ -124,7 +128,9 @@ namespace ome
         Impl(const boost::filesystem::path& filename,
              const std::string&             mode):
           tiff(),
-          directoryCount(0)
+          directoryCount(0),
+          tileCacheLimit(0),
+          mutex()
         {
           Sentry sentry;
 
@@ -177,7 +183,7 @@ namespace ome
         {
           if (tiff)
             {
-              Sentry sentry;
+              Sentry sentry(mutex);
 
               TIFFClose(tiff);
               if (!sentry.getMessage().empty())
@@ -205,6 +211,12 @@ namespace ome
         return reinterpret_cast<wrapped_type *>(impl->tiff);
       }
 
+      boost::recursive_mutex&
+      TIFF::getMutex() const
+      {
+        return impl->mutex;
+      }
+
       ome::compat::shared_ptr<TIFF>
       TIFF::open(const boost::filesystem::path& filename,
                  const std::string& mode)
@@ -237,6 +249,8 @@ namespace ome
       directory_index_type
       TIFF::directoryCount() const
       {
+        boost::lock_guard<boost::recursive_mutex> lock(impl->mutex);
+
         if (!impl->directoryCount)
           {
             directory_index_type nIFD = 0U;
@@ -251,7 +265,7 @@ namespace ome
       ome::compat::shared_ptr<IFD>
       TIFF::getDirectoryByIndex(directory_index_type index) const
       {
-        Sentry sentry;
+        Sentry sentry(impl->mutex);
 
         if (!TIFFSetDirectory(impl->tiff, index))
           sentry.error();
@@ -263,7 +277,7 @@ namespace ome
       ome::compat::shared_ptr<IFD>
       TIFF::getDirectoryByOffset(offset_type offset) const
       {
-        Sentry sentry;
+        Sentry sentry(impl->mutex);
 
 #if TIFF_HAVE_BIGTIFF
         if (!TIFFSetSubDirectory(impl->tiff, offset))
@@ -287,7 +301,7 @@ namespace ome
       void
       TIFF::writeCurrentDirectory()
       {
-        Sentry sentry;
+        Sentry sentry(impl->mutex);
 
         static const std::string software("OME Bio-Formats (C++) " OME_BIOFORMATS_VERSION_MAJOR_S "." OME_BIOFORMATS_VERSION_MINOR_S "." OME_BIOFORMATS_VERSION_PATCH_S);
         getCurrentDirectory()->getField(SOFTWARE).set(software);
@@ -296,6 +310,18 @@ namespace ome
           sentry.error("Failed to write current directory");
       }
 
+      dimension_size_type
+      TIFF::getTileCacheLimit() const
+      {
+        return impl->tileCacheLimit;
+      }
+
+      void
+      TIFF::setTileCacheLimit(dimension_size_type limit)
+      {
+        impl->tileCacheLimit = limit;
+      }
+
       TIFF::iterator
       TIFF::begin()
       {
@@ -353,7 +379,7 @@ namespace ome
 
         ::TIFF *tiffraw = reinterpret_cast< ::TIFF *>(getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(impl->mutex);
 
 # if TIFF_HAVE_MERGEFIELDINFO_RETURN
         int e = TIFFMergeFieldInfo(tiffraw, ImageJFieldInfo, boost::size(ImageJFieldInfo));
@@ -41,6 +41,7 @@
 #include <string>
 
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 
 #include <ome/bioformats/tiff/Types.h>
 
@@ -152,6 +153,15 @@ namespace ome
        * files.  Use the static open() method to get a working
        * instance.  This instance may be used to get IFD instances and
        * then access to image metadata and pixel data.
+       *
+       * Each TIFF has its own mutex (see getMutex()), which is held
+       * by every TIFF, IFD, Field and TileInfo method for the duration
+       * of its libtiff calls.  Separate TIFF files may therefore be
+       * used concurrently without contention, and a single TIFF and
+       * its IFDs may be shared between threads, with each call being
+       * serialised.  Sequences of calls are not atomic; a thread
+       * requiring several calls to see a consistent state must hold
+       * the mutex across them.
        */
       class TIFF : public ome::compat::enable_shared_from_this<TIFF>
       {
@@ -262,6 +272,27 @@ namespace ome
         void
         writeCurrentDirectory();
 
+        /**
+         * Get the default tile cache memory limit.
+         *
+         * @returns the maximum memory used to hold partially written
+         * tiles of each IFD (bytes); zero if unlimited.
+         */
+        dimension_size_type
+        getTileCacheLimit() const;
+
+        /**
+         * Set the default tile cache memory limit.
+         *
+         * This is the limit used by IFDs subsequently obtained from
+         * this TIFF; see IFD::setTileCacheLimit().
+         *
+         * @param limit the maximum memory used to hold partially
+         * written tiles of each IFD (bytes); zero if unlimited.
+         */
+        void
+        setTileCacheLimit(dimension_size_type limit);
+
         /**
          * Get the underlying libtiff @c \::TIFF instance.
          *
@@ -284,6 +315,19 @@ namespace ome
         wrapped_type *
         getWrapped() const;
 
+        /**
+         * Get the mutex serialising libtiff access to this file.
+         *
+         * This is a recursive mutex, so it may be held while calling
+         * other TIFF and IFD methods.  It must be held when using the
+         * handle returned by getWrapped() directly if the TIFF may be
+         * in use by other threads.
+         *
+         * @returns the mutex.
+         */
+        boost::recursive_mutex&
+        getMutex() const;
+
         friend class IFD;
 
         /// IFD iterator.
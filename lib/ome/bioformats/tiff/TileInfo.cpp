@@ -102,7 +102,7 @@ namespace ome
           ntiles(),
           buffersize()
         {
-          Sentry sentry;
+          Sentry sentry(getIFD()->getTIFF()->getMutex());
           ::TIFF *tiff = getTIFF();
 
           // Get basic image metadata.
@@ -229,7 +229,7 @@ namespace ome
                           dimension_size_type y,
                           dimension_size_type s) const
       {
-        Sentry sentry;
+        Sentry sentry(impl->getIFD()->getTIFF()->getMutex());
         ::TIFF *tiff = impl->getTIFF();
 
         return TIFFComputeTile(tiff, x, y, 0, s);
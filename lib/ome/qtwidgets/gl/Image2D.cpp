@@ -37,6 +37,7 @@
  */
 
 #include <ome/bioformats/PixelBuffer.h>
+#include <ome/bioformats/PixelTranspose.h>
 #include <ome/bioformats/VariantPixelBuffer.h>
 
 #include <ome/qtwidgets/gl/Image2D.h>
@@ -190,23 +191,23 @@ namespace
             {
               ordering[d] = order.ordering(d);
               ascending[d] = order.ascending(d);
-
-              PixelBufferBase::size_type xo = ordering[0];
-              PixelBufferBase::size_type yo = ordering[1];
-              PixelBufferBase::size_type so = ordering[2];
-              bool xa = ascending[0];
-              bool ya = ascending[1];
-              bool sa = ascending[2];
-
-              ordering[0] = so;
-              ordering[1] = xo;
-              ordering[2] = yo;
-              ascending[0] = sa;
-              ascending[1] = xa;
-              ascending[2] = ya;
-
-              ret = PixelBufferBase::storage_order_type(ordering, ascending);
             }
+
+          PixelBufferBase::size_type xo = ordering[0];
+          PixelBufferBase::size_type yo = ordering[1];
+          PixelBufferBase::size_type so = ordering[2];
+          bool xa = ascending[0];
+          bool ya = ascending[1];
+          bool sa = ascending[2];
+
+          ordering[0] = so;
+          ordering[1] = xo;
+          ordering[2] = yo;
+          ascending[0] = sa;
+          ascending[1] = xa;
+          ascending[2] = ya;
+
+          ret = PixelBufferBase::storage_order_type(ordering, ascending);
         }
       return ret;
     }
@@ -230,7 +231,7 @@ namespace
                                                 v->pixelType(),
                                                 v->endianType(),
                                                 new_order));
-          *gl_buf = *v;
+          ome::bioformats::transpose(*v, *gl_buf);
           src_buffer = gl_buf;
         }
 
@@ -247,7 +248,7 @@ namespace
                       tprop.external_format,  // format
                       tprop.external_type, // type
                       //                      testdata);
-                      v->data());
+                      src_buffer->data());
       check_gl("Texture set pixels in subregion");
       glGenerateMipmap(GL_TEXTURE_2D);
       check_gl("Generate mipmaps");
@@ -287,7 +288,8 @@ namespace ome
         texcorr(1.0f),
         reader(reader),
         series(series),
-        plane(-1)
+        plane(-1),
+        stats()
       {
         initializeOpenGLFunctions();
       }
@@ -430,6 +432,8 @@ namespace ome
             reader->openBytes(plane, buf);
             reader->setSeries(oldseries);
 
+            stats.compute(buf);
+
             GLSetBufferVisitor v(textureid, tprop);
             boost::apply_visitor(v, buf.vbuffer());
           }
@@ -460,6 +464,12 @@ namespace ome
         texmax = max;
       }
 
+      const ome::bioformats::PixelStatistics&
+      Image2D::getStatistics() const
+      {
+        return stats;
+      }
+
       unsigned int
       Image2D::texture()
       {
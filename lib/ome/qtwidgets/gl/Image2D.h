@@ -46,6 +46,7 @@
 
 #include <ome/bioformats/Types.h>
 #include <ome/bioformats/FormatReader.h>
+#include <ome/bioformats/PixelStatistics.h>
 
 #include <ome/compat/memory.h>
 
@@ -159,6 +160,18 @@ namespace ome
         void
         setMax(const glm::vec3& max);
 
+        /**
+         * Get pixel statistics for the current plane.
+         *
+         * The statistics are computed when the plane is set, and may
+         * be used to determine the limits for linear contrast when
+         * using the PlaneRange policy.
+         *
+         * @returns the statistics for each subchannel.
+         */
+        const ome::bioformats::PixelStatistics&
+        getStatistics() const;
+
         /**
          * Range of min/max adjustment for linear contrast.
          */
@@ -224,6 +237,8 @@ namespace ome
         ome::bioformats::dimension_size_type series;
         /// The current image plane.
         ome::bioformats::dimension_size_type plane;
+        /// Pixel statistics for the current plane.
+        ome::bioformats::PixelStatistics stats;
       };
 
     }
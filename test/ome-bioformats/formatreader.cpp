@@ -36,11 +36,13 @@
  * #L%
  */
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <ome/common/module.h>
 
 #include <ome/bioformats/FormatReader.h>
+#include <ome/bioformats/MetadataTools.h>
 #include <ome/bioformats/VariantPixelBuffer.h>
 #include <ome/bioformats/PixelProperties.h>
 #include <ome/bioformats/detail/FormatReader.h>
@@ -114,6 +116,30 @@ namespace
 
 }
 
+namespace
+{
+
+  // Fill a plane with its plane index.
+  struct PlaneFillVisitor : public boost::static_visitor<>
+  {
+    dimension_size_type plane;
+
+    PlaneFillVisitor(dimension_size_type plane):
+      plane(plane)
+    {}
+
+    template<typename T>
+    void
+    operator()(T& v) const
+    {
+      typedef typename T::element_type::value_type value_type;
+      std::fill(v->data(), v->data() + v->num_elements(),
+                pixel_value<value_type>(static_cast<uint32_t>(plane)));
+    }
+  };
+
+}
+
 class FormatReaderCustom : public ::ome::bioformats::detail::FormatReader
 {
 private:
@@ -250,7 +276,7 @@ public:
             dimension_size_type y,
             dimension_size_type w,
             dimension_size_type h,
-            dimension_size_type samples)
+            dimension_size_type samples) const
   {
     ::ome::bioformats::detail::FormatReader::readPlane(source, dest, x, y, w, h, samples);
   }
@@ -263,13 +289,49 @@ public:
             dimension_size_type w,
             dimension_size_type h,
             dimension_size_type scanlinePad,
-            dimension_size_type samples)
+            dimension_size_type samples) const
   {
     ::ome::bioformats::detail::FormatReader::readPlane(source, dest, x, y, w, h, scanlinePad, samples);
   }
 
 };
 
+// Fills each plane with its plane index.  Planes are always
+// interleaved, unlike the series, as for chunky RGB TIFF data.
+class FormatReaderFill : public FormatReaderCustom
+{
+public:
+  FormatReaderFill(const FormatReaderTestParameters& test_params):
+    FormatReaderCustom(test_params)
+  {
+  }
+
+protected:
+  void
+  openBytesImpl(dimension_size_type no,
+                VariantPixelBuffer& buf,
+                dimension_size_type /* x */,
+                dimension_size_type /* y */,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    assertId(currentId, true);
+
+    ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+    shape[::ome::bioformats::DIM_SPATIAL_X] = w;
+    shape[::ome::bioformats::DIM_SPATIAL_Y] = h;
+    shape[::ome::bioformats::DIM_SUBCHANNEL] = getRGBChannelCount(getZCTCoords(no)[1]);
+    shape[::ome::bioformats::DIM_SPATIAL_Z] = shape[::ome::bioformats::DIM_TEMPORAL_T] = shape[::ome::bioformats::DIM_CHANNEL] =
+      shape[::ome::bioformats::DIM_MODULO_Z] = shape[::ome::bioformats::DIM_MODULO_T] = shape[::ome::bioformats::DIM_MODULO_C] = 1;
+
+    buf.ensureBuffer(shape, getPixelType(),
+                     ::ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+
+    PlaneFillVisitor v(no);
+    boost::apply_visitor(v, buf.vbuffer());
+  }
+};
+
 class FormatReaderTest : public ::testing::TestWithParam<FormatReaderTestParameters>
 {
 public:
@@ -988,6 +1050,22 @@ TEST_P(FormatReaderTest, FlatMetadataStore)
   EXPECT_THROW(r.setMetadataStore(store), std::logic_error);
 }
 
+TEST_P(FormatReaderTest, FlatOriginalMetadataStore)
+{
+  ome::compat::shared_ptr<OMEXMLMetadata> omexml(ome::compat::make_shared<OMEXMLMetadata>());
+  ome::compat::shared_ptr<MetadataStore> store(omexml);
+
+  r.setMetadataStore(store);
+  r.setOriginalMetadataPopulated(true);
+  r.setId("flat");
+
+  // The caller's store is populated without using getMetadataStore().
+  MetadataMap original(ome::bioformats::getOriginalMetadata(*omexml));
+  EXPECT_FALSE(original.empty());
+  EXPECT_TRUE(original.find("Institution") != original.end());
+  EXPECT_TRUE(original.find("Series 0 Organism") != original.end());
+}
+
 TEST_P(FormatReaderTest, Readers)
 {
   EXPECT_TRUE(r.getUnderlyingReaders().empty());
@@ -1079,6 +1157,202 @@ TEST_P(FormatReaderTest, FlatPixels)
   boost::apply_visitor(v, buf.vbuffer());
 }
 
+TEST_P(FormatReaderTest, DefaultPlanes)
+{
+  VariantPixelBuffer buf;
+
+  EXPECT_THROW(r.openPlanes(dim(), dim(), buf), std::logic_error);
+}
+
+namespace
+{
+
+  struct PlanesCheck : public boost::static_visitor<>
+  {
+    const FormatReaderCustom& reader;
+    dim start;
+    dim count;
+
+    PlanesCheck(const FormatReaderCustom& reader,
+                const dim&                start,
+                const dim&                count):
+      reader(reader),
+      start(start),
+      count(count)
+    {}
+
+    template<typename T>
+    void
+    operator()(T& v) const
+    {
+      typedef typename T::element_type::value_type value_type;
+
+      ASSERT_EQ(count[0], v->shape()[::ome::bioformats::DIM_SPATIAL_Z]);
+      ASSERT_EQ(count[1], v->shape()[::ome::bioformats::DIM_CHANNEL]);
+      ASSERT_EQ(count[2], v->shape()[::ome::bioformats::DIM_TEMPORAL_T]);
+
+      ::ome::bioformats::PixelBufferBase::indices_type idx;
+      std::fill(idx.begin(), idx.end(), 0);
+      for (dimension_size_type z = 0; z < count[0]; ++z)
+        for (dimension_size_type c = 0; c < count[1]; ++c)
+          for (dimension_size_type t = 0; t < count[2]; ++t)
+            {
+              const value_type expected
+                (pixel_value<value_type>(static_cast<uint32_t>(reader.getIndex(start[0] + z, start[1] + c, start[2] + t))));
+              idx[::ome::bioformats::DIM_SPATIAL_Z] = static_cast< ::ome::bioformats::PixelBufferBase::index>(z);
+              idx[::ome::bioformats::DIM_CHANNEL] = static_cast< ::ome::bioformats::PixelBufferBase::index>(c);
+              idx[::ome::bioformats::DIM_TEMPORAL_T] = static_cast< ::ome::bioformats::PixelBufferBase::index>(t);
+              for (dimension_size_type s = 0; s < v->shape()[::ome::bioformats::DIM_SUBCHANNEL]; ++s)
+                for (dimension_size_type y = 0; y < v->shape()[::ome::bioformats::DIM_SPATIAL_Y]; ++y)
+                  for (dimension_size_type x = 0; x < v->shape()[::ome::bioformats::DIM_SPATIAL_X]; ++x)
+                    {
+                      idx[::ome::bioformats::DIM_SUBCHANNEL] = static_cast< ::ome::bioformats::PixelBufferBase::index>(s);
+                      idx[::ome::bioformats::DIM_SPATIAL_Y] = static_cast< ::ome::bioformats::PixelBufferBase::index>(y);
+                      idx[::ome::bioformats::DIM_SPATIAL_X] = static_cast< ::ome::bioformats::PixelBufferBase::index>(x);
+                      ASSERT_EQ(expected, v->at(idx));
+                    }
+            }
+    }
+  };
+
+}
+
+TEST_P(FormatReaderTest, FlatPlanes)
+{
+  FormatReaderFill r(GetParam());
+  r.setId("flat");
+
+  VariantPixelBuffer buf;
+
+  // Z and T range of the first channel, sub-image.
+  {
+    dim start = {{2, 0, 1}};
+    dim count = {{15, 1, 3}};
+    ASSERT_NO_THROW(r.openPlanes(start, count, buf, 16, 32, 8, 4));
+    EXPECT_EQ(8U * 4U * 15U * 3U, buf.num_elements());
+
+    PlanesCheck v(r, start, count);
+    boost::apply_visitor(v, buf.vbuffer());
+  }
+
+  // Single Z of the second (3 subchannel) channel, full plane.
+  {
+    dim start = {{7, 1, 4}};
+    dim count = {{1, 1, 1}};
+    ASSERT_NO_THROW(r.openPlanes(start, count, buf));
+    EXPECT_EQ(512U * 1024U * 3U, buf.num_elements());
+
+    PlanesCheck v(r, start, count);
+    boost::apply_visitor(v, buf.vbuffer());
+  }
+
+  // Invalid ranges.
+  {
+    dim start = {{0, 0, 0}};
+    dim count = {{21, 1, 1}};
+    EXPECT_THROW(r.openPlanes(start, count, buf, 0, 0, 8, 8), std::logic_error);
+    count[0] = 0;
+    EXPECT_THROW(r.openPlanes(start, count, buf, 0, 0, 8, 8), std::logic_error);
+    start[2] = 4;
+    count[0] = 1;
+    count[2] = 2;
+    EXPECT_THROW(r.openPlanes(start, count, buf, 0, 0, 8, 8), std::logic_error);
+  }
+
+  // Channels with differing subchannel counts.
+  {
+    dim start = {{0, 0, 0}};
+    dim count = {{1, 2, 1}};
+    EXPECT_THROW(r.openPlanes(start, count, buf, 0, 0, 8, 8), std::logic_error);
+  }
+}
+
+TEST_P(FormatReaderTest, FlatRegions)
+{
+  FormatReaderFill r(GetParam());
+  r.setId("flat");
+
+  std::vector<ome::bioformats::PlaneRegion> regions;
+  regions.push_back(ome::bioformats::PlaneRegion(0, 0, 8, 4));
+  regions.push_back(ome::bioformats::PlaneRegion(4, 2, 16, 8));
+  regions.push_back(ome::bioformats::PlaneRegion(16, 32, 8, 4));
+
+  std::vector<VariantPixelBuffer> bufs;
+  ASSERT_NO_THROW(r.openRegions(3, bufs, regions));
+  ASSERT_EQ(regions.size(), bufs.size());
+
+  for (std::vector<ome::bioformats::PlaneRegion>::size_type i = 0; i < regions.size(); ++i)
+    {
+      const ome::bioformats::PlaneRegion& region(regions[i]);
+
+      VariantPixelBuffer buf;
+      r.openBytes(3, buf, region.x, region.y, region.w, region.h);
+      EXPECT_TRUE(buf == bufs[i]);
+    }
+}
+
+TEST_P(FormatReaderTest, FlatPrefetch)
+{
+  FormatReaderFill r(GetParam());
+  r.setId("flat");
+
+  EXPECT_EQ(0U, r.getPrefetch());
+  r.setPrefetch(4);
+  EXPECT_EQ(4U, r.getPrefetch());
+
+  // Sequential reads of the last planes; all but the first two are
+  // prefetched.
+  const dimension_size_type first = r.getImageCount() - 20;
+  std::vector<VariantPixelBuffer> bufs(20);
+  for (dimension_size_type p = 0; p < bufs.size(); ++p)
+    ASSERT_NO_THROW(r.openBytes(first + p, bufs[p], 0, 0, 64, 32));
+
+  ome::bioformats::FormatReader::PrefetchStatistics stats(r.getPrefetchStatistics());
+  EXPECT_EQ(18U, stats.hits);
+  EXPECT_EQ(2U, stats.misses);
+  EXPECT_EQ(18U, stats.prefetched);
+  EXPECT_EQ(0U, stats.discarded);
+
+  // Explicit hint.
+  std::vector<dimension_size_type> planes;
+  planes.push_back(10);
+  planes.push_back(5);
+  ASSERT_NO_THROW(r.prefetchPlanes(planes));
+  VariantPixelBuffer hinted;
+  ASSERT_NO_THROW(r.openBytes(5, hinted));
+
+  stats = r.getPrefetchStatistics();
+  EXPECT_EQ(19U, stats.hits);
+  EXPECT_EQ(20U, stats.prefetched);
+
+  planes.push_back(r.getImageCount());
+  EXPECT_THROW(r.prefetchPlanes(planes), std::logic_error);
+
+  // Plane ranges are read directly, and do not trigger prefetching.
+  {
+    dim start = {{2, 0, 1}};
+    dim count = {{15, 1, 3}};
+    VariantPixelBuffer range;
+    ASSERT_NO_THROW(r.openPlanes(start, count, range, 0, 0, 8, 4));
+    stats = r.getPrefetchStatistics();
+    EXPECT_EQ(19U, stats.hits);
+    EXPECT_EQ(2U, stats.misses);
+    EXPECT_EQ(20U, stats.prefetched);
+  }
+
+  // Prefetched data matches direct reads.
+  r.setPrefetch(0);
+  for (dimension_size_type p = 0; p < bufs.size(); ++p)
+    {
+      VariantPixelBuffer buf;
+      r.openBytes(first + p, buf, 0, 0, 64, 32);
+      EXPECT_TRUE(buf == bufs[p]);
+    }
+  VariantPixelBuffer buf;
+  r.openBytes(5, buf);
+  EXPECT_TRUE(buf == hinted);
+}
+
 FormatReaderTestParameters variant_params[] =
   { //                         PixelType          EndianType
     FormatReaderTestParameters(PT::INT8,          ome::bioformats::ENDIAN_BIG),
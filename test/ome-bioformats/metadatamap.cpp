@@ -400,6 +400,59 @@ TEST_F(MetadataMapTest, Flatten)
   ASSERT_EQ(os.str(), expected);
 }
 
+TEST_F(MetadataMapTest, FlattenInPlace)
+{
+  for (uint32_t i = 40; i >= 24; --i)
+    m.append("padtest", i);
+
+  ASSERT_TRUE(m.hasLists());
+
+  MetadataMap flat = m.flatten();
+  m.flattenInPlace();
+
+  ASSERT_FALSE(m.hasLists());
+  ASSERT_EQ(flat.size(), m.size());
+  ASSERT_EQ(flat, m);
+}
+
+TEST_F(MetadataMapTest, AppendReplacesScalar)
+{
+  m.append("int1", std::string("s1"));
+  m.append("int1", std::string("s2"));
+
+  int32_t i = 0;
+  ASSERT_FALSE(m.get("int1", i));
+
+  std::vector<std::string> vs;
+  ASSERT_TRUE(m.get("int1", vs));
+  ASSERT_EQ(2U, vs.size());
+}
+
+TEST_F(MetadataMapTest, Prefix)
+{
+  MetadataMap m2;
+  m2.set("key1", int32_t(1));
+  m2.set("key2", int32_t(2));
+
+  m.merge(m2, "Series 0 ");
+  m.merge(m2, "Series 1 ");
+  ASSERT_EQ(m.size(), 7U);
+
+  std::pair<MetadataMap::const_iterator, MetadataMap::const_iterator> range(cm.prefix("Series 1 "));
+  std::vector<std::string> keys;
+  for (MetadataMap::const_iterator i = range.first;
+       i != range.second;
+       ++i)
+    keys.push_back(i->first);
+
+  ASSERT_EQ(2U, keys.size());
+  ASSERT_EQ(std::string("Series 1 key1"), keys[0]);
+  ASSERT_EQ(std::string("Series 1 key2"), keys[1]);
+
+  range = cm.prefix("nonexistent");
+  ASSERT_TRUE(range.first == range.second);
+}
+
 TEST_F(MetadataMapTest, Size)
 {
   ASSERT_EQ(m.size(), 3U);
@@ -687,6 +687,104 @@ TEST_P(ModelTest, CreateMetadataFromString)
   ASSERT_NO_THROW(meta = createOMEXMLMetadata(input));
 }
 
+TEST_P(ModelTest, CreateMetadataFromStringMatchesFile)
+{
+  const ModelTestParameters& params = GetParam();
+
+  std::string input;
+  readFile(params.file, input);
+
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> filemeta;
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> textmeta;
+  ASSERT_NO_THROW(filemeta = createOMEXMLMetadata(params.file));
+  ASSERT_NO_THROW(textmeta = createOMEXMLMetadata(input));
+
+  // TiffData elements may be streamed from text; check they are
+  // identical to those in the full DOM.
+  ASSERT_EQ(filemeta->getImageCount(), textmeta->getImageCount());
+  for (dimension_size_type i = 0; i < filemeta->getImageCount(); ++i)
+    {
+      ASSERT_EQ(filemeta->getTiffDataCount(i), textmeta->getTiffDataCount(i));
+      for (dimension_size_type td = 0; td < filemeta->getTiffDataCount(i); ++td)
+        {
+          std::string fileuuid, textuuid;
+          try
+            {
+              fileuuid = filemeta->getUUIDValue(i, td);
+            }
+          catch (const std::exception&)
+            {
+            }
+          try
+            {
+              textuuid = textmeta->getUUIDValue(i, td);
+            }
+          catch (const std::exception&)
+            {
+            }
+          EXPECT_EQ(fileuuid, textuuid);
+        }
+    }
+
+  EXPECT_EQ(ome::bioformats::getOMEXML(*filemeta, false),
+            ome::bioformats::getOMEXML(*textmeta, false));
+}
+
+TEST(MetadataToolsTest, CreateMetadataFromStringTiffDataDefaults)
+{
+  const std::string ns("http://www.openmicroscopy.org/Schemas/OME/" OME_XML_MODEL_VERSION);
+  const std::string text
+    ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+     "<OME xmlns=\"" + ns + "\" "
+     "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+     "xsi:schemaLocation=\"" + ns + " " + ns + "/ome.xsd\">"
+     "<Image ID=\"Image:0\">"
+     "<Pixels ID=\"Pixels:0\" DimensionOrder=\"XYZCT\" Type=\"uint8\" "
+     "SizeX=\"2\" SizeY=\"2\" SizeZ=\"3\" SizeC=\"1\" SizeT=\"1\">"
+     "<Channel ID=\"Channel:0:0\" SamplesPerPixel=\"1\"/>"
+     "<TiffData PlaneCount=\"1\"/>"
+     "<TiffData IFD=\"1\" FirstZ=\"1\" PlaneCount=\"1\"/>"
+     "<TiffData FirstZ=\"2\">"
+     "<UUID FileName=\"other.ome.tiff\">urn:uuid:2d3a8c6e-3b5e-4c55-9a0b-2b1f7e0d9c41</UUID>"
+     "</TiffData>"
+     "</Pixels>"
+     "</Image>"
+     "</OME>");
+
+  // Reference model from the full document with schema processing.
+  ome::common::xml::Platform xmlplat;
+  ome::common::xml::dom::Document doc(ome::xml::createDocument(text, ome::common::xml::dom::ParseParameters(),
+                                                               "OME-XML text"));
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> dommeta;
+  ASSERT_NO_THROW(dommeta = createOMEXMLMetadata(doc));
+
+  // Model with TiffData streamed from text.
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> textmeta;
+  ASSERT_NO_THROW(textmeta = createOMEXMLMetadata(text));
+
+  ASSERT_EQ(1U, textmeta->getImageCount());
+  ASSERT_EQ(3U, textmeta->getTiffDataCount(0));
+
+  // Omitted attributes take their schema defaults, whether or not
+  // the element was streamed.
+  for (dimension_size_type td = 0; td < 3; ++td)
+    {
+      EXPECT_EQ(td, static_cast<dimension_size_type>(textmeta->getTiffDataFirstZ(0, td)));
+      EXPECT_EQ(0U, static_cast<dimension_size_type>(textmeta->getTiffDataFirstT(0, td)));
+      EXPECT_EQ(0U, static_cast<dimension_size_type>(textmeta->getTiffDataFirstC(0, td)));
+    }
+  EXPECT_EQ(0U, static_cast<dimension_size_type>(textmeta->getTiffDataIFD(0, 0)));
+  EXPECT_EQ(1U, static_cast<dimension_size_type>(textmeta->getTiffDataIFD(0, 1)));
+  EXPECT_EQ(0U, static_cast<dimension_size_type>(textmeta->getTiffDataIFD(0, 2)));
+  EXPECT_EQ(std::string("other.ome.tiff"), textmeta->getUUIDFileName(0, 2));
+
+  EXPECT_EQ(ome::bioformats::getOMEXML(*dommeta, false),
+            ome::bioformats::getOMEXML(*textmeta, false));
+
+  // Malformed XML is reported as an error.
+  EXPECT_THROW(createOMEXMLMetadata(text.substr(0, text.size() - 10)), std::exception);
+}
+
 // Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
 // this is solely to work around a missing prototype in gtest.
 #ifdef __GNUC__
@@ -36,12 +36,23 @@
  * #L%
  */
 
+#include <algorithm>
+#include <fstream>
+#include <set>
 #include <stdexcept>
 #include <vector>
 
+#include <boost/lexical_cast.hpp>
+#include <boost/range/size.hpp>
+
 #include <ome/bioformats/CoreMetadata.h>
+#include <ome/bioformats/FormatException.h>
 #include <ome/bioformats/MetadataTools.h>
+#include <ome/bioformats/PixelCopy.h>
+#include <ome/bioformats/PlaneRegion.h>
 #include <ome/bioformats/VariantPixelBuffer.h>
+#include <ome/bioformats/detail/TIFFHandlePool.h>
+#include <ome/bioformats/in/OMETIFFReader.h>
 #include <ome/bioformats/out/OMETIFFWriter.h>
 #include <ome/bioformats/tiff/Field.h>
 #include <ome/bioformats/tiff/IFD.h>
@@ -58,6 +69,8 @@
 using ome::bioformats::dimension_size_type;
 using ome::bioformats::CoreMetadata;
 using ome::bioformats::VariantPixelBuffer;
+using ome::bioformats::detail::TIFFHandlePool;
+using ome::bioformats::in::OMETIFFReader;
 using ome::bioformats::out::OMETIFFWriter;
 using ome::bioformats::tiff::IFD;
 using ome::bioformats::tiff::TIFF;
@@ -121,6 +134,115 @@ public:
     ASSERT_NO_THROW(ifd->getField(ome::bioformats::tiff::SAMPLESPERPIXEL).get(samples));
   }
 
+  /**
+   * Write a multi-file OME-TIFF dataset.
+   *
+   * Each series is a copy of the first IFD of the test TIFF, and is
+   * written to a separate file.
+   *
+   * @param name the name to add to the dataset filenames.
+   * @param seriesCount the number of series to write.
+   * @param writermeta if not null, set to the metadata used by the
+   * writer.
+   * @returns the files written, one per series.
+   */
+  std::vector<path>
+  writeSeriesFiles(const std::string&                                        name,
+                   dimension_size_type                                       seriesCount,
+                   ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> *writermeta = 0)
+  {
+    std::vector<path> files;
+
+    ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+    std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList;
+    for (dimension_size_type i = 0U; i < seriesCount; ++i)
+      seriesList.push_back(ome::bioformats::tiff::makeCoreMetadata(*ifd));
+
+    ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+    ome::bioformats::fillMetadata(*meta, seriesList);
+    ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+    OMETIFFWriter writer;
+    writer.setMetadataRetrieve(retrieve);
+    writer.setInterleaved(true);
+
+    VariantPixelBuffer buf;
+    ifd->readImage(buf);
+
+    ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+    shape[ome::bioformats::DIM_SPATIAL_X] = ifd->getImageWidth();
+    shape[ome::bioformats::DIM_SPATIAL_Y] = ifd->getImageHeight();
+    shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+    shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+      shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+
+    ome::bioformats::PixelBufferBase::storage_order_type order(ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+
+    VariantPixelBuffer src(shape, ifd->getPixelType(), order);
+    src = buf;
+
+    for (dimension_size_type i = 0U; i < seriesCount; ++i)
+      {
+        path seriesfile(testfile.parent_path() /
+                        (testfile.stem().stem().string() + "-" + name + "-" +
+                         boost::lexical_cast<std::string>(i) + ".ome.tiff"));
+        writer.setId(seriesfile);
+        if (writermeta && !*writermeta)
+          *writermeta = ome::compat::dynamic_pointer_cast< ::ome::xml::meta::OMEXMLMetadata>(writer.getMetadataRetrieve());
+        writer.setSeries(i);
+        writer.saveBytes(0, src);
+        files.push_back(seriesfile);
+      }
+    writer.close();
+
+    return files;
+  }
+
+  /**
+   * Write a TIFF with the specified ImageDescription.
+   *
+   * Each IFD is a copy of the first IFD of the test TIFF.  The
+   * description is set in the first IFD only.
+   *
+   * @param file the file to write.
+   * @param text the ImageDescription text.
+   * @param ifdCount the number of IFDs to write.
+   */
+  void
+  writeDescription(const path&         file,
+                   const std::string&  text,
+                   dimension_size_type ifdCount)
+  {
+    ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+    VariantPixelBuffer buf;
+    ifd->readImage(buf);
+
+    ome::compat::shared_ptr<TIFF> wtiff(TIFF::open(file, "w"));
+    for (dimension_size_type i = 0U; i < ifdCount; ++i)
+      {
+        ome::compat::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+        wifd->setImageWidth(ifd->getImageWidth());
+        wifd->setImageHeight(ifd->getImageHeight());
+        wifd->setTileType(ome::bioformats::tiff::STRIP);
+        wifd->setTileWidth(ifd->getImageWidth());
+        wifd->setTileHeight(1U);
+        wifd->setPixelType(ifd->getPixelType());
+        wifd->setBitsPerSample(ifd->getBitsPerSample());
+        wifd->setSamplesPerPixel(ifd->getSamplesPerPixel());
+        wifd->setPlanarConfiguration(ifd->getPlanarConfiguration());
+        // A palette would require a colormap.
+        ome::bioformats::tiff::PhotometricInterpretation photometric(ifd->getPhotometricInterpretation());
+        if (photometric == ome::bioformats::tiff::PALETTE)
+          photometric = ome::bioformats::tiff::MIN_IS_BLACK;
+        wifd->setPhotometricInterpretation(photometric);
+        if (i == 0U)
+          wifd->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).set(text);
+        wifd->writeImage(buf);
+        wtiff->writeCurrentDirectory();
+      }
+    wtiff->close();
+  }
+
   void
   TearDown()
   {
@@ -181,6 +303,993 @@ TEST_P(TIFFWriterTest, setId)
   tiffwriter.close();
 }
 
+TEST_P(TIFFWriterTest, OutOfOrder)
+{
+  std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList;
+  for (TIFF::const_iterator i = tiff->begin();
+       i != tiff->end();
+       ++i)
+    {
+      ome::compat::shared_ptr<CoreMetadata> c = ome::bioformats::tiff::makeCoreMetadata(**i);
+      seriesList.push_back(c);
+    }
+
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+  ome::bioformats::fillMetadata(*meta, seriesList);
+  ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+  tiffwriter.setMetadataRetrieve(retrieve);
+
+  bool interleaved = true;
+
+  tiffwriter.setInterleaved(interleaved);
+
+  path outoforder(testfile.parent_path() /
+                  (testfile.stem().stem().string() + "-outoforder.ome.tiff"));
+  ASSERT_NO_THROW(tiffwriter.setId(outoforder));
+
+  // Write series in reverse order.
+  VariantPixelBuffer buf;
+  for (dimension_size_type i = seriesList.size(); i > 0U; --i)
+    {
+      const dimension_size_type series = i - 1U;
+      ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(series);
+      ASSERT_TRUE(static_cast<bool>(ifd));
+      ifd->readImage(buf);
+
+      ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+      shape[ome::bioformats::DIM_SPATIAL_X] = ifd->getImageWidth();
+      shape[ome::bioformats::DIM_SPATIAL_Y] = ifd->getImageHeight();
+      shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+      shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+        shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+
+      ome::bioformats::PixelBufferBase::storage_order_type order(ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, interleaved));
+
+      VariantPixelBuffer src(shape, ifd->getPixelType(), order);
+      src = buf;
+
+      ASSERT_NO_THROW(tiffwriter.setSeries(series));
+      ASSERT_NO_THROW(tiffwriter.saveBytes(0, src));
+
+      // Planes may not be rewritten once flushed.
+      if (i < seriesList.size())
+        {
+          ASSERT_NO_THROW(tiffwriter.setSeries(series + 1U));
+          EXPECT_THROW(tiffwriter.saveBytes(0, src), ome::bioformats::FormatException);
+        }
+    }
+  tiffwriter.close();
+
+  // Reading back gives the source pixels for each series, and the
+  // TiffData IFD for each series refers to its pixel data.
+  OMETIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(outoforder));
+  ASSERT_EQ(seriesList.size(), reader.getSeriesCount());
+
+  ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> written
+    (ome::compat::dynamic_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(reader.getMetadataStore()));
+  ASSERT_TRUE(static_cast<bool>(written));
+
+  ome::compat::shared_ptr<TIFF> writtentiff;
+  ASSERT_NO_THROW(writtentiff = TIFF::open(outoforder, "r"));
+
+  std::set<dimension_size_type> ifds;
+  for (dimension_size_type series = 0U; series < seriesList.size(); ++series)
+    {
+      ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(series);
+      ASSERT_TRUE(static_cast<bool>(ifd));
+      VariantPixelBuffer reference;
+      ifd->readImage(reference);
+
+      reader.setSeries(series);
+      VariantPixelBuffer pixels;
+      ASSERT_NO_THROW(reader.openBytes(0U, pixels));
+      EXPECT_TRUE(pixels == reference);
+
+      ASSERT_EQ(1U, written->getTiffDataCount(series));
+      dimension_size_type ifdIndex = static_cast<dimension_size_type>(written->getTiffDataIFD(series, 0U));
+      EXPECT_TRUE(ifds.insert(ifdIndex).second);
+
+      ome::compat::shared_ptr<IFD> writtenifd = writtentiff->getDirectoryByIndex(ifdIndex);
+      ASSERT_TRUE(static_cast<bool>(writtenifd));
+      VariantPixelBuffer ifdpixels;
+      writtenifd->readImage(ifdpixels);
+      EXPECT_TRUE(ifdpixels == reference);
+    }
+  reader.close();
+
+  // Strict ordering is still enforced on request.
+  OMETIFFWriter sequentialwriter;
+  sequentialwriter.setMetadataRetrieve(retrieve);
+  sequentialwriter.setWriteSequentially(true);
+  path sequential(testfile.parent_path() /
+                  (testfile.stem().stem().string() + "-sequential.ome.tiff"));
+  ASSERT_NO_THROW(sequentialwriter.setId(sequential));
+  if (seriesList.size() > 2U)
+    EXPECT_THROW(sequentialwriter.setSeries(2U), std::logic_error);
+  sequentialwriter.close();
+}
+
+TEST_P(TIFFWriterTest, ConcurrentWrite)
+{
+  std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList;
+  for (TIFF::const_iterator i = tiff->begin();
+       i != tiff->end();
+       ++i)
+    {
+      ome::compat::shared_ptr<CoreMetadata> c = ome::bioformats::tiff::makeCoreMetadata(**i);
+      seriesList.push_back(c);
+    }
+
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+  ome::bioformats::fillMetadata(*meta, seriesList);
+  ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+  tiffwriter.setMetadataRetrieve(retrieve);
+
+  bool interleaved = true;
+
+  tiffwriter.setInterleaved(interleaved);
+
+  EXPECT_FALSE(tiffwriter.getConcurrentWrite());
+  tiffwriter.setConcurrentWrite(true);
+  EXPECT_TRUE(tiffwriter.getConcurrentWrite());
+
+  // Write each series to a separate file.
+  VariantPixelBuffer buf;
+  for (dimension_size_type i = 0U; i < seriesList.size(); ++i)
+    {
+      path seriesfile(testfile.parent_path() /
+                      (testfile.stem().stem().string() + "-concurrent-" +
+                       boost::lexical_cast<std::string>(i) + ".ome.tiff"));
+      ASSERT_NO_THROW(tiffwriter.setId(seriesfile));
+
+      ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(i);
+      ASSERT_TRUE(static_cast<bool>(ifd));
+      ifd->readImage(buf);
+
+      ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+      shape[ome::bioformats::DIM_SPATIAL_X] = ifd->getImageWidth();
+      shape[ome::bioformats::DIM_SPATIAL_Y] = ifd->getImageHeight();
+      shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+      shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+        shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+
+      ome::bioformats::PixelBufferBase::storage_order_type order(ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, interleaved));
+
+      VariantPixelBuffer src(shape, ifd->getPixelType(), order);
+      src = buf;
+
+      ASSERT_NO_THROW(tiffwriter.setSeries(i));
+      ASSERT_NO_THROW(tiffwriter.saveBytes(0, src));
+    }
+  ASSERT_NO_THROW(tiffwriter.close());
+  EXPECT_FALSE(tiffwriter.getConcurrentWrite());
+
+  // Each file contains the pixel data for its series.
+  for (dimension_size_type i = 0U; i < seriesList.size(); ++i)
+    {
+      path seriesfile(testfile.parent_path() /
+                      (testfile.stem().stem().string() + "-concurrent-" +
+                       boost::lexical_cast<std::string>(i) + ".ome.tiff"));
+      ome::compat::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(seriesfile, "r"));
+      ome::compat::shared_ptr<IFD> ifd = written->getDirectoryByIndex(0);
+      ASSERT_TRUE(static_cast<bool>(ifd));
+      EXPECT_EQ(tiff->getDirectoryByIndex(i)->getImageWidth(), ifd->getImageWidth());
+      EXPECT_EQ(tiff->getDirectoryByIndex(i)->getImageHeight(), ifd->getImageHeight());
+
+      VariantPixelBuffer reference;
+      tiff->getDirectoryByIndex(i)->readImage(reference);
+      ASSERT_NO_THROW(ifd->readImage(buf));
+      EXPECT_TRUE(buf == reference);
+
+      // The embedded OME-XML describes every series, and maps this
+      // series to the first IFD of this file.
+      std::string omexml;
+      ASSERT_NO_THROW(ifd->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(omexml));
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> filemeta;
+      ASSERT_NO_THROW(filemeta = ome::bioformats::createOMEXMLMetadata(omexml));
+      ASSERT_TRUE(static_cast<bool>(filemeta));
+      ASSERT_EQ(seriesList.size(), filemeta->getImageCount());
+      EXPECT_EQ(static_cast<dimension_size_type>(ifd->getImageWidth()),
+                static_cast<dimension_size_type>(filemeta->getPixelsSizeX(i)));
+      EXPECT_EQ(static_cast<dimension_size_type>(ifd->getImageHeight()),
+                static_cast<dimension_size_type>(filemeta->getPixelsSizeY(i)));
+      ASSERT_EQ(1U, filemeta->getTiffDataCount(i));
+      EXPECT_EQ(0U, static_cast<dimension_size_type>(filemeta->getTiffDataIFD(i, 0U)));
+      EXPECT_EQ(seriesfile.filename().generic_string(), filemeta->getUUIDFileName(i, 0U));
+    }
+}
+
+TEST_P(TIFFWriterTest, ReaderModes)
+{
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("modes", 3U));
+
+  // Reference metadata and pixels using the default reader settings.
+  std::vector<CoreMetadata> refcore;
+  std::vector<VariantPixelBuffer> refpixels;
+  {
+    OMETIFFReader reader;
+    EXPECT_FALSE(reader.getConcurrentProbe());
+    EXPECT_FALSE(reader.getTrustOMEXML());
+    ASSERT_NO_THROW(reader.setId(files.at(0)));
+    ASSERT_EQ(files.size(), reader.getSeriesCount());
+    for (dimension_size_type series = 0U; series < reader.getSeriesCount(); ++series)
+      {
+        reader.setSeries(series);
+        refcore.push_back(*reader.getCoreMetadataList().at(reader.getCoreIndex()));
+        refpixels.push_back(VariantPixelBuffer());
+        ASSERT_NO_THROW(reader.openBytes(0U, refpixels.back()));
+      }
+    reader.close();
+  }
+
+  // Concurrent probing, trusted OME-XML, and both combined.
+  for (int mode = 1; mode < 4; ++mode)
+    {
+      OMETIFFReader reader;
+      reader.setConcurrentProbe((mode & 1) != 0);
+      reader.setTrustOMEXML((mode & 2) != 0);
+      EXPECT_EQ((mode & 1) != 0, reader.getConcurrentProbe());
+      EXPECT_EQ((mode & 2) != 0, reader.getTrustOMEXML());
+
+      ASSERT_NO_THROW(reader.setId(files.at(0)));
+      ASSERT_EQ(refcore.size(), reader.getSeriesCount());
+      for (dimension_size_type series = 0U; series < reader.getSeriesCount(); ++series)
+        {
+          reader.setSeries(series);
+          const CoreMetadata& ref(refcore.at(series));
+          EXPECT_EQ(ref.sizeX, reader.getSizeX());
+          EXPECT_EQ(ref.sizeY, reader.getSizeY());
+          EXPECT_EQ(ref.sizeZ, reader.getSizeZ());
+          EXPECT_EQ(ref.sizeT, reader.getSizeT());
+          EXPECT_EQ(ref.sizeC, reader.getCoreMetadataList().at(reader.getCoreIndex())->sizeC);
+          EXPECT_EQ(ref.pixelType, reader.getPixelType());
+          EXPECT_EQ(ref.imageCount, reader.getImageCount());
+          EXPECT_EQ(ref.dimensionOrder, reader.getDimensionOrder());
+
+          VariantPixelBuffer pixels;
+          ASSERT_NO_THROW(reader.openBytes(0U, pixels));
+          EXPECT_TRUE(pixels == refpixels.at(series));
+        }
+      reader.close();
+    }
+
+  // A TIFF which does not match the OME-XML is only detected when
+  // its pixels are first read if the OME-XML is trusted.
+  for (int mismatch = 0; mismatch < 2; ++mismatch)
+    {
+      std::vector<path> mfiles;
+      ASSERT_NO_THROW(mfiles = writeSeriesFiles("mismatch", 2U));
+
+      ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+      ome::compat::shared_ptr<CoreMetadata> c(ome::bioformats::tiff::makeCoreMetadata(*ifd));
+      if (mismatch == 0)
+        c->sizeX /= 2U;
+      else
+        c->pixelType = (c->pixelType == ome::xml::model::enums::PixelType::UINT8 ?
+                        ome::xml::model::enums::PixelType::UINT16 :
+                        ome::xml::model::enums::PixelType::UINT8);
+
+      std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList(1U, c);
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+      ome::bioformats::fillMetadata(*meta, seriesList);
+      ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+      ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+      shape[ome::bioformats::DIM_SPATIAL_X] = c->sizeX;
+      shape[ome::bioformats::DIM_SPATIAL_Y] = c->sizeY;
+      shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+      shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+        shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+      VariantPixelBuffer src(shape, c->pixelType,
+                             ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+
+      // Replace the second file with a TIFF of a different size or
+      // pixel type.
+      path replacement(testfile.parent_path() /
+                       (testfile.stem().stem().string() + "-replacement.ome.tiff"));
+      {
+        OMETIFFWriter writer;
+        writer.setMetadataRetrieve(retrieve);
+        writer.setInterleaved(true);
+        ASSERT_NO_THROW(writer.setId(replacement));
+        ASSERT_NO_THROW(writer.saveBytes(0, src));
+        writer.close();
+      }
+      remove(mfiles.at(1));
+      copy_file(replacement, mfiles.at(1));
+
+      OMETIFFReader reader;
+      reader.setTrustOMEXML(true);
+      ASSERT_NO_THROW(reader.setId(mfiles.at(0)));
+      ASSERT_EQ(2U, reader.getSeriesCount());
+
+      VariantPixelBuffer pixels;
+      reader.setSeries(0U);
+      EXPECT_NO_THROW(reader.openBytes(0U, pixels));
+      reader.setSeries(1U);
+      EXPECT_THROW(reader.openBytes(0U, pixels), ome::bioformats::FormatException);
+      reader.close();
+    }
+}
+
+TEST_P(TIFFWriterTest, TrustPrefetch)
+{
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("trustprefetch", 3U));
+
+  std::vector<dimension_size_type> widths, heights;
+  std::vector<VariantPixelBuffer> refpixels;
+  {
+    OMETIFFReader reader;
+    ASSERT_NO_THROW(reader.setId(files.at(0)));
+    for (dimension_size_type series = 0U; series < reader.getSeriesCount(); ++series)
+      {
+        reader.setSeries(series);
+        widths.push_back(reader.getOptimalTileWidth(0U));
+        heights.push_back(reader.getOptimalTileHeight(0U));
+        refpixels.push_back(VariantPixelBuffer());
+        ASSERT_NO_THROW(reader.openBytes(0U, refpixels.back()));
+      }
+    reader.close();
+  }
+
+  // With trusted OME-XML, the tile sizes are read from the TIFF on
+  // demand, which must not race with the prefetch thread.
+  OMETIFFReader reader;
+  reader.setTrustOMEXML(true);
+  ASSERT_NO_THROW(reader.setId(files.at(0)));
+  reader.setPrefetch(4U);
+  for (int repeat = 0; repeat < 20; ++repeat)
+    {
+      for (dimension_size_type series = 0U; series < reader.getSeriesCount(); ++series)
+        {
+          reader.setSeries(series);
+          ASSERT_NO_THROW(reader.prefetchPlanes(std::vector<dimension_size_type>(1U, 0U)));
+          EXPECT_EQ(widths.at(series), reader.getOptimalTileWidth(0U));
+          EXPECT_EQ(heights.at(series), reader.getOptimalTileHeight(0U));
+
+          VariantPixelBuffer pixels;
+          ASSERT_NO_THROW(reader.openBytes(0U, pixels));
+          EXPECT_TRUE(pixels == refpixels.at(series));
+        }
+    }
+  reader.close();
+}
+
+namespace
+{
+
+  /**
+   * Read each series sequentially, interleaved with other use.
+   *
+   * Each plane read is followed by a change of series, a lookup
+   * table read and region reads, so that with prefetching enabled
+   * these run while the following planes of the previous series are
+   * read in the background.
+   *
+   * @param reader the reader to use.
+   * @param bufs the planes and regions read, in order.
+   * @param luts whether each lookup table read succeeded, in order.
+   */
+  void
+  readInterleaved(const ome::bioformats::FormatReader& reader,
+                  std::vector<VariantPixelBuffer>&     bufs,
+                  std::vector<bool>&                   luts)
+  {
+    std::vector<ome::bioformats::PlaneRegion> regions;
+    regions.push_back(ome::bioformats::PlaneRegion(0, 0, 8, 8));
+    regions.push_back(ome::bioformats::PlaneRegion(4, 4, 8, 8));
+
+    for (int repeat = 0; repeat < 5; ++repeat)
+      {
+        for (dimension_size_type series = 0U; series < reader.getSeriesCount(); ++series)
+          {
+            reader.setSeries(series);
+            for (dimension_size_type plane = 0U; plane < reader.getImageCount(); ++plane)
+              {
+                bufs.push_back(VariantPixelBuffer());
+                ASSERT_NO_THROW(reader.openBytes(plane, bufs.back()));
+
+                reader.setSeries((series + 1U) % reader.getSeriesCount());
+                VariantPixelBuffer lut;
+                try
+                  {
+                    reader.getLookupTable(0U, lut);
+                    luts.push_back(true);
+                    bufs.push_back(lut);
+                  }
+                catch (const ome::bioformats::FormatException&)
+                  {
+                    luts.push_back(false);
+                  }
+
+                std::vector<VariantPixelBuffer> regionbufs;
+                ASSERT_NO_THROW(reader.openRegions(0U, regionbufs, regions));
+                bufs.insert(bufs.end(), regionbufs.begin(), regionbufs.end());
+
+                reader.setSeries(series);
+              }
+          }
+      }
+  }
+
+}
+
+TEST_P(TIFFWriterTest, PrefetchInterleaved)
+{
+  ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+  VariantPixelBuffer reference;
+  ifd->readImage(reference);
+
+  // Each series differs in width, and each plane is a different
+  // part of the test image, so that a plane read from the wrong
+  // series or plane is detected.
+  const dimension_size_type seriesCount = 3U;
+  const dimension_size_type planeCount = 4U;
+  std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList;
+  for (dimension_size_type s = 0U; s < seriesCount; ++s)
+    {
+      ome::compat::shared_ptr<CoreMetadata> core(ome::bioformats::tiff::makeCoreMetadata(*ifd));
+      core->sizeX -= planeCount - 1U + s;
+      core->sizeT = planeCount;
+      core->imageCount = planeCount;
+      seriesList.push_back(core);
+    }
+
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+  ome::bioformats::fillMetadata(*meta, seriesList);
+  ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+  path seriesfile(testfile.parent_path() /
+                  (testfile.stem().stem().string() + "-prefetch.ome.tiff"));
+  {
+    OMETIFFWriter writer;
+    writer.setMetadataRetrieve(retrieve);
+    writer.setInterleaved(true);
+    ASSERT_NO_THROW(writer.setId(seriesfile));
+    for (dimension_size_type s = 0U; s < seriesCount; ++s)
+      {
+        const CoreMetadata& core(*seriesList.at(s));
+
+        ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[ome::bioformats::DIM_SPATIAL_X] = core.sizeX;
+        shape[ome::bioformats::DIM_SPATIAL_Y] = core.sizeY;
+        shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+        shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+          shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+
+        ASSERT_NO_THROW(writer.setSeries(s));
+        for (dimension_size_type p = 0U; p < planeCount; ++p)
+          {
+            VariantPixelBuffer src(shape, ifd->getPixelType(),
+                                   ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+            ASSERT_NO_THROW(ome::bioformats::copyRegion(reference,
+                                                        ome::bioformats::PlaneRegion(p, 0, core.sizeX, core.sizeY),
+                                                        src, 0, 0));
+            ASSERT_NO_THROW(writer.saveBytes(p, src));
+          }
+      }
+    ASSERT_NO_THROW(writer.close());
+  }
+
+  std::vector<VariantPixelBuffer> refbufs;
+  std::vector<bool> refluts;
+  {
+    OMETIFFReader reader;
+    ASSERT_NO_THROW(reader.setId(seriesfile));
+    ASSERT_EQ(seriesCount, reader.getSeriesCount());
+    readInterleaved(reader, refbufs, refluts);
+    reader.close();
+  }
+
+  OMETIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(seriesfile));
+  reader.setPrefetch(planeCount);
+  std::vector<VariantPixelBuffer> bufs;
+  std::vector<bool> luts;
+  readInterleaved(reader, bufs, luts);
+  EXPECT_LT(0U, reader.getPrefetchStatistics().hits);
+  reader.close();
+
+  EXPECT_TRUE(luts == refluts);
+  ASSERT_EQ(refbufs.size(), bufs.size());
+  for (std::vector<VariantPixelBuffer>::size_type i = 0U; i < bufs.size(); ++i)
+    EXPECT_TRUE(bufs.at(i) == refbufs.at(i)) << "Buffer " << i;
+}
+
+TEST_P(TIFFWriterTest, ProbeLimit)
+{
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("probelimit", 4U));
+
+  // Probing must not open more files than the pool can hold, else
+  // they are evicted and opened again when checked.
+  TIFFHandlePool& pool(TIFFHandlePool::instance());
+  const dimension_size_type oldLimit = pool.getLimit();
+  pool.setLimit(2U);
+
+  OMETIFFReader reader;
+  reader.setConcurrentProbe(true);
+  const TIFFHandlePool::Statistics before(pool.getStatistics());
+  EXPECT_NO_THROW(reader.setId(files.at(0)));
+  const TIFFHandlePool::Statistics after(pool.getStatistics());
+  EXPECT_EQ(files.size(), after.opened - before.opened);
+  EXPECT_EQ(files.size(), reader.getSeriesCount());
+  reader.close();
+
+  pool.setLimit(oldLimit);
+}
+
+TEST_P(TIFFWriterTest, Comment)
+{
+  ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList(1U, ome::bioformats::tiff::makeCoreMetadata(*ifd));
+
+  VariantPixelBuffer reference;
+  ifd->readImage(reference);
+
+  ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::bioformats::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::bioformats::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+    shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+  VariantPixelBuffer src(shape, ifd->getPixelType(),
+                         ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+  src = reference;
+
+  // The OME-XML text is appended and referenced from the existing
+  // ImageDescription entry, which differs for classic and BigTIFF.
+  for (int big = 0; big < 2; ++big)
+    {
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+      ome::bioformats::fillMetadata(*meta, seriesList);
+      ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+      path commentfile(testfile.parent_path() /
+                       (testfile.stem().stem().string() + "-comment-" +
+                        boost::lexical_cast<std::string>(big) + ".ome.tiff"));
+      {
+        OMETIFFWriter writer;
+        writer.setMetadataRetrieve(retrieve);
+        writer.setBigTIFF(big != 0);
+        writer.setInterleaved(true);
+        ASSERT_NO_THROW(writer.setId(commentfile));
+        ASSERT_NO_THROW(writer.saveBytes(0, src));
+        ASSERT_NO_THROW(writer.close());
+      }
+
+      ome::compat::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(commentfile, "r"));
+      ome::compat::shared_ptr<IFD> wifd(written->getDirectoryByIndex(0));
+      std::string omexml;
+      ASSERT_NO_THROW(wifd->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(omexml));
+      EXPECT_EQ(0U, omexml.find("<?xml"));
+      EXPECT_EQ(std::string::npos, omexml.find('\0'));
+
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> filemeta;
+      ASSERT_NO_THROW(filemeta = ome::bioformats::createOMEXMLMetadata(omexml));
+      ASSERT_EQ(1U, filemeta->getImageCount());
+      EXPECT_EQ(commentfile.filename().generic_string(), filemeta->getUUIDFileName(0U, 0U));
+
+      // The IFD and pixel data are unaffected.
+      EXPECT_EQ(1U, written->directoryCount());
+      VariantPixelBuffer pixels;
+      ASSERT_NO_THROW(wifd->readImage(pixels));
+      EXPECT_TRUE(pixels == reference);
+      written->close();
+
+      OMETIFFReader reader;
+      ASSERT_NO_THROW(reader.setId(commentfile));
+      ASSERT_EQ(1U, reader.getSeriesCount());
+      reader.close();
+    }
+}
+
+TEST_P(TIFFWriterTest, CommentUUIDs)
+{
+  std::vector<path> files;
+  ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> writermeta;
+  ASSERT_NO_THROW(files = writeSeriesFiles("uuid", 3U, &writermeta));
+
+  // Each file embeds the complete OME-XML, with its own UUID as the
+  // root UUID, matching the UUID referenced for its series.
+  std::set<std::string> uuids;
+  for (dimension_size_type i = 0U; i < files.size(); ++i)
+    {
+      ome::compat::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(files.at(i), "r"));
+      std::string omexml;
+      ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(omexml));
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> filemeta;
+      ASSERT_NO_THROW(filemeta = ome::bioformats::createOMEXMLMetadata(omexml));
+      ASSERT_EQ(files.size(), filemeta->getImageCount());
+
+      const std::string root(filemeta->getUUID());
+      EXPECT_EQ(std::string("urn:uuid:") + filemeta->getUUIDValue(i, 0U), root);
+      EXPECT_EQ(files.at(i).filename().generic_string(), filemeta->getUUIDFileName(i, 0U));
+      uuids.insert(root);
+
+      // The text is otherwise identical between files.
+      if (i > 0U)
+        {
+          std::string first;
+          ome::compat::shared_ptr<TIFF> firstfile(TIFF::open(files.at(0), "r"));
+          firstfile->getDirectoryByIndex(0)->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(first);
+          ASSERT_EQ(first.size(), omexml.size());
+          const std::string::size_type pos = omexml.find(root);
+          ASSERT_NE(std::string::npos, pos);
+          EXPECT_EQ(first.substr(0, pos), omexml.substr(0, pos));
+          EXPECT_EQ(first.substr(pos + root.size()), omexml.substr(pos + root.size()));
+        }
+    }
+  EXPECT_EQ(files.size(), uuids.size());
+
+  // The metadata used by the writer is left with a real file UUID,
+  // not the placeholder used for serialization.
+  ASSERT_TRUE(static_cast<bool>(writermeta));
+  EXPECT_TRUE(uuids.find(writermeta->getUUID()) != uuids.end());
+}
+
+namespace
+{
+
+  /**
+   * Replace an attribute value in the last element of a given name.
+   *
+   * @param text the XML text to modify.
+   * @param element the element name.
+   * @param attr the attribute name.
+   * @param value the replacement value.
+   */
+  void
+  replaceLastAttribute(std::string&       text,
+                       const std::string& element,
+                       const std::string& attr,
+                       const std::string& value)
+  {
+    const std::string::size_type start = text.rfind("<" + element + " ");
+    ASSERT_NE(std::string::npos, start);
+    const std::string::size_type pos = text.find(" " + attr + "=\"", start);
+    ASSERT_NE(std::string::npos, pos);
+    ASSERT_LT(pos, text.find('>', start));
+    const std::string::size_type begin = pos + attr.size() + 3;
+    const std::string::size_type end = text.find('"', begin);
+    text.replace(begin, end - begin, value);
+  }
+
+}
+
+TEST_P(TIFFWriterTest, Detection)
+{
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("detect", 3U));
+
+  OMETIFFReader reader;
+
+  // Three images, each in a separate single-IFD file.
+  EXPECT_TRUE(reader.isThisType(files.at(0)));
+  EXPECT_FALSE(reader.isSingleFile(files.at(0)));
+
+  std::string omexml;
+  {
+    ome::compat::shared_ptr<TIFF> first(TIFF::open(files.at(0), "r"));
+    first->getDirectoryByIndex(0)->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(omexml);
+  }
+
+  const path base(testfile.parent_path() / testfile.stem().stem());
+
+  // The same three images with an IFD for each plane.
+  path single(base.string() + "-detect-single.ome.tiff");
+  ASSERT_NO_THROW(writeDescription(single, omexml, 3U));
+  EXPECT_TRUE(reader.isThisType(single));
+  EXPECT_TRUE(reader.isSingleFile(single));
+
+  // Too few IFDs for all images.
+  path partial(base.string() + "-detect-partial.ome.tiff");
+  ASSERT_NO_THROW(writeDescription(partial, omexml, 2U));
+  EXPECT_TRUE(reader.isThisType(partial));
+  EXPECT_FALSE(reader.isSingleFile(partial));
+
+  // Every image is verified, not only the first.
+  std::string noid(omexml);
+  replaceLastAttribute(noid, "Channel", "ID", "");
+  path noidfile(base.string() + "-detect-noid.ome.tiff");
+  ASSERT_NO_THROW(writeDescription(noidfile, noid, 3U));
+  EXPECT_FALSE(reader.isThisType(noidfile));
+
+  // Invalid sizes in the last image.
+  const char *badsizes[] = {"0", "-1", "x", ""};
+  for (const char **size = badsizes; size != badsizes + boost::size(badsizes); ++size)
+    {
+      std::string badsize(omexml);
+      replaceLastAttribute(badsize, "Pixels", "SizeZ", *size);
+      path badsizefile(base.string() + "-detect-badsize.ome.tiff");
+      ASSERT_NO_THROW(writeDescription(badsizefile, badsize, 3U));
+      EXPECT_FALSE(reader.isThisType(badsizefile)) << "SizeZ=" << *size;
+      EXPECT_THROW(reader.isSingleFile(badsizefile), ome::bioformats::FormatException) << "SizeZ=" << *size;
+    }
+
+  // Not OME-XML.
+  path other(base.string() + "-detect-other.ome.tiff");
+  ASSERT_NO_THROW(writeDescription(other, "<html>http://www.openmicroscopy.org/</html>", 1U));
+  EXPECT_FALSE(reader.isThisType(other));
+}
+
+namespace
+{
+
+  // Expose isUsedFile() for testing.
+  class UsedFileReader : public OMETIFFReader
+  {
+  public:
+    using OMETIFFReader::isUsedFile;
+  };
+
+}
+
+TEST_P(TIFFWriterTest, UsedFilesSymlinks)
+{
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("symlink", 3U));
+
+  // Links to the first and last files.
+  std::vector<path> links;
+  for (dimension_size_type i = 0U; i < files.size(); i += files.size() - 1U)
+    {
+      path link(testfile.parent_path() /
+                (testfile.stem().stem().string() + "-symlink-link-" +
+                 boost::lexical_cast<std::string>(i) + ".ome.tiff"));
+      boost::system::error_code ec;
+      remove(link, ec);
+      create_symlink(files.at(i).filename(), link, ec);
+      if (ec) // Symbolic links are not supported on all platforms.
+        return;
+      links.push_back(link);
+    }
+
+  UsedFileReader reader;
+  ASSERT_NO_THROW(reader.setId(links.at(0)));
+  ASSERT_EQ(files.size(), reader.getSeriesCount());
+
+  // Used files are canonical, so each file is listed once however
+  // it was reached.
+  const std::vector<path> used(reader.getUsedFiles());
+  EXPECT_EQ(files.size(), used.size());
+  EXPECT_EQ(used.size(), std::set<path>(used.begin(), used.end()).size());
+  for (std::vector<path>::const_iterator f = files.begin(); f != files.end(); ++f)
+    EXPECT_TRUE(std::find(used.begin(), used.end(), canonical(*f)) != used.end());
+
+  for (std::vector<path>::const_iterator f = files.begin(); f != files.end(); ++f)
+    EXPECT_TRUE(reader.isUsedFile(*f));
+  for (std::vector<path>::const_iterator l = links.begin(); l != links.end(); ++l)
+    EXPECT_TRUE(reader.isUsedFile(*l));
+  EXPECT_FALSE(reader.isUsedFile(testfile.parent_path() / "nonexistent.ome.tiff"));
+
+  // The cached used files are discarded on close.
+  reader.close();
+  std::vector<path> other;
+  ASSERT_NO_THROW(other = writeSeriesFiles("symlink-other", 1U));
+  ASSERT_NO_THROW(reader.setId(other.at(0)));
+  EXPECT_TRUE(reader.isUsedFile(other.at(0)));
+  EXPECT_FALSE(reader.isUsedFile(links.at(0)));
+  reader.close();
+}
+
+namespace
+{
+
+  // Expose readMetadata() for testing.
+  class MetadataCacheReader : public OMETIFFReader
+  {
+  public:
+    using OMETIFFReader::readMetadata;
+  };
+
+}
+
+TEST_P(TIFFWriterTest, MetadataCache)
+{
+  typedef ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta_ptr;
+
+  std::vector<path> files;
+  ASSERT_NO_THROW(files = writeSeriesFiles("cache", 2U));
+
+  // Documents of the same size, differing only in the root UUID.
+  std::vector<std::string> texts;
+  for (std::vector<path>::const_iterator f = files.begin(); f != files.end(); ++f)
+    {
+      std::string omexml;
+      ome::compat::shared_ptr<TIFF> written(TIFF::open(*f, "r"));
+      written->getDirectoryByIndex(0)->getField(ome::bioformats::tiff::IMAGEDESCRIPTION).get(omexml);
+      texts.push_back(omexml);
+    }
+  ASSERT_EQ(texts.at(0).size(), texts.at(1).size());
+  ASSERT_NE(texts.at(0), texts.at(1));
+
+  MetadataCacheReader reader;
+
+  // Miss, then hit.
+  meta_ptr first(reader.readMetadata(texts.at(0), false));
+  ASSERT_TRUE(static_cast<bool>(first));
+  EXPECT_EQ(first.get(), reader.readMetadata(texts.at(0), false).get());
+
+  // A different document of the same size is a miss.
+  meta_ptr second(reader.readMetadata(texts.at(1), false));
+  ASSERT_TRUE(static_cast<bool>(second));
+  EXPECT_NE(first.get(), second.get());
+  EXPECT_EQ(std::string("urn:uuid:") + first->getUUIDValue(0U, 0U), first->getUUID());
+  EXPECT_EQ(std::string("urn:uuid:") + second->getUUIDValue(1U, 0U), second->getUUID());
+
+  // Taking removes the entry, and is not cached.
+  EXPECT_EQ(first.get(), reader.readMetadata(texts.at(0), true).get());
+  meta_ptr taken(reader.readMetadata(texts.at(0), true));
+  EXPECT_NE(first.get(), taken.get());
+  EXPECT_NE(taken.get(), reader.readMetadata(texts.at(0), false).get());
+
+  // Closing discards all entries.
+  EXPECT_EQ(second.get(), reader.readMetadata(texts.at(1), false).get());
+  reader.close();
+  EXPECT_NE(second.get(), reader.readMetadata(texts.at(1), false).get());
+
+  // A file is parsed again once modified.
+  path companion(testfile.parent_path() /
+                 (testfile.stem().stem().string() + "-cache.companion.ome"));
+  {
+    std::ofstream out(companion.string().c_str());
+    out << texts.at(0);
+  }
+  meta_ptr unmodified(reader.readMetadata(companion, false));
+  EXPECT_EQ(unmodified.get(), reader.readMetadata(companion, false).get());
+  {
+    std::ofstream out(companion.string().c_str());
+    out << texts.at(0) << '\n';
+  }
+  meta_ptr modified(reader.readMetadata(companion, false));
+  EXPECT_NE(unmodified.get(), modified.get());
+  EXPECT_EQ(modified.get(), reader.readMetadata(companion, false).get());
+  reader.close();
+}
+
+namespace
+{
+
+  // Check each plane of a range read with openPlanes() matches the
+  // same plane read with openBytes().
+  void
+  checkPlanes(const ome::bioformats::FormatReader&               reader,
+              const ome::compat::array<dimension_size_type, 3>& start,
+              const ome::compat::array<dimension_size_type, 3>& count,
+              const VariantPixelBuffer&                         range,
+              const ome::bioformats::PlaneRegion&               region)
+  {
+    ASSERT_EQ(count[0], range.shape()[ome::bioformats::DIM_SPATIAL_Z]);
+    ASSERT_EQ(count[1], range.shape()[ome::bioformats::DIM_CHANNEL]);
+    ASSERT_EQ(count[2], range.shape()[ome::bioformats::DIM_TEMPORAL_T]);
+
+    for (dimension_size_type z = 0; z < count[0]; ++z)
+      for (dimension_size_type c = 0; c < count[1]; ++c)
+        for (dimension_size_type t = 0; t < count[2]; ++t)
+          {
+            VariantPixelBuffer expected;
+            reader.openBytes(reader.getIndex(start[0] + z, start[1] + c, start[2] + t),
+                             expected, region.x, region.y, region.w, region.h);
+
+            ome::bioformats::PixelBufferBase::shape_type shape;
+            std::copy(expected.shape(), expected.shape() + shape.size(), shape.begin());
+
+            ome::bioformats::PixelBufferBase::indices_type origin;
+            std::fill(origin.begin(), origin.end(), 0);
+            ome::bioformats::PixelBufferBase::indices_type position(origin);
+            position[ome::bioformats::DIM_SPATIAL_Z] = static_cast<ome::bioformats::PixelBufferBase::index>(z);
+            position[ome::bioformats::DIM_CHANNEL] = static_cast<ome::bioformats::PixelBufferBase::index>(c);
+            position[ome::bioformats::DIM_TEMPORAL_T] = static_cast<ome::bioformats::PixelBufferBase::index>(t);
+
+            VariantPixelBuffer plane;
+            plane.ensureBuffer(shape, expected.pixelType(), expected.storage_order());
+            ASSERT_NO_THROW(ome::bioformats::copyRegion(range, position, shape, plane, origin));
+            EXPECT_TRUE(plane == expected) << "Z=" << z << " C=" << c << " T=" << t;
+          }
+  }
+
+}
+
+TEST(OMETIFFReaderTest, OpenPlanes)
+{
+  OMETIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(PROJECT_SOURCE_DIR "/test/ome-bioformats/data/2010-06-18x24y5z1t2c8b-text.ome.tiff"));
+  // Not the XYZTC order used for TIFF planes.
+  EXPECT_EQ(std::string("XYCTZ"), reader.getDimensionOrder());
+
+  // A range of Z in both channels.
+  ome::compat::array<dimension_size_type, 3> start = {{1, 0, 0}};
+  ome::compat::array<dimension_size_type, 3> count = {{3, 2, 1}};
+
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(reader.openPlanes(start, count, buf));
+  EXPECT_EQ(reader.getSizeX() * reader.getSizeY() * 3U * 2U, buf.num_elements());
+  checkPlanes(reader, start, count, buf,
+              ome::bioformats::PlaneRegion(0, 0, reader.getSizeX(), reader.getSizeY()));
+
+  const ome::bioformats::PlaneRegion region(3, 5, 7, 4);
+  ASSERT_NO_THROW(reader.openPlanes(start, count, buf, region.x, region.y, region.w, region.h));
+  checkPlanes(reader, start, count, buf, region);
+  reader.close();
+}
+
+TEST_P(TIFFWriterTest, OpenPlanes)
+{
+  ome::compat::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+  VariantPixelBuffer reference;
+  ifd->readImage(reference);
+
+  ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::bioformats::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::bioformats::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::bioformats::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::bioformats::DIM_SPATIAL_Z] = shape[ome::bioformats::DIM_TEMPORAL_T] = shape[ome::bioformats::DIM_CHANNEL] =
+    shape[ome::bioformats::DIM_MODULO_Z] = shape[ome::bioformats::DIM_MODULO_T] = shape[ome::bioformats::DIM_MODULO_C] = 1;
+
+  // Chunky and planar files; the reader is not interleaved, so
+  // chunky planes are copied and planar planes read in place.
+  for (int interleaved = 0; interleaved < 2; ++interleaved)
+    {
+      ome::compat::shared_ptr<CoreMetadata> core(ome::bioformats::tiff::makeCoreMetadata(*ifd));
+      core->sizeT = 3U;
+      core->imageCount = 3U;
+      std::vector<ome::compat::shared_ptr<CoreMetadata> > seriesList(1U, core);
+
+      ome::compat::shared_ptr< ::ome::xml::meta::OMEXMLMetadata> meta(ome::compat::make_shared< ::ome::xml::meta::OMEXMLMetadata>());
+      ome::bioformats::fillMetadata(*meta, seriesList);
+      ome::compat::shared_ptr< ::ome::xml::meta::MetadataRetrieve> retrieve(ome::compat::static_pointer_cast< ::ome::xml::meta::MetadataRetrieve>(meta));
+
+      VariantPixelBuffer src(shape, ifd->getPixelType(),
+                             ome::bioformats::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, interleaved != 0));
+      src = reference;
+
+      path planesfile(testfile.parent_path() /
+                      (testfile.stem().stem().string() + "-planes-" +
+                       boost::lexical_cast<std::string>(interleaved) + ".ome.tiff"));
+      {
+        OMETIFFWriter writer;
+        writer.setMetadataRetrieve(retrieve);
+        writer.setInterleaved(interleaved != 0);
+        ASSERT_NO_THROW(writer.setId(planesfile));
+        for (dimension_size_type p = 0U; p < core->imageCount; ++p)
+          ASSERT_NO_THROW(writer.saveBytes(p, src));
+        ASSERT_NO_THROW(writer.close());
+      }
+
+      OMETIFFReader reader;
+      ASSERT_NO_THROW(reader.setId(planesfile));
+      ASSERT_EQ(static_cast<dimension_size_type>(ifd->getSamplesPerPixel()), reader.getRGBChannelCount(0));
+
+      ome::compat::array<dimension_size_type, 3> start = {{0, 0, 0}};
+      ome::compat::array<dimension_size_type, 3> count = {{1, 1, 3}};
+
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openPlanes(start, count, buf));
+      EXPECT_EQ(reference.num_elements() * 3U, buf.num_elements());
+      checkPlanes(reader, start, count, buf,
+                  ome::bioformats::PlaneRegion(0, 0, reader.getSizeX(), reader.getSizeY()));
+
+      // A sub-image of a later range.
+      start[2] = 1;
+      count[2] = 2;
+      const ome::bioformats::PlaneRegion region(5, 7, 16, 9);
+      ASSERT_NO_THROW(reader.openPlanes(start, count, buf, region.x, region.y, region.w, region.h));
+      checkPlanes(reader, start, count, buf, region);
+      reader.close();
+    }
+}
+
 std::vector<TileTestParameters> params(find_tile_tests());
 
 // Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
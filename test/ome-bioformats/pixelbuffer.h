@@ -48,11 +48,13 @@
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
+#include <utility>
 
 using ome::bioformats::Dimensions;
 using ome::bioformats::PixelEndianProperties;
 using ome::bioformats::PixelBufferBase;
 using ome::bioformats::PixelBuffer;
+using ome::bioformats::PixelSpan;
 typedef ome::xml::model::enums::DimensionOrder DO;
 typedef ome::xml::model::enums::PixelType PT;
 
@@ -185,6 +187,108 @@ TYPED_TEST_P(PixelBufferType, ConstructCopy)
   ASSERT_NE(buf1, buf2);
 }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+TYPED_TEST_P(PixelBufferType, ConstructMove)
+{
+  std::vector<TypeParam> source;
+  for (uint32_t i = 0; i < 10; ++i)
+    source.push_back(pixel_value<TypeParam>(i));
+
+  PixelBuffer<TypeParam> buf1(boost::extents[5][2][1][1][1][1][1][1][1]);
+  buf1.assign(source.begin(), source.end());
+  const TypeParam *data = buf1.data();
+
+  PixelBuffer<TypeParam> buf2(std::move(buf1));
+  ASSERT_FALSE(buf1.valid());
+  ASSERT_TRUE(buf2.valid());
+  ASSERT_EQ(data, buf2.data());
+  for (uint32_t i = 0; i < 10; ++i)
+    ASSERT_EQ(pixel_value<TypeParam>(i), *(buf2.data()+i));
+}
+
+TYPED_TEST_P(PixelBufferType, AssignMove)
+{
+  std::vector<TypeParam> source;
+  for (uint32_t i = 0; i < 12; ++i)
+    source.push_back(pixel_value<TypeParam>(i));
+
+  PixelBuffer<TypeParam> buf1(boost::extents[6][2][1][1][1][1][1][1][1]);
+  buf1.assign(source.begin(), source.end());
+  const TypeParam *data = buf1.data();
+
+  PixelBuffer<TypeParam> buf2(boost::extents[5][2][1][1][1][1][1][1][1]);
+  buf2 = std::move(buf1);
+  ASSERT_FALSE(buf1.valid());
+  ASSERT_EQ(data, buf2.data());
+  ASSERT_EQ(12U, buf2.num_elements());
+  ASSERT_EQ(6U, buf2.shape()[0]);
+}
+#else
+// Move semantics are not available without C++11.
+TYPED_TEST_P(PixelBufferType, ConstructMove)
+{
+}
+
+TYPED_TEST_P(PixelBufferType, AssignMove)
+{
+}
+#endif
+
+TYPED_TEST_P(PixelBufferType, View)
+{
+  PixelBuffer<TypeParam> buf(boost::extents[5][2][1][1][1][1][1][1][1]);
+  ome::compat::shared_ptr<PixelBuffer<TypeParam> > view(buf.view());
+
+  ASSERT_EQ(buf.data(), view->data());
+  typename PixelBuffer<TypeParam>::indices_type idx;
+  idx[0] = 3;
+  idx[1] = idx[2] = idx[3] = idx[4] = idx[5] = idx[6] = idx[7] = idx[8] = 0;
+  view->at(idx) = pixel_value<TypeParam>(1);
+  ASSERT_EQ(pixel_value<TypeParam>(1), buf.at(idx));
+}
+
+TYPED_TEST_P(PixelBufferType, Clone)
+{
+  ome::compat::array<TypeParam, 24> source;
+  for (uint32_t i = 0; i < 24; ++i)
+    source[i] = pixel_value<TypeParam>(i);
+
+  PixelBuffer<TypeParam> buf(&*source.begin(), boost::extents[4][3][1][1][1][2][1][1][1],
+                             PT::UINT8, ome::bioformats::ENDIAN_NATIVE,
+                             PixelBufferBase::make_storage_order(DO::XYZTC, false));
+  ome::compat::shared_ptr<PixelBuffer<TypeParam> > copy(buf.clone());
+
+  ASSERT_FALSE(buf.managed());
+  ASSERT_TRUE(copy->managed());
+  ASSERT_NE(buf.data(), copy->data());
+  ASSERT_TRUE(buf.storage_order() == copy->storage_order());
+  ASSERT_EQ(buf.pixelType(), copy->pixelType());
+  ASSERT_EQ(buf, *copy);
+
+  typename PixelBuffer<TypeParam>::indices_type idx;
+  idx[0] = idx[1] = idx[2] = idx[3] = idx[4] = idx[5] = idx[6] = idx[7] = idx[8] = 0;
+  copy->at(idx) = pixel_value<TypeParam>(1);
+  ASSERT_EQ(pixel_value<TypeParam>(0), buf.at(idx));
+}
+
+TYPED_TEST_P(PixelBufferType, Swap)
+{
+  PixelBuffer<TypeParam> buf1(boost::extents[5][2][1][1][1][1][1][1][1]);
+  PixelBuffer<TypeParam> buf2(boost::extents[3][2][1][1][1][1][1][1][1]);
+  const TypeParam *data1 = buf1.data();
+  const TypeParam *data2 = buf2.data();
+
+  buf1.swap(buf2);
+  ASSERT_EQ(data2, buf1.data());
+  ASSERT_EQ(data1, buf2.data());
+  ASSERT_EQ(6U, buf1.num_elements());
+  ASSERT_EQ(10U, buf2.num_elements());
+
+  PixelBuffer<TypeParam> buf3(boost::extents[5][2][1][1][1][1][1][1][1],
+                              PT::UINT8, ome::bioformats::ENDIAN_BIG);
+  ASSERT_THROW(buf1.swap(buf3), std::logic_error);
+}
+
 template<typename T>
 void test_operators(const PixelBuffer<T>& buf1,
                     const PixelBuffer<T>& buf2)
@@ -349,6 +453,48 @@ TYPED_TEST_P(PixelBufferType, Origin)
   EXPECT_EQ(cbuf.data(), origin);
 }
 
+TYPED_TEST_P(PixelBufferType, Span)
+{
+  PixelBuffer<TypeParam> buf(boost::extents[10][3][1][1][10][1][4][1][1]);
+  const PixelBuffer<TypeParam>& cbuf(buf);
+
+  PixelSpan<TypeParam> span(buf.span());
+  PixelSpan<const TypeParam> cspan(cbuf.span());
+  PixelSpan<const uint8_t> rspan(cbuf.rawSpan());
+
+  EXPECT_EQ(buf.data(), span.data);
+  EXPECT_EQ(cbuf.data(), cspan.data);
+  EXPECT_EQ(reinterpret_cast<const uint8_t *>(cbuf.data()), rspan.data);
+  EXPECT_EQ(1U, span.element_size);
+  EXPECT_EQ(sizeof(TypeParam), rspan.element_size);
+  EXPECT_TRUE(span.contiguous(ome::bioformats::DIM_SPATIAL_X));
+  EXPECT_TRUE(rspan.contiguous(ome::bioformats::DIM_SPATIAL_X));
+  EXPECT_FALSE(span.contiguous(ome::bioformats::DIM_SPATIAL_Y));
+
+  for (boost::multi_array_types::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+    {
+      EXPECT_EQ(cbuf.shape()[d], span.shape[d]);
+      EXPECT_EQ(cbuf.strides()[d], span.strides[d]);
+      EXPECT_EQ(cbuf.strides()[d] * static_cast<boost::multi_array_types::index>(sizeof(TypeParam)),
+                rspan.strides[d]);
+    }
+
+  typename PixelBuffer<TypeParam>::indices_type idx;
+  std::fill(idx.begin(), idx.end(), 0);
+  idx[ome::bioformats::DIM_SPATIAL_X] = 7;
+  idx[ome::bioformats::DIM_SPATIAL_Y] = 2;
+  idx[ome::bioformats::DIM_CHANNEL] = 4;
+  idx[ome::bioformats::DIM_MODULO_Z] = 3;
+
+  EXPECT_EQ(&buf.at(idx), span.pointer(idx));
+  EXPECT_EQ(&cbuf.at(idx), cspan.pointer(idx));
+  EXPECT_EQ(reinterpret_cast<const uint8_t *>(&cbuf.at(idx)), rspan.pointer(idx));
+
+  idx[ome::bioformats::DIM_CHANNEL] = 0;
+  idx[ome::bioformats::DIM_MODULO_Z] = 0;
+  EXPECT_EQ(&buf.at(idx), span.pointer(7, 2));
+}
+
 TYPED_TEST_P(PixelBufferType, StorageOrder)
 {
   {
@@ -514,6 +660,11 @@ REGISTER_TYPED_TEST_CASE_P(PixelBufferType,
                            ConstructRange,
                            ConstructRangeRef,
                            ConstructCopy,
+                           ConstructMove,
+                           AssignMove,
+                           View,
+                           Clone,
+                           Swap,
                            Operators,
                            Array,
                            Data,
@@ -525,6 +676,7 @@ REGISTER_TYPED_TEST_CASE_P(PixelBufferType,
                            Strides,
                            IndexBases,
                            Origin,
+                           Span,
                            StorageOrder,
                            GetIndex,
                            SetIndex,
@@ -0,0 +1,388 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * %%
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include <ome/bioformats/PixelCopy.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+#include <ome/test/test.h>
+
+#include "pixel.h"
+
+using ome::bioformats::PixelBuffer;
+using ome::bioformats::PixelBufferBase;
+using ome::bioformats::PlaneRegion;
+using ome::bioformats::VariantPixelBuffer;
+using ome::bioformats::copyRegion;
+using ome::bioformats::dimension_size_type;
+typedef ome::xml::model::enums::PixelType PT;
+typedef ome::xml::model::enums::DimensionOrder DO;
+
+class PixelCopyTestParameters
+{
+public:
+  PT type;
+
+  PixelCopyTestParameters(PT type):
+    type(type)
+  {}
+};
+
+template<class charT, class traits>
+inline std::basic_ostream<charT,traits>&
+operator<< (std::basic_ostream<charT,traits>& os,
+            const PixelCopyTestParameters& params)
+{
+  return os << PT(params.type);
+}
+
+class PixelCopyTest : public ::testing::TestWithParam<PixelCopyTestParameters>
+{
+};
+
+namespace
+{
+
+  // Convert a linear element number to buffer indices (first
+  // dimension varying fastest).
+  PixelBufferBase::indices_type
+  linear_index(PixelBufferBase::size_type        i,
+               const PixelBufferBase::size_type *shape)
+  {
+    PixelBufferBase::indices_type idx;
+    for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+      {
+        idx[d] = static_cast<PixelBufferBase::index>(i % shape[d]);
+        i /= shape[d];
+      }
+    return idx;
+  }
+
+  // Check the region was copied, and all destination elements
+  // outside the region are unchanged.
+  template<typename T>
+  void
+  check_region(const PixelBuffer<T>&                source,
+               const PixelBufferBase::indices_type& source_start,
+               const PixelBufferBase::shape_type&   shape,
+               const PixelBuffer<T>&                original,
+               const PixelBuffer<T>&                dest,
+               const PixelBufferBase::indices_type& dest_start)
+  {
+    for (PixelBufferBase::size_type i = 0; i < dest.num_elements(); ++i)
+      {
+        PixelBufferBase::indices_type idx(linear_index(i, dest.shape()));
+        PixelBufferBase::indices_type sidx;
+        bool inside = true;
+        for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+          {
+            if (idx[d] < dest_start[d] ||
+                idx[d] >= dest_start[d] + static_cast<PixelBufferBase::index>(shape[d]))
+              inside = false;
+            sidx[d] = idx[d] - dest_start[d] + source_start[d];
+          }
+        if (inside)
+          ASSERT_EQ(source.at(sidx), dest.at(idx));
+        else
+          ASSERT_EQ(original.at(idx), dest.at(idx));
+      }
+  }
+
+}
+
+/*
+ * Fill source and destination buffers, copy a plane region from the
+ * source into the destination and check the logical content of the
+ * destination.
+ */
+struct PlaneRegionTestVisitor : public boost::static_visitor<>
+{
+  const PixelBufferBase::storage_order_type& source_order;
+  const PixelBufferBase::storage_order_type& dest_order;
+  const PixelBufferBase::shape_type&         dest_shape;
+  PlaneRegion                                region;
+  dimension_size_type                        x;
+  dimension_size_type                        y;
+  dimension_size_type                        threads;
+
+  PlaneRegionTestVisitor(const PixelBufferBase::storage_order_type& source_order,
+                         const PixelBufferBase::storage_order_type& dest_order,
+                         const PixelBufferBase::shape_type&         dest_shape,
+                         const PlaneRegion&                         region,
+                         dimension_size_type                        x,
+                         dimension_size_type                        y,
+                         dimension_size_type                        threads = 0U):
+    source_order(source_order),
+    dest_order(dest_order),
+    dest_shape(dest_shape),
+    region(region),
+    x(x),
+    y(y),
+    threads(threads)
+  {}
+
+  template<typename T>
+  void
+  operator() (const T& v)
+  {
+    typedef typename T::element_type::value_type value_type;
+
+    const PixelBufferBase::size_type *shape = v->shape();
+    PixelBufferBase::shape_type extents;
+    std::copy(shape, shape + PixelBufferBase::dimensions, extents.begin());
+
+    T source(ome::compat::make_shared<PixelBuffer<value_type> >
+             (extents, v->pixelType(), ome::bioformats::ENDIAN_NATIVE, source_order));
+    T dest(ome::compat::make_shared<PixelBuffer<value_type> >
+           (dest_shape, v->pixelType(), ome::bioformats::ENDIAN_NATIVE, dest_order));
+
+    std::vector<value_type> data;
+    for (PixelBufferBase::size_type i = 0; i < source->num_elements(); ++i)
+      data.push_back(pixel_value<value_type>(i));
+    source->assign(data.begin(), data.end());
+
+    data.clear();
+    for (PixelBufferBase::size_type i = 0; i < dest->num_elements(); ++i)
+      data.push_back(pixel_value<value_type>(i + 3));
+    dest->assign(data.begin(), data.end());
+    T original(dest->clone());
+
+    VariantPixelBuffer vsource(source);
+    VariantPixelBuffer vdest(dest);
+    copyRegion(vsource, region, vdest, x, y, threads);
+
+    PixelBufferBase::indices_type source_start;
+    PixelBufferBase::indices_type dest_start;
+    PixelBufferBase::shape_type region_shape(extents);
+    std::fill(source_start.begin(), source_start.end(), 0);
+    std::fill(dest_start.begin(), dest_start.end(), 0);
+    source_start[ome::bioformats::DIM_SPATIAL_X] = static_cast<PixelBufferBase::index>(region.x);
+    source_start[ome::bioformats::DIM_SPATIAL_Y] = static_cast<PixelBufferBase::index>(region.y);
+    dest_start[ome::bioformats::DIM_SPATIAL_X] = static_cast<PixelBufferBase::index>(x);
+    dest_start[ome::bioformats::DIM_SPATIAL_Y] = static_cast<PixelBufferBase::index>(y);
+    region_shape[ome::bioformats::DIM_SPATIAL_X] = region.w;
+    region_shape[ome::bioformats::DIM_SPATIAL_Y] = region.h;
+
+    check_region(*source, source_start, region_shape, *original, *dest, dest_start);
+    ASSERT_TRUE(dest->storage_order() == dest_order);
+  }
+};
+
+TEST_P(PixelCopyTest, SameOrder)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][3][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 50, 20, 1, 1, 1, 3, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PlaneRegionTestVisitor v(interleaved, interleaved, dest_shape,
+                           PlaneRegion(5, 7, 30, 12), 11, 3);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelCopyTest, WholeRows)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][3][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 40, 50, 1, 1, 1, 3, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PlaneRegionTestVisitor v(planar, planar, dest_shape,
+                           PlaneRegion(0, 4, 40, 20), 0, 17);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelCopyTest, InterleavedToPlanar)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][3][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 32, 32, 1, 1, 1, 3, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PlaneRegionTestVisitor v(interleaved, planar, dest_shape,
+                           PlaneRegion(30, 10, 32, 32), 0, 0);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelCopyTest, PlanarToInterleaved)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][4][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 100, 100, 1, 1, 1, 4, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PlaneRegionTestVisitor v(planar, interleaved, dest_shape,
+                           PlaneRegion(0, 0, 67, 45), 33, 55);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelCopyTest, Descending)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][3][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 40, 33, 1, 1, 1, 3, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PixelBufferBase::size_type ordering[PixelBufferBase::dimensions];
+  bool ascending[PixelBufferBase::dimensions];
+  for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+    {
+      ordering[d] = interleaved.ordering(d);
+      ascending[d] = true;
+    }
+  // Flip Y and reverse samples.
+  ascending[ome::bioformats::DIM_SPATIAL_Y] = false;
+  ascending[ome::bioformats::DIM_SUBCHANNEL] = false;
+  PixelBufferBase::storage_order_type flipped(ordering, ascending);
+
+  PlaneRegionTestVisitor v(interleaved, flipped, dest_shape,
+                           PlaneRegion(3, 5, 20, 21), 17, 9);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelCopyTest, Parallel)
+{
+  const PixelCopyTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[2200][1000][1][1][1][1][1][1][1],
+                         params.type);
+  PixelBufferBase::shape_type dest_shape = {{ 2100, 1000, 1, 1, 1, 1, 1, 1, 1 }};
+
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PlaneRegionTestVisitor v(planar, planar, dest_shape,
+                           PlaneRegion(50, 0, 2100, 1000), 0, 0, 4);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST(PixelCopy, Region)
+{
+  PixelBuffer<uint16_t> source(boost::extents[9][7][3][2][5][2][1][1][1],
+                               PT::UINT16, ome::bioformats::ENDIAN_NATIVE,
+                               PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBuffer<uint16_t> dest(boost::extents[6][6][4][3][2][2][1][1][1],
+                             PT::UINT16, ome::bioformats::ENDIAN_NATIVE,
+                             PixelBufferBase::make_storage_order(DO::XYCTZ, false));
+
+  std::vector<uint16_t> data;
+  for (PixelBufferBase::size_type i = 0; i < source.num_elements(); ++i)
+    data.push_back(static_cast<uint16_t>(i));
+  source.assign(data.begin(), data.end());
+  data.assign(dest.num_elements(), 0xFFFFU);
+  dest.assign(data.begin(), data.end());
+  ome::compat::shared_ptr<PixelBuffer<uint16_t> > original(dest.clone());
+
+  PixelBufferBase::indices_type source_start = {{ 2, 1, 1, 0, 2, 1, 0, 0, 0 }};
+  PixelBufferBase::indices_type dest_start = {{ 1, 2, 1, 1, 0, 0, 0, 0, 0 }};
+  PixelBufferBase::shape_type shape = {{ 5, 4, 2, 2, 2, 1, 1, 1, 1 }};
+
+  copyRegion(source, source_start, shape, dest, dest_start);
+  check_region(source, source_start, shape, *original, dest, dest_start);
+}
+
+TEST(PixelCopy, OutOfRange)
+{
+  PixelBuffer<uint8_t> source(boost::extents[4][4][1][1][1][3][1][1][1]);
+  PixelBuffer<uint8_t> dest(boost::extents[4][3][1][1][1][3][1][1][1]);
+
+  ASSERT_THROW(copyRegion(source, PlaneRegion(1, 1, 4, 2), dest, 0, 0), std::logic_error);
+  ASSERT_THROW(copyRegion(source, PlaneRegion(0, 0, 4, 4), dest, 0, 0), std::logic_error);
+  ASSERT_THROW(copyRegion(source, PlaneRegion(0, 0, 2, 2), dest, 3, 0), std::logic_error);
+  ASSERT_NO_THROW(copyRegion(source, PlaneRegion(0, 1, 4, 3), dest, 0, 0));
+}
+
+TEST(PixelCopy, IncompatibleShape)
+{
+  PixelBuffer<uint8_t> source(boost::extents[4][4][1][1][1][3][1][1][1]);
+  PixelBuffer<uint8_t> dest(boost::extents[4][4][1][1][1][4][1][1][1]);
+
+  ASSERT_THROW(copyRegion(source, PlaneRegion(0, 0, 2, 2), dest, 0, 0), std::logic_error);
+}
+
+TEST(PixelCopy, IncompatibleType)
+{
+  VariantPixelBuffer source(boost::extents[4][4][1][1][1][3][1][1][1], PT::UINT8);
+  VariantPixelBuffer dest(boost::extents[4][4][1][1][1][3][1][1][1], PT::UINT16);
+
+  ASSERT_THROW(copyRegion(source, PlaneRegion(0, 0, 2, 2), dest, 0, 0), std::runtime_error);
+}
+
+PixelCopyTestParameters variant_params[] =
+  { //                      PixelType
+    PixelCopyTestParameters(PT::INT8),
+    PixelCopyTestParameters(PT::INT16),
+    PixelCopyTestParameters(PT::INT32),
+    PixelCopyTestParameters(PT::UINT8),
+    PixelCopyTestParameters(PT::UINT16),
+    PixelCopyTestParameters(PT::UINT32),
+    PixelCopyTestParameters(PT::FLOAT),
+    PixelCopyTestParameters(PT::DOUBLE),
+    PixelCopyTestParameters(PT::BIT),
+    PixelCopyTestParameters(PT::COMPLEX),
+    PixelCopyTestParameters(PT::DOUBLECOMPLEX)
+  };
+
+// Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
+// this is solely to work around a missing prototype in gtest.
+#ifdef __GNUC__
+#  if defined __clang__ || defined __APPLE__
+#    pragma GCC diagnostic ignored "-Wmissing-prototypes"
+#  endif
+#  pragma GCC diagnostic ignored "-Wmissing-declarations"
+#endif
+
+INSTANTIATE_TEST_CASE_P(PixelCopyVariants, PixelCopyTest, ::testing::ValuesIn(variant_params));
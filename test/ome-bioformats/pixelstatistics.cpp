@@ -0,0 +1,396 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * %%
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/bioformats/PixelStatistics.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+#include <ome/test/test.h>
+
+#include "pixel.h"
+
+using ome::bioformats::PixelBuffer;
+using ome::bioformats::PixelBufferBase;
+using ome::bioformats::PixelStatistics;
+using ome::bioformats::SampleStatistics;
+using ome::bioformats::VariantPixelBuffer;
+using ome::bioformats::dimension_size_type;
+typedef ome::xml::model::enums::PixelType PT;
+typedef ome::xml::model::enums::DimensionOrder DO;
+
+class PixelStatisticsTestParameters
+{
+public:
+  PT type;
+
+  PixelStatisticsTestParameters(PT type):
+    type(type)
+  {}
+};
+
+template<class charT, class traits>
+inline std::basic_ostream<charT,traits>&
+operator<< (std::basic_ostream<charT,traits>& os,
+            const PixelStatisticsTestParameters& params)
+{
+  return os << PT(params.type);
+}
+
+class PixelStatisticsTest : public ::testing::TestWithParam<PixelStatisticsTestParameters>
+{
+};
+
+namespace
+{
+
+  template<typename T>
+  double
+  sample_value(const T& v)
+  {
+    return static_cast<double>(v);
+  }
+
+  template<typename T>
+  double
+  sample_value(const std::complex<T>& v)
+  {
+    return std::abs(std::complex<double>(v.real(), v.imag()));
+  }
+
+}
+
+/*
+ * Fill buffer, compute statistics, and check against statistics
+ * computed by iterating over each logical pixel index.
+ */
+struct StatisticsTestVisitor : public boost::static_visitor<>
+{
+  PixelStatistics& stats;
+
+  StatisticsTestVisitor(PixelStatistics& stats):
+    stats(stats)
+  {}
+
+  template<typename T>
+  void
+  operator() (const T& v)
+  {
+    typedef typename T::element_type::value_type value_type;
+
+    const PixelBufferBase::size_type *shape = v->shape();
+    dimension_size_type nsub = shape[ome::bioformats::DIM_SUBCHANNEL];
+
+    typename T::element_type::indices_type idx;
+    std::fill(idx.begin(), idx.end(), 0);
+    uint32_t i = 0;
+    for (idx[ome::bioformats::DIM_SUBCHANNEL] = 0; idx[ome::bioformats::DIM_SUBCHANNEL] < nsub; ++idx[ome::bioformats::DIM_SUBCHANNEL])
+      for (idx[ome::bioformats::DIM_SPATIAL_Y] = 0; idx[ome::bioformats::DIM_SPATIAL_Y] < shape[ome::bioformats::DIM_SPATIAL_Y]; ++idx[ome::bioformats::DIM_SPATIAL_Y])
+        for (idx[ome::bioformats::DIM_SPATIAL_X] = 0; idx[ome::bioformats::DIM_SPATIAL_X] < shape[ome::bioformats::DIM_SPATIAL_X]; ++idx[ome::bioformats::DIM_SPATIAL_X])
+          v->at(idx) = pixel_value<value_type>(((i++ * 7U) % 251U) + 2U * static_cast<uint32_t>(idx[ome::bioformats::DIM_SUBCHANNEL]));
+
+    T shared(v);
+    VariantPixelBuffer buf(shared);
+    stats.compute(buf);
+
+    const double rmin = stats.getRangeMin();
+    const double rmax = stats.getRangeMax();
+    const dimension_size_type bins = stats.getBins();
+
+    ASSERT_EQ(nsub, stats.getStatistics().size());
+
+    for (dimension_size_type s = 0; s < nsub; ++s)
+      {
+        SampleStatistics expected(bins);
+        idx[ome::bioformats::DIM_SUBCHANNEL] = s;
+        for (idx[ome::bioformats::DIM_SPATIAL_Y] = 0; idx[ome::bioformats::DIM_SPATIAL_Y] < shape[ome::bioformats::DIM_SPATIAL_Y]; ++idx[ome::bioformats::DIM_SPATIAL_Y])
+          for (idx[ome::bioformats::DIM_SPATIAL_X] = 0; idx[ome::bioformats::DIM_SPATIAL_X] < shape[ome::bioformats::DIM_SPATIAL_X]; ++idx[ome::bioformats::DIM_SPATIAL_X])
+            {
+              double val = sample_value(v->at(idx));
+              ++expected.count;
+              expected.min = std::min(expected.min, val);
+              expected.max = std::max(expected.max, val);
+              expected.sum += val;
+              expected.sumsq += val * val;
+              double b = (val - rmin) * (static_cast<double>(bins) / (rmax - rmin));
+              if (b <= 0.0)
+                ++expected.histogram[0];
+              else if (b >= static_cast<double>(bins))
+                ++expected.histogram[bins - 1];
+              else
+                ++expected.histogram[static_cast<dimension_size_type>(b)];
+            }
+
+        const SampleStatistics& observed(stats.getStatistics(s));
+        EXPECT_EQ(expected.count, observed.count);
+        EXPECT_EQ(expected.min, observed.min);
+        EXPECT_EQ(expected.max, observed.max);
+        EXPECT_NEAR(expected.sum, observed.sum, std::abs(expected.sum) * 1e-12);
+        EXPECT_NEAR(expected.sumsq, observed.sumsq, std::abs(expected.sumsq) * 1e-12);
+        EXPECT_NEAR(expected.mean(), observed.mean(), std::abs(expected.mean()) * 1e-12);
+        EXPECT_TRUE(expected.histogram == observed.histogram);
+      }
+  }
+};
+
+TEST_P(PixelStatisticsTest, Interleaved)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][3][1][1][1],
+                         params.type,
+                         PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PixelStatistics stats;
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelStatisticsTest, Planar)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][3][1][1][1],
+                         params.type,
+                         PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PixelStatistics stats;
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelStatisticsTest, Descending)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PixelBufferBase::size_type ordering[PixelBufferBase::dimensions];
+  bool ascending[PixelBufferBase::dimensions];
+  for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+    {
+      ordering[d] = interleaved.ordering(d);
+      ascending[d] = true;
+    }
+  ascending[ome::bioformats::DIM_SPATIAL_Y] = false;
+  ascending[ome::bioformats::DIM_SUBCHANNEL] = false;
+  PixelBufferBase::storage_order_type flipped(ordering, ascending);
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][4][1][1][1],
+                         params.type, flipped);
+
+  PixelStatistics stats;
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelStatisticsTest, Threaded)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[1024][1024][1][1][1][3][1][1][1],
+                         params.type,
+                         PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PixelStatistics stats;
+  stats.setThreads(4);
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelStatisticsTest, ThreadedInterleaved)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[1024][1024][1][1][1][3][1][1][1],
+                         params.type,
+                         PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PixelStatistics stats;
+  stats.setThreads(4);
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelStatisticsTest, ExplicitRange)
+{
+  const PixelStatisticsTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][2][1][1][1],
+                         params.type);
+
+  PixelStatistics stats(16);
+  stats.setRange(16.0, 128.0);
+  StatisticsTestVisitor v(stats);
+  boost::apply_visitor(v, buf.vbuffer());
+
+  ASSERT_EQ(16.0, stats.getRangeMin());
+  ASSERT_EQ(128.0, stats.getRangeMax());
+  ASSERT_EQ(16U, stats.getStatistics(0).histogram.size());
+}
+
+TEST(PixelStatistics, DefaultRange)
+{
+  PixelStatistics stats;
+
+  stats.reset(1, PT::UINT8);
+  ASSERT_EQ(0.0, stats.getRangeMin());
+  ASSERT_EQ(256.0, stats.getRangeMax());
+
+  stats.reset(1, PT::INT16);
+  ASSERT_EQ(-32768.0, stats.getRangeMin());
+  ASSERT_EQ(32768.0, stats.getRangeMax());
+
+  stats.reset(1, PT::BIT);
+  ASSERT_EQ(0.0, stats.getRangeMin());
+  ASSERT_EQ(2.0, stats.getRangeMax());
+
+  stats.reset(1, PT::FLOAT);
+  ASSERT_EQ(0.0, stats.getRangeMin());
+  ASSERT_EQ(1.0, stats.getRangeMax());
+}
+
+TEST(PixelStatistics, Add)
+{
+  PixelStatistics stats(4);
+  stats.setRange(0.0, 4.0);
+  stats.reset(3, PT::FLOAT);
+
+  const float interleaved[] = { 0.0f, 1.0f, 2.0f,
+                                1.0f, 2.0f, 3.0f };
+  stats.add(interleaved, 2, 2, 1);
+  stats.add(interleaved, 6);
+
+  const SampleStatistics& s0(stats.getStatistics(0));
+  ASSERT_EQ(6U, s0.count);
+  ASSERT_EQ(0.0, s0.min);
+  ASSERT_EQ(3.0, s0.max);
+  ASSERT_EQ(1.5, s0.mean());
+
+  const SampleStatistics& s1(stats.getStatistics(1));
+  ASSERT_EQ(2U, s1.count);
+  ASSERT_EQ(0.0, s1.min);
+  ASSERT_EQ(2.0, s1.max);
+  ASSERT_EQ(1U, s1.histogram[0]);
+  ASSERT_EQ(1U, s1.histogram[2]);
+
+  const SampleStatistics& s2(stats.getStatistics(2));
+  ASSERT_EQ(2U, s2.count);
+  ASSERT_EQ(1.0, s2.min);
+  ASSERT_EQ(1.0, s2.max);
+  ASSERT_EQ(0.0, s2.variance());
+
+  ASSERT_THROW(stats.add(interleaved, 2, 3, 1), std::logic_error);
+  ASSERT_THROW(stats.getStatistics(3), std::logic_error);
+}
+
+TEST(PixelStatistics, NaN)
+{
+  PixelStatistics stats;
+  stats.reset(1, PT::DOUBLE);
+
+  const double values[] = { 0.25, std::numeric_limits<double>::quiet_NaN(), 0.75 };
+  stats.add(values, 3);
+
+  const SampleStatistics& s(stats.getStatistics(0));
+  ASSERT_EQ(2U, s.count);
+  ASSERT_EQ(0.5, s.mean());
+  ASSERT_EQ(0.25, s.stddev());
+}
+
+TEST(PixelStatistics, Merge)
+{
+  PixelStatistics a;
+  PixelStatistics b;
+  a.reset(1, PT::UINT8);
+  b.reset(1, PT::UINT8);
+
+  const uint8_t va[] = { 1, 2, 3 };
+  const uint8_t vb[] = { 4, 5 };
+  a.add(va, 3);
+  b.add(vb, 2);
+  a.merge(b);
+
+  const SampleStatistics& s(a.getStatistics(0));
+  ASSERT_EQ(5U, s.count);
+  ASSERT_EQ(1.0, s.min);
+  ASSERT_EQ(5.0, s.max);
+  ASSERT_EQ(3.0, s.mean());
+  ASSERT_EQ(1U, s.histogram[5]);
+
+  PixelStatistics c;
+  c.reset(2, PT::UINT8);
+  ASSERT_THROW(a.merge(c), std::logic_error);
+}
+
+TEST(PixelStatistics, InvalidParameters)
+{
+  PixelStatistics stats;
+
+  ASSERT_THROW(stats.setBins(0), std::logic_error);
+  ASSERT_THROW(stats.setRange(1.0, 1.0), std::logic_error);
+  ASSERT_THROW(PixelStatistics(0), std::logic_error);
+}
+
+PixelStatisticsTestParameters variant_params[] =
+  { //                            PixelType
+    PixelStatisticsTestParameters(PT::INT8),
+    PixelStatisticsTestParameters(PT::INT16),
+    PixelStatisticsTestParameters(PT::INT32),
+    PixelStatisticsTestParameters(PT::UINT8),
+    PixelStatisticsTestParameters(PT::UINT16),
+    PixelStatisticsTestParameters(PT::UINT32),
+    PixelStatisticsTestParameters(PT::FLOAT),
+    PixelStatisticsTestParameters(PT::DOUBLE),
+    PixelStatisticsTestParameters(PT::BIT),
+    PixelStatisticsTestParameters(PT::COMPLEX),
+    PixelStatisticsTestParameters(PT::DOUBLECOMPLEX)
+  };
+
+// Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
+// this is solely to work around a missing prototype in gtest.
+#ifdef __GNUC__
+#  if defined __clang__ || defined __APPLE__
+#    pragma GCC diagnostic ignored "-Wmissing-prototypes"
+#  endif
+#  pragma GCC diagnostic ignored "-Wmissing-declarations"
+#endif
+
+INSTANTIATE_TEST_CASE_P(PixelStatisticsVariants, PixelStatisticsTest, ::testing::ValuesIn(variant_params));
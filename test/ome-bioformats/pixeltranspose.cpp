@@ -0,0 +1,230 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * %%
+ * Copyright © 2006 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <vector>
+
+#include <ome/bioformats/PixelTranspose.h>
+#include <ome/bioformats/VariantPixelBuffer.h>
+
+#include <ome/test/test.h>
+
+#include "pixel.h"
+
+using ome::bioformats::PixelBuffer;
+using ome::bioformats::PixelBufferBase;
+using ome::bioformats::VariantPixelBuffer;
+using ome::bioformats::transpose;
+typedef ome::xml::model::enums::PixelType PT;
+typedef ome::xml::model::enums::DimensionOrder DO;
+
+class PixelTransposeTestParameters
+{
+public:
+  PT type;
+
+  PixelTransposeTestParameters(PT type):
+    type(type)
+  {}
+};
+
+template<class charT, class traits>
+inline std::basic_ostream<charT,traits>&
+operator<< (std::basic_ostream<charT,traits>& os,
+            const PixelTransposeTestParameters& params)
+{
+  return os << PT(params.type);
+}
+
+class PixelTransposeTest : public ::testing::TestWithParam<PixelTransposeTestParameters>
+{
+};
+
+/*
+ * Fill source buffer, transpose into destination buffer and check
+ * that the logical content is identical.
+ */
+struct TransposeTestVisitor : public boost::static_visitor<>
+{
+  const PixelBufferBase::storage_order_type& source_order;
+  const PixelBufferBase::storage_order_type& dest_order;
+
+  TransposeTestVisitor(const PixelBufferBase::storage_order_type& source_order,
+                       const PixelBufferBase::storage_order_type& dest_order):
+    source_order(source_order),
+    dest_order(dest_order)
+  {}
+
+  template<typename T>
+  void
+  operator() (const T& v)
+  {
+    typedef typename T::element_type::value_type value_type;
+
+    const PixelBufferBase::size_type *shape = v->shape();
+    ome::compat::array<PixelBufferBase::size_type, 9> extents;
+    std::copy(shape, shape + PixelBufferBase::dimensions, extents.begin());
+
+    PixelBuffer<value_type> source(extents, v->pixelType(), ome::bioformats::ENDIAN_NATIVE, source_order);
+    PixelBuffer<value_type> dest(extents, v->pixelType(), ome::bioformats::ENDIAN_NATIVE, dest_order);
+
+    std::vector<value_type> data;
+    for (PixelBufferBase::size_type i = 0; i < source.num_elements(); ++i)
+      data.push_back(pixel_value<value_type>(i));
+    source.assign(data.begin(), data.end());
+
+    transpose(source, dest);
+
+    ASSERT_TRUE(source == dest);
+    ASSERT_TRUE(source.storage_order() == source_order);
+    ASSERT_TRUE(dest.storage_order() == dest_order);
+  }
+};
+
+TEST_P(PixelTransposeTest, InterleavedToPlanar)
+{
+  const PixelTransposeTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][3][1][1][1],
+                         params.type);
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  TransposeTestVisitor v(interleaved, planar);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelTransposeTest, PlanarToInterleaved)
+{
+  const PixelTransposeTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[67][45][1][1][1][4][1][1][1],
+                         params.type);
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  TransposeTestVisitor v(planar, interleaved);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelTransposeTest, DimensionOrder)
+{
+  const PixelTransposeTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[9][7][3][2][5][2][1][1][1],
+                         params.type);
+
+  PixelBufferBase::storage_order_type xyztc(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  PixelBufferBase::storage_order_type xyctz(PixelBufferBase::make_storage_order(DO::XYCTZ, false));
+
+  TransposeTestVisitor v(xyztc, xyctz);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelTransposeTest, SameOrder)
+{
+  const PixelTransposeTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][3][1][1][1],
+                         params.type);
+
+  PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  TransposeTestVisitor v(planar, planar);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(PixelTransposeTest, Descending)
+{
+  const PixelTransposeTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[40][33][1][1][1][3][1][1][1],
+                         params.type);
+
+  PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+
+  PixelBufferBase::size_type ordering[PixelBufferBase::dimensions];
+  bool ascending[PixelBufferBase::dimensions];
+  for (PixelBufferBase::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+    {
+      ordering[d] = interleaved.ordering(d);
+      ascending[d] = true;
+    }
+  // Flip Y and reverse samples.
+  ascending[ome::bioformats::DIM_SPATIAL_Y] = false;
+  ascending[ome::bioformats::DIM_SUBCHANNEL] = false;
+  PixelBufferBase::storage_order_type flipped(ordering, ascending);
+
+  TransposeTestVisitor v(interleaved, flipped);
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST(PixelTranspose, IncompatibleShape)
+{
+  PixelBuffer<uint8_t> source(boost::extents[4][4][1][1][1][3][1][1][1]);
+  PixelBuffer<uint8_t> dest(boost::extents[4][3][1][1][1][3][1][1][1]);
+
+  ASSERT_THROW(transpose(source, dest), std::runtime_error);
+}
+
+PixelTransposeTestParameters variant_params[] =
+  { //                           PixelType
+    PixelTransposeTestParameters(PT::INT8),
+    PixelTransposeTestParameters(PT::INT16),
+    PixelTransposeTestParameters(PT::INT32),
+    PixelTransposeTestParameters(PT::UINT8),
+    PixelTransposeTestParameters(PT::UINT16),
+    PixelTransposeTestParameters(PT::UINT32),
+    PixelTransposeTestParameters(PT::FLOAT),
+    PixelTransposeTestParameters(PT::DOUBLE),
+    PixelTransposeTestParameters(PT::BIT),
+    PixelTransposeTestParameters(PT::COMPLEX),
+    PixelTransposeTestParameters(PT::DOUBLECOMPLEX)
+  };
+
+// Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
+// this is solely to work around a missing prototype in gtest.
+#ifdef __GNUC__
+#  if defined __clang__ || defined __APPLE__
+#    pragma GCC diagnostic ignored "-Wmissing-prototypes"
+#  endif
+#  pragma GCC diagnostic ignored "-Wmissing-declarations"
+#endif
+
+INSTANTIATE_TEST_CASE_P(PixelTransposeVariants, PixelTransposeTest, ::testing::ValuesIn(variant_params));
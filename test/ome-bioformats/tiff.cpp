@@ -40,10 +40,14 @@
 #include <stdexcept>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include <boost/type_traits.hpp>
 
+#include <ome/bioformats/PixelCopy.h>
 #include <ome/bioformats/PixelProperties.h>
+#include <ome/bioformats/PixelStatistics.h>
 #include <ome/bioformats/tiff/config.h>
 #include <ome/bioformats/tiff/Codec.h>
 #include <ome/bioformats/tiff/TileInfo.h>
@@ -811,6 +815,63 @@ TEST_F(TIFFTest, PixelType)
   ASSERT_EQ(8U, ifd->getBitsPerSample());
 }
 
+namespace
+{
+
+  // Read every IFD of a shared TIFF in turn, in an order starting at
+  // a thread-specific offset so that threads use different IFDs.
+  void
+  read_all_ifds(ome::compat::shared_ptr<TIFF>           tiff,
+                directory_index_type                    start,
+                const std::vector<VariantPixelBuffer>&  expected,
+                bool&                                   ok)
+  {
+    ok = true;
+    try
+      {
+        for (directory_index_type n = 0; n < 50; ++n)
+          {
+            directory_index_type i = (start + n) % expected.size();
+            ome::compat::shared_ptr<IFD> ifd(tiff->getDirectoryByIndex(i));
+            VariantPixelBuffer vb;
+            ifd->readImage(vb);
+            if (!(vb == expected[i]))
+              ok = false;
+          }
+      }
+    catch (const std::exception&)
+      {
+        ok = false;
+      }
+  }
+
+}
+
+TEST_F(TIFFTest, ConcurrentRead)
+{
+  ome::compat::shared_ptr<TIFF> t;
+  ASSERT_NO_THROW(t = TIFF::open(tiff_path, "r"));
+
+  std::vector<VariantPixelBuffer> expected(10);
+  for (directory_index_type i = 0; i < expected.size(); ++i)
+    t->getDirectoryByIndex(i)->readImage(expected[i]);
+
+  // Each IFD and the TIFF itself are shared between the threads; the
+  // per-TIFF lock must keep the current directory consistent with
+  // each read.
+  const directory_index_type nthreads = 4;
+  bool ok[nthreads];
+  boost::thread_group threads;
+  for (directory_index_type i = 0; i < nthreads; ++i)
+    threads.create_thread(boost::bind(read_all_ifds, t, i * 3,
+                                      boost::cref(expected),
+                                      boost::ref(ok[i])));
+  threads.join_all();
+
+  for (directory_index_type i = 0; i < nthreads; ++i)
+    EXPECT_TRUE(ok[i]);
+}
+
 TEST(TIFFCodec, ListCodecs)
 {
   // Note this list depends upon the codecs provided by libtiff, which
@@ -1316,6 +1377,31 @@ TEST_P(TIFFTileTest, PlaneReadUnalignedTileRandom)
     }
 }
 
+TEST_P(TIFFTileTest, PlaneReadMultipleRegions)
+{
+  PlaneRegion full(0, 0, ifd->getImageWidth(), ifd->getImageHeight());
+
+  // Overlapping regions sharing tiles, plus the whole plane.
+  std::vector<PlaneRegion> regions;
+  for (dimension_size_type x = 0; x < full.w; x+= 13)
+    for (dimension_size_type y = 0; y < full.h; y+= 11)
+      regions.push_back(PlaneRegion(x, y, 17, 19) & full);
+  regions.push_back(full);
+
+  std::vector<VariantPixelBuffer> vbs;
+  ASSERT_NO_THROW(ifd->readImages(vbs, regions));
+  ASSERT_EQ(regions.size(), vbs.size());
+
+  for (std::vector<PlaneRegion>::size_type i = 0; i < regions.size(); ++i)
+    {
+      const PlaneRegion& r = regions[i];
+
+      VariantPixelBuffer vb;
+      ifd->readImage(vb, r.x, r.y, r.w, r.h);
+      EXPECT_TRUE(vb == vbs[i]);
+    }
+}
+
 class PixelTestParameters
 {
 public:
@@ -1530,6 +1616,247 @@ TEST_P(PixelTest, WriteTIFF)
 
 }
 
+namespace
+{
+
+  // As for the WriteTIFF test, but using a source storage order
+  // which either matches (reorder=false) or differs from
+  // (reorder=true) the planar configuration, optionally limiting the
+  // memory used to cache partially written tiles, and optionally
+  // writing each subchannel separately (in reverse order).
+  void
+  write_tiff(const PixelTestParameters& params,
+             bool                       reorder,
+             dimension_size_type        cachelimit = 0U,
+             bool                       subchannels = false)
+  {
+    const VariantPixelBuffer& pixels(TIFFTileTest::getPNGData(params.pixeltype, params.planarconfig));
+    const VariantPixelBuffer::size_type *shape = pixels.shape();
+
+    dimension_size_type exp_size = (params.tilewidth * params.tileheight *
+                                    ::ome::bioformats::bytesPerPixel(params.pixeltype) *
+                                    (params.planarconfig == ::ome::bioformats::tiff::CONTIG ? shape[ome::bioformats::DIM_SUBCHANNEL] : 1));
+
+    // Write TIFF
+    {
+      ome::compat::shared_ptr<TIFF> wtiff;
+      ASSERT_NO_THROW(wtiff = TIFF::open(params.filename, "w"));
+      ASSERT_TRUE(static_cast<bool>(wtiff));
+      wtiff->setTileCacheLimit(cachelimit);
+      ome::compat::shared_ptr<IFD> wifd;
+      ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+      ASSERT_TRUE(static_cast<bool>(wifd));
+      EXPECT_EQ(cachelimit, wifd->getTileCacheLimit());
+
+      // Set IFD tags
+      ASSERT_NO_THROW(wifd->setImageWidth(shape[ome::bioformats::DIM_SPATIAL_X]));
+      ASSERT_NO_THROW(wifd->setImageHeight(shape[ome::bioformats::DIM_SPATIAL_Y]));
+      ASSERT_NO_THROW(wifd->setTileType(params.tiletype));
+      ASSERT_NO_THROW(wifd->setTileWidth(params.tilewidth));
+      ASSERT_NO_THROW(wifd->setTileHeight(params.tileheight));
+      ASSERT_NO_THROW(wifd->setPixelType(params.pixeltype));
+      ASSERT_NO_THROW(wifd->setBitsPerSample(significantBitsPerPixel(params.pixeltype)));
+      ASSERT_NO_THROW(wifd->setSamplesPerPixel(shape[ome::bioformats::DIM_SUBCHANNEL]));
+      ASSERT_NO_THROW(wifd->setPlanarConfiguration(params.planarconfig));
+      ASSERT_NO_THROW(wifd->setPhotometricInterpretation(params.photometricinterp));
+
+      // Verify IFD tags
+      EXPECT_EQ(shape[ome::bioformats::DIM_SPATIAL_X], wifd->getImageWidth());
+      EXPECT_EQ(shape[ome::bioformats::DIM_SPATIAL_Y], wifd->getImageHeight());
+      EXPECT_EQ(params.tiletype, wifd->getTileType());
+      EXPECT_EQ(params.tilewidth, wifd->getTileWidth());
+      EXPECT_EQ(params.tileheight, wifd->getTileHeight());
+      EXPECT_EQ(params.pixeltype, wifd->getPixelType());
+      EXPECT_EQ(significantBitsPerPixel(params.pixeltype), wifd->getBitsPerSample());
+      EXPECT_EQ(shape[ome::bioformats::DIM_SUBCHANNEL], wifd->getSamplesPerPixel());
+      EXPECT_EQ(params.planarconfig, wifd->getPlanarConfiguration());
+
+      // Make sure our expectations about buffer size are correct
+      if (params.pixeltype == PT::BIT)
+        {
+          dimension_size_type size;
+          size = exp_size / 8;
+          if (exp_size % 8)
+            ++size;
+          exp_size = size;
+        }
+      ASSERT_EQ(exp_size,
+                wifd->getTileInfo().bufferSize());
+
+      PlaneRegion full(0, 0, wifd->getImageWidth(), wifd->getImageHeight());
+
+      dimension_size_type wtilewidth = params.tilewidth;
+      dimension_size_type wtileheight = params.tileheight;
+      if (!params.optimal)
+        {
+          wtilewidth = 5;
+          wtileheight = 7;
+        }
+
+      std::vector<PlaneRegion> tiles;
+      for (dimension_size_type x = 0; x < full.w; x+= wtilewidth)
+        for (dimension_size_type y = 0; y < full.h; y+= wtileheight)
+          {
+            PlaneRegion r = PlaneRegion(x, y, wtilewidth, wtileheight) & full;
+            tiles.push_back(r);
+          }
+
+      if (!params.ordered)
+        std::random_shuffle(tiles.begin(), tiles.end());
+
+      for (std::vector<PlaneRegion>::const_iterator i = tiles.begin();
+           i != tiles.end();
+           ++i)
+        {
+          const PlaneRegion& r = *i;
+
+          ome::compat::array<VariantPixelBuffer::size_type, 9> shape;
+          shape[::ome::bioformats::DIM_SPATIAL_X] = r.w;
+          shape[::ome::bioformats::DIM_SPATIAL_Y] = r.h;
+          shape[::ome::bioformats::DIM_SUBCHANNEL] = 3U;
+          shape[::ome::bioformats::DIM_SPATIAL_Z] = shape[::ome::bioformats::DIM_TEMPORAL_T] = shape[::ome::bioformats::DIM_CHANNEL] =
+            shape[::ome::bioformats::DIM_MODULO_Z] = shape[::ome::bioformats::DIM_MODULO_T] = shape[::ome::bioformats::DIM_MODULO_C] = 1;
+
+          ::ome::bioformats::PixelBufferBase::storage_order_type order
+              (::ome::bioformats::PixelBufferBase::make_storage_order(::ome::xml::model::enums::DimensionOrder::XYZTC,
+                                                                      (params.planarconfig == ::ome::bioformats::tiff::CONTIG) != reorder));
+
+          VariantPixelBuffer vb;
+          vb.setBuffer(shape, params.pixeltype, order);
+
+          // Temporary subrange to write into tile
+          PixelSubrangeVisitor sv(r.x, r.y);
+          boost::apply_visitor(sv, pixels.vbuffer(), vb.vbuffer());
+
+          if (!subchannels)
+            {
+              wifd->writeImage(vb, r.x, r.y, r.w, r.h);
+              continue;
+            }
+
+          ome::compat::array<VariantPixelBuffer::size_type, 9> subshape(shape);
+          subshape[::ome::bioformats::DIM_SUBCHANNEL] = 1U;
+
+          for (dimension_size_type s = shape[::ome::bioformats::DIM_SUBCHANNEL]; s > 0; --s)
+            {
+              VariantPixelBuffer svb;
+              svb.setBuffer(subshape, params.pixeltype, order);
+
+              ::ome::bioformats::PixelBufferBase::indices_type start;
+              ::ome::bioformats::PixelBufferBase::indices_type substart;
+              std::fill(start.begin(), start.end(), 0);
+              std::fill(substart.begin(), substart.end(), 0);
+              start[::ome::bioformats::DIM_SUBCHANNEL] = static_cast< ::ome::bioformats::PixelBufferBase::index>(s - 1);
+              ::ome::bioformats::copyRegion(vb, start, subshape, svb, substart);
+
+              if (params.planarconfig == ::ome::bioformats::tiff::CONTIG)
+                {
+                  EXPECT_THROW(wifd->writeImage(svb, r.x, r.y, r.w, r.h, s - 1),
+                               ome::bioformats::tiff::Exception);
+                  wifd->writeImage(vb, r.x, r.y, r.w, r.h);
+                  break;
+                }
+
+              wifd->writeImage(svb, r.x, r.y, r.w, r.h, s - 1);
+            }
+        }
+
+      wtiff->writeCurrentDirectory();
+      wtiff->close();
+    }
+
+    // Read and validate TIFF
+    {
+      // Note "c" to disable automatic strip chopping so we can verify
+      // the exact tag content of ROWSPERSTRIP.
+      ome::compat::shared_ptr<TIFF> tiff;
+      ASSERT_NO_THROW(tiff = TIFF::open(params.filename, "rc"));
+      ASSERT_TRUE(static_cast<bool>(tiff));
+      ome::compat::shared_ptr<IFD> ifd;
+      ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+      ASSERT_TRUE(static_cast<bool>(ifd));
+
+      EXPECT_EQ(shape[ome::bioformats::DIM_SPATIAL_X], ifd->getImageWidth());
+      EXPECT_EQ(shape[ome::bioformats::DIM_SPATIAL_Y], ifd->getImageHeight());
+      EXPECT_EQ(params.tiletype, ifd->getTileType());
+      EXPECT_EQ(params.tilewidth, ifd->getTileWidth());
+      EXPECT_EQ(params.tileheight, ifd->getTileHeight());
+      EXPECT_EQ(params.pixeltype, ifd->getPixelType());
+      EXPECT_EQ(significantBitsPerPixel(params.pixeltype), ifd->getBitsPerSample());
+      EXPECT_EQ(shape[ome::bioformats::DIM_SUBCHANNEL], ifd->getSamplesPerPixel());
+      EXPECT_EQ(params.planarconfig, ifd->getPlanarConfiguration());
+      EXPECT_EQ(params.photometricinterp, ifd->getPhotometricInterpretation());
+
+      VariantPixelBuffer vb;
+      ifd->readImage(vb);
+
+      if(pixels != vb)
+        {
+          std::cout << "Observed\n";
+          dump_image_representation(vb, std::cout);
+          std::cout << "Expected\n";
+          dump_image_representation(pixels, std::cout);
+        }
+      EXPECT_TRUE(pixels == vb);
+    }
+  }
+
+}
+
+TEST_P(PixelTest, WriteTIFFReordered)
+{
+  write_tiff(GetParam(), true);
+}
+
+TEST_P(PixelTest, WriteTIFFCacheLimit)
+{
+  // Limit to a single resident tile; the tiles are written column
+  // by column, so partial strips and tiles are spilled.
+  write_tiff(GetParam(), false, 1U);
+}
+
+TEST_P(PixelTest, WriteTIFFSubchannels)
+{
+  write_tiff(GetParam(), false, 0U, true);
+}
+
+TEST_P(PixelTest, ReadTIFFStatistics)
+{
+  const PixelTestParameters& params = GetParam();
+
+  write_tiff(params, false);
+
+  ome::compat::shared_ptr<TIFF> tiff;
+  ASSERT_NO_THROW(tiff = TIFF::open(params.filename, "r"));
+  ASSERT_TRUE(static_cast<bool>(tiff));
+  ome::compat::shared_ptr<IFD> ifd;
+  ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+  ASSERT_TRUE(static_cast<bool>(ifd));
+
+  // Statistics computed during the read must match those computed
+  // separately from the pixel buffer.
+  VariantPixelBuffer vb;
+  ifd->readImage(vb);
+
+  VariantPixelBuffer svb;
+  ome::bioformats::PixelStatistics fused;
+  ome::bioformats::PixelStatistics computed;
+  ifd->readImage(svb, fused);
+  computed.compute(vb);
+  EXPECT_TRUE(vb == svb);
+  ASSERT_EQ(computed.getStatistics().size(), fused.getStatistics().size());
+  for (dimension_size_type s = 0; s < computed.getStatistics().size(); ++s)
+    {
+      const ome::bioformats::SampleStatistics& c(computed.getStatistics(s));
+      const ome::bioformats::SampleStatistics& f(fused.getStatistics(s));
+      EXPECT_EQ(c.count, f.count);
+      EXPECT_EQ(c.min, f.min);
+      EXPECT_EQ(c.max, f.max);
+      EXPECT_NEAR(c.sum, f.sum, std::abs(c.sum) * 1e-12);
+      EXPECT_TRUE(c.histogram == f.histogram);
+    }
+}
+
 namespace
 {
 
@@ -0,0 +1,147 @@
+/*
+ * #%L
+ * OME-BIOFORMATS C++ library for image IO.
+ * %%
+ * Copyright © 2014 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <ome/bioformats/Types.h>
+#include <ome/bioformats/detail/TIFFHandlePool.h>
+#include <ome/bioformats/tiff/Exception.h>
+#include <ome/bioformats/tiff/TIFF.h>
+
+#include <ome/compat/memory.h>
+
+#include <ome/test/test.h>
+
+using ome::bioformats::dimension_size_type;
+using ome::bioformats::detail::TIFFHandlePool;
+
+namespace
+{
+
+  const boost::filesystem::path
+  testfile(PROJECT_SOURCE_DIR "/test/ome-bioformats/data/2010-06-18x24y5z1t2c8b-text.ome.tiff");
+
+}
+
+class TIFFHandlePoolTest : public ::testing::Test
+{
+public:
+  dimension_size_type oldLimit;
+
+  virtual void SetUp()
+  {
+    oldLimit = TIFFHandlePool::instance().getLimit();
+  }
+
+  virtual void TearDown()
+  {
+    TIFFHandlePool::instance().setLimit(oldLimit);
+  }
+};
+
+TEST_F(TIFFHandlePoolTest, Instance)
+{
+  TIFFHandlePool& pool1(TIFFHandlePool::instance());
+  TIFFHandlePool& pool2(TIFFHandlePool::instance());
+
+  ASSERT_EQ(&pool1, &pool2);
+  ASSERT_LT(0U, pool1.getLimit());
+}
+
+TEST_F(TIFFHandlePoolTest, OpenEvict)
+{
+  TIFFHandlePool& pool(TIFFHandlePool::instance());
+  pool.setLimit(2U);
+
+  TIFFHandlePool::Statistics start(pool.getStatistics());
+
+  TIFFHandlePool::handle_type t1(pool.open(testfile));
+  ome::compat::weak_ptr<ome::bioformats::tiff::TIFF> w2(pool.open(testfile));
+  ASSERT_TRUE(t1);
+  ASSERT_FALSE(w2.expired());
+
+  TIFFHandlePool::handle_type t3(pool.open(testfile));
+  ASSERT_TRUE(t3);
+
+  TIFFHandlePool::Statistics stats(pool.getStatistics());
+  ASSERT_EQ(2U, stats.open);
+  ASSERT_EQ(start.opened + 3U, stats.opened);
+  ASSERT_EQ(start.evicted + 1U, stats.evicted);
+
+  // The least recently used TIFF (t1) was evicted, but is still in use.
+  ASSERT_TRUE(t1);
+  ASSERT_FALSE(w2.expired());
+
+  // Using an evicted TIFF returns it to the pool, evicting the
+  // least recently used TIFF, which is closed as it is unreferenced.
+  pool.use(t1);
+  ASSERT_TRUE(w2.expired());
+  ASSERT_EQ(start.evicted + 2U, pool.getStatistics().evicted);
+
+  // Reducing the limit evicts all but the most recently used.
+  pool.setLimit(1U);
+  stats = pool.getStatistics();
+  ASSERT_EQ(1U, stats.open);
+  ASSERT_EQ(start.evicted + 3U, stats.evicted);
+
+  pool.release(t1);
+  pool.release(t3);
+}
+
+TEST_F(TIFFHandlePoolTest, Release)
+{
+  TIFFHandlePool& pool(TIFFHandlePool::instance());
+
+  TIFFHandlePool::Statistics start(pool.getStatistics());
+
+  TIFFHandlePool::handle_type t(pool.open(testfile));
+  ASSERT_EQ(start.open + 1U, pool.getStatistics().open);
+
+  pool.release(t);
+
+  TIFFHandlePool::Statistics stats(pool.getStatistics());
+  ASSERT_EQ(start.open, stats.open);
+  ASSERT_EQ(start.evicted, stats.evicted);
+  ASSERT_TRUE(t);
+}
+
+TEST_F(TIFFHandlePoolTest, OpenMissing)
+{
+  TIFFHandlePool& pool(TIFFHandlePool::instance());
+
+  ASSERT_THROW(pool.open(PROJECT_SOURCE_DIR "/test/ome-bioformats/data/nonexistent.tiff"),
+               ome::bioformats::tiff::Exception);
+}
@@ -36,9 +36,15 @@
  * #L%
  */
 
+#include <algorithm>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include <boost/filesystem/fstream.hpp>
+
+#include <ome/bioformats/PixelCopy.h>
+#include <ome/bioformats/PlaneRegion.h>
 #include <ome/bioformats/VariantPixelBuffer.h>
 #include <ome/bioformats/in/TIFFReader.h>
 
@@ -147,6 +153,236 @@ TEST_P(TIFFTest, openBytes)
     }
 }
 
+namespace
+{
+
+  // Check each plane of a range read with openPlanes() matches the
+  // same plane read with openBytes().
+  void
+  checkPlanes(const ome::bioformats::FormatReader&               reader,
+              const ome::compat::array<dimension_size_type, 3>& start,
+              const ome::compat::array<dimension_size_type, 3>& count,
+              const VariantPixelBuffer&                         range,
+              const ome::bioformats::PlaneRegion&               region)
+  {
+    ASSERT_EQ(count[0], range.shape()[ome::bioformats::DIM_SPATIAL_Z]);
+    ASSERT_EQ(count[1], range.shape()[ome::bioformats::DIM_CHANNEL]);
+    ASSERT_EQ(count[2], range.shape()[ome::bioformats::DIM_TEMPORAL_T]);
+
+    for (dimension_size_type z = 0; z < count[0]; ++z)
+      for (dimension_size_type c = 0; c < count[1]; ++c)
+        for (dimension_size_type t = 0; t < count[2]; ++t)
+          {
+            VariantPixelBuffer expected;
+            reader.openBytes(reader.getIndex(start[0] + z, start[1] + c, start[2] + t),
+                             expected, region.x, region.y, region.w, region.h);
+
+            ome::bioformats::PixelBufferBase::shape_type shape;
+            std::copy(expected.shape(), expected.shape() + shape.size(), shape.begin());
+
+            ome::bioformats::PixelBufferBase::indices_type origin;
+            std::fill(origin.begin(), origin.end(), 0);
+            ome::bioformats::PixelBufferBase::indices_type position(origin);
+            position[ome::bioformats::DIM_SPATIAL_Z] = static_cast<ome::bioformats::PixelBufferBase::index>(z);
+            position[ome::bioformats::DIM_CHANNEL] = static_cast<ome::bioformats::PixelBufferBase::index>(c);
+            position[ome::bioformats::DIM_TEMPORAL_T] = static_cast<ome::bioformats::PixelBufferBase::index>(t);
+
+            VariantPixelBuffer plane;
+            plane.ensureBuffer(shape, expected.pixelType(), expected.storage_order());
+            ASSERT_NO_THROW(ome::bioformats::copyRegion(range, position, shape, plane, origin));
+            EXPECT_TRUE(plane == expected) << "Z=" << z << " C=" << c << " T=" << t;
+          }
+  }
+
+}
+
+TEST_P(TIFFTest, openPlanes)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+  // Not the XYZTC order used for TIFF planes.
+  EXPECT_EQ(std::string("XYCZT"), tiff.getDimensionOrder());
+
+  ome::compat::array<dimension_size_type, 3> start = {{0, 0, 2}};
+  ome::compat::array<dimension_size_type, 3> count = {{1, 1, params.sizeT - 3}};
+
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(tiff.openPlanes(start, count, buf));
+  EXPECT_EQ(tiff.getSizeX() * tiff.getSizeY() * count[2], buf.num_elements());
+  checkPlanes(tiff, start, count, buf,
+              ome::bioformats::PlaneRegion(0, 0, tiff.getSizeX(), tiff.getSizeY()));
+
+  const ome::bioformats::PlaneRegion region(3, 5, 7, 4);
+  ASSERT_NO_THROW(tiff.openPlanes(start, count, buf, region.x, region.y, region.w, region.h));
+  EXPECT_EQ(region.w * region.h * count[2], buf.num_elements());
+  checkPlanes(tiff, start, count, buf, region);
+}
+
+namespace
+{
+
+  class RawTIFFWriter
+  {
+  public:
+    std::string data;
+    bool bigEndian;
+
+    RawTIFFWriter(bool bigEndian):
+      data(),
+      bigEndian(bigEndian)
+    {}
+
+    void
+    put16(uint16_t value)
+    {
+      if (bigEndian)
+        {
+          data.push_back(static_cast<char>((value >> 8) & 0xFF));
+          data.push_back(static_cast<char>(value & 0xFF));
+        }
+      else
+        {
+          data.push_back(static_cast<char>(value & 0xFF));
+          data.push_back(static_cast<char>((value >> 8) & 0xFF));
+        }
+    }
+
+    void
+    put32(uint32_t value)
+    {
+      if (bigEndian)
+        {
+          put16(static_cast<uint16_t>(value >> 16));
+          put16(static_cast<uint16_t>(value & 0xFFFF));
+        }
+      else
+        {
+          put16(static_cast<uint16_t>(value & 0xFFFF));
+          put16(static_cast<uint16_t>(value >> 16));
+        }
+    }
+
+    void
+    entry(uint16_t tag,
+          uint16_t type,
+          uint32_t count,
+          uint32_t value)
+    {
+      put16(tag);
+      put16(type);
+      put32(count);
+      if (type == 3 && count == 1) // SHORT, left-justified
+        {
+          put16(static_cast<uint16_t>(value));
+          put16(0U);
+        }
+      else
+        put32(value);
+    }
+  };
+
+  uint16_t
+  imagejPixel(dimension_size_type plane,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 1000U) + (y * 18U) + x);
+  }
+
+  // Write an uncompressed 16-bit ImageJ stack with a single IFD, with
+  // all planes stored contiguously following the first, as written
+  // by ImageJ for stacks larger than 4 GiB.
+  void
+  writeImageJStack(const boost::filesystem::path& file,
+                   bool                           bigEndian)
+  {
+    const uint32_t width = 18U;
+    const uint32_t height = 24U;
+    const uint32_t images = 6U;
+    const std::string desc("ImageJ=1.51\nimages=6\nchannels=2\nslices=3\nhyperstack=true\n");
+    const uint32_t descOffset = 8U + 2U + (10U * 12U) + 4U;
+    const uint32_t dataOffset = descOffset + static_cast<uint32_t>(desc.size() + 2U) / 2U * 2U;
+    const uint32_t planeSize = width * height * 2U;
+
+    RawTIFFWriter w(bigEndian);
+    w.data += bigEndian ? "MM" : "II";
+    w.put16(42U);
+    w.put32(8U);
+
+    w.put16(10U);
+    w.entry(256U, 3U, 1U, width);                 // ImageWidth
+    w.entry(257U, 3U, 1U, height);                // ImageLength
+    w.entry(258U, 3U, 1U, 16U);                   // BitsPerSample
+    w.entry(259U, 3U, 1U, 1U);                    // Compression
+    w.entry(262U, 3U, 1U, 1U);                    // PhotometricInterpretation
+    w.entry(270U, 2U, static_cast<uint32_t>(desc.size() + 1U), descOffset); // ImageDescription
+    w.entry(273U, 4U, 1U, dataOffset);            // StripOffsets
+    w.entry(277U, 3U, 1U, 1U);                    // SamplesPerPixel
+    w.entry(278U, 3U, 1U, height);                // RowsPerStrip
+    w.entry(279U, 4U, 1U, planeSize);             // StripByteCounts
+    w.put32(0U);
+
+    w.data += desc;
+    while (w.data.size() < dataOffset)
+      w.data.push_back('\0');
+
+    for (dimension_size_type p = 0; p < images; ++p)
+      for (dimension_size_type y = 0; y < height; ++y)
+        for (dimension_size_type x = 0; x < width; ++x)
+          w.put16(imagejPixel(p, x, y));
+
+    boost::filesystem::ofstream out(file, std::ios::out | std::ios::binary);
+    out.write(w.data.data(), static_cast<std::streamsize>(w.data.size()));
+  }
+
+}
+
+TEST(TIFFImageJTest, ContiguousPlanes)
+{
+  for (int e = 0; e < 2; ++e)
+    {
+      const bool bigEndian = (e == 1);
+
+      boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-bioformats/data");
+      boost::filesystem::path file(dir / (std::string("tiffreader-imagej-") +
+                                          (bigEndian ? "be" : "le") + ".tiff"));
+      writeImageJStack(file, bigEndian);
+
+      TIFFReader reader;
+      ASSERT_NO_THROW(reader.setId(file));
+
+      EXPECT_EQ(1U, reader.getSeriesCount());
+      EXPECT_EQ(18U, reader.getSizeX());
+      EXPECT_EQ(24U, reader.getSizeY());
+      EXPECT_EQ(2U, reader.getSizeC());
+      EXPECT_EQ(3U, reader.getSizeZ());
+      EXPECT_EQ(1U, reader.getSizeT());
+      ASSERT_EQ(6U, reader.getImageCount());
+
+      for (dimension_size_type p = 0; p < reader.getImageCount(); ++p)
+        {
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(reader.openBytes(p, buf));
+          ASSERT_EQ(18U * 24U, buf.num_elements());
+
+          const uint16_t *data = buf.array<uint16_t>().data();
+          for (dimension_size_type y = 0; y < 24U; ++y)
+            for (dimension_size_type x = 0; x < 18U; ++x)
+              ASSERT_EQ(imagejPixel(p, x, y), data[(y * 18U) + x]);
+
+          // Region read.
+          VariantPixelBuffer region;
+          ASSERT_NO_THROW(reader.openBytes(p, region, 3, 5, 7, 4));
+          ASSERT_EQ(7U * 4U, region.num_elements());
+          const uint16_t *rdata = region.array<uint16_t>().data();
+          for (dimension_size_type y = 0; y < 4U; ++y)
+            for (dimension_size_type x = 0; x < 7U; ++x)
+              ASSERT_EQ(imagejPixel(p, x + 3U, y + 5U), rdata[(y * 7U) + x]);
+        }
+    }
+}
+
 namespace
 {
 
@@ -36,6 +36,8 @@
  * #L%
  */
 
+#include <algorithm>
+
 #include <ome/bioformats/Types.h>
 #include <ome/bioformats/TileBuffer.h>
 #include <ome/bioformats/TileCache.h>
@@ -98,6 +100,12 @@ TEST(TileCache, IndexOperator)
     }
 
   ASSERT_EQ(16U, c.size());
+  ASSERT_EQ(16U * 8192U, c.memoryUsage());
+
+  // Replaced and erased buffers are accounted for.
+  c[3] = ome::compat::shared_ptr<TileBuffer>(new TileBuffer((4096)));
+  c.erase(7);
+  ASSERT_EQ(14U * 8192U + 4096U, c.memoryUsage());
 }
 
 TEST(TileCache, Remove)
@@ -133,3 +141,122 @@ TEST(TileCache, Clear)
   c.clear();
   ASSERT_EQ(0U, c.size());
 }
+
+TEST(TileCache, MemoryLimit)
+{
+  TileCache c;
+  const TileCache& cc(c);
+
+  ASSERT_EQ(0U, c.getMemoryLimit());
+  c.setMemoryLimit(4U * 8192U);
+  ASSERT_EQ(4U * 8192U, c.getMemoryLimit());
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    {
+      ome::compat::shared_ptr<TileBuffer> buf(new TileBuffer(8192));
+      std::fill(buf->data(), buf->data() + buf->size(), static_cast<uint8_t>(i + 1));
+      ASSERT_TRUE(c.insert(i, buf));
+      ASSERT_LE(c.memoryUsage(), 4U * 8192U);
+    }
+
+  ASSERT_EQ(16U, c.size());
+  ASSERT_FALSE(c.insert(0, ome::compat::shared_ptr<TileBuffer>(new TileBuffer(8192))));
+
+  // Restore spilled tiles, in both orders.
+  for (dimension_size_type i = 0; i < 16; ++i)
+    {
+      ome::compat::shared_ptr<TileBuffer> buf(c.find(i));
+      ASSERT_TRUE(static_cast<bool>(buf));
+      ASSERT_EQ(8192U, buf->size());
+      for (dimension_size_type j = 0; j < buf->size(); ++j)
+        ASSERT_EQ(static_cast<uint8_t>(i + 1), buf->data()[j]);
+      ASSERT_LE(c.memoryUsage(), 4U * 8192U);
+    }
+  for (dimension_size_type i = 16; i > 0; --i)
+    {
+      ome::compat::shared_ptr<TileBuffer> buf(cc.find(i - 1));
+      ASSERT_TRUE(static_cast<bool>(buf));
+      ASSERT_EQ(static_cast<uint8_t>(i), buf->data()[4096]);
+    }
+  ASSERT_EQ(16U, c.size());
+
+  // Modifications must survive spilling.
+  c.find(3)->data()[0] = 0xFFU;
+  for (dimension_size_type i = 8; i < 16; ++i)
+    c.find(i);
+  ASSERT_EQ(0xFFU, c.find(3)->data()[0]);
+
+  c.erase(5);
+  c.erase(12);
+  ASSERT_FALSE(static_cast<bool>(c.find(5)));
+  ASSERT_FALSE(static_cast<bool>(c.find(12)));
+  ASSERT_EQ(14U, c.size());
+
+  c.setMemoryLimit(8192U);
+  ASSERT_LE(c.memoryUsage(), 8192U);
+  ASSERT_EQ(14U, c.size());
+
+  c.setMemoryLimit(0U);
+  for (dimension_size_type i = 0; i < 16; ++i)
+    if (i != 5 && i != 12)
+      ASSERT_TRUE(static_cast<bool>(c.find(i)));
+  ASSERT_EQ(14U * 8192U, c.memoryUsage());
+
+  c.clear();
+  ASSERT_EQ(0U, c.size());
+  ASSERT_EQ(0U, c.memoryUsage());
+}
+
+TEST(TileCache, MemoryLimitIndexOperator)
+{
+  TileCache c;
+  c.setMemoryLimit(4U * 8192U);
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    {
+      c[i] = ome::compat::shared_ptr<TileBuffer>(new TileBuffer(8192));
+      // The most recently assigned tile is accounted for on next use.
+      ASSERT_LE(c.memoryUsage(), 5U * 8192U);
+    }
+  ASSERT_EQ(16U, c.size());
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    ASSERT_EQ(8192U, c[i]->size());
+}
+
+TEST(TileCache, LeastRecentlyUsed)
+{
+  TileCache c;
+  c.setMemoryLimit(2U * 8192U);
+
+  ome::compat::shared_ptr<TileBuffer> buf0(new TileBuffer(8192));
+  ome::compat::shared_ptr<TileBuffer> buf1(new TileBuffer(8192));
+  ome::compat::shared_ptr<TileBuffer> buf2(new TileBuffer(8192));
+
+  ASSERT_TRUE(c.insert(0, buf0));
+  ASSERT_TRUE(c.insert(1, buf1));
+  // Tile 1 is now the least recently used, so is spilled.
+  ASSERT_EQ(buf0, c.find(0));
+  ASSERT_TRUE(c.insert(2, buf2));
+
+  ASSERT_EQ(3U, c.size());
+  ASSERT_EQ(2U * 8192U, c.memoryUsage());
+  // Resident tiles are the same buffers; a spilled tile is a copy.
+  ASSERT_EQ(buf0, c.find(0));
+  ASSERT_EQ(buf2, c.find(2));
+  ome::compat::shared_ptr<TileBuffer> restored(c.find(1));
+  ASSERT_TRUE(static_cast<bool>(restored));
+  ASSERT_NE(buf1, restored);
+}
+
+TEST(TileCache, UnlimitedIndexOperator)
+{
+  TileCache c;
+
+  // Repeated use of the same tiles must not accumulate state.
+  for (dimension_size_type n = 0; n < 1000; ++n)
+    c[n % 4] = ome::compat::shared_ptr<TileBuffer>(new TileBuffer(1024 * (n % 4 + 1)));
+
+  ASSERT_EQ(4U, c.size());
+  ASSERT_EQ((1U + 2U + 3U + 4U) * 1024U, c.memoryUsage());
+}
@@ -38,6 +38,7 @@
 
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 #include <ome/bioformats/VariantPixelBuffer.h>
 
@@ -48,6 +49,7 @@
 using ome::bioformats::PixelBuffer;
 using ome::bioformats::PixelBufferBase;
 using ome::bioformats::PixelProperties;
+using ome::bioformats::PixelSpan;
 using ome::bioformats::VariantPixelBuffer;
 typedef ome::xml::model::enums::PixelType PT;
 
@@ -276,6 +278,98 @@ struct ConstructRangeRefTestVisitor : public boost::static_visitor<>
   }
 };
 
+/*
+ * Construct unmanaged buffer with extents from raw storage.
+ */
+struct ConstructExtentRawRefTestVisitor : public boost::static_visitor<>
+{
+  template<typename T>
+  void
+  operator() (const T& v)
+  {
+    typedef typename T::element_type::value_type value_type;
+
+    ome::compat::array<VariantPixelBuffer::size_type, 9> extents;
+    extents[0] = 5;
+    extents[1] = 2;
+    extents[2] = extents[3] = extents[4] = extents[5] = extents[6] = extents[7] = extents[8] = 1;
+
+    // VariantPixelBuffer with unmanaged backing store.
+    value_type backing[10];
+    VariantPixelBuffer mbuf(static_cast<void *>(&backing[0]), extents, v->pixelType());
+
+    ASSERT_EQ(10U, mbuf.num_elements());
+    ASSERT_FALSE(mbuf.managed());
+    ASSERT_EQ(reinterpret_cast<VariantPixelBuffer::raw_type *>(&backing[0]), mbuf.data());
+
+    AssignTestVisitor av(mbuf);
+    boost::apply_visitor(av, mbuf.vbuffer());
+  }
+};
+
+/*
+ * Ensure buffer layout, reusing compatible storage.
+ */
+struct EnsureBufferTestVisitor : public boost::static_visitor<>
+{
+  template<typename T>
+  void
+  operator() (const T& v)
+  {
+    typedef typename T::element_type::value_type value_type;
+
+    ome::compat::array<VariantPixelBuffer::size_type, 9> extents, other;
+    extents[0] = 5;
+    extents[1] = 2;
+    extents[2] = extents[3] = extents[4] = extents[5] = extents[6] = extents[7] = extents[8] = 1;
+    other = extents;
+    other[1] = 1;
+
+    const VariantPixelBuffer::storage_order_type order(PixelBufferBase::default_storage_order());
+
+    // Compatible external storage is used in place.
+    value_type backing[10];
+    VariantPixelBuffer ebuf(static_cast<void *>(&backing[0]), extents, v->pixelType(), order);
+    ASSERT_TRUE(ebuf.compatible(extents, v->pixelType(), order));
+    ASSERT_NO_THROW(ebuf.ensureBuffer(extents, v->pixelType(), order));
+    ASSERT_FALSE(ebuf.managed());
+    ASSERT_EQ(reinterpret_cast<VariantPixelBuffer::raw_type *>(&backing[0]), ebuf.data());
+
+    // Incompatible external storage can not be reallocated.
+    ASSERT_FALSE(ebuf.compatible(other, v->pixelType(), order));
+    ASSERT_THROW(ebuf.ensureBuffer(other, v->pixelType(), order), std::logic_error);
+
+    // Storage orders differing only in dimensions of extent 1 are
+    // equivalent.
+    const VariantPixelBuffer::storage_order_type planar
+      (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYCZT, false));
+    ASSERT_TRUE(ebuf.compatible(extents, v->pixelType(), planar));
+    ASSERT_NO_THROW(ebuf.ensureBuffer(extents, v->pixelType(), planar));
+    ASSERT_EQ(reinterpret_cast<VariantPixelBuffer::raw_type *>(&backing[0]), ebuf.data());
+
+    // Interleaved and planar samples are not equivalent.
+    ome::compat::array<VariantPixelBuffer::size_type, 9> samples(extents);
+    samples[1] = 1;
+    samples[ome::bioformats::DIM_SUBCHANNEL] = 2;
+    VariantPixelBuffer sbuf(static_cast<void *>(&backing[0]), samples, v->pixelType(), order);
+    ASSERT_TRUE(sbuf.compatible(samples, v->pixelType(), order));
+    ASSERT_FALSE(sbuf.compatible(samples, v->pixelType(), planar));
+    ASSERT_THROW(sbuf.ensureBuffer(samples, v->pixelType(), planar), std::logic_error);
+
+    // Compatible internal storage is used in place.
+    VariantPixelBuffer mbuf(extents, v->pixelType(), order);
+    const VariantPixelBuffer::raw_type *data = mbuf.data();
+    mbuf.ensureBuffer(extents, v->pixelType(), order);
+    ASSERT_EQ(data, mbuf.data());
+
+    // Incompatible internal storage is reallocated.
+    mbuf.ensureBuffer(other, v->pixelType(), order);
+    ASSERT_TRUE(mbuf.managed());
+    ASSERT_EQ(5U, mbuf.num_elements());
+    ASSERT_TRUE(mbuf.compatible(other, v->pixelType(), order));
+  }
+};
+
 /*
  * Data test.
  */
@@ -627,6 +721,30 @@ TEST_P(VariantPixelBufferTest, ConstructRangeRef)
   boost::apply_visitor(v, buf.vbuffer());
 }
 
+TEST_P(VariantPixelBufferTest, ConstructExtentRawRef)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  // Dummy, for type selection.
+  VariantPixelBuffer buf(boost::extents[5][2][1][1][1][1][1][1][1],
+                         params.type);
+
+  ConstructExtentRawRefTestVisitor v;
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
+TEST_P(VariantPixelBufferTest, EnsureBuffer)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  // Dummy, for type selection.
+  VariantPixelBuffer buf(boost::extents[5][2][1][1][1][1][1][1][1],
+                         params.type);
+
+  EnsureBufferTestVisitor v;
+  boost::apply_visitor(v, buf.vbuffer());
+}
+
 TEST_P(VariantPixelBufferTest, ConstructCopy)
 {
   const VariantPixelBufferTestParameters& params = GetParam();
@@ -660,6 +778,91 @@ TEST_P(VariantPixelBufferTest, ConstructCopy)
   ASSERT_NE(buf1, buf2);
 }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+TEST_P(VariantPixelBufferTest, ConstructMove)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf1(boost::extents[5][2][1][1][1][1][1][1][1],
+                          params.type);
+  AssignTestVisitor v(buf1);
+  boost::apply_visitor(v, buf1.vbuffer());
+  const VariantPixelBuffer::raw_type *data = buf1.data();
+
+  VariantPixelBuffer buf2(std::move(buf1));
+  ASSERT_FALSE(buf1.valid());
+  ASSERT_TRUE(buf2.valid());
+  ASSERT_EQ(data, buf2.data());
+  ASSERT_EQ(params.type, buf2.pixelType());
+}
+
+TEST_P(VariantPixelBufferTest, AssignMove)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf1(boost::extents[6][2][1][1][1][1][1][1][1],
+                          params.type);
+  const VariantPixelBuffer::raw_type *data = buf1.data();
+
+  VariantPixelBuffer buf2(boost::extents[5][2][1][1][1][1][1][1][1],
+                          PT::UINT16);
+  buf2 = std::move(buf1);
+  ASSERT_FALSE(buf1.valid());
+  ASSERT_EQ(data, buf2.data());
+  ASSERT_EQ(params.type, buf2.pixelType());
+  ASSERT_EQ(12U, buf2.num_elements());
+}
+#endif
+
+TEST_P(VariantPixelBufferTest, View)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[5][2][1][1][1][1][1][1][1],
+                         params.type);
+  ome::compat::shared_ptr<VariantPixelBuffer> view(buf.view());
+
+  ASSERT_EQ(buf.data(), view->data());
+  AssignTestVisitor v(*view);
+  boost::apply_visitor(v, view->vbuffer());
+  ASSERT_EQ(buf, *view);
+}
+
+TEST_P(VariantPixelBufferTest, Clone)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[5][2][1][1][1][3][1][1][1],
+                         params.type,
+                         PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+  AssignTestVisitor v(buf);
+  boost::apply_visitor(v, buf.vbuffer());
+
+  ome::compat::shared_ptr<VariantPixelBuffer> copy(buf.clone());
+  ASSERT_NE(buf.data(), copy->data());
+  ASSERT_EQ(buf.pixelType(), copy->pixelType());
+  ASSERT_TRUE(buf.storage_order() == copy->storage_order());
+  ASSERT_EQ(buf, *copy);
+}
+
+TEST_P(VariantPixelBufferTest, Swap)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf1(boost::extents[5][2][1][1][1][1][1][1][1],
+                          params.type);
+  VariantPixelBuffer buf2(boost::extents[3][2][1][1][1][1][1][1][1],
+                          PT::DOUBLE);
+  const VariantPixelBuffer::raw_type *data1 = buf1.data();
+  const VariantPixelBuffer::raw_type *data2 = buf2.data();
+
+  buf1.swap(buf2);
+  ASSERT_EQ(data2, buf1.data());
+  ASSERT_EQ(data1, buf2.data());
+  ASSERT_EQ(PT::DOUBLE, buf1.pixelType());
+  ASSERT_EQ(params.type, buf2.pixelType());
+}
+
 TEST_P(VariantPixelBufferTest, OperatorEquals)
 {
   const VariantPixelBufferTestParameters& params = GetParam();
@@ -921,6 +1124,41 @@ TEST_P(VariantPixelBufferTest, Origin)
   boost::apply_visitor(v, buf.vbuffer());
 }
 
+TEST_P(VariantPixelBufferTest, Span)
+{
+  const VariantPixelBufferTestParameters& params = GetParam();
+
+  VariantPixelBuffer buf(boost::extents[10][3][1][1][10][1][4][1][1],
+                         params.type);
+  const VariantPixelBuffer& cbuf(buf);
+
+  PixelSpan<VariantPixelBuffer::raw_type> span(buf.span());
+  PixelSpan<const VariantPixelBuffer::raw_type> cspan(cbuf.span());
+
+  EXPECT_EQ(buf.data(), span.data);
+  EXPECT_EQ(cbuf.data(), cspan.data);
+  EXPECT_EQ(ome::bioformats::bytesPerPixel(params.type), span.element_size);
+  EXPECT_TRUE(span.contiguous(ome::bioformats::DIM_SPATIAL_X));
+
+  for (boost::multi_array_types::size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+    {
+      EXPECT_EQ(cbuf.shape()[d], cspan.shape[d]);
+      EXPECT_EQ(cbuf.strides()[d] * static_cast<boost::multi_array_types::index>(cspan.element_size),
+                cspan.strides[d]);
+    }
+
+  VariantPixelBuffer::indices_type idx;
+  std::fill(idx.begin(), idx.end(), 0);
+  idx[ome::bioformats::DIM_SPATIAL_X] = 7;
+  idx[ome::bioformats::DIM_SPATIAL_Y] = 2;
+  idx[ome::bioformats::DIM_MODULO_Z] = 3;
+
+  EXPECT_EQ(span.data + ((7 + (2 * 10) + (3 * 30)) * span.element_size),
+            span.pointer(idx));
+  EXPECT_EQ(span.data + ((7 + (2 * 10)) * span.element_size),
+            span.pointer(7, 2));
+}
+
 TEST_P(VariantPixelBufferTest, StorageOrder)
 {
   const VariantPixelBufferTestParameters& params = GetParam();
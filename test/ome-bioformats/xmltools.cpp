@@ -38,9 +38,15 @@
 
 #include <fstream>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 #include <ome/bioformats/XMLTools.h>
 
 #include <ome/common/xml/Platform.h>
+#include <ome/common/xml/dom/Document.h>
+
+#include <ome/xml/Document.h>
 
 #include <ome/test/test.h>
 #include <ome/test/io.h>
@@ -102,6 +108,76 @@ TEST_P(XMLToolsFileTest, ValidateXML)
     }
 }
 
+TEST_P(XMLToolsFileTest, ValidateXMLRepeated)
+{
+  const XMLToolsFileTestParameters& params = GetParam();
+
+  std::string data;
+  readFile(params.filename, data);
+
+  // The second and subsequent validations use the cached schema.
+  for (int i = 0; i < 3; ++i)
+    {
+      EXPECT_EQ(params.valid, ome::bioformats::validateXML(data));
+    }
+}
+
+namespace
+{
+
+  void
+  validateThread(const std::string& data,
+                 bool&              valid)
+  {
+    valid = ome::bioformats::validateXML(data);
+  }
+
+}
+
+TEST_P(XMLToolsFileTest, ValidateXMLConcurrent)
+{
+  const XMLToolsFileTestParameters& params = GetParam();
+
+  std::string data;
+  readFile(params.filename, data);
+
+  bool valid[4];
+  boost::thread_group threads;
+  for (int i = 0; i < 4; ++i)
+    threads.create_thread(boost::bind(&validateThread, boost::cref(data), boost::ref(valid[i])));
+  threads.join_all();
+
+  for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_EQ(params.valid, valid[i]);
+    }
+}
+
+TEST_P(XMLToolsFileTest, ValidateXMLDocument)
+{
+  const XMLToolsFileTestParameters& params = GetParam();
+
+  std::string data;
+  readFile(params.filename, data);
+
+  ome::common::xml::dom::ParseParameters parseparams;
+  parseparams.doSchema = false;
+  parseparams.validationSchemaFullChecking = false;
+  ome::common::xml::dom::Document doc;
+  try
+    {
+      doc = ome::xml::createDocument(data, parseparams, params.filename);
+    }
+  catch (const std::runtime_error&)
+    {
+      // Not well-formed.
+      ASSERT_FALSE(params.valid);
+      return;
+    }
+
+  EXPECT_EQ(params.valid, ome::bioformats::validateXML(doc, params.filename));
+}
+
 XMLToolsFileTestParameters params[] =
   {
     XMLToolsFileTestParameters(PROJECT_SOURCE_DIR "/test/ome-bioformats/data/18x24y5z5t2c8b-text.ome",          true),